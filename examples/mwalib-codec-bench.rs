@@ -0,0 +1,139 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Measure the compression ratio and speed of the visibility chunk codec (`ChunkCodec::ShuffleZstd`)
+/// on converted visibilities, in both baseline and frequency order.
+///
+/// Without gpubox files, a synthetic noise-like chunk is used.
+use std::time::Instant;
+
+use anyhow::*;
+use structopt::StructOpt;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-codec-bench", author)]
+struct Opt {
+    /// Uncompressed size of each codec block, in KiB.
+    #[structopt(long, default_value = "1024")]
+    block_kib: usize,
+
+    /// Number of times each chunk is compressed and decompressed.
+    #[structopt(long, default_value = "5")]
+    repeats: usize,
+
+    /// Path to the metafits file.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: Option<std::path::PathBuf>,
+
+    /// Paths to the gpubox files.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    files: Vec<std::path::PathBuf>,
+}
+
+/// Compress and decompress `data` (whole and one row) `repeats` times, and print the results.
+#[cfg(not(tarpaulin_include))]
+fn bench_chunk(
+    name: &str,
+    data: &[f32],
+    row_floats: usize,
+    block_bytes: usize,
+    repeats: usize,
+) -> Result<(), anyhow::Error> {
+    let num_bytes = (data.len() * std::mem::size_of::<f32>() * repeats) as f64;
+
+    let start = Instant::now();
+    let mut compressed = Vec::new();
+    for _ in 0..repeats {
+        compressed = compress_rows_with_block_bytes(data, row_floats, block_bytes)?;
+    }
+    let compress_seconds = start.elapsed().as_secs_f64();
+
+    let mut output = vec![0.; data.len()];
+    let start = Instant::now();
+    for _ in 0..repeats {
+        decompress_into(&compressed, &mut output)?;
+    }
+    let decompress_seconds = start.elapsed().as_secs_f64();
+    ensure!(output == data, "{}: decompressed data differs", name);
+
+    // A single row from the middle only needs its own block
+    let num_rows = data.len() / row_floats;
+    let mut row = vec![0.; row_floats];
+    let start = Instant::now();
+    for _ in 0..repeats {
+        decompress_rows_into(&compressed, num_rows / 2..num_rows / 2 + 1, &mut row)?;
+    }
+    let row_seconds = start.elapsed().as_secs_f64() / repeats as f64;
+
+    println!(
+        "{:<24} {:>8.2} {:>14.2} {:>16.2} {:>12.1}",
+        name,
+        (data.len() * std::mem::size_of::<f32>()) as f64 / compressed.len() as f64,
+        num_bytes / compress_seconds / 1e9,
+        num_bytes / decompress_seconds / 1e9,
+        row_seconds * 1e6
+    );
+
+    Ok(())
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+    let block_bytes = opts.block_kib * 1024;
+
+    println!(
+        "{:<24} {:>8} {:>14} {:>16} {:>12}",
+        "chunk", "ratio", "compress GB/s", "decompress GB/s", "1 row (us)"
+    );
+
+    match opts.metafits {
+        None => {
+            // 8256 baselines * 128 fine channels * 4 pols * 2, like a 128T legacy HDU
+            let row_floats = 128 * 4 * 2;
+            let mut seed: u32 = 1;
+            let data: Vec<f32> = (0..8256 * row_floats)
+                .map(|i| {
+                    seed ^= seed << 13;
+                    seed ^= seed >> 17;
+                    seed ^= seed << 5;
+                    1000. + (i % row_floats) as f32 + (seed >> 20) as f32 * 0.01
+                })
+                .collect();
+            bench_chunk("synthetic", &data, row_floats, block_bytes, opts.repeats)?;
+        }
+        Some(metafits) => {
+            let context = CorrelatorContext::new(&metafits, &opts.files)?;
+            let num_fine_chans = context.metafits_context.num_corr_fine_chans_per_coarse;
+            let fine_chan_floats = context.num_timestep_coarse_chan_floats / num_fine_chans;
+            let baseline_floats =
+                context.num_timestep_coarse_chan_floats / context.metafits_context.num_baselines;
+
+            for coarse_chan_index in 0..context.num_coarse_chans {
+                let receiver = context.coarse_chans[coarse_chan_index].rec_chan_number;
+                let data = context.read_by_baseline(0, coarse_chan_index)?;
+                bench_chunk(
+                    &format!("ch{:03} by baseline", receiver),
+                    &data,
+                    baseline_floats,
+                    block_bytes,
+                    opts.repeats,
+                )?;
+                let data = context.read_by_frequency(0, coarse_chan_index)?;
+                bench_chunk(
+                    &format!("ch{:03} by frequency", receiver),
+                    &data,
+                    fine_chan_floats,
+                    block_bytes,
+                    opts.repeats,
+                )?;
+            }
+        }
+    }
+
+    Ok(())
+}
@@ -0,0 +1,67 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Convert legacy correlator gpubox files into MWAX format gpubox files.
+use anyhow::*;
+use structopt::StructOpt;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-convert-to-mwax", author)]
+struct Opt {
+    /// Path to the metafits file.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: std::path::PathBuf,
+
+    /// Directory to write the MWAX files into.
+    #[structopt(short, long, parse(from_os_str))]
+    output_dir: std::path::PathBuf,
+
+    /// Do not write a weights HDU after each visibility HDU.
+    #[structopt(long)]
+    no_weights: bool,
+
+    /// Replace output files which already exist.
+    #[structopt(long)]
+    overwrite: bool,
+
+    /// Number of files to write at once. Defaults to the number of CPUs.
+    #[structopt(short = "j", long)]
+    threads: Option<usize>,
+
+    /// Paths to the legacy gpubox files.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    files: Vec<std::path::PathBuf>,
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+
+    let mut context_options = CorrelatorContextOptions::new();
+    if let Some(threads) = opts.threads {
+        context_options = context_options.with_num_threads(threads, &[])?;
+    }
+    let context =
+        CorrelatorContext::new_with_options(&opts.metafits, &opts.files, &context_options)?;
+
+    let options = MwaxWriterOptions {
+        write_weights: !opts.no_weights,
+        overwrite: opts.overwrite,
+    };
+    let start = std::time::Instant::now();
+    let output_files = write_mwax_gpubox_files(&context, &opts.output_dir, &options)?;
+    for output_file in &output_files {
+        println!("{}", output_file);
+    }
+    eprintln!(
+        "Wrote {} files in {:.2} s",
+        output_files.len(),
+        start.elapsed().as_secs_f64()
+    );
+
+    Ok(())
+}
@@ -0,0 +1,87 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Flag RFI in gpubox files, and report how much was flagged and how much faster than real time it ran.
+use anyhow::*;
+use structopt::StructOpt;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-flag", author)]
+struct Opt {
+    /// Path to the metafits file.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: std::path::PathBuf,
+
+    /// Threshold for a single sample, in standard deviations.
+    #[structopt(long, default_value = "6")]
+    threshold: f32,
+
+    /// Number of timesteps flagged together.
+    #[structopt(long, default_value = "32")]
+    block_timesteps: usize,
+
+    /// Number of threads in the context's thread pool. 0 uses the global pool.
+    #[structopt(long, default_value = "0")]
+    threads: usize,
+
+    /// Paths to the gpubox files.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    files: Vec<std::path::PathBuf>,
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+    let context = if opts.threads > 0 {
+        CorrelatorContext::new_with_options(
+            &opts.metafits,
+            &opts.files,
+            &CorrelatorContextOptions::default().with_num_threads(opts.threads, &[])?,
+        )?
+    } else {
+        CorrelatorContext::new(&opts.metafits, &opts.files)?
+    };
+
+    let options = FlaggerOptions {
+        base_threshold: opts.threshold,
+        num_timesteps_per_block: opts.block_timesteps,
+        ..Default::default()
+    };
+    let start = std::time::Instant::now();
+    let flags = flag_visibilities(&context, &options)?;
+    let seconds = start.elapsed().as_secs_f64();
+
+    for (coarse_chan_index, coarse_chan) in context.coarse_chans.iter().enumerate() {
+        let num_flagged: usize = (0..context.num_timesteps)
+            .map(|t| {
+                flags
+                    .get_hdu_bitmap(t, coarse_chan_index)
+                    .iter()
+                    .map(|w| w.count_ones() as usize)
+                    .sum::<usize>()
+            })
+            .sum();
+        println!(
+            "Coarse channel {:>3}: {:6.2}% flagged",
+            coarse_chan.rec_chan_number,
+            100. * num_flagged as f64
+                / (context.num_timesteps * flags.get_num_hdu_visibilities()) as f64
+        );
+    }
+
+    // The observation time covered, against the time taken to flag it
+    let observed_seconds =
+        context.num_timesteps as f64 * context.metafits_context.corr_int_time_ms as f64 / 1000.;
+    println!(
+        "Flagged {:.1} s of data in {:.2} s ({:.1}x real time)",
+        observed_seconds,
+        seconds,
+        observed_seconds / seconds
+    );
+
+    Ok(())
+}
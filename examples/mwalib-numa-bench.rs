@@ -0,0 +1,138 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Compare the bandwidth of consuming buffers placed on the local NUMA node with buffers placed
+/// on a remote node, and optionally time scan reads of real data with and without NUMA placement.
+use std::sync::Arc;
+use std::time::Instant;
+
+use anyhow::*;
+use structopt::StructOpt;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-numa-bench", author)]
+struct Opt {
+    /// Size of the synthetic buffer, in MiB.
+    #[structopt(long, default_value = "256")]
+    size_mib: usize,
+
+    /// Number of times the consumer reads the synthetic buffer.
+    #[structopt(long, default_value = "10")]
+    repeats: usize,
+
+    /// Path to the metafits file. If given with gpubox files, scan reads are also timed.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: Option<std::path::PathBuf>,
+
+    /// Paths to the gpubox files.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    files: Vec<std::path::PathBuf>,
+}
+
+/// Fill a buffer on a thread pinned to `producer_cpus`, then sum it `repeats` times on a thread
+/// pinned to `consumer_cpus`. Returns the consumer bandwidth in GB/s.
+#[cfg(not(tarpaulin_include))]
+fn consume_bandwidth(
+    num_floats: usize,
+    repeats: usize,
+    producer_cpus: Vec<usize>,
+    consumer_cpus: Vec<usize>,
+) -> Result<f64, anyhow::Error> {
+    // First touch (and so page placement) happens on the producer's node
+    let buffer = std::thread::spawn(move || -> Result<AlignedBuffer, ThreadPoolError> {
+        set_current_thread_affinity(&producer_cpus)?;
+        let mut buffer = AlignedBuffer::new(num_floats, BufferAlignment::Page, false);
+        buffer
+            .iter_mut()
+            .enumerate()
+            .for_each(|(i, x)| *x = i as f32);
+        Ok(buffer)
+    })
+    .join()
+    .unwrap()?;
+
+    let (elapsed, sum) = std::thread::spawn(move || -> Result<(f64, f64), ThreadPoolError> {
+        set_current_thread_affinity(&consumer_cpus)?;
+        let start = Instant::now();
+        let mut sum: f64 = 0.;
+        for _ in 0..repeats {
+            sum += buffer.iter().map(|x| *x as f64).sum::<f64>();
+        }
+        Ok((start.elapsed().as_secs_f64(), sum))
+    })
+    .join()
+    .unwrap()?;
+
+    // Stop the sum being optimised away
+    if sum < 0. {
+        println!("{}", sum);
+    }
+
+    Ok((num_floats * std::mem::size_of::<f32>() * repeats) as f64 / elapsed / 1e9)
+}
+
+/// Time reading every timestep with `read_scan_by_frequency`. Returns the read rate in GB/s.
+#[cfg(not(tarpaulin_include))]
+fn scan_bandwidth(context: &CorrelatorContext) -> Result<f64, anyhow::Error> {
+    let start = Instant::now();
+    let mut num_bytes = 0;
+    for t in 0..context.num_timesteps {
+        let scan = context.read_scan_by_frequency(t)?;
+        num_bytes += scan.len() * context.num_timestep_coarse_chan_bytes;
+    }
+
+    Ok(num_bytes as f64 / start.elapsed().as_secs_f64() / 1e9)
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+
+    let topology = NumaTopology::detect();
+    print!("NUMA topology:\n{}", topology);
+
+    println!("\nSynthetic buffer placement ({} MiB):", opts.size_mib);
+    println!("{:>10} {:>10} {:>12}", "producer", "consumer", "GB/s");
+    let num_floats = opts.size_mib * 1024 * 1024 / std::mem::size_of::<f32>();
+    for producer in &topology.nodes {
+        for consumer in &topology.nodes {
+            let bandwidth = consume_bandwidth(
+                num_floats,
+                opts.repeats,
+                producer.cpus.clone(),
+                consumer.cpus.clone(),
+            )?;
+            println!(
+                "{:>10} {:>10} {:>12.2} ({})",
+                producer.id,
+                consumer.id,
+                bandwidth,
+                if producer.id == consumer.id {
+                    "local"
+                } else {
+                    "remote"
+                }
+            );
+        }
+    }
+    if topology.num_nodes() == 1 {
+        println!("Only one NUMA node, so there is no remote placement to compare against.");
+    }
+
+    if let Some(metafits) = opts.metafits {
+        println!("\nScan reads:");
+        let context = CorrelatorContext::new(&metafits, &opts.files)?;
+        println!("{:>10} {:>12.2}", "default", scan_bandwidth(&context)?);
+
+        let options = CorrelatorContextOptions::new()
+            .with_numa_placement(Arc::new(NumaPlacement::new(topology, &[])?));
+        let context = CorrelatorContext::new_with_options(&metafits, &opts.files, &options)?;
+        println!("{:>10} {:>12.2}", "numa", scan_bandwidth(&context)?);
+    }
+
+    Ok(())
+}
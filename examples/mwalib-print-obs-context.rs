@@ -27,8 +27,8 @@ fn main() -> Result<(), anyhow::Error> {
     let opts = Opt::from_args();
     let mut context = CorrelatorContext::new(&opts.metafits, &opts.files)?;
 
-    context
-        .metafits_context
+    // The metafits context is shared, so sort a copy of it
+    std::sync::Arc::make_mut(&mut context.metafits_context)
         .rf_inputs
         .sort_by_key(|k| k.subfile_order);
 
@@ -0,0 +1,130 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Measure how reading an observation scales with the number of processes, when the work is
+/// split into shards of whole gpubox files (every batch of a coarse channel in the same shard)
+/// with `CorrelatorContext::plan_shards`.
+///
+/// For each process count, the observation is planned into that many shards and one child
+/// process is started per shard. Each child opens a context on just its shard's files and
+/// reads every work unit in it.
+use std::process::{Command, Stdio};
+use std::time::Instant;
+
+use anyhow::*;
+use structopt::StructOpt;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-shard-bench", author)]
+struct Opt {
+    /// Largest number of processes to try. Defaults to the number of online CPUs.
+    #[structopt(short = "n", long)]
+    max_processes: Option<usize>,
+
+    /// Run as a worker: read every work unit of the given gpubox files and print the bytes read.
+    #[structopt(long)]
+    worker: bool,
+
+    /// Path to the metafits file.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: std::path::PathBuf,
+
+    /// Paths to the gpubox files.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    files: Vec<std::path::PathBuf>,
+}
+
+/// Read every work unit of the given files (a single shard). Returns the bytes read.
+#[cfg(not(tarpaulin_include))]
+fn run_worker(
+    metafits: &std::path::PathBuf,
+    files: &[std::path::PathBuf],
+) -> Result<u64, anyhow::Error> {
+    // The context only examines this shard's files
+    let context = CorrelatorContext::new(metafits, files)?;
+    let shards = context.plan_shards(1)?;
+
+    let mut buffer = vec![0.; context.num_timestep_coarse_chan_floats];
+    for work_unit in context.get_shard_work_units(&shards[0]) {
+        context.read_by_baseline_into_buffer(
+            work_unit.timestep_index,
+            work_unit.coarse_chan_index,
+            &mut buffer,
+        )?;
+    }
+
+    Ok(shards[0].num_bytes)
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+
+    if opts.worker {
+        println!("{}", run_worker(&opts.metafits, &opts.files)?);
+        return Ok(());
+    }
+
+    let context = CorrelatorContext::new(&opts.metafits, &opts.files)?;
+    // rayon's global pool has one thread per CPU
+    let max_processes = opts
+        .max_processes
+        .unwrap_or_else(rayon::current_num_threads);
+    let exe = std::env::current_exe()?;
+
+    println!(
+        "{:>10} {:>12} {:>12} {:>10} {:>10}",
+        "processes", "largest GB", "seconds", "GB/s", "speedup"
+    );
+    let mut single_process_seconds = None;
+    for num_processes in 1..=max_processes {
+        let shards = context.plan_shards(num_processes)?;
+
+        let start = Instant::now();
+        let children = shards
+            .iter()
+            .filter(|s| !s.files.is_empty())
+            .map(|s| {
+                Command::new(&exe)
+                    .arg("--worker")
+                    .arg("--metafits")
+                    .arg(&opts.metafits)
+                    .args(s.get_filenames())
+                    .stdout(Stdio::piped())
+                    .stderr(Stdio::piped())
+                    .spawn()
+            })
+            .collect::<Vec<_>>();
+
+        // All the workers are running now; wait for each in turn
+        let mut num_bytes: u64 = 0;
+        for child in children {
+            let output = child?.wait_with_output()?;
+            ensure!(
+                output.status.success(),
+                "worker failed: {}",
+                String::from_utf8_lossy(&output.stderr)
+            );
+            num_bytes += String::from_utf8_lossy(&output.stdout)
+                .trim()
+                .parse::<u64>()?;
+        }
+        let seconds = start.elapsed().as_secs_f64();
+        let single_process_seconds = *single_process_seconds.get_or_insert(seconds);
+
+        println!(
+            "{:>10} {:>12.3} {:>12.3} {:>10.2} {:>10.2}",
+            num_processes,
+            shards.iter().map(|s| s.num_bytes).max().unwrap_or(0) as f64 / 1e9,
+            seconds,
+            num_bytes as f64 / seconds / 1e9,
+            single_process_seconds / seconds
+        );
+    }
+
+    Ok(())
+}
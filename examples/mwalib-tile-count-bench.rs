@@ -0,0 +1,265 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Measure how creating a `CorrelatorContext` and reading with `read_by_baseline` scale with the
+/// number of tiles, using synthetic observations of 128, 256 and 512 (or any other numbers of)
+/// tiles.
+///
+/// Each synthetic observation is made from a real metafits file and gpubox file: the metafits
+/// file's TILEDATA table is grown (or shrunk) to the number of tiles, copying the existing rows
+/// and renumbering their inputs, antennas and tiles, and a gpubox file of the same format (legacy
+/// or MWAX), coarse channel and name is written with that many baselines per HDU. The files are
+/// written to a temporary directory, and each HDU is `num_baselines * fine chans * 32` bytes, so
+/// 512 tiles of 128 fine channels take 0.5 GB per timestep.
+use std::path::{Path, PathBuf};
+use std::time::Instant;
+
+use anyhow::*;
+use fitsio::images::{ImageDescription, ImageType};
+use fitsio::FitsFile;
+use structopt::StructOpt;
+use tempdir::TempDir;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-tile-count-bench", author)]
+struct Opt {
+    /// Numbers of tiles to benchmark. Legacy observations need a multiple of 32.
+    #[structopt(short, long, default_value = "128,256,512", use_delimiter = true)]
+    tiles: Vec<usize>,
+
+    /// Number of timesteps in each synthetic gpubox file.
+    #[structopt(short = "n", long, default_value = "2")]
+    timesteps: usize,
+
+    /// Path to the metafits file to base the synthetic observations on.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: PathBuf,
+
+    /// Path to a gpubox file of the observation, whose format, coarse channel and name the
+    /// synthetic gpubox files take.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    gpubox: PathBuf,
+}
+
+/// Return an error if a cfitsio call failed.
+#[cfg(not(tarpaulin_include))]
+fn check_status(status: i32, action: &str) -> Result<(), anyhow::Error> {
+    ensure!(status == 0, "cfitsio returned status {} {}", status, action);
+    Ok(())
+}
+
+/// Write a copy of a metafits file with `num_tiles` tiles. Rows added to the TILEDATA table copy
+/// the existing rows; every row then gets a new input, antenna, tile and position.
+#[cfg(not(tarpaulin_include))]
+fn write_metafits(
+    template: &Path,
+    num_template_inputs: usize,
+    num_tiles: usize,
+    filename: &Path,
+) -> Result<(), anyhow::Error> {
+    std::fs::copy(template, filename)?;
+    let mut fptr = FitsFile::edit(filename)?;
+    let num_inputs = num_tiles * 2;
+    let primary_hdu = fptr.primary_hdu()?;
+    primary_hdu.write_key(&mut fptr, "NINPUTS", num_inputs as i64)?;
+
+    let tile_hdu = fptr.hdu(1)?;
+    let row_bytes: i64 = tile_hdu.read_key(&mut fptr, "NAXIS1")?;
+    let mut row = vec![0_u8; row_bytes as usize];
+    let mut status = 0;
+    unsafe {
+        if num_inputs > num_template_inputs {
+            fitsio_sys::ffirow(
+                fptr.as_raw(),
+                num_template_inputs as i64,
+                (num_inputs - num_template_inputs) as i64,
+                &mut status,
+            );
+            check_status(status, "inserting TILEDATA rows")?;
+            // FITS rows count from 1
+            for output_row in num_template_inputs..num_inputs {
+                let input_row = output_row % num_template_inputs;
+                fitsio_sys::ffgtbb(
+                    fptr.as_raw(),
+                    input_row as i64 + 1,
+                    1,
+                    row_bytes,
+                    row.as_mut_ptr(),
+                    &mut status,
+                );
+                fitsio_sys::ffptbb(
+                    fptr.as_raw(),
+                    output_row as i64 + 1,
+                    1,
+                    row_bytes,
+                    row.as_mut_ptr(),
+                    &mut status,
+                );
+                check_status(status, "copying TILEDATA rows")?;
+            }
+        } else if num_inputs < num_template_inputs {
+            fitsio_sys::ffdrow(
+                fptr.as_raw(),
+                num_inputs as i64 + 1,
+                (num_template_inputs - num_inputs) as i64,
+                &mut status,
+            );
+            check_status(status, "deleting TILEDATA rows")?;
+        }
+    }
+
+    // Two rows (X and Y) per tile, on a grid with 10 m spacing
+    let tile_indices: Vec<i32> = (0..num_inputs).map(|i| (i / 2) as i32).collect();
+    let inputs: Vec<i32> = (0..num_inputs as i32).collect();
+    let tile_ids: Vec<i32> = tile_indices.iter().map(|t| 1000 + t).collect();
+    let tile_names: Vec<String> = tile_indices.iter().map(|t| format!("S{:05}", t)).collect();
+    let pols: Vec<String> = (0..num_inputs)
+        .map(|i| if i % 2 == 0 { "X" } else { "Y" }.to_string())
+        .collect();
+    let east_m: Vec<f64> = tile_indices.iter().map(|t| (t % 32) as f64 * 10.).collect();
+    let north_m: Vec<f64> = tile_indices.iter().map(|t| (t / 32) as f64 * 10.).collect();
+
+    let tile_hdu = fptr.hdu(1)?;
+    tile_hdu.write_col(&mut fptr, "Input", &inputs)?;
+    tile_hdu.write_col(&mut fptr, "Antenna", &tile_indices)?;
+    tile_hdu.write_col(&mut fptr, "Tile", &tile_ids)?;
+    tile_hdu.write_col(&mut fptr, "TileName", &tile_names)?;
+    tile_hdu.write_col(&mut fptr, "Pol", &pols)?;
+    tile_hdu.write_col(&mut fptr, "East", &east_m)?;
+    tile_hdu.write_col(&mut fptr, "North", &north_m)?;
+
+    Ok(())
+}
+
+/// Write a gpubox file of the template context's format and first coarse channel, with
+/// `num_timesteps` HDUs of `num_baselines` baselines of noise-like data.
+#[cfg(not(tarpaulin_include))]
+fn write_gpubox(
+    template: &CorrelatorContext,
+    num_baselines: usize,
+    num_timesteps: usize,
+    filename: &Path,
+) -> Result<(), anyhow::Error> {
+    let metafits_context = &template.metafits_context;
+    let num_fine_chans = metafits_context.num_corr_fine_chans_per_coarse;
+    let num_pols = metafits_context.num_visibility_pols;
+    let num_floats = num_baselines * num_fine_chans * num_pols * 2;
+    let is_mwax = template.corr_version == CorrelatorVersion::V2;
+
+    let mut fptr = FitsFile::create(filename).overwrite().open()?;
+    let first_time_ms = template.timesteps[0].unix_time_ms;
+    let primary_hdu = fptr.primary_hdu()?;
+    primary_hdu.write_key(&mut fptr, "OBSID", metafits_context.obs_id as i64)?;
+    primary_hdu.write_key(&mut fptr, "TIME", (first_time_ms / 1000) as i64)?;
+    primary_hdu.write_key(&mut fptr, "MILLITIM", (first_time_ms % 1000) as i64)?;
+    if is_mwax {
+        primary_hdu.write_key(&mut fptr, "CORR_VER", 2_i64)?;
+        primary_hdu.write_key(
+            &mut fptr,
+            "COARSE_CHAN",
+            template.coarse_chans[0].rec_chan_number as i64,
+        )?;
+        primary_hdu.write_key(&mut fptr, "NFINECHS", num_fine_chans as i64)?;
+    }
+
+    let data: Vec<f32> = (0..num_floats)
+        .map(|i| ((i as u32).wrapping_mul(2_654_435_761) >> 8) as f32)
+        .collect();
+    let weights = vec![1.0_f32; num_baselines * num_pols];
+    for timestep_index in 0..num_timesteps {
+        let unix_time_ms =
+            first_time_ms + timestep_index as u64 * metafits_context.corr_int_time_ms;
+        // MWAX: NAXIS1 = fine chans * pols * 2, NAXIS2 = baselines, then a weights HDU.
+        // Legacy: NAXIS1 = baselines * pols * 2, NAXIS2 = fine chans.
+        let mut hdus: Vec<([usize; 2], &[f32])> = Vec::new();
+        if is_mwax {
+            hdus.push(([num_baselines, num_fine_chans * num_pols * 2], &data[..]));
+            hdus.push(([num_baselines, num_pols], &weights[..]));
+        } else {
+            hdus.push(([num_fine_chans, num_baselines * num_pols * 2], &data[..]));
+        }
+        for (dimensions, hdu_data) in hdus {
+            let hdu = fptr.create_image(
+                "DATA".to_string(),
+                &ImageDescription {
+                    data_type: ImageType::Float,
+                    dimensions: &dimensions,
+                },
+            )?;
+            hdu.write_key(&mut fptr, "TIME", (unix_time_ms / 1000) as i64)?;
+            hdu.write_key(&mut fptr, "MILLITIM", (unix_time_ms % 1000) as i64)?;
+            hdu.write_image(&mut fptr, hdu_data)?;
+        }
+    }
+
+    Ok(())
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+    ensure!(opts.timesteps > 0, "--timesteps must be at least 1");
+
+    let template = CorrelatorContext::new(&opts.metafits, &[opts.gpubox.clone()])?;
+    let dir = TempDir::new("mwalib-tile-count-bench")?;
+    let metafits_filename = dir.path().join(
+        opts.metafits
+            .file_name()
+            .context("metafits path has no file name")?,
+    );
+    let gpubox_filename = dir.path().join(
+        opts.gpubox
+            .file_name()
+            .context("gpubox path has no file name")?,
+    );
+
+    println!(
+        "{:>6} {:>10} {:>10} {:>12} {:>12} {:>10}",
+        "tiles", "baselines", "HDU MB", "context ms", "read ms", "GB/s"
+    );
+    for num_tiles in &opts.tiles {
+        let num_baselines = get_baseline_count(*num_tiles);
+        write_metafits(
+            &opts.metafits,
+            template.metafits_context.num_rf_inputs,
+            *num_tiles,
+            &metafits_filename,
+        )?;
+        write_gpubox(&template, num_baselines, opts.timesteps, &gpubox_filename)?;
+
+        let start = Instant::now();
+        let context = CorrelatorContext::new(&metafits_filename, &[gpubox_filename.clone()])?;
+        let context_seconds = start.elapsed().as_secs_f64();
+        ensure!(
+            context.metafits_context.num_baselines == num_baselines,
+            "expected {} baselines, the context has {}",
+            num_baselines,
+            context.metafits_context.num_baselines
+        );
+
+        // The first read also warms the page cache, so it is not timed
+        context.read_by_baseline(0, 0)?;
+        let start = Instant::now();
+        for timestep_index in 0..context.num_timesteps {
+            context.read_by_baseline(timestep_index, 0)?;
+        }
+        let read_seconds = start.elapsed().as_secs_f64() / context.num_timesteps as f64;
+        let hdu_bytes = context.num_timestep_coarse_chan_bytes as f64;
+
+        println!(
+            "{:>6} {:>10} {:>10.1} {:>12.2} {:>12.2} {:>10.2}",
+            num_tiles,
+            num_baselines,
+            hdu_bytes / 1e6,
+            context_seconds * 1e3,
+            read_seconds * 1e3,
+            hdu_bytes / read_seconds / 1e9
+        );
+    }
+
+    Ok(())
+}
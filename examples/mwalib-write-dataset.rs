@@ -0,0 +1,81 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Write gpubox files to a chunked dataset, then time reading a slice along each dimension.
+use std::time::Instant;
+
+use anyhow::*;
+use structopt::StructOpt;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-write-dataset", author)]
+struct Opt {
+    /// Path to the metafits file.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: std::path::PathBuf,
+
+    /// Directory to write the dataset into.
+    #[structopt(short, long, parse(from_os_str))]
+    output_dir: std::path::PathBuf,
+
+    /// Chunk shape as time,coarse_chan,fine_chan,baseline,pol.
+    #[structopt(long, default_value = "1,1,32,1024,4")]
+    chunk_shape: String,
+
+    /// Replace an existing dataset.
+    #[structopt(long)]
+    overwrite: bool,
+
+    /// Paths to the gpubox files.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    files: Vec<std::path::PathBuf>,
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+    let context = CorrelatorContext::new(&opts.metafits, &opts.files)?;
+
+    let values: Vec<usize> = opts
+        .chunk_shape
+        .split(',')
+        .map(|v| v.trim().parse())
+        .collect::<Result<_, _>>()?;
+    ensure!(values.len() == 5, "The chunk shape needs 5 dimensions");
+    let mut chunk_shape = [0; 5];
+    chunk_shape.copy_from_slice(&values);
+
+    let options = DatasetWriterOptions {
+        chunk_shape,
+        overwrite: opts.overwrite,
+    };
+    let start = Instant::now();
+    let dataset = write_dataset(&context, &opts.output_dir, &options)?;
+    println!(
+        "Wrote shape {:?} in chunks of {:?} in {:.2} s",
+        dataset.shape(),
+        dataset.chunk_shape(),
+        start.elapsed().as_secs_f64()
+    );
+
+    // One element wide in every dimension except the one being sliced along
+    let shape = dataset.shape();
+    for (dim, name) in DATASET_DIMENSIONS.iter().enumerate() {
+        let mut ranges = [0..1, 0..1, 0..1, 0..1, 0..1];
+        ranges[dim] = 0..shape[dim];
+        let start = Instant::now();
+        let data = dataset.read(&ranges)?;
+        println!(
+            "Slice along {:<12} {:>8} values in {:>8.1} us",
+            name,
+            data.len() / 2,
+            start.elapsed().as_secs_f64() * 1e6
+        );
+    }
+
+    Ok(())
+}
@@ -0,0 +1,83 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// Write gpubox files to a UVFITS file, and report the throughput.
+use anyhow::*;
+use structopt::StructOpt;
+
+use mwalib::*;
+
+#[cfg(not(tarpaulin_include))]
+#[derive(StructOpt, Debug)]
+#[structopt(name = "mwalib-write-uvfits", author)]
+struct Opt {
+    /// Path to the metafits file.
+    #[structopt(short, long, parse(from_os_str))]
+    metafits: std::path::PathBuf,
+
+    /// The UVFITS file to write.
+    #[structopt(short, long, parse(from_os_str))]
+    output: std::path::PathBuf,
+
+    /// Number of timesteps to average together.
+    #[structopt(long, default_value = "1")]
+    time_average: usize,
+
+    /// Number of fine channels to average together.
+    #[structopt(long, default_value = "1")]
+    freq_average: usize,
+
+    /// Leave the visibilities phased to zenith.
+    #[structopt(long)]
+    no_phase_rotate: bool,
+
+    /// Replace the output file if it exists.
+    #[structopt(long)]
+    overwrite: bool,
+
+    /// Number of threads reading gpubox files.
+    #[structopt(long, default_value = "2")]
+    read_workers: usize,
+
+    /// Number of threads converting visibilities.
+    #[structopt(long, default_value = "2")]
+    convert_workers: usize,
+
+    /// Paths to the gpubox files.
+    #[structopt(name = "GPUBOX FILE", parse(from_os_str))]
+    files: Vec<std::path::PathBuf>,
+}
+
+#[cfg(not(tarpaulin_include))]
+fn main() -> Result<(), anyhow::Error> {
+    let opts = Opt::from_args();
+    let context = CorrelatorContext::new(&opts.metafits, &opts.files)?;
+
+    let options = UvfitsWriterOptions {
+        time_average: opts.time_average,
+        freq_average: opts.freq_average,
+        phase_rotate: !opts.no_phase_rotate,
+        overwrite: opts.overwrite,
+        num_read_workers: opts.read_workers,
+        num_convert_workers: opts.convert_workers,
+    };
+    let start = std::time::Instant::now();
+    let num_groups = write_uvfits(&context, &opts.output, &options)?;
+    let seconds = start.elapsed().as_secs_f64();
+
+    // The gpubox data read, against the UVFITS file written
+    let read_bytes = (context.num_timesteps
+        * context.num_coarse_chans
+        * context.num_timestep_coarse_chan_bytes) as f64;
+    let written_bytes = std::fs::metadata(&opts.output)?.len() as f64;
+    println!(
+        "Wrote {} groups in {:.2} s: read {:.1} MB/s, wrote {:.1} MB/s",
+        num_groups,
+        seconds,
+        read_bytes / seconds / 1e6,
+        written_bytes / seconds / 1e6
+    );
+
+    Ok(())
+}
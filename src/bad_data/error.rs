@@ -0,0 +1,27 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with finding bad data and saving bad data reports.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum BadDataError {
+    /// Error when a saved report cannot be parsed.
+    #[error("Invalid bad data report {filename} at line {line_number}")]
+    InvalidReport {
+        filename: String,
+        line_number: usize,
+    },
+
+    /// An error derived from `FitsError`, from reading a gpubox file.
+    #[error("{0}")]
+    Fits(#[from] crate::fits_read::error::FitsError),
+
+    /// An IO error, from saving or loading a report.
+    #[error("{0}")]
+    Io(#[from] std::io::Error),
+}
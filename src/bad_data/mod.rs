@@ -0,0 +1,628 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Find bad data (NaN, infinite or all-zero visibilities) in gpubox HDUs.
+
+`find_bad_data` scans every HDU of a context straight from its gpubox files, without converting
+them. The files are scanned in parallel in the context's thread pool, each by one worker reading
+its HDUs in file order, so the scan runs at close to disk bandwidth. Each HDU is first checked
+with a single branch-free count over all of its floats; only HDUs with bad data get a second pass
+counting bad visibilities per baseline and per fine channel.
+
+`get_hdu_bad_data` checks data already read with any of the context's reads, so the same check
+can be made as part of the read path (e.g. in a `Pipeline`'s user stage).
+
+A `BadDataReport` only lists HDUs with bad data. It can be saved to and loaded from a directory;
+`find_bad_data` saves it in the context's scan cache directory, next to the cache's index.
+ */
+pub mod error;
+pub use error::BadDataError;
+
+use std::collections::BTreeMap;
+use std::fs;
+use std::path::{Path, PathBuf};
+
+use rayon::prelude::*;
+
+use crate::correlator_context::CorrelatorContext;
+use crate::metafits_context::CorrelatorVersion;
+use crate::*;
+
+#[cfg(test)]
+mod test;
+
+/// Appended to the obs ID to give a saved report's filename
+pub const BAD_DATA_REPORT_SUFFIX: &str = "_bad_data.txt";
+/// First line of a saved report. The last character is the format version.
+const REPORT_HEADER: &str = "# mwalib bad data report v1";
+
+/// Options for `find_bad_data`.
+#[derive(Clone, Debug)]
+pub struct BadDataOptions {
+    /// If the context has a scan cache, save the report in the cache's directory.
+    pub save_to_scan_cache: bool,
+}
+
+impl Default for BadDataOptions {
+    fn default() -> Self {
+        BadDataOptions {
+            save_to_scan_cache: true,
+        }
+    }
+}
+
+/// The bad data in one HDU. Visibility counts are of complex visibilities (r, i pairs).
+#[derive(Clone, Debug, Default, PartialEq, Eq)]
+pub struct HduBadData {
+    /// Index within the context's timesteps
+    pub timestep_index: usize,
+    /// Index within the context's coarse_chans
+    pub coarse_chan_index: usize,
+    /// Number of visibilities with a NaN part
+    pub num_nan: usize,
+    /// Number of visibilities with an infinite part
+    pub num_inf: usize,
+    /// Number of visibilities which are exactly 0
+    pub num_zero: usize,
+    /// (baseline index, number of bad visibilities) for each baseline with any bad visibilities
+    pub bad_baselines: Vec<(usize, usize)>,
+    /// (fine channel index, number of bad visibilities) for each fine channel with any bad visibilities
+    pub bad_fine_chans: Vec<(usize, usize)>,
+}
+
+impl HduBadData {
+    /// Returns true if the HDU has no bad visibilities.
+    pub fn is_clean(&self) -> bool {
+        self.num_nan == 0 && self.num_inf == 0 && self.num_zero == 0
+    }
+
+    /// Number of bad visibilities (NaN, infinite or zero).
+    pub fn get_num_bad(&self) -> usize {
+        self.bad_baselines.iter().map(|(_, n)| n).sum()
+    }
+}
+
+/// The bad data found in a context's HDUs.
+#[derive(Clone, Debug, PartialEq)]
+pub struct BadDataReport {
+    /// Observation ID
+    pub obs_id: u32,
+    /// Number of baselines in each HDU
+    pub num_baselines: usize,
+    /// Number of fine channels in each HDU
+    pub num_fine_chans_per_coarse: usize,
+    /// Number of visibility pols
+    pub num_pols: usize,
+    /// Number of HDUs checked
+    pub num_hdus_checked: usize,
+    /// The HDUs which have any bad data, in timestep then coarse channel order
+    pub hdus: Vec<HduBadData>,
+}
+
+impl BadDataReport {
+    /// Number of visibilities in each HDU.
+    pub fn get_num_hdu_visibilities(&self) -> usize {
+        self.num_baselines * self.num_fine_chans_per_coarse * self.num_pols
+    }
+
+    /// The HDUs which are entirely zeros.
+    pub fn get_all_zero_hdus(&self) -> Vec<&HduBadData> {
+        let num_visibilities = self.get_num_hdu_visibilities();
+        self.hdus
+            .iter()
+            .filter(|h| h.num_zero == num_visibilities)
+            .collect()
+    }
+
+    /// The filename a report of an observation is saved as.
+    pub fn get_filename(obs_id: u32) -> String {
+        format!("{}{}", obs_id, BAD_DATA_REPORT_SUFFIX)
+    }
+
+    /// Save the report in a directory, replacing any report of the same observation.
+    ///
+    /// # Arguments
+    ///
+    /// * `dir` - the directory to save in.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the path of the saved report, or a `BadDataError`.
+    ///
+    ///
+    pub fn save<P: AsRef<Path>>(&self, dir: P) -> Result<PathBuf, BadDataError> {
+        let mut contents = format!(
+            "{}\nobs_id {}\nshape {} {} {}\nhdus_checked {}\n",
+            REPORT_HEADER,
+            self.obs_id,
+            self.num_baselines,
+            self.num_fine_chans_per_coarse,
+            self.num_pols,
+            self.num_hdus_checked
+        );
+        for hdu in &self.hdus {
+            contents.push_str(&format!(
+                "hdu {} {} {} {} {} baselines {} fine_chans {}\n",
+                hdu.timestep_index,
+                hdu.coarse_chan_index,
+                hdu.num_nan,
+                hdu.num_inf,
+                hdu.num_zero,
+                format_counts(&hdu.bad_baselines),
+                format_counts(&hdu.bad_fine_chans)
+            ));
+        }
+
+        // Via a temporary file, so the report is replaced atomically
+        let path = dir.as_ref().join(Self::get_filename(self.obs_id));
+        let temp_path = dir.as_ref().join(format!(
+            "{}.{}.tmp",
+            Self::get_filename(self.obs_id),
+            std::process::id()
+        ));
+        fs::write(&temp_path, contents)?;
+        fs::rename(&temp_path, &path)?;
+
+        Ok(path)
+    }
+
+    /// Load a saved report of an observation from a directory.
+    ///
+    /// # Arguments
+    ///
+    /// * `dir` - the directory the report was saved in.
+    ///
+    /// * `obs_id` - the observation ID.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the report, or None if there is no saved report, or a `BadDataError`.
+    ///
+    ///
+    pub fn load<P: AsRef<Path>>(dir: P, obs_id: u32) -> Result<Option<Self>, BadDataError> {
+        let path = dir.as_ref().join(Self::get_filename(obs_id));
+        let contents = match fs::read_to_string(&path) {
+            Ok(c) => c,
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(None),
+            Err(e) => return Err(e.into()),
+        };
+        let invalid = |line_number: usize| BadDataError::InvalidReport {
+            filename: path.display().to_string(),
+            line_number,
+        };
+
+        let lines: Vec<&str> = contents.lines().collect();
+        if lines.first() != Some(&REPORT_HEADER) {
+            return Err(invalid(1));
+        }
+        // The "key value..." lines after the header
+        let get_fields = |line_index: usize, key: &str| -> Result<Vec<usize>, BadDataError> {
+            let mut fields = lines
+                .get(line_index)
+                .ok_or_else(|| invalid(line_index + 1))?
+                .split_whitespace();
+            if fields.next() != Some(key) {
+                return Err(invalid(line_index + 1));
+            }
+            fields
+                .map(|f| f.parse().map_err(|_| invalid(line_index + 1)))
+                .collect()
+        };
+        if get_fields(1, "obs_id")? != [obs_id as usize] {
+            return Err(invalid(2));
+        }
+        let shape = get_fields(2, "shape")?;
+        if shape.len() != 3 {
+            return Err(invalid(3));
+        }
+        let hdus_checked = get_fields(3, "hdus_checked")?;
+        if hdus_checked.len() != 1 {
+            return Err(invalid(4));
+        }
+
+        let mut hdus = Vec::new();
+        for (line_index, line) in lines.iter().enumerate().skip(4) {
+            if line.trim().is_empty() {
+                continue;
+            }
+            hdus.push(parse_hdu_line(line).ok_or_else(|| invalid(line_index + 1))?);
+        }
+
+        Ok(Some(BadDataReport {
+            obs_id,
+            num_baselines: shape[0],
+            num_fine_chans_per_coarse: shape[1],
+            num_pols: shape[2],
+            num_hdus_checked: hdus_checked[0],
+            hdus,
+        }))
+    }
+}
+
+/// How visibilities map to baselines and fine channels in the data being checked
+enum VisibilityLayout {
+    /// [baseline][fine_chan][pol][r][i]: MWAX HDUs, and data read by baseline
+    BaselineMajor,
+    /// [fine_chan][...][r][i], where the baseline of each visibility within a fine channel is
+    /// given: legacy HDUs, and data read by frequency
+    FrequencyMajor(Vec<u32>),
+}
+
+/// Format (index, count) pairs as "index:count,..." with runs of consecutive indices with the
+/// same count as "first-last:count", or "-" if there are none.
+fn format_counts(counts: &[(usize, usize)]) -> String {
+    if counts.is_empty() {
+        return "-".to_string();
+    }
+
+    let mut runs: Vec<(usize, usize, usize)> = Vec::new();
+    for (index, count) in counts {
+        match runs.last_mut() {
+            Some((_, last, run_count)) if *last + 1 == *index && run_count == count => {
+                *last = *index
+            }
+            _ => runs.push((*index, *index, *count)),
+        }
+    }
+
+    runs.iter()
+        .map(|(first, last, count)| match first == last {
+            true => format!("{}:{}", first, count),
+            false => format!("{}-{}:{}", first, last, count),
+        })
+        .collect::<Vec<String>>()
+        .join(",")
+}
+
+/// Parse the output of `format_counts`.
+fn parse_counts(s: &str) -> Option<Vec<(usize, usize)>> {
+    if s == "-" {
+        return Some(Vec::new());
+    }
+
+    let mut counts = Vec::new();
+    for run in s.split(',') {
+        let mut parts = run.split(':');
+        let (indices, count) = (parts.next()?, parts.next()?.parse().ok()?);
+        if parts.next().is_some() {
+            return None;
+        }
+        let (first, last) = match indices.find('-') {
+            Some(dash) => (
+                indices[..dash].parse().ok()?,
+                indices[dash + 1..].parse().ok()?,
+            ),
+            None => {
+                let index = indices.parse().ok()?;
+                (index, index)
+            }
+        };
+        counts.extend((first..=last).map(|index| (index, count)));
+    }
+
+    Some(counts)
+}
+
+/// Parse a line of a saved report:
+/// "hdu <timestep> <coarse chan> <nan> <inf> <zero> baselines <counts> fine_chans <counts>".
+fn parse_hdu_line(line: &str) -> Option<HduBadData> {
+    let fields: Vec<&str> = line.split_whitespace().collect();
+    if fields.len() != 10
+        || fields[0] != "hdu"
+        || fields[6] != "baselines"
+        || fields[8] != "fine_chans"
+    {
+        return None;
+    }
+    let numbers: Vec<usize> = fields[1..6]
+        .iter()
+        .map(|f| f.parse().ok())
+        .collect::<Option<_>>()?;
+
+    Some(HduBadData {
+        timestep_index: numbers[0],
+        coarse_chan_index: numbers[1],
+        num_nan: numbers[2],
+        num_inf: numbers[3],
+        num_zero: numbers[4],
+        bad_baselines: parse_counts(fields[7])?,
+        bad_fine_chans: parse_counts(fields[9])?,
+    })
+}
+
+/// Returns true if a visibility is NaN, infinite or zero.
+#[inline]
+fn is_bad_visibility(r: f32, i: f32) -> bool {
+    !(r.is_finite() && i.is_finite()) || (r == 0. && i == 0.)
+}
+
+/// Count the visibilities with a NaN part, an infinite part, and which are zero. The loop has no
+/// branches, so it is vectorised.
+///
+/// # Arguments
+///
+/// * `data` - visibilities as [r][i] pairs, in any order.
+///
+///
+/// # Returns
+///
+/// * (NaN count, infinite count, zero count)
+///
+///
+fn count_bad_visibilities(data: &[f32]) -> (usize, usize, usize) {
+    let (mut num_nan, mut num_inf, mut num_zero) = (0, 0, 0);
+    for ri in data.chunks_exact(2) {
+        let (r, i) = (ri[0], ri[1]);
+        num_nan += (r.is_nan() | i.is_nan()) as usize;
+        num_inf += (r.is_infinite() | i.is_infinite()) as usize;
+        num_zero += ((r == 0.) & (i == 0.)) as usize;
+    }
+    (num_nan, num_inf, num_zero)
+}
+
+/// Find the bad data in one HDU's worth of visibilities.
+///
+/// # Arguments
+///
+/// * `data` - the visibilities.
+///
+/// * `layout` - where each visibility's baseline and fine channel are.
+///
+/// * `num_baselines` - number of baselines.
+///
+/// * `num_fine_chans` - number of fine channels.
+///
+/// * `work_unit` - the timestep and coarse channel the data is for.
+///
+///
+/// # Returns
+///
+/// * The `HduBadData`.
+///
+///
+fn scan_visibilities(
+    data: &[f32],
+    layout: &VisibilityLayout,
+    num_baselines: usize,
+    num_fine_chans: usize,
+    work_unit: WorkUnit,
+) -> HduBadData {
+    let (num_nan, num_inf, num_zero) = count_bad_visibilities(data);
+    let mut hdu = HduBadData {
+        timestep_index: work_unit.timestep_index,
+        coarse_chan_index: work_unit.coarse_chan_index,
+        num_nan,
+        num_inf,
+        num_zero,
+        ..Default::default()
+    };
+    if hdu.is_clean() {
+        return hdu;
+    }
+
+    let mut baseline_counts = vec![0; num_baselines];
+    let mut fine_chan_counts = vec![0; num_fine_chans];
+    match layout {
+        VisibilityLayout::BaselineMajor => {
+            let baseline_floats = data.len() / num_baselines;
+            let fine_chan_floats = baseline_floats / num_fine_chans;
+            for (baseline_count, baseline_data) in baseline_counts
+                .iter_mut()
+                .zip(data.chunks_exact(baseline_floats))
+            {
+                for (fine_chan_count, vis) in fine_chan_counts
+                    .iter_mut()
+                    .zip(baseline_data.chunks_exact(fine_chan_floats))
+                {
+                    let num_bad = vis
+                        .chunks_exact(2)
+                        .filter(|ri| is_bad_visibility(ri[0], ri[1]))
+                        .count();
+                    *baseline_count += num_bad;
+                    *fine_chan_count += num_bad;
+                }
+            }
+        }
+        VisibilityLayout::FrequencyMajor(vis_baselines) => {
+            for (fine_chan_count, fine_chan_data) in fine_chan_counts
+                .iter_mut()
+                .zip(data.chunks_exact(vis_baselines.len() * 2))
+            {
+                for (baseline_index, ri) in vis_baselines.iter().zip(fine_chan_data.chunks_exact(2))
+                {
+                    let bad = is_bad_visibility(ri[0], ri[1]) as usize;
+                    baseline_counts[*baseline_index as usize] += bad;
+                    *fine_chan_count += bad;
+                }
+            }
+        }
+    }
+
+    let nonzero = |counts: Vec<usize>| -> Vec<(usize, usize)> {
+        counts
+            .into_iter()
+            .enumerate()
+            .filter(|(_, count)| *count > 0)
+            .collect()
+    };
+    hdu.bad_baselines = nonzero(baseline_counts);
+    hdu.bad_fine_chans = nonzero(fine_chan_counts);
+    hdu
+}
+
+/// Find the bad data in one timestep and coarse channel which has already been read.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` the data was read from.
+///
+/// * `work_unit` - the timestep and coarse channel the data is for.
+///
+/// * `data` - the visibilities, `num_timestep_coarse_chan_floats` floats.
+///
+/// * `by_frequency` - true if `data` is in [frequency][baseline][pol][r][i] order, false if it is in
+///                    [baseline][frequency][pol][r][i] order.
+///
+///
+/// # Returns
+///
+/// * The `HduBadData`.
+///
+///
+pub fn get_hdu_bad_data(
+    context: &CorrelatorContext,
+    work_unit: WorkUnit,
+    data: &[f32],
+    by_frequency: bool,
+) -> HduBadData {
+    let metafits_context = &context.metafits_context;
+    let num_baselines = metafits_context.num_baselines;
+    let layout = match by_frequency {
+        true => VisibilityLayout::FrequencyMajor(
+            (0..num_baselines * metafits_context.num_visibility_pols)
+                .map(|v| (v / metafits_context.num_visibility_pols) as u32)
+                .collect(),
+        ),
+        false => VisibilityLayout::BaselineMajor,
+    };
+
+    scan_visibilities(
+        &data[..context.num_timestep_coarse_chan_floats],
+        &layout,
+        num_baselines,
+        metafits_context.num_corr_fine_chans_per_coarse,
+        work_unit,
+    )
+}
+
+/// The layout of a context's HDUs as they are stored in its gpubox files.
+fn get_raw_layout(context: &CorrelatorContext) -> VisibilityLayout {
+    match context.corr_version {
+        CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => {
+            // Each fine channel holds every baseline's 4 pols, in the order of the conversion table
+            let mut vis_baselines = vec![0; context.legacy_conversion_table.len() * 4];
+            for entry in context.legacy_conversion_table.iter() {
+                for index in &[
+                    entry.xx_index,
+                    entry.xy_index,
+                    entry.yx_index,
+                    entry.yy_index,
+                ] {
+                    vis_baselines[*index as usize / 2] = entry.baseline;
+                }
+            }
+            VisibilityLayout::FrequencyMajor(vis_baselines)
+        }
+        CorrelatorVersion::V2 => VisibilityLayout::BaselineMajor,
+    }
+}
+
+/// Find the bad data in every HDU of a context, reading the gpubox files in parallel. See the
+/// module documentation.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to check. Only its timesteps and coarse channels are checked.
+///
+/// * `options` - see `BadDataOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing the `BadDataReport`, or a `BadDataError`.
+///
+///
+pub fn find_bad_data(
+    context: &CorrelatorContext,
+    options: &BadDataOptions,
+) -> Result<BadDataReport, BadDataError> {
+    let metafits_context = &context.metafits_context;
+    let layout = get_raw_layout(context);
+
+    // The HDUs to check in each gpubox file, by (batch index, gpubox number)
+    let mut file_hdus: BTreeMap<(usize, usize), Vec<(usize, WorkUnit)>> = BTreeMap::new();
+    for (timestep_index, timestep) in context.timesteps.iter().enumerate() {
+        let chans = match context.gpubox_time_map.get(&timestep.unix_time_ms) {
+            Some(c) => c,
+            None => continue,
+        };
+        for (coarse_chan_index, coarse_chan) in context.coarse_chans.iter().enumerate() {
+            if let Some((batch_index, hdu_index)) = chans.get(&coarse_chan.gpubox_number) {
+                file_hdus
+                    .entry((*batch_index, coarse_chan.gpubox_number))
+                    .or_default()
+                    .push((
+                        *hdu_index,
+                        WorkUnit {
+                            timestep_index,
+                            coarse_chan_index,
+                        },
+                    ));
+            }
+        }
+    }
+    let files: Vec<(&str, Vec<(usize, WorkUnit)>)> = file_hdus
+        .into_iter()
+        .filter_map(|((batch_index, gpubox_number), mut hdus)| {
+            let gpubox_file = context.gpubox_batches[batch_index]
+                .gpubox_files
+                .iter()
+                .find(|f| f.channel_identifier == gpubox_number)?;
+            hdus.sort_unstable();
+            Some((gpubox_file.filename.as_str(), hdus))
+        })
+        .collect();
+
+    let file_reports = context.install(|| {
+        files
+            .par_iter()
+            .map(
+                |(filename, hdus)| -> Result<Vec<HduBadData>, BadDataError> {
+                    let mut fptr = fits_open!(filename)?;
+                    let mut buffer = context
+                        .buffer_pool
+                        .get(context.num_timestep_coarse_chan_floats);
+                    let mut reports = Vec::new();
+                    for (hdu_index, work_unit) in hdus {
+                        let hdu = fits_open_hdu!(&mut fptr, *hdu_index)?;
+                        get_fits_float_image_into_buffer!(&mut fptr, &hdu, &mut buffer)?;
+                        let report = scan_visibilities(
+                            &buffer,
+                            &layout,
+                            metafits_context.num_baselines,
+                            metafits_context.num_corr_fine_chans_per_coarse,
+                            *work_unit,
+                        );
+                        if !report.is_clean() {
+                            reports.push(report);
+                        }
+                    }
+                    Ok(reports)
+                },
+            )
+            .collect::<Result<Vec<_>, _>>()
+    })?;
+
+    let mut hdus: Vec<HduBadData> = file_reports.into_iter().flatten().collect();
+    hdus.sort_by_key(|h| (h.timestep_index, h.coarse_chan_index));
+    let report = BadDataReport {
+        obs_id: metafits_context.obs_id,
+        num_baselines: metafits_context.num_baselines,
+        num_fine_chans_per_coarse: metafits_context.num_corr_fine_chans_per_coarse,
+        num_pols: metafits_context.num_visibility_pols,
+        num_hdus_checked: files.iter().map(|(_, hdus)| hdus.len()).sum(),
+        hdus,
+    };
+
+    if options.save_to_scan_cache {
+        if let Some(scan_cache) = context.scan_cache() {
+            report.save(scan_cache.dir())?;
+        }
+    }
+
+    Ok(report)
+}
@@ -0,0 +1,246 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for finding bad data
+*/
+#[cfg(test)]
+use super::*;
+
+const WORK_UNIT: WorkUnit = WorkUnit {
+    timestep_index: 3,
+    coarse_chan_index: 1,
+};
+
+#[test]
+fn test_count_bad_visibilities() {
+    // Good; zero; good, as only one part is zero; NaN; infinite; NaN and infinite
+    let data = [
+        1.,
+        2.,
+        0.,
+        0.,
+        0.,
+        1.,
+        f32::NAN,
+        1.,
+        1.,
+        f32::INFINITY,
+        f32::NAN,
+        f32::NEG_INFINITY,
+    ];
+    assert_eq!(count_bad_visibilities(&data), (2, 2, 1));
+    assert_eq!(count_bad_visibilities(&[1.; 64]), (0, 0, 0));
+}
+
+#[test]
+fn test_scan_baseline_major() {
+    // 3 baselines, 4 fine channels, 2 pols
+    let (num_baselines, num_fine_chans) = (3, 4);
+    let mut data = vec![1.; num_baselines * num_fine_chans * 2 * 2];
+    let hdu = scan_visibilities(
+        &data,
+        &VisibilityLayout::BaselineMajor,
+        num_baselines,
+        num_fine_chans,
+        WORK_UNIT,
+    );
+    assert!(hdu.is_clean());
+    assert!(hdu.bad_baselines.is_empty());
+
+    // Baseline 1, fine channel 2, both pols are zero; baseline 2, fine channel 0, pol 1 is NaN
+    let index = |baseline: usize, fine_chan: usize, pol: usize| {
+        ((baseline * num_fine_chans + fine_chan) * 2 + pol) * 2
+    };
+    for pol in 0..2 {
+        data[index(1, 2, pol)] = 0.;
+        data[index(1, 2, pol) + 1] = 0.;
+    }
+    data[index(2, 0, 1) + 1] = f32::NAN;
+
+    let hdu = scan_visibilities(
+        &data,
+        &VisibilityLayout::BaselineMajor,
+        num_baselines,
+        num_fine_chans,
+        WORK_UNIT,
+    );
+    assert_eq!(hdu.timestep_index, 3);
+    assert_eq!(hdu.coarse_chan_index, 1);
+    assert_eq!((hdu.num_nan, hdu.num_inf, hdu.num_zero), (1, 0, 2));
+    assert_eq!(hdu.bad_baselines, vec![(1, 2), (2, 1)]);
+    assert_eq!(hdu.bad_fine_chans, vec![(0, 1), (2, 2)]);
+    assert_eq!(hdu.get_num_bad(), 3);
+}
+
+#[test]
+fn test_scan_frequency_major() {
+    // 2 fine channels of 3 visibilities, in the order baselines 2, 0, 1
+    let layout = VisibilityLayout::FrequencyMajor(vec![2, 0, 1]);
+    let mut data = vec![1.; 2 * 3 * 2];
+    data[(3 + 2) * 2] = f32::INFINITY;
+    data[2] = 0.;
+    data[3] = 0.;
+
+    let hdu = scan_visibilities(&data, &layout, 3, 2, WORK_UNIT);
+    assert_eq!((hdu.num_nan, hdu.num_inf, hdu.num_zero), (0, 1, 1));
+    assert_eq!(hdu.bad_baselines, vec![(0, 1), (1, 1)]);
+    assert_eq!(hdu.bad_fine_chans, vec![(0, 1), (1, 1)]);
+}
+
+#[test]
+fn test_all_zero_hdu() {
+    let hdu = scan_visibilities(
+        &vec![0.; 2 * 4 * 4 * 2],
+        &VisibilityLayout::BaselineMajor,
+        2,
+        4,
+        WORK_UNIT,
+    );
+    assert_eq!(hdu.num_zero, 2 * 4 * 4);
+    assert_eq!(hdu.bad_baselines, vec![(0, 16), (1, 16)]);
+
+    let report = BadDataReport {
+        obs_id: 1_101_503_312,
+        num_baselines: 2,
+        num_fine_chans_per_coarse: 4,
+        num_pols: 4,
+        num_hdus_checked: 2,
+        hdus: vec![hdu],
+    };
+    assert_eq!(report.get_all_zero_hdus().len(), 1);
+}
+
+#[test]
+fn test_format_counts() {
+    assert_eq!(format_counts(&[]), "-");
+    let counts = vec![(0, 4), (1, 4), (2, 4), (3, 1), (5, 1), (6, 2)];
+    assert_eq!(format_counts(&counts), "0-2:4,3:1,5:1,6:2");
+    assert_eq!(parse_counts(&format_counts(&counts)), Some(counts));
+    assert_eq!(parse_counts("-"), Some(vec![]));
+    assert_eq!(parse_counts("1:2:3"), None);
+    assert_eq!(parse_counts("a-2:1"), None);
+}
+
+#[test]
+fn test_report_save_and_load() {
+    let dir = tempdir::TempDir::new("mwalib_bad_data_test").unwrap();
+    assert!(BadDataReport::load(dir.path(), 1_101_503_312)
+        .unwrap()
+        .is_none());
+
+    let report = BadDataReport {
+        obs_id: 1_101_503_312,
+        num_baselines: 8256,
+        num_fine_chans_per_coarse: 128,
+        num_pols: 4,
+        num_hdus_checked: 24,
+        hdus: vec![
+            HduBadData {
+                timestep_index: 0,
+                coarse_chan_index: 5,
+                num_nan: 0,
+                num_inf: 0,
+                num_zero: 8256 * 128 * 4,
+                bad_baselines: (0..8256).map(|b| (b, 512)).collect(),
+                bad_fine_chans: (0..128).map(|f| (f, 8256 * 4)).collect(),
+            },
+            HduBadData {
+                timestep_index: 2,
+                coarse_chan_index: 0,
+                num_nan: 3,
+                num_inf: 1,
+                num_zero: 0,
+                bad_baselines: vec![(17, 3), (400, 1)],
+                bad_fine_chans: vec![(64, 4)],
+            },
+        ],
+    };
+    let path = report.save(dir.path()).unwrap();
+    assert_eq!(
+        path.file_name().unwrap().to_str().unwrap(),
+        "1101503312_bad_data.txt"
+    );
+    // Runs keep the report of an all-zero HDU short
+    assert!(fs::metadata(&path).unwrap().len() < 200);
+
+    let loaded = BadDataReport::load(dir.path(), 1_101_503_312)
+        .unwrap()
+        .unwrap();
+    assert_eq!(loaded, report);
+}
+
+#[test]
+fn test_report_load_invalid() {
+    let dir = tempdir::TempDir::new("mwalib_bad_data_test").unwrap();
+    let path = dir.path().join(BadDataReport::get_filename(1));
+
+    fs::write(&path, "not a report\n").unwrap();
+    assert!(matches!(
+        BadDataReport::load(dir.path(), 1),
+        Err(BadDataError::InvalidReport { line_number: 1, .. })
+    ));
+
+    fs::write(
+        &path,
+        format!(
+            "{}\nobs_id 1\nshape 2 4 4\nhdus_checked 1\nhdu 0 0 x 0 0 baselines - fine_chans -\n",
+            REPORT_HEADER
+        ),
+    )
+    .unwrap();
+    assert!(matches!(
+        BadDataReport::load(dir.path(), 1),
+        Err(BadDataError::InvalidReport { line_number: 5, .. })
+    ));
+
+    // A report of another observation
+    fs::write(
+        &path,
+        format!("{}\nobs_id 2\nshape 2 4 4\nhdus_checked 1\n", REPORT_HEADER),
+    )
+    .unwrap();
+    assert!(matches!(
+        BadDataReport::load(dir.path(), 1),
+        Err(BadDataError::InvalidReport { line_number: 2, .. })
+    ));
+}
+
+#[test]
+fn test_find_bad_data() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+
+    let report = find_bad_data(&context, &BadDataOptions::default()).unwrap();
+    assert_eq!(report.obs_id, 1_101_503_312);
+    assert_eq!(report.num_hdus_checked, 1);
+
+    // The raw scan agrees with checking the converted data, in either order
+    let expected = match report.hdus.first() {
+        Some(h) => h.clone(),
+        None => HduBadData::default(),
+    };
+    let data_by_bl = context.read_by_baseline(0, 0).unwrap();
+    let data_by_freq = context.read_by_frequency(0, 0).unwrap();
+    for (data, by_frequency) in &[(data_by_bl, false), (data_by_freq, true)] {
+        let hdu = get_hdu_bad_data(
+            &context,
+            WorkUnit {
+                timestep_index: 0,
+                coarse_chan_index: 0,
+            },
+            data,
+            *by_frequency,
+        );
+        assert_eq!(
+            (hdu.num_nan, hdu.num_inf, hdu.num_zero),
+            (expected.num_nan, expected.num_inf, expected.num_zero)
+        );
+        assert_eq!(hdu.bad_baselines, expected.bad_baselines);
+        assert_eq!(hdu.bad_fine_chans, expected.bad_fine_chans);
+    }
+}
@@ -0,0 +1,20 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with summarising bandpasses.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum BandpassError {
+    /// Error when none of the context's timesteps and coarse channels have data.
+    #[error("No gpubox HDUs were found to summarise")]
+    NoData,
+
+    /// An error derived from `GpuboxError`.
+    #[error("{0}")]
+    Gpubox(#[from] crate::gpubox_files::error::GpuboxError),
+}
@@ -0,0 +1,517 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Time averaged autocorrelation bandpasses, and the median cross-power spectrum, of an observation.
+
+`summarise_bandpasses` streams over every timestep and coarse channel of a context, in parallel in
+the context's thread pool. Each HDU's autocorrelations are added to running sums per tile, pol and
+fine channel, so memory does not grow with the number of timesteps and no cross-correlations are
+kept. Without the cross-power spectrum only the autocorrelations are read (see
+`CorrelatorContext::read_autos_into_buffer`). With it, each HDU is read whole and, without being
+converted, the median amplitude over the cross-correlation baselines of each fine channel and pol
+is taken; these medians are averaged over time.
+
+Bandpasses are of the XX and YY pols (the real parts of the autocorrelations). Non-finite values
+are skipped; a channel with no finite values is NaN.
+ */
+pub mod error;
+pub use error::BandpassError;
+
+use rayon::prelude::*;
+
+use crate::correlator_context::CorrelatorContext;
+use crate::flagging::get_median;
+use crate::gpubox_files::GpuboxError;
+use crate::metafits_context::CorrelatorVersion;
+
+#[cfg(test)]
+mod test;
+
+/// The indices of the XX and YY pols within a visibility's 4 pols
+pub const BANDPASS_POL_INDICES: [usize; 2] = [0, 3];
+/// The number of pols in a bandpass (XX and YY)
+pub const NUM_BANDPASS_POLS: usize = BANDPASS_POL_INDICES.len();
+
+/// Options for `summarise_bandpasses`.
+#[derive(Clone, Debug)]
+pub struct BandpassOptions {
+    /// Also compute the median cross-power spectrum. This reads every HDU whole, rather than
+    /// only the autocorrelations.
+    pub cross_power: bool,
+}
+
+impl Default for BandpassOptions {
+    fn default() -> Self {
+        BandpassOptions { cross_power: true }
+    }
+}
+
+/// Time averaged bandpasses and summary statistics of an observation. Channels are sky fine
+/// channels: the fine channels of each of the context's coarse channels, in coarse channel order.
+#[derive(Clone, Debug, PartialEq)]
+pub struct BandpassSummary {
+    /// Number of tiles (antennas), in the order of the metafits' antennas
+    pub num_tiles: usize,
+    /// Number of pols (XX and YY)
+    pub num_pols: usize,
+    /// Number of sky fine channels
+    pub num_sky_fine_chans: usize,
+    /// Number of HDUs summarised
+    pub num_hdus: usize,
+    /// Time averaged autocorrelation power, [tile][pol][sky fine chan]
+    pub auto_bandpasses: Vec<f32>,
+    /// Median over tiles of the bandpasses, [pol][sky fine chan]
+    pub median_bandpass: Vec<f32>,
+    /// Mean over channels of each tile's bandpass, [tile][pol]
+    pub tile_mean_power: Vec<f32>,
+    /// RMS over channels of each tile's fractional deviation from the median bandpass, [tile][pol]
+    pub tile_deviation: Vec<f32>,
+    /// Time averaged median cross-correlation amplitude, [pol][sky fine chan], if requested
+    pub cross_power: Option<Vec<f32>>,
+}
+
+impl BandpassSummary {
+    /// Build a summary from time averaged bandpasses, computing the summary statistics.
+    /// Only called by `summarise_bandpasses`, which always passes bandpasses of the right length.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_tiles` - the number of tiles.
+    ///
+    /// * `num_sky_fine_chans` - the number of sky fine channels.
+    ///
+    /// * `num_hdus` - the number of HDUs averaged.
+    ///
+    /// * `auto_bandpasses` - the bandpasses, [tile][pol][sky fine chan].
+    ///
+    /// * `cross_power` - the cross-power spectrum, [pol][sky fine chan], if any.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The `BandpassSummary`.
+    ///
+    ///
+    pub(crate) fn new(
+        num_tiles: usize,
+        num_sky_fine_chans: usize,
+        num_hdus: usize,
+        auto_bandpasses: Vec<f32>,
+        cross_power: Option<Vec<f32>>,
+    ) -> Self {
+        assert_eq!(
+            auto_bandpasses.len(),
+            num_tiles * NUM_BANDPASS_POLS * num_sky_fine_chans
+        );
+        let bandpass = |tile: usize, pol: usize| {
+            let start = (tile * NUM_BANDPASS_POLS + pol) * num_sky_fine_chans;
+            &auto_bandpasses[start..start + num_sky_fine_chans]
+        };
+
+        let mut median_bandpass = vec![f32::NAN; NUM_BANDPASS_POLS * num_sky_fine_chans];
+        let mut values = Vec::with_capacity(num_tiles);
+        for (pol, median_pol) in median_bandpass
+            .chunks_exact_mut(num_sky_fine_chans.max(1))
+            .enumerate()
+        {
+            for (chan, median) in median_pol.iter_mut().enumerate() {
+                values.clear();
+                values.extend(
+                    (0..num_tiles)
+                        .map(|tile| bandpass(tile, pol)[chan])
+                        .filter(|v| v.is_finite()),
+                );
+                *median = get_median(&mut values);
+            }
+        }
+
+        let mut tile_mean_power = Vec::with_capacity(num_tiles * NUM_BANDPASS_POLS);
+        let mut tile_deviation = Vec::with_capacity(num_tiles * NUM_BANDPASS_POLS);
+        for tile in 0..num_tiles {
+            for pol in 0..NUM_BANDPASS_POLS {
+                let median_pol =
+                    &median_bandpass[pol * num_sky_fine_chans..(pol + 1) * num_sky_fine_chans];
+                tile_mean_power.push(get_mean(
+                    bandpass(tile, pol)
+                        .iter()
+                        .copied()
+                        .filter(|v| v.is_finite()),
+                ));
+                let squared_deviations = bandpass(tile, pol)
+                    .iter()
+                    .zip(median_pol)
+                    .filter(|(v, m)| v.is_finite() && m.is_finite() && **m != 0.)
+                    .map(|(v, m)| (v / m - 1.).powi(2));
+                tile_deviation.push(get_mean(squared_deviations).sqrt());
+            }
+        }
+
+        BandpassSummary {
+            num_tiles,
+            num_pols: NUM_BANDPASS_POLS,
+            num_sky_fine_chans,
+            num_hdus,
+            auto_bandpasses,
+            median_bandpass,
+            tile_mean_power,
+            tile_deviation,
+            cross_power,
+        }
+    }
+
+    /// The time averaged bandpass of one tile and pol, over sky fine channels.
+    ///
+    /// # Arguments
+    ///
+    /// * `tile_index` - index of the tile (antenna).
+    ///
+    /// * `pol_index` - 0 for XX, 1 for YY.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A slice of `num_sky_fine_chans` floats.
+    ///
+    ///
+    pub fn get_auto_bandpass(&self, tile_index: usize, pol_index: usize) -> &[f32] {
+        let start = (tile_index * NUM_BANDPASS_POLS + pol_index) * self.num_sky_fine_chans;
+        &self.auto_bandpasses[start..start + self.num_sky_fine_chans]
+    }
+}
+
+/// Mean of some values; NaN if there are none.
+fn get_mean<I: Iterator<Item = f32>>(values: I) -> f32 {
+    let (sum, count) = values.fold((0., 0), |(sum, count), v| (sum + v as f64, count + 1));
+    match count {
+        0 => f32::NAN,
+        _ => (sum / count as f64) as f32,
+    }
+}
+
+/// Running sums over the timesteps of one coarse channel.
+#[derive(Clone, Debug, PartialEq)]
+struct CoarseChanSums {
+    /// Sum of autocorrelation powers, [tile][pol][fine chan]
+    auto_sums: Vec<f64>,
+    auto_counts: Vec<u32>,
+    /// Sum of per-HDU median cross-correlation amplitudes, [pol][fine chan]
+    cross_sums: Vec<f64>,
+    cross_counts: Vec<u32>,
+    num_hdus: usize,
+}
+
+impl CoarseChanSums {
+    fn new(num_tiles: usize, num_fine_chans: usize) -> Self {
+        let num_auto = num_tiles * NUM_BANDPASS_POLS * num_fine_chans;
+        let num_cross = NUM_BANDPASS_POLS * num_fine_chans;
+        CoarseChanSums {
+            auto_sums: vec![0.; num_auto],
+            auto_counts: vec![0; num_auto],
+            cross_sums: vec![0.; num_cross],
+            cross_counts: vec![0; num_cross],
+            num_hdus: 0,
+        }
+    }
+
+    /// Add one HDU's autocorrelations, [tile][fine chan][pol][r][i].
+    fn add_autos(&mut self, autos: &[f32], num_fine_chans: usize, num_vis_pols: usize) {
+        let floats_per_tile = num_fine_chans * num_vis_pols * 2;
+        for (tile, autos_tile) in autos.chunks_exact(floats_per_tile).enumerate() {
+            for (fine_chan, vis) in autos_tile.chunks_exact(num_vis_pols * 2).enumerate() {
+                for (pol, pol_index) in BANDPASS_POL_INDICES.iter().enumerate() {
+                    let power = vis[pol_index * 2];
+                    if power.is_finite() {
+                        let i = (tile * NUM_BANDPASS_POLS + pol) * num_fine_chans + fine_chan;
+                        self.auto_sums[i] += power as f64;
+                        self.auto_counts[i] += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    /// Add one HDU's median cross-correlation amplitudes, [pol][fine chan].
+    fn add_cross_medians(&mut self, medians: &[f32]) {
+        for ((sum, count), median) in self
+            .cross_sums
+            .iter_mut()
+            .zip(self.cross_counts.iter_mut())
+            .zip(medians)
+        {
+            if median.is_finite() {
+                *sum += *median as f64;
+                *count += 1;
+            }
+        }
+    }
+
+    fn merge(mut self, other: Self) -> Self {
+        for (a, b) in self.auto_sums.iter_mut().zip(other.auto_sums) {
+            *a += b;
+        }
+        for (a, b) in self.auto_counts.iter_mut().zip(other.auto_counts) {
+            *a += b;
+        }
+        for (a, b) in self.cross_sums.iter_mut().zip(other.cross_sums) {
+            *a += b;
+        }
+        for (a, b) in self.cross_counts.iter_mut().zip(other.cross_counts) {
+            *a += b;
+        }
+        self.num_hdus += other.num_hdus;
+        self
+    }
+}
+
+/// Where the cross-correlations of the bandpass pols are in a raw (unconverted) HDU.
+#[derive(Clone, Debug, PartialEq)]
+struct CrossLayout {
+    /// For each bandpass pol, the offset of each cross-correlation's real part in the first fine channel
+    offsets: Vec<Vec<usize>>,
+    /// Floats between consecutive fine channels of a visibility
+    fine_chan_stride: usize,
+}
+
+/// The layout of the cross-correlations in a context's raw HDUs.
+fn get_cross_layout(context: &CorrelatorContext) -> CrossLayout {
+    let metafits_context = &context.metafits_context;
+    match context.corr_version {
+        // Each fine channel holds every baseline, in the order of the conversion table
+        CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => CrossLayout {
+            offsets: vec![
+                context
+                    .legacy_conversion_table
+                    .iter()
+                    .filter(|b| b.ant1 != b.ant2)
+                    .map(|b| b.xx_index as usize)
+                    .collect(),
+                context
+                    .legacy_conversion_table
+                    .iter()
+                    .filter(|b| b.ant1 != b.ant2)
+                    .map(|b| b.yy_index as usize)
+                    .collect(),
+            ],
+            fine_chan_stride: context.legacy_conversion_table.len() * 8,
+        },
+        // Each baseline holds every fine channel
+        CorrelatorVersion::V2 => {
+            let floats_per_vis = metafits_context.num_visibility_pols * 2;
+            let floats_per_baseline =
+                metafits_context.num_corr_fine_chans_per_coarse * floats_per_vis;
+            let offsets = BANDPASS_POL_INDICES
+                .iter()
+                .map(|pol_index| {
+                    metafits_context
+                        .baselines
+                        .iter()
+                        .enumerate()
+                        .filter(|(_, b)| b.ant1_index != b.ant2_index)
+                        .map(|(i, _)| i * floats_per_baseline + pol_index * 2)
+                        .collect()
+                })
+                .collect();
+            CrossLayout {
+                offsets,
+                fine_chan_stride: floats_per_vis,
+            }
+        }
+    }
+}
+
+/// The median cross-correlation amplitude of each bandpass pol and fine channel of a raw HDU.
+///
+/// # Arguments
+///
+/// * `hdu_buffer` - the raw HDU.
+///
+/// * `layout` - the `CrossLayout` of the HDU.
+///
+/// * `scratch` - working space, reused between calls.
+///
+/// * `medians` - slice of NUM_BANDPASS_POLS * fine chans floats to write the medians into,
+///               [pol][fine chan]. A channel with no finite amplitudes is NaN.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+fn get_cross_medians(
+    hdu_buffer: &[f32],
+    layout: &CrossLayout,
+    scratch: &mut Vec<f32>,
+    medians: &mut [f32],
+) {
+    let num_fine_chans = medians.len() / NUM_BANDPASS_POLS;
+    for (offsets, medians_pol) in layout
+        .offsets
+        .iter()
+        .zip(medians.chunks_exact_mut(num_fine_chans.max(1)))
+    {
+        for (fine_chan, median) in medians_pol.iter_mut().enumerate() {
+            let fine_chan_offset = fine_chan * layout.fine_chan_stride;
+            scratch.clear();
+            scratch.extend(
+                offsets
+                    .iter()
+                    .map(|o| {
+                        let i = o + fine_chan_offset;
+                        hdu_buffer[i].hypot(hdu_buffer[i + 1])
+                    })
+                    .filter(|a| a.is_finite()),
+            );
+            *median = get_median(scratch);
+        }
+    }
+}
+
+/// Sum the bandpasses of one coarse channel over the timesteps which have data, in parallel.
+fn sum_coarse_chan(
+    context: &CorrelatorContext,
+    coarse_chan_index: usize,
+    cross_layout: Option<&CrossLayout>,
+) -> Result<CoarseChanSums, GpuboxError> {
+    let metafits_context = &context.metafits_context;
+    let num_tiles = metafits_context.num_ants;
+    let num_fine_chans = metafits_context.num_corr_fine_chans_per_coarse;
+    let num_vis_pols = metafits_context.num_visibility_pols;
+    let num_auto_floats = num_tiles * num_fine_chans * num_vis_pols * 2;
+
+    let timestep_indices =
+        context.get_hdu_timestep_indices(coarse_chan_index, 0..context.num_timesteps);
+
+    timestep_indices
+        .par_iter()
+        .try_fold(
+            || CoarseChanSums::new(num_tiles, num_fine_chans),
+            |mut sums, timestep_index| -> Result<CoarseChanSums, GpuboxError> {
+                let mut autos = context.buffer_pool.get(num_auto_floats);
+                match cross_layout {
+                    None => context.read_autos_into_buffer(
+                        *timestep_index,
+                        coarse_chan_index,
+                        &mut autos,
+                    )?,
+                    Some(layout) => {
+                        let mut hdu_buffer = context
+                            .buffer_pool
+                            .get(context.num_timestep_coarse_chan_floats);
+                        context.read_hdu_into_buffer(
+                            *timestep_index,
+                            coarse_chan_index,
+                            &mut hdu_buffer,
+                        )?;
+                        context.convert_hdu_autos_into_buffer(&hdu_buffer, &mut autos);
+
+                        let mut scratch = Vec::with_capacity(metafits_context.num_baselines);
+                        let mut medians = vec![0.; NUM_BANDPASS_POLS * num_fine_chans];
+                        get_cross_medians(&hdu_buffer, layout, &mut scratch, &mut medians);
+                        sums.add_cross_medians(&medians);
+                    }
+                }
+                sums.add_autos(&autos, num_fine_chans, num_vis_pols);
+                sums.num_hdus += 1;
+                Ok(sums)
+            },
+        )
+        .try_reduce(
+            || CoarseChanSums::new(num_tiles, num_fine_chans),
+            |a, b| Ok(a.merge(b)),
+        )
+}
+
+/// Summarise the bandpasses of every timestep and coarse channel of a context. See the module
+/// documentation.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to summarise.
+///
+/// * `options` - see `BandpassOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing the `BandpassSummary`, or a `BandpassError`.
+///
+///
+pub fn summarise_bandpasses(
+    context: &CorrelatorContext,
+    options: &BandpassOptions,
+) -> Result<BandpassSummary, BandpassError> {
+    let metafits_context = &context.metafits_context;
+    let num_tiles = metafits_context.num_ants;
+    let num_fine_chans = metafits_context.num_corr_fine_chans_per_coarse;
+    let num_sky_fine_chans = context.num_coarse_chans * num_fine_chans;
+    let cross_layout = match options.cross_power {
+        true => Some(get_cross_layout(context)),
+        false => None,
+    };
+
+    let coarse_chan_sums = context.install(|| {
+        (0..context.num_coarse_chans)
+            .into_par_iter()
+            .map(|c| sum_coarse_chan(context, c, cross_layout.as_ref()))
+            .collect::<Result<Vec<_>, _>>()
+    })?;
+
+    let num_hdus: usize = coarse_chan_sums.iter().map(|s| s.num_hdus).sum();
+    if num_hdus == 0 {
+        return Err(BandpassError::NoData);
+    }
+
+    let average = |sum: f64, count: u32| match count {
+        0 => f32::NAN,
+        _ => (sum / count as f64) as f32,
+    };
+    let mut auto_bandpasses = vec![f32::NAN; num_tiles * NUM_BANDPASS_POLS * num_sky_fine_chans];
+    let mut cross_power = vec![f32::NAN; NUM_BANDPASS_POLS * num_sky_fine_chans];
+    for (coarse_chan_index, sums) in coarse_chan_sums.iter().enumerate() {
+        let sky_start = coarse_chan_index * num_fine_chans;
+        for (tile_pol, (auto_sums, auto_counts)) in sums
+            .auto_sums
+            .chunks_exact(num_fine_chans)
+            .zip(sums.auto_counts.chunks_exact(num_fine_chans))
+            .enumerate()
+        {
+            let start = tile_pol * num_sky_fine_chans + sky_start;
+            for ((bandpass, sum), count) in auto_bandpasses[start..start + num_fine_chans]
+                .iter_mut()
+                .zip(auto_sums)
+                .zip(auto_counts)
+            {
+                *bandpass = average(*sum, *count);
+            }
+        }
+        for (pol, (cross_sums, cross_counts)) in sums
+            .cross_sums
+            .chunks_exact(num_fine_chans)
+            .zip(sums.cross_counts.chunks_exact(num_fine_chans))
+            .enumerate()
+        {
+            let start = pol * num_sky_fine_chans + sky_start;
+            for ((power, sum), count) in cross_power[start..start + num_fine_chans]
+                .iter_mut()
+                .zip(cross_sums)
+                .zip(cross_counts)
+            {
+                *power = average(*sum, *count);
+            }
+        }
+    }
+
+    Ok(BandpassSummary::new(
+        num_tiles,
+        num_sky_fine_chans,
+        num_hdus,
+        auto_bandpasses,
+        match options.cross_power {
+            true => Some(cross_power),
+            false => None,
+        },
+    ))
+}
@@ -0,0 +1,196 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for bandpass summaries
+*/
+#[cfg(test)]
+use super::*;
+use float_cmp::*;
+
+#[test]
+fn test_add_autos() {
+    // 2 tiles, 3 fine channels, 4 pols; XX power is tile * 10 + fine chan, YY is negated
+    let (num_tiles, num_fine_chans) = (2, 3);
+    let mut autos = vec![0.; num_tiles * num_fine_chans * 4 * 2];
+    for tile in 0..num_tiles {
+        for fine_chan in 0..num_fine_chans {
+            let vis = ((tile * num_fine_chans) + fine_chan) * 8;
+            autos[vis] = (tile * 10 + fine_chan) as f32;
+            autos[vis + 6] = -((tile * 10 + fine_chan) as f32);
+        }
+    }
+    // A NaN is skipped
+    autos[8] = f32::NAN;
+
+    let mut sums = CoarseChanSums::new(num_tiles, num_fine_chans);
+    sums.add_autos(&autos, num_fine_chans, 4);
+    sums.add_autos(&autos, num_fine_chans, 4);
+    assert_eq!(
+        sums.auto_sums,
+        vec![0., 0., 4., -0., -2., -4., 20., 22., 24., -20., -22., -24.]
+    );
+    assert_eq!(sums.auto_counts, vec![2, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2]);
+
+    let merged = sums.clone().merge(sums);
+    assert_eq!(merged.auto_sums[2], 8.);
+    assert_eq!(merged.auto_counts[2], 4);
+}
+
+#[test]
+fn test_cross_medians() {
+    // 3 cross baselines of 2 fine channels in mwax order; XX amplitudes are 3, 4 and 5 times the
+    // fine channel + 1, YY are all NaN
+    let layout = CrossLayout {
+        offsets: vec![vec![0, 16, 32], vec![6, 22, 38]],
+        fine_chan_stride: 8,
+    };
+    let mut hdu = vec![f32::NAN; 3 * 2 * 8];
+    for (baseline, amplitude) in [3., 4., 5.].iter().enumerate() {
+        for fine_chan in 0..2 {
+            let i = baseline * 16 + fine_chan * 8;
+            // A 3-4-5 triangle scaled to the amplitude
+            hdu[i] = amplitude * (fine_chan + 1) as f32 * 0.6;
+            hdu[i + 1] = amplitude * (fine_chan + 1) as f32 * 0.8;
+        }
+    }
+
+    let mut medians = vec![0.; 4];
+    get_cross_medians(&hdu, &layout, &mut Vec::new(), &mut medians);
+    assert!(approx_eq!(f32, medians[0], 4., F32Margin::default()));
+    assert!(approx_eq!(f32, medians[1], 8., F32Margin::default()));
+    assert!(medians[2].is_nan());
+    assert!(medians[3].is_nan());
+
+    let mut sums = CoarseChanSums::new(1, 2);
+    sums.add_cross_medians(&medians);
+    assert_eq!(sums.cross_counts, vec![1, 1, 0, 0]);
+}
+
+#[test]
+fn test_summary_statistics() {
+    // 3 tiles of 2 channels; tile 2 is twice tile 0, and tile 1 is 1.5 times tile 0
+    let auto_bandpasses = vec![
+        1.,
+        2.,
+        1.,
+        2., // tile 0
+        1.5,
+        3.,
+        1.5,
+        3., // tile 1
+        2.,
+        4.,
+        2.,
+        f32::NAN, // tile 2
+    ];
+    let summary = BandpassSummary::new(3, 2, 6, auto_bandpasses, None);
+    assert_eq!(summary.num_pols, 2);
+    assert_eq!(summary.get_auto_bandpass(1, 1), &[1.5, 3.]);
+    assert_eq!(summary.median_bandpass, vec![1.5, 3., 1.5, 2.5]);
+    assert_eq!(summary.tile_mean_power, vec![1.5, 1.5, 2.25, 2.25, 3., 2.]);
+
+    // Tile 1 is the median of XX, so does not deviate from it
+    assert_eq!(summary.tile_deviation[2], 0.);
+    assert!(approx_eq!(
+        f32,
+        summary.tile_deviation[0],
+        1. / 3.,
+        F32Margin::default()
+    ));
+    assert!(approx_eq!(
+        f32,
+        summary.tile_deviation[5],
+        1. / 3.,
+        F32Margin::default()
+    ));
+    assert!(summary.cross_power.is_none());
+}
+
+#[test]
+fn test_summary_no_finite_data() {
+    let summary = BandpassSummary::new(2, 1, 1, vec![f32::NAN; 4], None);
+    assert!(summary.median_bandpass.iter().all(|v| v.is_nan()));
+    assert!(summary.tile_mean_power.iter().all(|v| v.is_nan()));
+    assert!(summary.tile_deviation.iter().all(|v| v.is_nan()));
+}
+
+/// The autocorrelations read by the fast path match those of a full read.
+fn check_read_autos(metafits_filename: &str, gpubox_filename: &str) {
+    let context = CorrelatorContext::new(&metafits_filename, &[gpubox_filename])
+        .expect("Failed to create CorrelatorContext");
+    let metafits_context = &context.metafits_context;
+    let floats_per_baseline =
+        metafits_context.num_corr_fine_chans_per_coarse * metafits_context.num_visibility_pols * 2;
+
+    let mut autos = vec![0.; metafits_context.num_ants * floats_per_baseline];
+    context.read_autos_into_buffer(0, 0, &mut autos).unwrap();
+
+    let data = context.read_by_baseline_pooled(0, 0).unwrap();
+    let expected: Vec<f32> = data
+        .chunks_exact(floats_per_baseline)
+        .zip(metafits_context.baselines.iter())
+        .filter(|(_, b)| b.ant1_index == b.ant2_index)
+        .flat_map(|(row, _)| row.iter().copied())
+        .collect();
+    assert_eq!(autos, expected);
+
+    assert!(matches!(
+        context.read_autos_into_buffer(0, 0, &mut autos[1..]),
+        Err(GpuboxError::InvalidBufferSize { .. })
+    ));
+}
+
+#[test]
+fn test_read_autos_legacy() {
+    check_read_autos(
+        "test_files/1101503312_1_timestep/1101503312.metafits",
+        "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits",
+    );
+}
+
+#[test]
+fn test_read_autos_mwax() {
+    check_read_autos(
+        "test_files/1244973688_1_timestep/1244973688.metafits",
+        "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits",
+    );
+}
+
+#[test]
+fn test_summarise_bandpasses() {
+    let metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+
+    let summary = summarise_bandpasses(&context, &BandpassOptions::default()).unwrap();
+    assert_eq!(summary.num_tiles, context.metafits_context.num_ants);
+    assert_eq!(summary.num_hdus, 1);
+    assert_eq!(
+        summary.num_sky_fine_chans,
+        context.num_coarse_chans * context.metafits_context.num_corr_fine_chans_per_coarse
+    );
+    assert_eq!(
+        summary.auto_bandpasses.len(),
+        summary.num_tiles * 2 * summary.num_sky_fine_chans
+    );
+    assert_eq!(
+        summary.cross_power.as_ref().unwrap().len(),
+        2 * summary.num_sky_fine_chans
+    );
+
+    // The fast path gives the same bandpasses, without the cross-power spectrum
+    let autos_only =
+        summarise_bandpasses(&context, &BandpassOptions { cross_power: false }).unwrap();
+    assert!(autos_only.cross_power.is_none());
+    for (a, b) in summary
+        .auto_bandpasses
+        .iter()
+        .zip(autos_only.auto_bandpasses.iter())
+    {
+        assert!(a == b || (a.is_nan() && b.is_nan()));
+    }
+}
@@ -0,0 +1,27 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with selecting baselines.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum BaselineError {
+    /// Error when a selection names a tile which is not in the observation.
+    #[error("Tile {0} is not in this observation")]
+    UnknownTileName(String),
+
+    /// Error when a selection has an antenna index which is not in the observation.
+    #[error("Antenna index {antenna_index} is invalid, as there are only {num_ants} antennas")]
+    InvalidAntennaIndex {
+        antenna_index: usize,
+        num_ants: usize,
+    },
+
+    /// Error when an antenna remap lists an antenna more than once.
+    #[error("Antenna index {0} appears more than once in the antenna remap")]
+    DuplicateAntennaIndex(usize),
+}
@@ -8,6 +8,16 @@ Structs and helper methods for baseline metadata
 use crate::misc;
 use std::fmt;
 
+pub mod error;
+mod remap;
+mod selection;
+pub use error::BaselineError;
+pub(crate) use remap::{remap_mwax_hdu_to_baseline_order, remap_mwax_hdu_to_frequency_order};
+pub use remap::{
+    AntennaRemap, BaselineTriangle, ConjugationConvention, RemappedBaseline, VisibilityConvention,
+};
+pub use selection::{get_index_ranges, select_baselines, BaselineGeometry, BaselineSelection};
+
 #[cfg(test)]
 mod test;
 /// This is a struct for our baselines, so callers know the antenna ordering
@@ -0,0 +1,340 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Reordering antennas, or taking a subarray, while visibilities are read.
+
+An `AntennaRemap` lists the antennas to output, in order; the output baselines are the upper
+triangle (0,0 .. 0,N 1,1 .. 1,N) or, by a `VisibilityConvention`, the lower triangle (0,0 1,0 1,1
+2,0 ..) of those antennas. For each output baseline the remap holds the input baseline it comes
+from, whether the antennas are swapped (so the xy and yx pols are exchanged), and whether the
+visibility is conjugated, which it is for swapped antennas unless the convention conjugates
+everything. MWAX data is gathered through this table; for legacy data the table is composed with
+the legacy conversion table when the remap is built, so either way the data is reordered once,
+straight from the raw HDU, and a convention costs nothing at read time.
+ */
+use rayon::prelude::*;
+
+use super::error::BaselineError;
+use crate::convert::LegacyConversionBaseline;
+use crate::misc;
+
+/// Which way round visibilities are conjugated.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum ConjugationConvention {
+    /// mwalib's convention, as output by `read_by_baseline`
+    Standard,
+    /// Every visibility conjugated relative to mwalib's convention
+    Conjugated,
+}
+
+/// Which triangle of the antenna by antenna matrix the output baselines are.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum BaselineTriangle {
+    /// ant1 <= ant2, in the order 0,0 .. 0,N 1,1 .. 1,N, as output by `read_by_baseline`
+    Upper,
+    /// ant1 >= ant2, in the order 0,0 1,0 1,1 2,0 2,1 2,2 ..
+    Lower,
+}
+
+/// The conjugation and baseline triangle to read visibilities in.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct VisibilityConvention {
+    pub conjugation: ConjugationConvention,
+    pub triangle: BaselineTriangle,
+}
+
+/// mwalib's own convention.
+impl Default for VisibilityConvention {
+    fn default() -> Self {
+        VisibilityConvention {
+            conjugation: ConjugationConvention::Standard,
+            triangle: BaselineTriangle::Upper,
+        }
+    }
+}
+
+/// Where an output baseline of an `AntennaRemap` comes from.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct RemappedBaseline {
+    /// Index in the context's antenna array of the output baseline's first antenna
+    pub ant1_index: usize,
+    /// Index in the context's antenna array of the output baseline's second antenna
+    pub ant2_index: usize,
+    /// Index of the input baseline holding the data
+    pub source_baseline_index: usize,
+    /// True if the input baseline has the antennas the other way round, so xy and yx are
+    /// exchanged
+    pub swapped: bool,
+    /// True if the visibility is conjugated
+    pub conjugate: bool,
+}
+
+/// An antenna order or subset to read visibilities in. Build one with
+/// `CorrelatorContext::get_antenna_remap`, as a remap is specific to its context.
+#[derive(Debug)]
+pub struct AntennaRemap {
+    /// Index in the context's antenna array of each output antenna
+    pub antenna_indices: Vec<usize>,
+    /// The conjugation and triangle of the output
+    pub convention: VisibilityConvention,
+    /// The output baselines, in order
+    pub baselines: Vec<RemappedBaseline>,
+    /// Number of antennas of the context the remap was built for
+    pub(crate) num_input_ants: usize,
+    /// For legacy contexts, the legacy conversion table composed with the remap: one entry per
+    /// output baseline
+    pub(crate) legacy_conversion_table: Option<Vec<LegacyConversionBaseline>>,
+}
+
+impl AntennaRemap {
+    /// Build the remap of an antenna order or subset.
+    ///
+    /// # Arguments
+    ///
+    /// * `antenna_indices` - index in the antenna array of each output antenna, in output order.
+    ///                       Each antenna may appear at most once.
+    ///
+    /// * `num_input_ants` - number of antennas in the observation.
+    ///
+    /// * `convention` - the conjugation and triangle to output.
+    ///
+    /// * `legacy_conversion_table` - the context's legacy conversion table, or None for MWAX data.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `AntennaRemap`, or a `BaselineError` if an antenna index is out of
+    ///   range or repeated.
+    ///
+    ///
+    pub(crate) fn new(
+        antenna_indices: Vec<usize>,
+        num_input_ants: usize,
+        convention: VisibilityConvention,
+        legacy_conversion_table: Option<&[LegacyConversionBaseline]>,
+    ) -> Result<Self, BaselineError> {
+        let mut seen = vec![false; num_input_ants];
+        for &antenna_index in &antenna_indices {
+            if antenna_index >= num_input_ants {
+                return Err(BaselineError::InvalidAntennaIndex {
+                    antenna_index,
+                    num_ants: num_input_ants,
+                });
+            }
+            if seen[antenna_index] {
+                return Err(BaselineError::DuplicateAntennaIndex(antenna_index));
+            }
+            seen[antenna_index] = true;
+        }
+
+        // Offset of the first baseline of each input antenna in the input triangle
+        let first_baseline: Vec<usize> = (0..num_input_ants)
+            .map(|a| a * num_input_ants - a * a.saturating_sub(1) / 2)
+            .collect();
+        let get_source = |a: usize, b: usize| first_baseline[a] + b - a;
+
+        let conjugate_all = convention.conjugation == ConjugationConvention::Conjugated;
+        let num_output_ants = antenna_indices.len();
+        let mut baselines = Vec::with_capacity(misc::get_baseline_count(num_output_ants));
+        for i in 0..num_output_ants {
+            let pairs = match convention.triangle {
+                BaselineTriangle::Upper => i..num_output_ants,
+                BaselineTriangle::Lower => 0..i + 1,
+            };
+            for j in pairs {
+                let (ant1_index, ant2_index) = (antenna_indices[i], antenna_indices[j]);
+                let swapped = ant1_index > ant2_index;
+                let source_baseline_index = if swapped {
+                    get_source(ant2_index, ant1_index)
+                } else {
+                    get_source(ant1_index, ant2_index)
+                };
+                baselines.push(RemappedBaseline {
+                    ant1_index,
+                    ant2_index,
+                    source_baseline_index,
+                    swapped,
+                    conjugate: swapped != conjugate_all,
+                });
+            }
+        }
+
+        let legacy_conversion_table = legacy_conversion_table.map(|table| {
+            baselines
+                .iter()
+                .enumerate()
+                .map(|(output_index, b)| {
+                    compose_legacy_baseline(output_index, &table[b.source_baseline_index], b)
+                })
+                .collect()
+        });
+
+        Ok(AntennaRemap {
+            antenna_indices,
+            convention,
+            baselines,
+            num_input_ants,
+            legacy_conversion_table,
+        })
+    }
+
+    /// Returns the number of output baselines.
+    pub fn num_baselines(&self) -> usize {
+        self.baselines.len()
+    }
+}
+
+/// Compose a legacy conversion table entry with a remapped baseline, so converting with the result
+/// writes the remapped baseline directly.
+fn compose_legacy_baseline(
+    output_index: usize,
+    source: &LegacyConversionBaseline,
+    baseline: &RemappedBaseline,
+) -> LegacyConversionBaseline {
+    // Each pol of the source is converted as input, conjugated per pol and again for crosses, so
+    // flipping a pol's conjugation conjugates that pol of the output. xy of a swapped baseline is
+    // yx of the source, and vice versa.
+    let ((xy_index, xy_conjugate), (yx_index, yx_conjugate)) = if baseline.swapped {
+        (
+            (source.yx_index, source.yx_conjugate),
+            (source.xy_index, source.xy_conjugate),
+        )
+    } else {
+        (
+            (source.xy_index, source.xy_conjugate),
+            (source.yx_index, source.yx_conjugate),
+        )
+    };
+
+    LegacyConversionBaseline {
+        baseline: output_index as u32,
+        ant1: baseline.ant1_index as u32,
+        ant2: baseline.ant2_index as u32,
+        xx_index: source.xx_index,
+        xx_conjugate: source.xx_conjugate != baseline.conjugate,
+        xy_index,
+        xy_conjugate: xy_conjugate != baseline.conjugate,
+        yx_index,
+        yx_conjugate: yx_conjugate != baseline.conjugate,
+        yy_index: source.yy_index,
+        yy_conjugate: source.yy_conjugate != baseline.conjugate,
+        is_cross: source.is_cross,
+    }
+}
+
+/// Copy one baseline and fine channel of visibilities (xx, xy, yx, yy), exchanging xy and yx for
+/// swapped antennas and conjugating if needed.
+#[inline(always)]
+fn remap_baseline_fine_chan(input: &[f32], output: &mut [f32], baseline: &RemappedBaseline) {
+    let sign = if baseline.conjugate { -1. } else { 1. };
+    let (xy, yx) = if baseline.swapped { (4, 2) } else { (2, 4) };
+
+    output[0] = input[0];
+    output[1] = sign * input[1];
+    output[2] = input[xy];
+    output[3] = sign * input[xy + 1];
+    output[4] = input[yx];
+    output[5] = sign * input[yx + 1];
+    output[6] = input[6];
+    output[7] = sign * input[7];
+}
+
+/// Remap MWAX visibilities, in [baseline][freq][pol][real][imag] order, into the remap's
+/// baselines in the same order. Output baselines are gathered in parallel, in the current rayon
+/// thread pool.
+///
+/// # Arguments
+///
+/// * `remap` - the remap.
+///
+/// * `input_buffer` - the raw MWAX HDU.
+///
+/// * `output_buffer` - slice of at least `remap.num_baselines()` * fine chans * 8 floats.
+///
+/// * `num_fine_chans` - number of fine channels per coarse channel.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+pub(crate) fn remap_mwax_hdu_to_baseline_order(
+    remap: &AntennaRemap,
+    input_buffer: &[f32],
+    output_buffer: &mut [f32],
+    num_fine_chans: usize,
+) {
+    let floats_per_baseline_fine_chan = 8;
+    let floats_per_baseline = num_fine_chans * floats_per_baseline_fine_chan;
+
+    output_buffer[..remap.num_baselines() * floats_per_baseline]
+        .par_chunks_mut(floats_per_baseline)
+        .zip(remap.baselines.par_iter())
+        .for_each(|(output_baseline, baseline)| {
+            let source_index = baseline.source_baseline_index * floats_per_baseline;
+            let input_baseline = &input_buffer[source_index..source_index + floats_per_baseline];
+            if !baseline.swapped && !baseline.conjugate {
+                output_baseline.copy_from_slice(input_baseline);
+                return;
+            }
+            for (input, output) in input_baseline
+                .chunks_exact(floats_per_baseline_fine_chan)
+                .zip(output_baseline.chunks_exact_mut(floats_per_baseline_fine_chan))
+            {
+                remap_baseline_fine_chan(input, output, baseline);
+            }
+        });
+}
+
+/// Remap MWAX visibilities, in [baseline][freq][pol][real][imag] order, into the remap's
+/// baselines in [freq][baseline][pol][real][imag] order. Fine channels are gathered in parallel,
+/// in the current rayon thread pool.
+///
+/// # Arguments
+///
+/// * `remap` - the remap.
+///
+/// * `input_buffer` - the raw MWAX HDU.
+///
+/// * `output_buffer` - slice of at least `remap.num_baselines()` * fine chans * 8 floats.
+///
+/// * `num_fine_chans` - number of fine channels per coarse channel.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+pub(crate) fn remap_mwax_hdu_to_frequency_order(
+    remap: &AntennaRemap,
+    input_buffer: &[f32],
+    output_buffer: &mut [f32],
+    num_fine_chans: usize,
+) {
+    let floats_per_baseline_fine_chan = 8;
+    let floats_per_baseline = num_fine_chans * floats_per_baseline_fine_chan;
+    let floats_per_fine_chan = remap.num_baselines() * floats_per_baseline_fine_chan;
+
+    output_buffer[..num_fine_chans * floats_per_fine_chan]
+        .par_chunks_mut(floats_per_fine_chan)
+        .enumerate()
+        .for_each(|(fine_chan_index, output_fine_chan)| {
+            for (baseline, output) in remap
+                .baselines
+                .iter()
+                .zip(output_fine_chan.chunks_exact_mut(floats_per_baseline_fine_chan))
+            {
+                let source_index = baseline.source_baseline_index * floats_per_baseline
+                    + fine_chan_index * floats_per_baseline_fine_chan;
+                remap_baseline_fine_chan(
+                    &input_buffer[source_index..source_index + floats_per_baseline_fine_chan],
+                    output,
+                    baseline,
+                );
+            }
+        });
+}
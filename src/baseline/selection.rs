@@ -0,0 +1,275 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Selecting baselines by length, orientation, antennas, tile names, flags, or autos and crosses.
+
+A `BaselineGeometry` holds each baseline's separation, length, orientation and flag state as
+contiguous arrays; `MetafitsContext` builds it on first use and shares it between clones. A
+selection resolves its antennas and tile names to a per-antenna mask once, then makes a single
+branch-light pass over the arrays, so selecting from 8256 baselines takes microseconds. The
+result is a sorted list of baseline indices; `get_index_ranges` turns it into the contiguous runs
+that `CorrelatorContext::read_by_baseline_rows_into_buffer` reads.
+ */
+use std::f64::consts::PI;
+use std::ops::Range;
+
+use super::error::BaselineError;
+use super::Baseline;
+use crate::antenna::Antenna;
+
+/// Separation, length, orientation and flag state of every baseline, in baseline order.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct BaselineGeometry {
+    /// Index of each baseline's first antenna
+    pub ant1_indices: Vec<u32>,
+    /// Index of each baseline's second antenna
+    pub ant2_indices: Vec<u32>,
+    /// East component of the separation (antenna 2 - antenna 1) in metres
+    pub east_m: Vec<f64>,
+    /// North component of the separation in metres
+    pub north_m: Vec<f64>,
+    /// Height component of the separation in metres
+    pub height_m: Vec<f64>,
+    /// Length of the separation in metres
+    pub length_m: Vec<f64>,
+    /// Direction of the separation's ground projection in radians east of north, in [0, pi). A
+    /// baseline and its reverse have the same orientation.
+    pub orientation_rad: Vec<f64>,
+    /// True if either of the baseline's antennas is flagged in the metafits
+    pub flagged: Vec<bool>,
+}
+
+impl BaselineGeometry {
+    /// Compute the geometry of some baselines.
+    ///
+    /// # Arguments
+    ///
+    /// * `antennas` - the observation's antennas.
+    ///
+    /// * `baselines` - the baselines, whose antenna indices index `antennas`.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A populated `BaselineGeometry`.
+    ///
+    ///
+    pub(crate) fn new(antennas: &[Antenna], baselines: &[Baseline]) -> Self {
+        let num_baselines = baselines.len();
+        let mut geometry = BaselineGeometry {
+            ant1_indices: Vec::with_capacity(num_baselines),
+            ant2_indices: Vec::with_capacity(num_baselines),
+            east_m: Vec::with_capacity(num_baselines),
+            north_m: Vec::with_capacity(num_baselines),
+            height_m: Vec::with_capacity(num_baselines),
+            length_m: Vec::with_capacity(num_baselines),
+            orientation_rad: Vec::with_capacity(num_baselines),
+            flagged: Vec::with_capacity(num_baselines),
+        };
+
+        for baseline in baselines {
+            // Both pols of an antenna share its position
+            let ant1 = &antennas[baseline.ant1_index];
+            let ant2 = &antennas[baseline.ant2_index];
+            let east_m = ant2.rfinput_x.east_m - ant1.rfinput_x.east_m;
+            let north_m = ant2.rfinput_x.north_m - ant1.rfinput_x.north_m;
+            let height_m = ant2.rfinput_x.height_m - ant1.rfinput_x.height_m;
+
+            geometry.ant1_indices.push(baseline.ant1_index as u32);
+            geometry.ant2_indices.push(baseline.ant2_index as u32);
+            geometry.east_m.push(east_m);
+            geometry.north_m.push(north_m);
+            geometry.height_m.push(height_m);
+            geometry
+                .length_m
+                .push((east_m * east_m + north_m * north_m + height_m * height_m).sqrt());
+            geometry
+                .orientation_rad
+                .push(east_m.atan2(north_m).rem_euclid(PI));
+            geometry.flagged.push(
+                ant1.rfinput_x.flagged
+                    || ant1.rfinput_y.flagged
+                    || ant2.rfinput_x.flagged
+                    || ant2.rfinput_y.flagged,
+            );
+        }
+
+        geometry
+    }
+}
+
+/// Which baselines to select. Every condition must hold for a baseline to be selected; the
+/// default selects every baseline.
+#[derive(Clone, Debug, PartialEq)]
+pub struct BaselineSelection {
+    /// Minimum length in metres (inclusive)
+    pub min_length_m: f64,
+    /// Maximum length in metres (inclusive)
+    pub max_length_m: f64,
+    /// Range of orientations (see `BaselineGeometry::orientation_rad`) in radians, inclusive. If
+    /// the start is greater than the end, the range wraps through 0. Autos have no orientation,
+    /// so are not selected by an orientation range.
+    pub orientation_rad: Option<(f64, f64)>,
+    /// Only baselines whose antennas are both in this set of antenna indices
+    pub antenna_indices: Option<Vec<usize>>,
+    /// Only baselines whose antennas are both in this set of tile names
+    pub tile_names: Option<Vec<String>>,
+    /// Select baselines with a flagged antenna
+    pub include_flagged: bool,
+    /// Select autocorrelations
+    pub autos: bool,
+    /// Select cross-correlations
+    pub crosses: bool,
+}
+
+impl Default for BaselineSelection {
+    fn default() -> Self {
+        BaselineSelection {
+            min_length_m: 0.,
+            max_length_m: f64::INFINITY,
+            orientation_rad: None,
+            antenna_indices: None,
+            tile_names: None,
+            include_flagged: true,
+            autos: true,
+            crosses: true,
+        }
+    }
+}
+
+/// The antennas a selection allows, as a mask over antenna indices.
+///
+/// # Arguments
+///
+/// * `selection` - the selection.
+///
+/// * `antennas` - the observation's antennas.
+///
+///
+/// # Returns
+///
+/// * Result containing a mask of `antennas.len()` values, or a `BaselineError` if an antenna
+///   index or tile name is not in the observation.
+///
+///
+fn get_antenna_mask(
+    selection: &BaselineSelection,
+    antennas: &[Antenna],
+) -> Result<Vec<bool>, BaselineError> {
+    let num_ants = antennas.len();
+    let mut mask = vec![true; num_ants];
+
+    if let Some(antenna_indices) = &selection.antenna_indices {
+        let mut allowed = vec![false; num_ants];
+        for antenna_index in antenna_indices {
+            match allowed.get_mut(*antenna_index) {
+                Some(a) => *a = true,
+                None => {
+                    return Err(BaselineError::InvalidAntennaIndex {
+                        antenna_index: *antenna_index,
+                        num_ants,
+                    })
+                }
+            }
+        }
+        for (m, a) in mask.iter_mut().zip(allowed) {
+            *m &= a;
+        }
+    }
+
+    if let Some(tile_names) = &selection.tile_names {
+        let mut allowed = vec![false; num_ants];
+        for tile_name in tile_names {
+            match antennas.iter().position(|a| &a.tile_name == tile_name) {
+                Some(i) => allowed[i] = true,
+                None => return Err(BaselineError::UnknownTileName(tile_name.clone())),
+            }
+        }
+        for (m, a) in mask.iter_mut().zip(allowed) {
+            *m &= a;
+        }
+    }
+
+    Ok(mask)
+}
+
+/// Select baselines.
+///
+/// # Arguments
+///
+/// * `geometry` - the `BaselineGeometry` of the observation's baselines.
+///
+/// * `antennas` - the observation's antennas.
+///
+/// * `selection` - which baselines to select.
+///
+///
+/// # Returns
+///
+/// * Result containing the indices of the selected baselines in ascending order, or a
+///   `BaselineError` if an antenna index or tile name is not in the observation.
+///
+///
+pub fn select_baselines(
+    geometry: &BaselineGeometry,
+    antennas: &[Antenna],
+    selection: &BaselineSelection,
+) -> Result<Vec<usize>, BaselineError> {
+    let antenna_mask = get_antenna_mask(selection, antennas)?;
+    let in_orientation = |orientation: f64| match selection.orientation_rad {
+        None => true,
+        Some((start, end)) if start <= end => orientation >= start && orientation <= end,
+        Some((start, end)) => orientation >= start || orientation <= end,
+    };
+
+    let mut indices = Vec::with_capacity(geometry.length_m.len());
+    for (i, (((ant1, ant2), length), flagged)) in geometry
+        .ant1_indices
+        .iter()
+        .zip(geometry.ant2_indices.iter())
+        .zip(geometry.length_m.iter())
+        .zip(geometry.flagged.iter())
+        .enumerate()
+    {
+        let is_auto = ant1 == ant2;
+        let selected = antenna_mask[*ant1 as usize]
+            & antenna_mask[*ant2 as usize]
+            & (selection.include_flagged | !flagged)
+            & ((is_auto & selection.autos) | (!is_auto & selection.crosses))
+            & (*length >= selection.min_length_m)
+            & (*length <= selection.max_length_m);
+        if selected
+            && (selection.orientation_rad.is_none()
+                || (!is_auto && in_orientation(geometry.orientation_rad[i])))
+        {
+            indices.push(i);
+        }
+    }
+
+    Ok(indices)
+}
+
+/// Coalesce sorted indices into contiguous ranges.
+///
+/// # Arguments
+///
+/// * `indices` - indices in ascending order, e.g. from `select_baselines`.
+///
+///
+/// # Returns
+///
+/// * The ranges, in ascending order, which together hold exactly `indices`.
+///
+///
+pub fn get_index_ranges(indices: &[usize]) -> Vec<Range<usize>> {
+    let mut ranges: Vec<Range<usize>> = Vec::new();
+    for index in indices {
+        match ranges.last_mut() {
+            Some(r) if r.end == *index => r.end += 1,
+            _ => ranges.push(*index..*index + 1),
+        }
+    }
+    ranges
+}
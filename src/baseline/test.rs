@@ -11,6 +11,8 @@ use super::*;
 #[cfg(test)]
 mod tests {
     use super::*;
+    use crate::antenna::Antenna;
+    use crate::rfinput::*;
 
     #[test]
     fn test_populate_baselines() {
@@ -28,4 +30,285 @@ mod tests {
         assert_eq!(bls[8255].ant1_index, 127);
         assert_eq!(bls[8255].ant2_index, 127);
     }
+
+    /// 4 antennas at (east, north) (0, 0), (10, 0), (0, 20) and (30, 30) metres; antenna 3 is
+    /// flagged
+    fn get_test_antennas() -> Vec<Antenna> {
+        [(0., 0.), (10., 0.), (0., 20.), (30., 30.)]
+            .iter()
+            .enumerate()
+            .map(|(i, (east_m, north_m))| {
+                let rfinput = Rfinput {
+                    input: 2 * i as u32,
+                    ant: i as u32,
+                    tile_id: i as u32,
+                    tile_name: format!("tile{}", i),
+                    pol: Pol::X,
+                    electrical_length_m: 0.,
+                    north_m: *north_m,
+                    east_m: *east_m,
+                    height_m: 0.,
+                    vcs_order: 0,
+                    subfile_order: 0,
+                    flagged: i == 3,
+                    digital_gains: vec![],
+                    dipole_gains: vec![],
+                    dipole_delays: vec![],
+                    rec_number: 1,
+                    rec_slot_number: 0,
+                };
+                Antenna {
+                    ant: i as u32,
+                    tile_id: i as u32,
+                    tile_name: format!("tile{}", i),
+                    rfinput_x: rfinput.clone(),
+                    rfinput_y: Rfinput {
+                        pol: Pol::Y,
+                        ..rfinput
+                    },
+                }
+            })
+            .collect()
+    }
+
+    fn select(selection: &BaselineSelection) -> Result<Vec<usize>, BaselineError> {
+        let antennas = get_test_antennas();
+        let geometry = BaselineGeometry::new(&antennas, &Baseline::populate_baselines(4));
+        select_baselines(&geometry, &antennas, selection)
+    }
+
+    #[test]
+    fn test_baseline_geometry() {
+        let antennas = get_test_antennas();
+        let geometry = BaselineGeometry::new(&antennas, &Baseline::populate_baselines(4));
+        assert_eq!(geometry.length_m.len(), 10);
+
+        // Baseline 1 is antennas 0 and 1, due east
+        assert_eq!(geometry.east_m[1], 10.);
+        assert_eq!(geometry.length_m[1], 10.);
+        assert_eq!(geometry.orientation_rad[1], std::f64::consts::FRAC_PI_2);
+        // Baseline 5 is antennas 1 and 2, pointing north west; orientations are in [0, pi)
+        assert!(geometry.orientation_rad[5] > std::f64::consts::FRAC_PI_2);
+        assert!(geometry.orientation_rad[5] < std::f64::consts::PI);
+        assert_eq!(
+            geometry.flagged,
+            vec![false, false, false, true, false, false, true, false, true, true]
+        );
+    }
+
+    #[test]
+    fn test_select_baselines() {
+        assert_eq!(
+            select(&BaselineSelection::default()).unwrap(),
+            (0..10).collect::<Vec<_>>()
+        );
+
+        let unflagged_crosses = BaselineSelection {
+            include_flagged: false,
+            autos: false,
+            ..Default::default()
+        };
+        assert_eq!(select(&unflagged_crosses).unwrap(), vec![1, 2, 5]);
+
+        let by_length = BaselineSelection {
+            min_length_m: 15.,
+            max_length_m: 40.,
+            ..Default::default()
+        };
+        assert_eq!(select(&by_length).unwrap(), vec![2, 5, 6, 8]);
+
+        let by_tile_name = BaselineSelection {
+            tile_names: Some(vec![String::from("tile0"), String::from("tile1")]),
+            ..Default::default()
+        };
+        assert_eq!(select(&by_tile_name).unwrap(), vec![0, 1, 4]);
+
+        // Antennas and tile names must both allow an antenna
+        let by_antennas = BaselineSelection {
+            antenna_indices: Some(vec![1, 2, 3]),
+            tile_names: Some(vec![
+                String::from("tile0"),
+                String::from("tile1"),
+                String::from("tile2"),
+            ]),
+            ..Default::default()
+        };
+        assert_eq!(select(&by_antennas).unwrap(), vec![4, 5, 7]);
+    }
+
+    #[test]
+    fn test_select_baselines_by_orientation() {
+        let selection = BaselineSelection {
+            orientation_rad: Some((0.5, 1.3)),
+            ..Default::default()
+        };
+        assert_eq!(select(&selection).unwrap(), vec![3, 6, 8]);
+
+        // A range wrapping through 0 (north-south)
+        let selection = BaselineSelection {
+            orientation_rad: Some((2.5, 0.1)),
+            ..Default::default()
+        };
+        assert_eq!(select(&selection).unwrap(), vec![2, 5]);
+    }
+
+    #[test]
+    fn test_select_baselines_invalid() {
+        let selection = BaselineSelection {
+            tile_names: Some(vec![String::from("tile9")]),
+            ..Default::default()
+        };
+        assert!(matches!(
+            select(&selection),
+            Err(BaselineError::UnknownTileName(_))
+        ));
+
+        let selection = BaselineSelection {
+            antenna_indices: Some(vec![4]),
+            ..Default::default()
+        };
+        assert!(matches!(
+            select(&selection),
+            Err(BaselineError::InvalidAntennaIndex {
+                antenna_index: 4,
+                num_ants: 4
+            })
+        ));
+    }
+
+    #[test]
+    fn test_get_index_ranges() {
+        assert_eq!(
+            get_index_ranges(&[0, 1, 2, 5, 7, 8]),
+            vec![0..3, 5..6, 7..9]
+        );
+        assert!(get_index_ranges(&[]).is_empty());
+    }
+
+    #[test]
+    fn test_antenna_remap() {
+        // 3 antennas, output in the order 2, 0
+        let remap =
+            AntennaRemap::new(vec![2, 0], 3, VisibilityConvention::default(), None).unwrap();
+        assert_eq!(remap.num_baselines(), 3);
+        let sources: Vec<(usize, usize, usize, bool)> = remap
+            .baselines
+            .iter()
+            .map(|b| {
+                (
+                    b.ant1_index,
+                    b.ant2_index,
+                    b.source_baseline_index,
+                    b.swapped,
+                )
+            })
+            .collect();
+        // Input baselines are 0,0 0,1 0,2 1,1 1,2 2,2
+        assert_eq!(
+            sources,
+            vec![(2, 2, 5, false), (2, 0, 2, true), (0, 0, 0, false)]
+        );
+
+        // The identity gives the input order
+        let remap = AntennaRemap::new(
+            (0..128).collect(),
+            128,
+            VisibilityConvention::default(),
+            None,
+        )
+        .unwrap();
+        let baselines = Baseline::populate_baselines(128);
+        assert!(remap.baselines.iter().enumerate().all(|(i, b)| {
+            b.source_baseline_index == i
+                && !b.swapped
+                && baselines[i].ant1_index == b.ant1_index
+                && baselines[i].ant2_index == b.ant2_index
+        }));
+
+        assert!(matches!(
+            AntennaRemap::new(vec![0, 3], 3, VisibilityConvention::default(), None),
+            Err(BaselineError::InvalidAntennaIndex {
+                antenna_index: 3,
+                num_ants: 3
+            })
+        ));
+        assert!(matches!(
+            AntennaRemap::new(vec![1, 0, 1], 3, VisibilityConvention::default(), None),
+            Err(BaselineError::DuplicateAntennaIndex(1))
+        ));
+    }
+
+    #[test]
+    fn test_remap_mwax_hdu() {
+        // 3 antennas (6 baselines), 2 fine channels; each float is its own index
+        let num_fine_chans = 2;
+        let input: Vec<f32> = (0..6 * num_fine_chans * 8).map(|i| i as f32).collect();
+        let remap =
+            AntennaRemap::new(vec![2, 0], 3, VisibilityConvention::default(), None).unwrap();
+
+        let mut by_baseline = vec![0.; 3 * num_fine_chans * 8];
+        remap_mwax_hdu_to_baseline_order(&remap, &input, &mut by_baseline, num_fine_chans);
+        // 2,2 is input baseline 5, unchanged
+        assert_eq!(by_baseline[..16], input[80..96]);
+        // 2,0 is input baseline 0,2 conjugated, with xy and yx exchanged
+        assert_eq!(
+            by_baseline[16..24],
+            [32., -33., 36., -37., 34., -35., 38., -39.]
+        );
+        // 0,0 is input baseline 0
+        assert_eq!(by_baseline[32..48], input[..16]);
+
+        let mut by_frequency = vec![0.; 3 * num_fine_chans * 8];
+        remap_mwax_hdu_to_frequency_order(&remap, &input, &mut by_frequency, num_fine_chans);
+        for baseline in 0..3 {
+            for fine_chan in 0..num_fine_chans {
+                let bl_index = (baseline * num_fine_chans + fine_chan) * 8;
+                let freq_index = (fine_chan * 3 + baseline) * 8;
+                assert_eq!(
+                    by_frequency[freq_index..freq_index + 8],
+                    by_baseline[bl_index..bl_index + 8]
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn test_antenna_remap_with_convention() {
+        let convention = VisibilityConvention {
+            conjugation: ConjugationConvention::Conjugated,
+            triangle: BaselineTriangle::Lower,
+        };
+        let remap = AntennaRemap::new(vec![0, 1, 2], 3, convention, None).unwrap();
+        let sources: Vec<(usize, usize, usize, bool, bool)> = remap
+            .baselines
+            .iter()
+            .map(|b| {
+                (
+                    b.ant1_index,
+                    b.ant2_index,
+                    b.source_baseline_index,
+                    b.swapped,
+                    b.conjugate,
+                )
+            })
+            .collect();
+        // Swapping the antennas of a cross conjugates it, which the convention undoes
+        assert_eq!(
+            sources,
+            vec![
+                (0, 0, 0, false, true),
+                (1, 0, 1, true, false),
+                (1, 1, 3, false, true),
+                (2, 0, 2, true, false),
+                (2, 1, 4, true, false),
+                (2, 2, 5, false, true)
+            ]
+        );
+
+        let input: Vec<f32> = (0..6 * 8).map(|i| i as f32).collect();
+        let mut output = vec![0.; 6 * 8];
+        remap_mwax_hdu_to_baseline_order(&remap, &input, &mut output, 1);
+        assert_eq!(output[..8], [0., -1., 2., -3., 4., -5., 6., -7.]);
+        assert_eq!(output[8..16], [8., 9., 12., 13., 10., 11., 14., 15.]);
+    }
 }
@@ -0,0 +1,399 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+A pool of reusable, aligned buffers of 32 bit floats.
+
+Every HDU read needs one or two buffers of `num_timestep_coarse_chan_floats`
+floats. These are large enough that the allocator hands them straight to
+mmap/munmap, so allocating per read means a fresh set of page faults each
+time the buffer is first touched. A `BufferPool` keeps buffers around once
+they have been used, keyed by their size in floats, so that steady-state reads
+reuse already-faulted memory.
+
+A pool is wrapped in an `Arc` so it can be shared between several contexts
+(e.g. one per coarse channel) which have the same HDU geometry.
+ */
+use std::alloc::{self, Layout};
+use std::collections::HashMap;
+use std::fmt;
+use std::ops::{Deref, DerefMut};
+use std::ptr::NonNull;
+use std::sync::{Arc, Mutex};
+
+#[cfg(test)]
+mod test;
+
+/// Alignment of buffers when `BufferAlignment::CacheLine` is requested.
+pub const CACHE_LINE_SIZE_BYTES: usize = 64;
+
+/// Size of a transparent huge page on x86_64 / aarch64 Linux.
+pub const HUGE_PAGE_SIZE_BYTES: usize = 2 * 1024 * 1024;
+
+/// Default maximum number of idle buffers kept for each buffer size.
+pub const DEFAULT_MAX_BUFFERS_PER_SIZE: usize = 16;
+
+/// The alignment of buffers handed out by a `BufferPool`.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum BufferAlignment {
+    /// Align to a 64 byte cache line.
+    CacheLine,
+    /// Align to the operating system page size.
+    Page,
+}
+
+/// Returns the operating system page size in bytes.
+fn get_page_size_bytes() -> usize {
+    let page_size = unsafe { libc::sysconf(libc::_SC_PAGESIZE) };
+
+    if page_size > 0 {
+        page_size as usize
+    } else {
+        4096
+    }
+}
+
+/// A heap allocated, zero-initialised and pre-faulted buffer of floats with a
+/// guaranteed alignment.
+pub struct AlignedBuffer {
+    ptr: NonNull<f32>,
+    len: usize,
+    layout: Layout,
+}
+
+// AlignedBuffer uniquely owns its allocation, just like a Vec<f32>.
+unsafe impl Send for AlignedBuffer {}
+unsafe impl Sync for AlignedBuffer {}
+
+impl AlignedBuffer {
+    /// Allocate a new buffer.
+    ///
+    /// The whole allocation is written to once before returning, so every page
+    /// is faulted in up front rather than on the first read into the buffer.
+    ///
+    /// # Arguments
+    ///
+    /// * `len` - number of floats in the buffer.
+    ///
+    /// * `alignment` - required alignment of the start of the buffer.
+    ///
+    /// * `use_huge_pages` - if true (and on Linux), align to and advise the kernel to back the buffer with transparent huge pages.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A new `AlignedBuffer` of `len` zeroes.
+    ///
+    ///
+    pub fn new(len: usize, alignment: BufferAlignment, use_huge_pages: bool) -> Self {
+        let mut align_bytes = match alignment {
+            BufferAlignment::CacheLine => CACHE_LINE_SIZE_BYTES,
+            BufferAlignment::Page => get_page_size_bytes(),
+        };
+
+        let requested_bytes = len * std::mem::size_of::<f32>();
+
+        // Only bother with huge pages if the buffer will cover at least one.
+        let use_huge_pages =
+            cfg!(target_os = "linux") && use_huge_pages && requested_bytes >= HUGE_PAGE_SIZE_BYTES;
+        if use_huge_pages {
+            align_bytes = HUGE_PAGE_SIZE_BYTES;
+        }
+
+        // Round the allocation up to a whole number of alignment units. This
+        // also avoids a zero sized allocation when len is 0.
+        let alloc_bytes = std::cmp::max(
+            ((requested_bytes + align_bytes - 1) / align_bytes) * align_bytes,
+            align_bytes,
+        );
+        let layout = Layout::from_size_align(alloc_bytes, align_bytes)
+            .expect("AlignedBuffer::new: invalid layout");
+
+        let raw_ptr = unsafe { alloc::alloc(layout) };
+        if raw_ptr.is_null() {
+            alloc::handle_alloc_error(layout);
+        }
+
+        #[cfg(target_os = "linux")]
+        {
+            if use_huge_pages {
+                // This is only advice; if THP is disabled the kernel will
+                // ignore it and we still have a perfectly good buffer.
+                unsafe {
+                    libc::madvise(
+                        raw_ptr as *mut libc::c_void,
+                        alloc_bytes,
+                        libc::MADV_HUGEPAGE,
+                    );
+                }
+            }
+        }
+
+        // Zero (and therefore fault in) the whole allocation now.
+        unsafe { std::ptr::write_bytes(raw_ptr, 0, alloc_bytes) };
+
+        AlignedBuffer {
+            ptr: NonNull::new(raw_ptr as *mut f32).unwrap(),
+            len,
+            layout,
+        }
+    }
+
+    /// Returns the alignment of this buffer in bytes.
+    pub fn alignment(&self) -> usize {
+        self.layout.align()
+    }
+}
+
+impl Drop for AlignedBuffer {
+    fn drop(&mut self) {
+        unsafe { alloc::dealloc(self.ptr.as_ptr() as *mut u8, self.layout) };
+    }
+}
+
+impl Deref for AlignedBuffer {
+    type Target = [f32];
+
+    fn deref(&self) -> &[f32] {
+        unsafe { std::slice::from_raw_parts(self.ptr.as_ptr(), self.len) }
+    }
+}
+
+impl DerefMut for AlignedBuffer {
+    fn deref_mut(&mut self) -> &mut [f32] {
+        unsafe { std::slice::from_raw_parts_mut(self.ptr.as_ptr(), self.len) }
+    }
+}
+
+impl fmt::Debug for AlignedBuffer {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(
+            f,
+            "AlignedBuffer {{ len: {}, alignment: {} }}",
+            self.len,
+            self.layout.align()
+        )
+    }
+}
+
+///
+/// A thread-safe pool of `AlignedBuffer`s, keyed by size (in floats).
+///
+pub struct BufferPool {
+    /// Alignment of buffers allocated by this pool.
+    alignment: BufferAlignment,
+    /// Ask the kernel for transparent huge pages for large buffers.
+    use_huge_pages: bool,
+    /// The most idle buffers we keep for any one size. Buffers returned when
+    /// this is reached are freed.
+    max_buffers_per_size: usize,
+    /// Idle buffers, keyed by the number of floats in each buffer.
+    free_buffers: Mutex<HashMap<usize, Vec<AlignedBuffer>>>,
+}
+
+impl BufferPool {
+    /// Create a new, empty `BufferPool` with cache line aligned buffers and no
+    /// huge pages.
+    ///
+    /// # Returns
+    ///
+    /// * A new `BufferPool`.
+    ///
+    ///
+    pub fn new() -> Self {
+        Self::with_options(
+            BufferAlignment::CacheLine,
+            false,
+            DEFAULT_MAX_BUFFERS_PER_SIZE,
+        )
+    }
+
+    /// Create a new, empty `BufferPool`.
+    ///
+    /// # Arguments
+    ///
+    /// * `alignment` - alignment of each buffer.
+    ///
+    /// * `use_huge_pages` - request transparent huge pages for buffers of 2 MiB or more (Linux only).
+    ///
+    /// * `max_buffers_per_size` - the most idle buffers kept for each size.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A new `BufferPool`.
+    ///
+    ///
+    pub fn with_options(
+        alignment: BufferAlignment,
+        use_huge_pages: bool,
+        max_buffers_per_size: usize,
+    ) -> Self {
+        BufferPool {
+            alignment,
+            use_huge_pages,
+            max_buffers_per_size,
+            free_buffers: Mutex::new(HashMap::new()),
+        }
+    }
+
+    /// Take a buffer of `num_floats` floats out of the pool, allocating a new
+    /// one if there are none idle. The buffer goes back into the pool when the
+    /// returned `PooledBuffer` is dropped.
+    ///
+    /// Note that a reused buffer still holds whatever was last written into it.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_floats` - number of floats required. Typically `num_timestep_coarse_chan_floats`.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A `PooledBuffer` of exactly `num_floats` floats.
+    ///
+    ///
+    pub fn get(self: &Arc<Self>, num_floats: usize) -> PooledBuffer {
+        let reused = self
+            .free_buffers
+            .lock()
+            .unwrap()
+            .get_mut(&num_floats)
+            .and_then(|buffers| buffers.pop());
+
+        let buffer = match reused {
+            Some(b) => b,
+            None => AlignedBuffer::new(num_floats, self.alignment, self.use_huge_pages),
+        };
+
+        PooledBuffer {
+            buffer: Some(buffer),
+            pool: Arc::clone(self),
+        }
+    }
+
+    /// Allocate buffers ahead of time so that even the first reads do not need
+    /// to allocate.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_floats` - number of floats in each buffer.
+    ///
+    /// * `count` - number of idle buffers of this size the pool should hold (capped at `max_buffers_per_size`).
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Nothing
+    ///
+    ///
+    pub fn preallocate(&self, num_floats: usize, count: usize) {
+        let count = std::cmp::min(count, self.max_buffers_per_size);
+        let mut free_buffers = self.free_buffers.lock().unwrap();
+        let buffers = free_buffers.entry(num_floats).or_insert_with(Vec::new);
+
+        while buffers.len() < count {
+            buffers.push(AlignedBuffer::new(
+                num_floats,
+                self.alignment,
+                self.use_huge_pages,
+            ));
+        }
+    }
+
+    /// Returns the number of idle buffers of `num_floats` floats in the pool.
+    pub fn num_free_buffers(&self, num_floats: usize) -> usize {
+        self.free_buffers
+            .lock()
+            .unwrap()
+            .get(&num_floats)
+            .map_or(0, |b| b.len())
+    }
+
+    /// Free all idle buffers held by the pool. Buffers currently checked out
+    /// are not affected.
+    pub fn clear(&self) {
+        self.free_buffers.lock().unwrap().clear();
+    }
+
+    /// Return a buffer to the pool (or free it if the pool is full).
+    fn put(&self, buffer: AlignedBuffer) {
+        let mut free_buffers = self.free_buffers.lock().unwrap();
+        let buffers = free_buffers.entry(buffer.len).or_insert_with(Vec::new);
+
+        if buffers.len() < self.max_buffers_per_size {
+            buffers.push(buffer);
+        }
+    }
+}
+
+impl Default for BufferPool {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl fmt::Debug for BufferPool {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        let free_buffers = self.free_buffers.lock().unwrap();
+        let mut sizes: Vec<(&usize, usize)> =
+            free_buffers.iter().map(|(k, v)| (k, v.len())).collect();
+        sizes.sort();
+
+        write!(
+            f,
+            "BufferPool {{ alignment: {:?}, use_huge_pages: {}, max_buffers_per_size: {}, free (num_floats, count): {:?} }}",
+            self.alignment, self.use_huge_pages, self.max_buffers_per_size, sizes
+        )
+    }
+}
+
+///
+/// A buffer on loan from a `BufferPool`. Derefs to a `[f32]` slice, and is
+/// returned to its pool when dropped.
+///
+pub struct PooledBuffer {
+    buffer: Option<AlignedBuffer>,
+    pool: Arc<BufferPool>,
+}
+
+impl PooledBuffer {
+    /// Returns the pool this buffer will be returned to.
+    pub fn pool(&self) -> &Arc<BufferPool> {
+        &self.pool
+    }
+
+    /// Copy the contents of this buffer into a new `Vec<f32>`.
+    pub fn to_vec(&self) -> Vec<f32> {
+        self.deref().to_vec()
+    }
+}
+
+impl Drop for PooledBuffer {
+    fn drop(&mut self) {
+        if let Some(buffer) = self.buffer.take() {
+            self.pool.put(buffer);
+        }
+    }
+}
+
+impl Deref for PooledBuffer {
+    type Target = [f32];
+
+    fn deref(&self) -> &[f32] {
+        self.buffer.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for PooledBuffer {
+    fn deref_mut(&mut self) -> &mut [f32] {
+        self.buffer.as_mut().unwrap()
+    }
+}
+
+impl fmt::Debug for PooledBuffer {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "PooledBuffer {{ {:?} }}", self.buffer)
+    }
+}
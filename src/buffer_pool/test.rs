@@ -0,0 +1,145 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for the buffer pool
+*/
+#[cfg(test)]
+use super::*;
+
+#[test]
+fn test_aligned_buffer_cache_line() {
+    let buffer = AlignedBuffer::new(1000, BufferAlignment::CacheLine, false);
+
+    assert_eq!(buffer.len(), 1000);
+    assert_eq!(buffer.as_ptr() as usize % CACHE_LINE_SIZE_BYTES, 0);
+    assert!(buffer.iter().all(|x| *x == 0.));
+}
+
+#[test]
+fn test_aligned_buffer_page() {
+    let buffer = AlignedBuffer::new(1000, BufferAlignment::Page, false);
+
+    assert_eq!(buffer.len(), 1000);
+    assert_eq!(buffer.as_ptr() as usize % get_page_size_bytes(), 0);
+}
+
+#[test]
+fn test_aligned_buffer_huge_pages() {
+    // 4 MiB of floats so huge pages are requested
+    let num_floats = HUGE_PAGE_SIZE_BYTES / 2;
+    let mut buffer = AlignedBuffer::new(num_floats, BufferAlignment::CacheLine, true);
+
+    assert_eq!(buffer.len(), num_floats);
+    if cfg!(target_os = "linux") {
+        assert_eq!(buffer.alignment(), HUGE_PAGE_SIZE_BYTES);
+        assert_eq!(buffer.as_ptr() as usize % HUGE_PAGE_SIZE_BYTES, 0);
+    }
+
+    buffer[num_floats - 1] = 1.;
+    assert_eq!(buffer[num_floats - 1], 1.);
+}
+
+#[test]
+fn test_aligned_buffer_empty() {
+    let buffer = AlignedBuffer::new(0, BufferAlignment::CacheLine, false);
+
+    assert!(buffer.is_empty());
+}
+
+#[test]
+fn test_buffer_pool_reuse() {
+    let pool = Arc::new(BufferPool::new());
+    assert_eq!(pool.num_free_buffers(100), 0);
+
+    let first_ptr = {
+        let mut buffer = pool.get(100);
+        assert_eq!(buffer.len(), 100);
+        buffer[0] = 42.;
+        buffer.as_ptr()
+    };
+
+    // Dropping the buffer puts it back in the pool
+    assert_eq!(pool.num_free_buffers(100), 1);
+
+    // Getting another buffer of the same size should give us the same memory back
+    let buffer = pool.get(100);
+    assert_eq!(buffer.as_ptr(), first_ptr);
+    assert_eq!(buffer[0], 42.);
+    assert_eq!(pool.num_free_buffers(100), 0);
+}
+
+#[test]
+fn test_buffer_pool_size_classes() {
+    let pool = Arc::new(BufferPool::new());
+
+    {
+        let _a = pool.get(100);
+        let _b = pool.get(200);
+        let _c = pool.get(200);
+    }
+
+    assert_eq!(pool.num_free_buffers(100), 1);
+    assert_eq!(pool.num_free_buffers(200), 2);
+
+    // A buffer of a different size is a new allocation
+    let buffer = pool.get(300);
+    assert_eq!(buffer.len(), 300);
+    assert_eq!(pool.num_free_buffers(100), 1);
+    assert_eq!(pool.num_free_buffers(200), 2);
+}
+
+#[test]
+fn test_buffer_pool_max_buffers_per_size() {
+    let pool = Arc::new(BufferPool::with_options(
+        BufferAlignment::CacheLine,
+        false,
+        2,
+    ));
+
+    {
+        let _a = pool.get(10);
+        let _b = pool.get(10);
+        let _c = pool.get(10);
+    }
+
+    assert_eq!(pool.num_free_buffers(10), 2);
+}
+
+#[test]
+fn test_buffer_pool_preallocate_and_clear() {
+    let pool = Arc::new(BufferPool::new());
+    pool.preallocate(50, 4);
+    assert_eq!(pool.num_free_buffers(50), 4);
+
+    // Preallocating is capped at the max buffers per size
+    pool.preallocate(50, DEFAULT_MAX_BUFFERS_PER_SIZE + 10);
+    assert_eq!(pool.num_free_buffers(50), DEFAULT_MAX_BUFFERS_PER_SIZE);
+
+    pool.clear();
+    assert_eq!(pool.num_free_buffers(50), 0);
+}
+
+#[test]
+fn test_buffer_pool_shared_across_threads() {
+    let pool = Arc::new(BufferPool::new());
+    pool.preallocate(1000, 4);
+
+    let handles: Vec<_> = (0..4)
+        .map(|i| {
+            let pool = Arc::clone(&pool);
+            std::thread::spawn(move || {
+                let mut buffer = pool.get(1000);
+                buffer.iter_mut().for_each(|x| *x = i as f32);
+                buffer.iter().sum::<f32>()
+            })
+        })
+        .collect();
+
+    for (i, h) in handles.into_iter().enumerate() {
+        assert_eq!(h.join().unwrap(), 1000. * i as f32);
+    }
+
+    assert_eq!(pool.num_free_buffers(1000), 4);
+}
@@ -0,0 +1,120 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Precomputed fine channel frequencies, and the position of each fine channel in the observation's
+band in sky frequency order.
+
+Coarse channels are held in ascending sky frequency order, whatever order the correlator wrote them
+in (legacy receiver channels above 128 are reversed), so both tables are indexed
+[coarse chan][fine chan] with the coarse channels as in `coarse_chans`. A fine channel's sky index
+counts fine channels across all of the metafits' coarse channels, so data from any subset of
+coarse channels can be placed straight into a full band array.
+ */
+use super::CoarseChannel;
+
+/// Fine channel frequencies and sky order indices of a set of coarse channels.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct FineChanTable {
+    /// Number of coarse channels in the table
+    pub num_coarse_chans: usize,
+    /// Number of fine channels in each coarse channel
+    pub num_fine_chans_per_coarse: usize,
+    /// Number of fine channels across all of the metafits' coarse channels
+    pub num_sky_fine_chans: usize,
+    /// Centre frequency of each fine channel in Hz, [coarse chan][fine chan]
+    pub freqs_hz: Vec<f64>,
+    /// Index of each fine channel across all of the metafits' fine channels in sky frequency
+    /// order, [coarse chan][fine chan]
+    pub sky_fine_chan_indices: Vec<usize>,
+}
+
+impl FineChanTable {
+    /// Build the table of some coarse channels.
+    ///
+    /// # Arguments
+    ///
+    /// * `coarse_chans` - the coarse channels, in ascending sky frequency order.
+    ///
+    /// * `metafits_rec_chan_numbers` - receiver channel numbers of all of the metafits' coarse channels, in any order.
+    ///
+    /// * `num_fine_chans_per_coarse` - the number of fine channels in each coarse channel.
+    ///
+    /// * `fine_chan_width_hz` - the width of each fine channel.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A populated `FineChanTable`. Fine channel `f` of a coarse channel is centred
+    ///   `(f + 0.5) * fine_chan_width_hz` above the coarse channel's start.
+    ///
+    ///
+    pub(crate) fn new(
+        coarse_chans: &[CoarseChannel],
+        metafits_rec_chan_numbers: &[usize],
+        num_fine_chans_per_coarse: usize,
+        fine_chan_width_hz: u32,
+    ) -> Self {
+        let mut sky_rec_chan_numbers = metafits_rec_chan_numbers.to_vec();
+        sky_rec_chan_numbers.sort_unstable();
+
+        let num_fine_chans = coarse_chans.len() * num_fine_chans_per_coarse;
+        let mut freqs_hz = Vec::with_capacity(num_fine_chans);
+        let mut sky_fine_chan_indices = Vec::with_capacity(num_fine_chans);
+        for coarse_chan in coarse_chans {
+            let chan_start_hz = coarse_chan.chan_start_hz as f64;
+            freqs_hz.extend((0..num_fine_chans_per_coarse).map(|fine_chan_index| {
+                chan_start_hz + (fine_chan_index as f64 + 0.5) * fine_chan_width_hz as f64
+            }));
+
+            // A context's coarse channels always come from the metafits
+            let sky_coarse_chan_index = sky_rec_chan_numbers
+                .binary_search(&coarse_chan.rec_chan_number)
+                .unwrap_or_else(|i| i);
+            let sky_start = sky_coarse_chan_index * num_fine_chans_per_coarse;
+            sky_fine_chan_indices.extend(sky_start..sky_start + num_fine_chans_per_coarse);
+        }
+
+        FineChanTable {
+            num_coarse_chans: coarse_chans.len(),
+            num_fine_chans_per_coarse,
+            num_sky_fine_chans: sky_rec_chan_numbers.len() * num_fine_chans_per_coarse,
+            freqs_hz,
+            sky_fine_chan_indices,
+        }
+    }
+
+    /// The fine channel centre frequencies of one coarse channel.
+    ///
+    /// # Arguments
+    ///
+    /// * `coarse_chan_index` - index of the coarse channel within the table.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A slice of `num_fine_chans_per_coarse` frequencies in Hz.
+    ///
+    ///
+    pub fn get_coarse_chan_freqs_hz(&self, coarse_chan_index: usize) -> &[f64] {
+        let start = coarse_chan_index * self.num_fine_chans_per_coarse;
+        &self.freqs_hz[start..start + self.num_fine_chans_per_coarse]
+    }
+
+    /// The sky order index of one coarse channel's first fine channel.
+    ///
+    /// # Arguments
+    ///
+    /// * `coarse_chan_index` - index of the coarse channel within the table.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The sky fine channel index. The coarse channel's other fine channels follow it.
+    ///
+    ///
+    pub fn get_first_sky_fine_chan_index(&self, coarse_chan_index: usize) -> usize {
+        self.sky_fine_chan_indices[coarse_chan_index * self.num_fine_chans_per_coarse]
+    }
+}
@@ -8,8 +8,10 @@ Structs and helper methods for coarse channel metadata
 use crate::gpubox_files::GpuboxTimeMap;
 use crate::voltage_files::VoltageFileTimeMap;
 pub mod error;
+mod fine_chan_table;
 use crate::*;
 use error::CoarseChannelError;
+pub use fine_chan_table::FineChanTable;
 use std::fmt;
 
 #[cfg(test)]
@@ -342,3 +342,42 @@ fn test_coarse_chan_debug() {
 
     assert_eq!(format!("{:?}", cc), "gpu=2 corr=1 rec=109 @ 139.520 MHz");
 }
+
+#[test]
+fn test_fine_chan_table() {
+    // Legacy receiver channels 127..=130, of which the correlator reverses those above 128;
+    // the context only has 128 and 130
+    let metafits_rec_chans = vec![127, 128, 129, 130];
+    let gpubox_time_map = get_gpubox_time_map(vec![2, 3]);
+    let coarse_chans = CoarseChannel::populate_coarse_channels(
+        CorrelatorVersion::Legacy,
+        &metafits_rec_chans,
+        1_280_000,
+        Some(&gpubox_time_map),
+        None,
+    )
+    .unwrap();
+    assert_eq!(
+        coarse_chans
+            .iter()
+            .map(|c| c.rec_chan_number)
+            .collect::<Vec<_>>(),
+        vec![128, 130]
+    );
+
+    let table = FineChanTable::new(&coarse_chans, &metafits_rec_chans, 4, 320_000);
+    assert_eq!(table.num_coarse_chans, 2);
+    assert_eq!(table.num_sky_fine_chans, 16);
+    assert_eq!(
+        table.sky_fine_chan_indices,
+        vec![4, 5, 6, 7, 12, 13, 14, 15]
+    );
+    assert_eq!(table.get_first_sky_fine_chan_index(1), 12);
+
+    // Receiver channel 128 is centred on 163.84 MHz
+    assert_eq!(
+        table.get_coarse_chan_freqs_hz(0),
+        &[163_360_000., 163_680_000., 164_000_000., 164_320_000.]
+    );
+    assert_eq!(table.freqs_hz[4], 165_920_000.);
+}
@@ -0,0 +1,38 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with compressing and decompressing visibility chunks.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum CodecError {
+    /// Error when data to compress is not a whole number of rows.
+    #[error("{num_floats} floats cannot be split into rows of {row_floats} floats")]
+    InvalidRowSize {
+        num_floats: usize,
+        row_floats: usize,
+    },
+
+    /// Error when a row range is outside the compressed data.
+    #[error("Rows {start}..{end} were requested but the compressed data has {num_rows} rows")]
+    InvalidRowRange {
+        start: usize,
+        end: usize,
+        num_rows: usize,
+    },
+
+    /// Error when the output buffer is not the size of the data being decompressed.
+    #[error("Invalid buffer size provided. The buffer holds {buffer_len} floats but {expected_len} are being decompressed")]
+    InvalidBufferSize {
+        buffer_len: usize,
+        expected_len: usize,
+    },
+
+    /// Error when compressed data is damaged or is not from this codec.
+    #[error("Compressed data is corrupt: {reason}")]
+    Corrupt { reason: &'static str },
+}
@@ -0,0 +1,380 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Lossless compression of converted visibilities.
+
+Visibilities are split into rows (a baseline in baseline order, or a fine channel in frequency
+order), and whole rows are grouped into blocks of about `DEFAULT_CODEC_BLOCK_BYTES`. Each block
+is byte-shuffled (the first byte of every float, then the second byte of every float, and so
+on; neighbouring visibilities share their sign and exponent bytes, so this makes long runs) and
+then compressed with zstd at a fast level. Blocks are compressed and decompressed in parallel, in
+the current rayon thread pool, and a range of rows can be decompressed without touching the other
+blocks.
+
+Byte shuffling is used rather than bitshuffle. Bitshuffle mostly pays off in front of LZ4, which
+has no entropy coding of its own; zstd's entropy coder already packs the mantissa bytes that
+bitshuffle would split into bit planes, so byte shuffling gets nearly the same ratio for much
+less work per float.
+
+Compressed data starts with a header:
+
+* magic "MWZ2"
+* floats per row (u32)
+* number of rows (u64)
+* rows per block (u32)
+* number of blocks (u32)
+* end offset of each block within the block data (u64 per block)
+
+All little-endian, followed by the blocks. Each block is a mode byte (0 for stored, when
+compression did not help, or 2 for zstd) and then the shuffled bytes, stored or as a zstd frame.
+Floats are shuffled in little-endian byte order, so compressed data can be read on any machine.
+ */
+pub mod error;
+pub use error::CodecError;
+
+use std::ops::Range;
+
+use rayon::prelude::*;
+
+#[cfg(test)]
+mod test;
+
+/// Default uncompressed size of each block, in bytes
+pub const DEFAULT_CODEC_BLOCK_BYTES: usize = 1024 * 1024;
+/// zstd compression level of blocks: fast, as the codec has to keep up with NVMe
+const CODEC_ZSTD_LEVEL: i32 = 1;
+const CONTAINER_MAGIC: &[u8; 4] = b"MWZ2";
+/// Size of the header before the block end offsets
+const CONTAINER_HEADER_BYTES: usize = 24;
+const BLOCK_STORED: u8 = 0;
+const BLOCK_ZSTD: u8 = 2;
+
+/// How chunks of visibilities are stored
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum ChunkCodec {
+    /// Native-endian floats, as is
+    None,
+    /// Byte-shuffled, zstd compressed blocks of whole rows. See the module documentation.
+    ShuffleZstd,
+}
+
+impl ChunkCodec {
+    /// Value stored in file headers to identify the codec
+    pub(crate) fn to_id(self) -> u32 {
+        match self {
+            ChunkCodec::None => 0,
+            ChunkCodec::ShuffleZstd => 2,
+        }
+    }
+
+    /// The codec with an id from a file header, or `None` if the id is unknown
+    pub(crate) fn from_id(id: u32) -> Option<Self> {
+        match id {
+            0 => Some(ChunkCodec::None),
+            2 => Some(ChunkCodec::ShuffleZstd),
+            _ => None,
+        }
+    }
+}
+
+/// The parsed header of compressed data
+#[derive(Debug)]
+struct CompressedLayout {
+    row_floats: usize,
+    num_rows: usize,
+    rows_per_block: usize,
+    /// Byte range of each block within the compressed data
+    block_ranges: Vec<Range<usize>>,
+}
+
+impl CompressedLayout {
+    /// Parse and check the header of compressed data.
+    fn parse(compressed: &[u8]) -> Result<Self, CodecError> {
+        let corrupt = |reason| CodecError::Corrupt { reason };
+        if compressed.len() < CONTAINER_HEADER_BYTES || &compressed[..4] != CONTAINER_MAGIC {
+            return Err(corrupt("missing header"));
+        }
+        let read_u32 = |pos: usize| {
+            let mut bytes = [0u8; 4];
+            bytes.copy_from_slice(&compressed[pos..pos + 4]);
+            u32::from_le_bytes(bytes) as usize
+        };
+        let read_u64 = |pos: usize| {
+            let mut bytes = [0u8; 8];
+            bytes.copy_from_slice(&compressed[pos..pos + 8]);
+            u64::from_le_bytes(bytes) as usize
+        };
+
+        let row_floats = read_u32(4);
+        let num_rows = read_u64(8);
+        let rows_per_block = read_u32(16);
+        let num_blocks = read_u32(20);
+        if row_floats == 0 || rows_per_block == 0 {
+            return Err(corrupt("zero sized rows or blocks"));
+        }
+        if num_blocks != (num_rows + rows_per_block - 1) / rows_per_block {
+            return Err(corrupt("block count does not match row count"));
+        }
+
+        let data_start = CONTAINER_HEADER_BYTES + num_blocks * 8;
+        if compressed.len() < data_start {
+            return Err(corrupt("block table is truncated"));
+        }
+        let mut block_ranges = Vec::with_capacity(num_blocks);
+        let mut start = data_start;
+        for block_index in 0..num_blocks {
+            let end = data_start + read_u64(CONTAINER_HEADER_BYTES + block_index * 8);
+            if end <= start || end > compressed.len() {
+                return Err(corrupt("block offsets are out of order or out of range"));
+            }
+            block_ranges.push(start..end);
+            start = end;
+        }
+
+        Ok(CompressedLayout {
+            row_floats,
+            num_rows,
+            rows_per_block,
+            block_ranges,
+        })
+    }
+
+    /// Returns the range of rows in a block
+    fn get_block_rows(&self, block_index: usize) -> Range<usize> {
+        let start = block_index * self.rows_per_block;
+        start..(start + self.rows_per_block).min(self.num_rows)
+    }
+}
+
+/// Byte-shuffle floats (in little-endian byte order).
+fn shuffle(data: &[f32], shuffled: &mut [u8]) {
+    let n = data.len();
+    for (i, value) in data.iter().enumerate() {
+        let bytes = value.to_le_bytes();
+        shuffled[i] = bytes[0];
+        shuffled[n + i] = bytes[1];
+        shuffled[2 * n + i] = bytes[2];
+        shuffled[3 * n + i] = bytes[3];
+    }
+}
+
+/// Undo `shuffle`.
+fn unshuffle(shuffled: &[u8], data: &mut [f32]) {
+    let n = data.len();
+    for (i, value) in data.iter_mut().enumerate() {
+        *value = f32::from_le_bytes([
+            shuffled[i],
+            shuffled[n + i],
+            shuffled[2 * n + i],
+            shuffled[3 * n + i],
+        ]);
+    }
+}
+
+/// Compress one block of floats: mode byte, then shuffled bytes, stored or zstd compressed.
+fn compress_block(data: &[f32]) -> Vec<u8> {
+    let mut shuffled = vec![0u8; data.len() * 4];
+    shuffle(data, &mut shuffled);
+
+    let mut block = Vec::with_capacity(1 + shuffled.len());
+    // Compressing from memory into memory only fails if zstd cannot allocate
+    match zstd::bulk::compress(&shuffled, CODEC_ZSTD_LEVEL) {
+        Ok(compressed) if compressed.len() < shuffled.len() => {
+            block.push(BLOCK_ZSTD);
+            block.extend_from_slice(&compressed);
+        }
+        _ => {
+            block.push(BLOCK_STORED);
+            block.extend_from_slice(&shuffled);
+        }
+    }
+
+    block
+}
+
+/// Decompress one block written by `compress_block` into `data`, which it must exactly fill.
+fn decompress_block(block: &[u8], data: &mut [f32]) -> Result<(), CodecError> {
+    let mut shuffled = vec![0u8; data.len() * 4];
+    match block[0] {
+        BLOCK_ZSTD => {
+            let num_bytes = zstd::bulk::decompress_to_buffer(&block[1..], &mut shuffled[..])
+                .map_err(|_| CodecError::Corrupt {
+                    reason: "zstd block does not decompress",
+                })?;
+            if num_bytes != shuffled.len() {
+                return Err(CodecError::Corrupt {
+                    reason: "zstd block decompresses to the wrong size",
+                });
+            }
+        }
+        BLOCK_STORED if block.len() - 1 == shuffled.len() => shuffled.copy_from_slice(&block[1..]),
+        _ => {
+            return Err(CodecError::Corrupt {
+                reason: "unknown block mode or wrong stored block size",
+            })
+        }
+    }
+    unshuffle(&shuffled, data);
+
+    Ok(())
+}
+
+/// Compress rows of visibilities in blocks of about `DEFAULT_CODEC_BLOCK_BYTES`. See
+/// `compress_rows_with_block_bytes`.
+pub fn compress_rows(data: &[f32], row_floats: usize) -> Result<Vec<u8>, CodecError> {
+    compress_rows_with_block_bytes(data, row_floats, DEFAULT_CODEC_BLOCK_BYTES)
+}
+
+/// Compress rows of visibilities, compressing blocks in parallel in the current thread pool.
+///
+/// # Arguments
+///
+/// * `data` - the visibilities, a whole number of rows.
+///
+/// * `row_floats` - the number of floats in each row, i.e. the smallest unit that can later be
+///                  decompressed on its own: a baseline (fine chans * pols * 2) in baseline order,
+///                  or a fine channel (baselines * pols * 2) in frequency order.
+///
+/// * `block_bytes` - the approximate uncompressed size of each block. Blocks hold at least one row.
+///
+///
+/// # Returns
+///
+/// * Result containing the compressed data, or `CodecError::InvalidRowSize`.
+///
+///
+pub fn compress_rows_with_block_bytes(
+    data: &[f32],
+    row_floats: usize,
+    block_bytes: usize,
+) -> Result<Vec<u8>, CodecError> {
+    if row_floats == 0 || data.len() % row_floats != 0 {
+        return Err(CodecError::InvalidRowSize {
+            num_floats: data.len(),
+            row_floats,
+        });
+    }
+    let num_rows = data.len() / row_floats;
+    let rows_per_block = (block_bytes / (row_floats * 4)).max(1);
+
+    let blocks: Vec<Vec<u8>> = data
+        .par_chunks(rows_per_block * row_floats)
+        .map(compress_block)
+        .collect();
+
+    let data_start = CONTAINER_HEADER_BYTES + blocks.len() * 8;
+    let mut compressed =
+        Vec::with_capacity(data_start + blocks.iter().map(|b| b.len()).sum::<usize>());
+    compressed.extend_from_slice(CONTAINER_MAGIC);
+    compressed.extend_from_slice(&(row_floats as u32).to_le_bytes());
+    compressed.extend_from_slice(&(num_rows as u64).to_le_bytes());
+    compressed.extend_from_slice(&(rows_per_block as u32).to_le_bytes());
+    compressed.extend_from_slice(&(blocks.len() as u32).to_le_bytes());
+    let mut end = 0;
+    for block in &blocks {
+        end += block.len();
+        compressed.extend_from_slice(&(end as u64).to_le_bytes());
+    }
+    for block in &blocks {
+        compressed.extend_from_slice(block);
+    }
+
+    Ok(compressed)
+}
+
+/// Returns the number of floats in each row and the number of rows of compressed data.
+///
+/// # Arguments
+///
+/// * `compressed` - data from `compress_rows`.
+///
+///
+/// # Returns
+///
+/// * Result containing (floats per row, number of rows), or `CodecError::Corrupt`.
+///
+///
+pub fn get_compressed_shape(compressed: &[u8]) -> Result<(usize, usize), CodecError> {
+    let layout = CompressedLayout::parse(compressed)?;
+
+    Ok((layout.row_floats, layout.num_rows))
+}
+
+/// Decompress all of some compressed data. See `decompress_rows_into`.
+pub fn decompress_into(compressed: &[u8], output: &mut [f32]) -> Result<(), CodecError> {
+    let (_, num_rows) = get_compressed_shape(compressed)?;
+
+    decompress_rows_into(compressed, 0..num_rows, output)
+}
+
+/// Decompress a range of rows, decompressing only the blocks which hold them. Blocks are
+/// decompressed in parallel in the current thread pool.
+///
+/// # Arguments
+///
+/// * `compressed` - data from `compress_rows`.
+///
+/// * `rows` - the rows to decompress.
+///
+/// * `output` - buffer of exactly `rows.len()` rows.
+///
+///
+/// # Returns
+///
+/// * Result containing nothing if Ok, or a `CodecError`.
+///
+///
+pub fn decompress_rows_into(
+    compressed: &[u8],
+    rows: Range<usize>,
+    output: &mut [f32],
+) -> Result<(), CodecError> {
+    let layout = CompressedLayout::parse(compressed)?;
+    if rows.start > rows.end || rows.end > layout.num_rows {
+        return Err(CodecError::InvalidRowRange {
+            start: rows.start,
+            end: rows.end,
+            num_rows: layout.num_rows,
+        });
+    }
+    if output.len() != rows.len() * layout.row_floats {
+        return Err(CodecError::InvalidBufferSize {
+            buffer_len: output.len(),
+            expected_len: rows.len() * layout.row_floats,
+        });
+    }
+    if rows.is_empty() {
+        return Ok(());
+    }
+
+    // Split the output into the part each needed block fills
+    let first_block = rows.start / layout.rows_per_block;
+    let last_block = (rows.end - 1) / layout.rows_per_block;
+    let mut pieces = Vec::with_capacity(last_block - first_block + 1);
+    let mut rest = output;
+    for block_index in first_block..=last_block {
+        let block_rows = layout.get_block_rows(block_index);
+        let wanted = block_rows.start.max(rows.start)..block_rows.end.min(rows.end);
+        let (piece, remainder) = rest.split_at_mut(wanted.len() * layout.row_floats);
+        pieces.push((block_index, block_rows, wanted, piece));
+        rest = remainder;
+    }
+
+    pieces
+        .into_par_iter()
+        .try_for_each(|(block_index, block_rows, wanted, piece)| {
+            let block = &compressed[layout.block_ranges[block_index].clone()];
+            if wanted == block_rows {
+                // The whole block is wanted, so decompress it straight into the output
+                decompress_block(block, piece)
+            } else {
+                let mut block_data = vec![0.; block_rows.len() * layout.row_floats];
+                decompress_block(block, &mut block_data)?;
+                let start = (wanted.start - block_rows.start) * layout.row_floats;
+                piece.copy_from_slice(&block_data[start..start + piece.len()]);
+                Ok(())
+            }
+        })
+}
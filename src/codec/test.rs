@@ -0,0 +1,134 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for the visibility chunk codec
+*/
+#[cfg(test)]
+use super::*;
+
+/// Visibility-like test data: smooth values with a little noise
+fn make_test_data(num_floats: usize) -> Vec<f32> {
+    let mut seed: u32 = 12345;
+    (0..num_floats)
+        .map(|i| {
+            seed = seed.wrapping_mul(1_103_515_245).wrapping_add(12345);
+            ((i % 256) as f32 * 0.25) + (seed >> 28) as f32 * 0.001
+        })
+        .collect()
+}
+
+#[test]
+fn test_shuffle_round_trip() {
+    let data = make_test_data(1001);
+    let mut shuffled = vec![0; data.len() * 4];
+    shuffle(&data, &mut shuffled);
+    // The first quarter is the lowest byte of each float
+    assert_eq!(shuffled[5], data[5].to_le_bytes()[0]);
+    assert_eq!(shuffled[3 * 1001 + 5], data[5].to_le_bytes()[3]);
+
+    let mut unshuffled = vec![0.; data.len()];
+    unshuffle(&shuffled, &mut unshuffled);
+    assert_eq!(unshuffled, data);
+}
+
+#[test]
+fn test_compress_rows_round_trip() {
+    let row_floats = 64;
+    let data = make_test_data(row_floats * 100);
+
+    // 7 rows per block, so the last block is short
+    let compressed = compress_rows_with_block_bytes(&data, row_floats, 7 * row_floats * 4).unwrap();
+    assert!(compressed.len() < data.len() * 4);
+    assert_eq!(
+        get_compressed_shape(&compressed).unwrap(),
+        (row_floats, 100)
+    );
+
+    let mut output = vec![0.; data.len()];
+    decompress_into(&compressed, &mut output).unwrap();
+    assert_eq!(output, data);
+
+    // Ranges within a block, across blocks, whole blocks, and empty
+    for rows in vec![3..5, 5..23, 7..14, 95..100, 0..100, 40..40] {
+        let mut output = vec![0.; rows.len() * row_floats];
+        decompress_rows_into(&compressed, rows.clone(), &mut output).unwrap();
+        assert_eq!(
+            output,
+            &data[rows.start * row_floats..rows.end * row_floats]
+        );
+    }
+}
+
+#[test]
+fn test_compress_rows_errors() {
+    assert!(matches!(
+        compress_rows(&[0.; 10], 3).unwrap_err(),
+        CodecError::InvalidRowSize {
+            num_floats: 10,
+            row_floats: 3
+        }
+    ));
+    assert!(compress_rows(&[0.; 10], 0).is_err());
+
+    let compressed = compress_rows(&[1.; 10], 2).unwrap();
+    assert!(matches!(
+        decompress_rows_into(&compressed, 4..6, &mut [0.; 4]).unwrap_err(),
+        CodecError::InvalidRowRange {
+            start: 4,
+            end: 6,
+            num_rows: 5
+        }
+    ));
+    assert!(matches!(
+        decompress_into(&compressed, &mut [0.; 9]).unwrap_err(),
+        CodecError::InvalidBufferSize {
+            buffer_len: 9,
+            expected_len: 10
+        }
+    ));
+
+    // Damaged data
+    assert!(decompress_into(&compressed[..10], &mut [0.; 10]).is_err());
+    let mut damaged = compressed.clone();
+    let block_start = CONTAINER_HEADER_BYTES + 8;
+    assert_eq!(damaged[block_start], BLOCK_ZSTD);
+    damaged[block_start + 1..]
+        .iter_mut()
+        .for_each(|b| *b = 0xFF);
+    assert!(decompress_into(&damaged, &mut [0.; 10]).is_err());
+    let mut damaged = compressed.clone();
+    damaged[0] = b'X';
+    assert!(decompress_into(&damaged, &mut [0.; 10]).is_err());
+    let mut damaged = compressed;
+    let last = damaged.len() - 1;
+    damaged.truncate(last);
+    assert!(decompress_into(&damaged, &mut [0.; 10]).is_err());
+}
+
+#[test]
+fn test_incompressible_blocks_are_stored() {
+    // Random bytes (from xorshift32) do not compress, so the block is stored and only grows by
+    // its mode byte
+    let mut seed: u32 = 2_463_534_242;
+    let data: Vec<f32> = (0..4096)
+        .map(|_| {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            f32::from_bits(seed)
+        })
+        .collect();
+
+    let compressed = compress_rows(&data, 4096).unwrap();
+    assert_eq!(compressed.len(), CONTAINER_HEADER_BYTES + 8 + 1 + 4096 * 4);
+
+    // Compare bits, as some of the floats are NaNs
+    let mut output = vec![0.; data.len()];
+    decompress_into(&compressed, &mut output).unwrap();
+    assert!(output
+        .iter()
+        .zip(data.iter())
+        .all(|(a, b)| a.to_bits() == b.to_bits()));
+}
@@ -8,8 +8,10 @@ Structs and helper methods for coverting Legacy MWA data into a sensible orderin
 Major contributor: Brian Crosse (Curtin Institute for Radio Astronomy)
 
 */
+use crate::gpubox_files::GpuboxError;
 use crate::misc::*;
 use crate::rfinput::*;
+use rayon::prelude::*;
 use std::fmt;
 
 #[cfg(test)]
@@ -21,6 +23,8 @@ mod test;
 /// then 'or' the bottom 2 bit after shifting them left 4 positions,
 /// then 'or' the middle 4 bits after shifting them right 2 positions
 /// It is inlined so the compiler will effectively make this like a C macro rather than a function call.
+/// Bits above the bottom 6 (which PFB the input is on) are left where they are, so any number of
+/// PFBs can be reordered.
 ///
 /// # Arguments
 ///
@@ -31,21 +35,23 @@ mod test;
 ///
 /// * The correctly reordered rf_input index.
 fn fine_pfb_reorder(input: usize) -> usize {
-    ((input) & 0xc0) | (((input) & 0x03) << 4) | (((input) & 0x3c) >> 2)
+    ((input) & !0x3f) | (((input) & 0x03) << 4) | (((input) & 0x3c) >> 2)
 }
 
 /// Structure for storing where in the input visibilities to get the specified baseline when converting
+///
+/// Indices are u32, so an entry is 36 bytes rather than 64 (4.5 MiB for the 131328 baselines of 512 tiles).
 pub(crate) struct LegacyConversionBaseline {
-    pub baseline: usize,    // baseline index
-    pub ant1: usize,        // antenna1 index
-    pub ant2: usize,        // antenna2 index
-    pub xx_index: usize,    // index of where complex xx is in the input buffer
+    pub baseline: u32,      // baseline index
+    pub ant1: u32,          // antenna1 index
+    pub ant2: u32,          // antenna2 index
+    pub xx_index: u32,      // index of where complex xx is in the input buffer
     pub xx_conjugate: bool, // if true, we need to conjugate this visibility
-    pub xy_index: usize,    // index of where complex xx is in the input buffer
+    pub xy_index: u32,      // index of where complex xx is in the input buffer
     pub xy_conjugate: bool, // if true, we need to conjugate this visibility
-    pub yx_index: usize,    // index of where complex xx is in the input buffer
+    pub yx_index: u32,      // index of where complex xx is in the input buffer
     pub yx_conjugate: bool, // if true, we need to conjugate this visibility
-    pub yy_index: usize,    // index of where complex xx is in the input buffer
+    pub yy_index: u32,      // index of where complex xx is in the input buffer
     pub yy_conjugate: bool, // if true, we need to conjugate this visibility
     pub is_cross: bool,     // if true, we need to conjugate this visibility AGAIN
 }
@@ -69,16 +75,16 @@ impl LegacyConversionBaseline {
     ///
     fn new(baseline: usize, ant1: usize, ant2: usize, xx: i32, xy: i32, yx: i32, yy: i32) -> Self {
         Self {
-            baseline,
-            ant1,
-            ant2,
-            xx_index: xx.abs() as usize,
+            baseline: baseline as u32,
+            ant1: ant1 as u32,
+            ant2: ant2 as u32,
+            xx_index: xx.abs() as u32,
             xx_conjugate: xx < 0,
-            xy_index: xy.abs() as usize,
+            xy_index: xy.abs() as u32,
             xy_conjugate: xy < 0,
-            yx_index: yx.abs() as usize,
+            yx_index: yx.abs() as u32,
             yx_conjugate: yx < 0,
-            yy_index: yy.abs() as usize,
+            yy_index: yy.abs() as u32,
             yy_conjugate: yy < 0,
             is_cross: ant1 != ant2,
         }
@@ -113,9 +119,77 @@ impl fmt::Debug for LegacyConversionBaseline {
     }
 }
 
-/// Generates a full matrix mapping pfb inputs to MWAX format. Used to generate conversion table
-/// which is vector of `
-///LegacyConversionBaseline` structs.
+/// Locates the legacy correlator's products for pairs of rf_inputs, without storing the full
+/// rf_input by rf_input matrix (4 * (2 * tiles)^2 bytes); only the fine-PFB position of each
+/// rf_input is kept, and a product's index is computed from the positions.
+struct LegacyProductLocator {
+    /// Position in the fine-PFB (legacy output) order of each rf_input, indexed by MWAX order
+    pfb_positions: Vec<usize>,
+}
+
+impl LegacyProductLocator {
+    /// Create a new LegacyProductLocator.
+    ///
+    /// # Arguments
+    ///
+    /// * `mwax_order` - The MWAX order of each rf_input, sorted by "input" from the metafits.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A populated LegacyProductLocator.
+    ///
+    fn new(mwax_order: &[usize]) -> Self {
+        let mut pfb_positions = vec![0; mwax_order.len()];
+        for position in 0..mwax_order.len() {
+            // The fine-PFB takes its inputs in *not* metafits order
+            pfb_positions[mwax_order[fine_pfb_reorder(position)]] = position;
+        }
+
+        Self { pfb_positions }
+    }
+
+    /// The index of the product of two rf_inputs (by fine-PFB position) in the legacy output, if
+    /// the legacy correlator outputs it.
+    ///
+    /// The legacy correlator goes through the 2x2 correlation squares on and above the diagonal,
+    /// by column then row, outputting top left, bottom left, top right and bottom right; the
+    /// bottom left of a square on the diagonal is one of its redundant outputs.
+    fn get_output_index(row: usize, col: usize) -> Option<usize> {
+        let (row_square, col_square) = (row / 2, col / 2);
+        if row_square > col_square || (row_square == col_square && row % 2 == 1 && col % 2 == 0) {
+            return None;
+        }
+
+        Some(4 * (col_square * (col_square + 1) / 2 + row_square) + row % 2 + 2 * (col % 2))
+    }
+
+    /// Locate the product of two rf_inputs.
+    ///
+    /// # Arguments
+    ///
+    /// * `row` - The MWAX order of the first rf_input.
+    ///
+    /// * `col` - The MWAX order of the second rf_input.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The index of the product in the legacy output, or its negation if the legacy output has
+    ///   the product of `col` and `row` instead, which must be conjugated.
+    ///
+    fn get(&self, row: usize, col: usize) -> i32 {
+        let (row, col) = (self.pfb_positions[row], self.pfb_positions[col]);
+        match Self::get_output_index(row, col) {
+            Some(index) => index as i32,
+            // Every product the legacy correlator doesn't output is the conjugate of one it does
+            None => -(Self::get_output_index(col, row).unwrap() as i32),
+        }
+    }
+}
+
+/// Generates a full matrix mapping pfb inputs to MWAX format. The conversion table is generated
+/// with a `LegacyProductLocator` rather than this matrix, which is kept to check the locator.
 ///
 ///
 /// # Arguments
@@ -125,62 +199,19 @@ impl fmt::Debug for LegacyConversionBaseline {
 ///
 /// # Returns
 ///
-/// * A Vector with one element per rf_input vs rf_input (256x256). Positive numbers represent the index of the
+/// * A Vector with one element per rf_input vs rf_input (256x256 for 128 tiles). Positive numbers represent the index of the
 /// input HDU to get data from, negative numbers mean to take the complex conjugate of the data at the index of
 /// the input HDU.
 ///
+#[cfg(test)]
 fn generate_full_matrix(mwax_order: Vec<usize>) -> Vec<i32> {
-    let mut row1st: usize;
-    let mut row2nd: usize;
-    let mut col_a: usize;
-    let mut col_b: usize; // temp space for the rf_inputs that form the row and column of the 2x2 correlation matrix
-                          // Pull subfile order out into seperate vector, ensuring it is sorted by input/metafits order
-    assert_eq!(mwax_order.len(), 256);
-
-    // Create an array of 65536 ints.  Really a 2d array of 256 x 256 ints
-    // set them all to -1 to say 'contains nothing useful'
-    let mut full_matrix: Vec<i32> = vec![-1; 65536];
-    // We're going to iterate through the legacy complex numbers in the order they appear.
-    let mut source_legacy_ndx: i32 = 0;
-
-    // Below loop is equivalent to: for ( col_order = 0 ; col_order < 256 ; col_order+=2 )
-    for col_order in (0..256).step_by(2) {
-        // For a while we'll be working with two inputs that appear as the columns in our 2x2 correlation square.  Let's look them up now.
-        col_a = mwax_order[fine_pfb_reorder(col_order)]; // We need to access in *not* in metafits order, but the order the fine-PFB uses
-        col_b = mwax_order[fine_pfb_reorder(col_order + 1)];
-
-        // below for loop is equivalent to: for ( row_order = 0 ; row_order <= col_order ; row_order+=2 )
-        for row_order in (0..=col_order).step_by(2) {
-            // Right now, we need to know which two inputs appear as the rows in our 2x2 correlation square.  Let's look them up now.
-            row1st = mwax_order[fine_pfb_reorder(row_order)];
-            row2nd = mwax_order[fine_pfb_reorder(row_order + 1)];
-
-            full_matrix[((row1st << 8) | col_a)] = source_legacy_ndx; // Top left complex number in the 2x2 correlation square
-            source_legacy_ndx += 1;
-            // Unless it's one of the 128 redundant outputs from the old correlator
-            if col_order != row_order {
-                full_matrix[((row2nd << 8) | col_a)] = source_legacy_ndx; // Bottom left
-            }
-            source_legacy_ndx += 1; // NB the source index *isn't* incremented during the 'if'
-            full_matrix[((row1st << 8) | col_b)] = source_legacy_ndx; // Here is the Top right.
-            source_legacy_ndx += 1;
-
-            full_matrix[((row2nd << 8) | col_b)] = source_legacy_ndx; // Bottom Right complex number in the 2x2.
-            source_legacy_ndx += 1;
-        }
-    }
+    let num_inputs = mwax_order.len();
+    let locator = LegacyProductLocator::new(&mwax_order);
 
-    for row_order in 0..256 {
-        // Now we want to fill in the pointers to conjugates where we don't have the value itself
-        for col_order in 0..256 {
-            // Go through every cell by row and column
-            if full_matrix[(row_order << 8 | col_order)] == -1 {
-                // If the entry is currently empty (represented by -1)
-                full_matrix[(row_order << 8 | col_order)] =
-                    -(full_matrix[(col_order << 8 | row_order)]); // copy the result from the inverse and negate it
-            }
-            // Useful debug
-            // print!("{},", full_matrix[row_order << 8 | col_order]);
+    let mut full_matrix: Vec<i32> = Vec::with_capacity(num_inputs * num_inputs);
+    for row in 0..num_inputs {
+        for col in 0..num_inputs {
+            full_matrix.push(locator.get(row, col));
         }
     }
 
@@ -196,74 +227,139 @@ fn generate_full_matrix(mwax_order: Vec<usize>) -> Vec<i32> {
 ///
 /// # Returns
 ///
-/// * A Vector of `
-///LegacyConversionBaseline`s which tell us, for a specific output baseline, where in the input HDU
-/// to get data from (and whether it needs to be conjugated).
+/// * Result containing a Vector of `LegacyConversionBaseline`s which tell us, for a specific output
+///   baseline, where in the input HDU to get data from (and whether it needs to be conjugated), or a
+///   `GpuboxError` if the number of rf inputs is not a multiple of 64.
 ///
 pub(crate) fn generate_conversion_array(
     rf_inputs: &mut Vec<Rfinput>,
-) -> Vec<LegacyConversionBaseline> {
+) -> Result<Vec<LegacyConversionBaseline>, GpuboxError> {
     // Sort the rf_inputs by "Input / metafits" order
     rf_inputs.sort_by(|a, b| a.input.cmp(&b.input));
 
-    // Ensure we have a 256 element array of rf_inputs
-    // This is an OK assumption since we only use this for Legacy and OldLegacy MWA data which always must have 128 tiles
-    // which is 256 rf inputs.
-    assert_eq!(rf_inputs.len(), 256);
-
-    // Create a vector which contains all the mwax_orders, sorted by "input" from the metafits
-    let mut mwax_order: Vec<usize> = vec![0; 256];
-    for index in 0..256 {
-        mwax_order[index] = rf_inputs[index].subfile_order as usize;
+    // Legacy and OldLegacy MWA data always has 128 tiles (256 rf inputs), but the conversion works
+    // for any number of whole fine-PFBs, each of which takes 64 rf inputs (32 tiles).
+    if rf_inputs.len() % 64 != 0 {
+        return Err(GpuboxError::InvalidLegacyRfInputCount(rf_inputs.len()));
     }
+    let num_tiles = rf_inputs.len() / 2;
 
-    // Generate the full matrix
-    let full_matrix: Vec<i32> = generate_full_matrix(mwax_order);
-    // Now step through the 256 x 256 square, but in the order of the wanted triangular output!
-    // Each step, we need to pick up the source position index that we stored in the 256 x 256 square.
-    let (mut xx, mut xy, mut yx, mut yy): (i32, i32, i32, i32); // Indexes to the polarisations for this pair of tiles
-    let mut baseline: usize = 0;
+    // Create a vector which contains all the mwax_orders, sorted by "input" from the metafits
+    let mwax_order: Vec<usize> = rf_inputs
+        .iter()
+        .map(|rf_input| rf_input.subfile_order as usize)
+        .collect();
+    let locator = LegacyProductLocator::new(&mwax_order);
 
     // Create an output vector so we can lookup where to get data from the legacy HDU, given a baseline/ant1/ant2
-    let baseline_count = get_baseline_count(128);
-
-    let mut conversion_table: Vec<LegacyConversionBaseline> =
-        Vec::with_capacity(baseline_count as usize);
+    let baseline_count = get_baseline_count(num_tiles);
+    let mut conversion_table: Vec<LegacyConversionBaseline> = Vec::with_capacity(baseline_count);
 
-    // Our row tile and column tile.  Now 2 pols each so only 128 in legacy obs
-    for row_tile in 0..128 {
-        for col_tile in row_tile..128 {
+    // Step through the tiles in the order of the wanted triangular output
+    for row_tile in 0..num_tiles {
+        for col_tile in row_tile..num_tiles {
             // The following indicies are for the complex pair of values
             // To get the individual real or imaginary we need to multiply by 2
             // Therefore the imag value will be the index of the real, plus 1.
-            xx = full_matrix[(row_tile * 2) << 8 | (col_tile * 2)] * 2;
-            xy = full_matrix[(row_tile * 2) << 8 | (col_tile * 2 + 1)] * 2;
-            yx = full_matrix[(row_tile * 2 + 1) << 8 | (col_tile * 2)] * 2;
-            yy = full_matrix[(row_tile * 2 + 1) << 8 | (col_tile * 2 + 1)] * 2;
+            let xx = locator.get(row_tile * 2, col_tile * 2) * 2;
+            let xy = locator.get(row_tile * 2, col_tile * 2 + 1) * 2;
+            let yx = locator.get(row_tile * 2 + 1, col_tile * 2) * 2;
+            let yy = locator.get(row_tile * 2 + 1, col_tile * 2 + 1) * 2;
 
             conversion_table.push(LegacyConversionBaseline::new(
-                baseline, row_tile, col_tile, xx, xy, yx, yy,
+                conversion_table.len(),
+                row_tile,
+                col_tile,
+                xx,
+                xy,
+                yx,
+                yy,
             ));
-
-            /* Handy debug to print out the output lookup for each baseline/pol
-            println!(
-                "{}:{},{}  {}:{}:{}:{}",
-                baseline, row_tile, col_tile, xx, xy, yx, yy
-            );*/
-
-            baseline += 1;
         }
     }
 
     // Ensure we processed all baselines
-    assert_eq!(baseline, baseline_count as usize);
-    assert_eq!(conversion_table.len(), baseline_count as usize);
+    assert_eq!(conversion_table.len(), baseline_count);
 
-    conversion_table
+    Ok(conversion_table)
+}
+
+/// Convert one baseline and fine channel of legacy visibilities (xx, xy, yx, yy) into mwax order,
+/// conjugating as needed.
+///
+/// # Arguments
+///
+/// * `baseline` - The pre-calculated `LegacyConversionBaseline` for this baseline.
+///
+/// * `input_fine_chan` - Slice of the legacy input for all baselines of one fine channel.
+///
+/// * `output` - Slice of the 8 output floats (4 pols, r and i) for this baseline and fine channel.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+#[inline(always)]
+fn convert_legacy_baseline_fine_chan(
+    baseline: &LegacyConversionBaseline,
+    input_fine_chan: &[f32],
+    output: &mut [f32],
+) {
+    // xx_r
+    output[0] = input_fine_chan[baseline.xx_index as usize];
+    // xx_i
+    output[1] = if baseline.xx_conjugate {
+        // We have to conjugate the visibility
+        -input_fine_chan[baseline.xx_index as usize + 1]
+    } else {
+        input_fine_chan[baseline.xx_index as usize + 1]
+    };
+
+    // xy_r
+    output[2] = input_fine_chan[baseline.xy_index as usize];
+    // xy_i
+    output[3] = if baseline.xy_conjugate {
+        // We have to conjugate the visibility
+        -input_fine_chan[baseline.xy_index as usize + 1]
+    } else {
+        input_fine_chan[baseline.xy_index as usize + 1]
+    };
+
+    // yx_r
+    output[4] = input_fine_chan[baseline.yx_index as usize];
+    // yx_i
+    output[5] = if baseline.yx_conjugate {
+        // We have to conjugate the visibility
+        -input_fine_chan[baseline.yx_index as usize + 1]
+    } else {
+        input_fine_chan[baseline.yx_index as usize + 1]
+    };
+
+    // yy_r
+    output[6] = input_fine_chan[baseline.yy_index as usize];
+    // yy_i
+    output[7] = if baseline.yy_conjugate {
+        // We have to conjugate the visibility
+        -input_fine_chan[baseline.yy_index as usize + 1]
+    } else {
+        input_fine_chan[baseline.yy_index as usize + 1]
+    };
+
+    // Finally if we are a cross correlaton, take the conjugate
+    if baseline.is_cross {
+        output[1] = -output[1];
+        output[3] = -output[3];
+        output[5] = -output[5];
+        output[7] = -output[7];
+    }
 }
 
 /// Using the precalculated conversion table, reorder the legacy visibilities into our preferred output order
 /// [time][baseline][freq][pol] in a standard triangle of 0,0 .. 0,N 1,1..1,N baseline order.
+///
+/// Baselines are converted in parallel, in the current rayon thread pool.
 /// # Arguments
 ///
 /// * `conversion_table` - A vector containing all of the `
@@ -273,6 +369,9 @@ pub(crate) fn generate_conversion_array(
 ///
 /// * `output_buffer` - Float vector to write converted data into.
 ///
+/// * `num_input_baselines` - Number of baselines in the legacy HDU (8256 for the 128 tiles of
+///                           all legacy observations).
+///
 /// * `num_fine_chans` - Number of file channels in this observation.
 ///
 ///
@@ -285,91 +384,47 @@ pub(crate) fn convert_legacy_hdu_to_mwax_baseline_order(
     conversion_table: &[LegacyConversionBaseline],
     input_buffer: &[f32],
     output_buffer: &mut [f32],
+    num_input_baselines: usize,
     num_fine_chans: usize,
 ) {
-    // Note: hardcoded values are safe here because they are only for the case where we are using the
-    // legacy correlator which ALWAYS has 128 tiles
-    let num_baselines = get_baseline_count(128);
-
     // Striding for input array
     let floats_per_baseline_fine_chan = 8; // xx_r,xx_i,xy_r,xy_i,yx_r,yx_i,yy_r,yy_i
-    let floats_per_fine_chan = num_baselines * floats_per_baseline_fine_chan; // All floats for all baselines and 1 fine channel
+    let floats_per_fine_chan = num_input_baselines * floats_per_baseline_fine_chan; // All floats for all baselines and 1 fine channel
 
-    // Striding for output array
+    // Striding for output array. There is an output baseline per conversion table entry, which is
+    // every baseline unless the table has been composed with an antenna remap.
     let floats_per_baseline = floats_per_baseline_fine_chan * num_fine_chans;
 
-    // Read from the input buffer and write into the temp buffer
-    for fine_chan_index in 0..num_fine_chans {
-        // convert one fine channel at a time
-        for (baseline_index, baseline) in conversion_table.iter().enumerate() {
-            // Input visibilities are in [fine_chan][baseline][pol][real][imag] order so we need to stride
-            // through it.
-            // source index =
-            // (fine_chan_index * num_baselines * floats per baseline_chan) +
-            // (baseline_index * floats per baseline_chan)
-
-            // We need to work out where to start indexing the source data
-            // Go "down" the fine channels as if they are rows
-            // Go "across" the baselines as if they are columns
-            let source_index = fine_chan_index * floats_per_fine_chan;
-            // We need to work out where to start indexing the destination data
-            // Go "down" the baselines as if they are rows
-            // Go "across" the fine channels as if they are columns
-            let destination_index = (baseline_index * floats_per_baseline)
-                + (fine_chan_index * floats_per_baseline_fine_chan);
-            // xx_r
-            output_buffer[destination_index] = input_buffer[source_index + baseline.xx_index];
-            // xx_i
-            output_buffer[destination_index + 1] = if baseline.xx_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.xx_index + 1]
-            } else {
-                input_buffer[source_index + baseline.xx_index + 1]
-            };
-
-            // xy_r
-            output_buffer[destination_index + 2] = input_buffer[source_index + baseline.xy_index];
-            // xy_i
-            output_buffer[destination_index + 3] = if baseline.xy_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.xy_index + 1]
-            } else {
-                input_buffer[source_index + baseline.xy_index + 1]
-            };
-
-            // yx_r
-            output_buffer[destination_index + 4] = input_buffer[source_index + baseline.yx_index];
-            // yx_i
-            output_buffer[destination_index + 5] = if baseline.yx_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.yx_index + 1]
-            } else {
-                input_buffer[source_index + baseline.yx_index + 1]
-            };
-
-            // yy_r
-            output_buffer[destination_index + 6] = input_buffer[source_index + baseline.yy_index];
-            // yy_i
-            output_buffer[destination_index + 7] = if baseline.yy_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.yy_index + 1]
-            } else {
-                input_buffer[source_index + baseline.yy_index + 1]
-            };
-
-            // Finally if we are a cross correlaton, take the conjugate
-            if baseline.is_cross {
-                output_buffer[destination_index + 1] = -output_buffer[destination_index + 1];
-                output_buffer[destination_index + 3] = -output_buffer[destination_index + 3];
-                output_buffer[destination_index + 5] = -output_buffer[destination_index + 5];
-                output_buffer[destination_index + 7] = -output_buffer[destination_index + 7];
+    // Each output baseline is a contiguous [freq][pol] block, so split the output by baseline
+    // and convert each one independently.
+    output_buffer[..conversion_table.len() * floats_per_baseline]
+        .par_chunks_mut(floats_per_baseline)
+        .zip(conversion_table.par_iter())
+        .for_each(|(output_baseline, baseline)| {
+            for fine_chan_index in 0..num_fine_chans {
+                // Input visibilities are in [fine_chan][baseline][pol][real][imag] order so we need to stride
+                // through it.
+                // We need to work out where to start indexing the source data
+                // Go "down" the fine channels as if they are rows
+                // Go "across" the baselines as if they are columns
+                let source_index = fine_chan_index * floats_per_fine_chan;
+                // Within this baseline's output block, go "across" the fine channels
+                let destination_index = fine_chan_index * floats_per_baseline_fine_chan;
+
+                convert_legacy_baseline_fine_chan(
+                    baseline,
+                    &input_buffer[source_index..source_index + floats_per_fine_chan],
+                    &mut output_baseline
+                        [destination_index..destination_index + floats_per_baseline_fine_chan],
+                );
             }
-        }
-    }
+        });
 }
 
 /// Using the precalculated conversion table, reorder the legacy visibilities into our preferred output order
 /// [time][freq][baseline][pol] in a standard triangle of 0,0 .. 0,N 1,1..1,N baseline order.
+///
+/// Fine channels are converted in parallel, in the current rayon thread pool.
 /// # Arguments
 ///
 /// * `conversion_table` - A vector containing all of the `
@@ -379,6 +434,9 @@ pub(crate) fn convert_legacy_hdu_to_mwax_baseline_order(
 ///
 /// * `output_buffer` - Float vector to write converted data into.
 ///
+/// * `num_input_baselines` - Number of baselines in the legacy HDU (8256 for the 128 tiles of
+///                           all legacy observations).
+///
 /// * `num_fine_chans` - Number of file channels in this observation.
 ///
 ///
@@ -391,81 +449,88 @@ pub(crate) fn convert_legacy_hdu_to_mwax_frequency_order(
     conversion_table: &[LegacyConversionBaseline],
     input_buffer: &[f32],
     output_buffer: &mut [f32],
+    num_input_baselines: usize,
     num_fine_chans: usize,
 ) {
-    // Note: hardcoded values are safe here because they are only for the case where we are using the
-    // legacy correlator which ALWAYS has 128 tiles
-    let num_baselines = get_baseline_count(128);
-
     // Striding for input array
     let floats_per_baseline_fine_chan = 8; // xx_r,xx_i,xy_r,xy_i,yx_r,yx_i,yy_r,yy_i
-    let floats_per_fine_chan = num_baselines * floats_per_baseline_fine_chan; // All floats for all baselines and 1 fine channel
-                                                                              // Read from the input buffer and write into the temp buffer
-    for fine_chan_index in 0..num_fine_chans {
-        // convert one fine channel at a time
-        for (baseline_index, baseline) in conversion_table.iter().enumerate() {
-            // Input visibilities are in [fine_chan][baseline][pol][real][imag] order
-            // We need to work out where to start indexing the source data
-            // Go "down" the fine channels as if they are rows
-            // Go "across" the baselines as if they are columns
-            let source_index = fine_chan_index * floats_per_fine_chan;
-            // Since the destination is also to be in [fine_chan][baseline][pol][real][imag] order
-            // For the destination, we have to stride along each baseline for this channel
-            let destination_index = source_index + (baseline_index * floats_per_baseline_fine_chan);
-
-            // xx_r
-            output_buffer[destination_index] = input_buffer[source_index + baseline.xx_index];
-            // xx_i
-            output_buffer[destination_index + 1] = if baseline.xx_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.xx_index + 1]
-            } else {
-                input_buffer[source_index + baseline.xx_index + 1]
-            };
-
-            // xy_r
-            output_buffer[destination_index + 2] = input_buffer[source_index + baseline.xy_index];
-            // xy_i
-            output_buffer[destination_index + 3] = if baseline.xy_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.xy_index + 1]
-            } else {
-                input_buffer[source_index + baseline.xy_index + 1]
-            };
-
-            // yx_r
-            output_buffer[destination_index + 4] = input_buffer[source_index + baseline.yx_index];
-            // yx_i
-            output_buffer[destination_index + 5] = if baseline.yx_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.yx_index + 1]
-            } else {
-                input_buffer[source_index + baseline.yx_index + 1]
-            };
-
-            // yy_r
-            output_buffer[destination_index + 6] = input_buffer[source_index + baseline.yy_index];
-            // yy_i
-            output_buffer[destination_index + 7] = if baseline.yy_conjugate {
-                // We have to conjugate the visibility
-                -input_buffer[source_index + baseline.yy_index + 1]
-            } else {
-                input_buffer[source_index + baseline.yy_index + 1]
-            };
-
-            // Finally if we are a cross correlaton, take the conjugate
-            if baseline.is_cross {
-                output_buffer[destination_index + 1] = -output_buffer[destination_index + 1];
-                output_buffer[destination_index + 3] = -output_buffer[destination_index + 3];
-                output_buffer[destination_index + 5] = -output_buffer[destination_index + 5];
-                output_buffer[destination_index + 7] = -output_buffer[destination_index + 7];
+    let floats_per_fine_chan = num_input_baselines * floats_per_baseline_fine_chan; // All floats for all baselines and 1 fine channel
+
+    // There is an output baseline per conversion table entry (see
+    // `convert_legacy_hdu_to_mwax_baseline_order`)
+    let output_floats_per_fine_chan = conversion_table.len() * floats_per_baseline_fine_chan;
+
+    // Input and output are both in [fine_chan][baseline][pol][real][imag] order, so split both
+    // by fine channel and convert each one independently.
+    output_buffer[..num_fine_chans * output_floats_per_fine_chan]
+        .par_chunks_mut(output_floats_per_fine_chan)
+        .zip(input_buffer.par_chunks(floats_per_fine_chan))
+        .for_each(|(output_fine_chan, input_fine_chan)| {
+            for (baseline_index, baseline) in conversion_table.iter().enumerate() {
+                // For the destination, we have to stride along each baseline for this channel
+                let destination_index = baseline_index * floats_per_baseline_fine_chan;
+
+                convert_legacy_baseline_fine_chan(
+                    baseline,
+                    input_fine_chan,
+                    &mut output_fine_chan
+                        [destination_index..destination_index + floats_per_baseline_fine_chan],
+                );
             }
+        });
+}
+
+/// Using the precalculated conversion table, gather only the autocorrelations of a legacy HDU,
+/// in [antenna][freq][pol][real][imag] order. No cross correlations are converted.
+///
+/// # Arguments
+///
+/// * `conversion_table` - A vector containing all of the `LegacyConversionBaseline`s we have pre-calculated.
+///
+/// * `input_buffer` - Float vector read from legacy MWA HDUs.
+///
+/// * `output_buffer` - Float vector of num_ants * num_fine_chans * 8 floats to write the autocorrelations into.
+///
+/// * `num_input_baselines` - Number of baselines in the legacy HDU.
+///
+/// * `num_fine_chans` - Number of file channels in this observation.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+pub(crate) fn convert_legacy_hdu_autos(
+    conversion_table: &[LegacyConversionBaseline],
+    input_buffer: &[f32],
+    output_buffer: &mut [f32],
+    num_input_baselines: usize,
+    num_fine_chans: usize,
+) {
+    let floats_per_baseline_fine_chan = 8; // xx_r,xx_i,xy_r,xy_i,yx_r,yx_i,yy_r,yy_i
+    let floats_per_fine_chan = num_input_baselines * floats_per_baseline_fine_chan;
+    let floats_per_ant = num_fine_chans * floats_per_baseline_fine_chan;
+
+    // The conversion table is in baseline order, so the autos are in antenna order
+    for (baseline, output_ant) in conversion_table
+        .iter()
+        .filter(|b| b.ant1 == b.ant2)
+        .zip(output_buffer.chunks_exact_mut(floats_per_ant))
+    {
+        for (input_fine_chan, output) in input_buffer
+            .chunks_exact(floats_per_fine_chan)
+            .zip(output_ant.chunks_exact_mut(floats_per_baseline_fine_chan))
+        {
+            convert_legacy_baseline_fine_chan(baseline, input_fine_chan, output);
         }
     }
 }
 
 /// Reorder correlator v2 (MWAX) visibilities into our preferred output order
 /// [time][freq][baseline][pol]. The antennas/baselines are already in our preferred order.
+///
+/// Fine channels are converted in parallel, in the current rayon thread pool.
 /// # Arguments
 ///
 /// * `input_buffer` - Float vector read from MWAX HDUs.
@@ -493,27 +558,29 @@ pub(crate) fn convert_mwax_hdu_to_frequency_order(
     let floats_per_baseline_fine_chan = num_visibility_pols * 2; // xx_r,xx_i,xy_r,xy_i,yx_r,yx_i,yy_r,yy_i
     let floats_per_baseline = num_fine_chans * floats_per_baseline_fine_chan; // All floats for 1 baseline and all fine channels
     let floats_per_fine_chan = num_baselines * floats_per_baseline_fine_chan; // All floats for all baselines and 1 fine channel
-                                                                              // Read from the input buffer and write into the temp buffer
-    for baseline_index in 0..num_baselines {
-        // convert one baseline at a time
-        for fine_chan_index in 0..num_fine_chans {
-            // Input visibilities are in [baseline][fine_chan][pol][real][imag] order
-            //
-            // We need to work out where to start indexing the source data
-            // Go "down" the baselines as if they are rows
-            // Go "across" the fine_chans as if they are columns
-            let source_index = (baseline_index * floats_per_baseline)
-                + (fine_chan_index * floats_per_baseline_fine_chan);
-            // The destination is to be in [fine_chan][baseline][pol][real][imag] order
-            // For the destination, we have to stride along each fine channel for this baseline
-            let destination_index = (fine_chan_index * floats_per_fine_chan)
-                + (baseline_index * floats_per_baseline_fine_chan);
-            // for each polarisation (r,i) => xx_r, xx_i, xy_r, xy_i, ... copy input to output
-            // Copy source into dest
-            output_buffer[destination_index..(floats_per_baseline_fine_chan + destination_index)]
-                .clone_from_slice(
-                    &input_buffer[source_index..(floats_per_baseline_fine_chan + source_index)],
-                );
-        }
-    }
+
+    // The output is in [fine_chan][baseline][pol][real][imag] order, so split it by fine channel
+    // and gather each one independently.
+    output_buffer[..num_fine_chans * floats_per_fine_chan]
+        .par_chunks_mut(floats_per_fine_chan)
+        .enumerate()
+        .for_each(|(fine_chan_index, output_fine_chan)| {
+            for baseline_index in 0..num_baselines {
+                // Input visibilities are in [baseline][fine_chan][pol][real][imag] order
+                //
+                // We need to work out where to start indexing the source data
+                // Go "down" the baselines as if they are rows
+                // Go "across" the fine_chans as if they are columns
+                let source_index = (baseline_index * floats_per_baseline)
+                    + (fine_chan_index * floats_per_baseline_fine_chan);
+                // For the destination, we have to stride along each baseline for this fine channel
+                let destination_index = baseline_index * floats_per_baseline_fine_chan;
+                // for each polarisation (r,i) => xx_r, xx_i, xy_r, xy_i, ... copy input to output
+                output_fine_chan
+                    [destination_index..(floats_per_baseline_fine_chan + destination_index)]
+                    .copy_from_slice(
+                        &input_buffer[source_index..(floats_per_baseline_fine_chan + source_index)],
+                    );
+            }
+        });
 }
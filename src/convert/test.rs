@@ -139,7 +139,7 @@ fn test_conversion_of_legacy_hdu_to_mwax_baseline_ordervs_pyuvdata() {
     let metafits = "test_files/1101503312_1_timestep/1101503312.metafits";
     let gpuboxfiles =
         vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
-    let mut context = CorrelatorContext::new(&metafits, &gpuboxfiles)
+    let context = CorrelatorContext::new(&metafits, &gpuboxfiles)
         .expect("Failed to create CorrelatorContext");
 
     // Read and convert first HDU
@@ -293,7 +293,7 @@ fn test_conversion_of_legacy_hdu_to_mwax_frequency_order_vs_pyuvdata() {
     let metafits = "test_files/1101503312_1_timestep/1101503312.metafits";
     let gpuboxfiles =
         vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
-    let mut context =
+    let context =
         CorrelatorContext::new(&metafits, &gpuboxfiles).expect("Failed to create mwalibContext");
 
     // Read and convert first HDU
@@ -459,7 +459,7 @@ fn test_conversion_of_legacy_hdu_to_mwax_baseline_order_vs_cotter() {
     let metafits = "test_files/1101503312_1_timestep/1101503312.metafits";
     let gpuboxfiles =
         vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
-    let mut context = CorrelatorContext::new(&metafits, &gpuboxfiles)
+    let context = CorrelatorContext::new(&metafits, &gpuboxfiles)
         .expect("Failed to create CorrelatorContext");
 
     // Read and convert first HDU
@@ -637,7 +637,7 @@ fn test_mwax_conversion_to_frequency_order() {
     //
     // Open a context and load in a test metafits and gpubox file
     let gpuboxfiles = vec![mwax_filename];
-    let mut context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
         .expect("Failed to create mwalibContext");
 
     // Read and convert first HDU
@@ -669,3 +669,80 @@ fn test_mwax_conversion_to_frequency_order() {
         }
     }
 }
+
+/// Synthetic legacy rf_inputs for any number of tiles, whose MWAX order is the reverse of their
+/// input order
+fn get_synthetic_rf_inputs(num_tiles: usize) -> Vec<Rfinput> {
+    let num_inputs = num_tiles * 2;
+    (0..num_inputs)
+        .map(|input| Rfinput {
+            input: input as u32,
+            ant: (input / 2) as u32,
+            tile_id: (input / 2) as u32,
+            tile_name: format!("Tile{:03}", input / 2),
+            pol: if input % 2 == 0 { Pol::X } else { Pol::Y },
+            electrical_length_m: 0.,
+            north_m: 0.,
+            east_m: 0.,
+            height_m: 0.,
+            vcs_order: input as u32,
+            subfile_order: (num_inputs - 1 - input) as u32,
+            flagged: false,
+            digital_gains: vec![],
+            dipole_gains: vec![],
+            dipole_delays: vec![],
+            rec_number: 1,
+            rec_slot_number: 0,
+        })
+        .collect()
+}
+
+#[test]
+fn test_conversion_array_any_tile_count() {
+    for num_tiles in &[32, 128, 256] {
+        let num_tiles = *num_tiles;
+        let table = generate_conversion_array(&mut get_synthetic_rf_inputs(num_tiles)).unwrap();
+        assert_eq!(table.len(), get_baseline_count(num_tiles));
+
+        // The legacy HDU holds 4 complex products per baseline per fine channel, one of which is
+        // redundant for each auto; every other product is used exactly once
+        let num_products = 4 * get_baseline_count(num_tiles);
+        let mut used = vec![false; num_products];
+        for baseline in table.iter() {
+            let indices = if baseline.is_cross {
+                vec![
+                    baseline.xx_index,
+                    baseline.xy_index,
+                    baseline.yx_index,
+                    baseline.yy_index,
+                ]
+            } else {
+                // An auto's xy and yx are the same product, and its xx and yy are not conjugated
+                assert_eq!(baseline.xy_index, baseline.yx_index);
+                assert_ne!(baseline.xy_conjugate, baseline.yx_conjugate);
+                assert!(!baseline.xx_conjugate && !baseline.yy_conjugate);
+                vec![baseline.xx_index, baseline.xy_index, baseline.yy_index]
+            };
+            for index in indices {
+                assert_eq!(index % 2, 0);
+                let product = index as usize / 2;
+                assert!(!used[product], "product {} used twice", product);
+                used[product] = true;
+            }
+        }
+        assert_eq!(
+            used.iter().filter(|u| **u).count(),
+            num_products - num_tiles
+        );
+    }
+}
+
+#[test]
+fn test_conversion_array_invalid_rf_input_count() {
+    // 48 tiles is 96 rf inputs, which is not a whole number of fine PFBs
+    let result = generate_conversion_array(&mut get_synthetic_rf_inputs(48));
+    assert!(matches!(
+        result,
+        Err(GpuboxError::InvalidLegacyRfInputCount(96))
+    ));
+}
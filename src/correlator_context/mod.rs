@@ -7,15 +7,32 @@ The main interface to MWA data.
  */
 use std::collections::BTreeMap;
 use std::fmt;
+use std::ops::Range;
+use std::sync::Arc;
 
+use rayon::prelude::*;
+use rayon::ThreadPool;
+
+use crate::baseline::{self, AntennaRemap, BaselineError, VisibilityConvention};
+use crate::buffer_pool::*;
 use crate::coarse_channel::*;
 use crate::convert::*;
 use crate::error::*;
+use crate::geometry::TimestepGeometry;
 use crate::gpubox_files::*;
 use crate::metafits_context::*;
+use crate::numa::NumaPlacement;
+use crate::pipeline::WorkUnit;
+use crate::scan_cache::{self, CachedChunk, ScanCache, ScanCacheError};
+use crate::shard::{self, Shard, ShardError, ShardFile};
 use crate::timestep::*;
 use crate::*;
 
+pub mod options;
+pub mod presence;
+pub use options::CorrelatorContextOptions;
+pub use presence::HduPresence;
+
 #[cfg(test)]
 mod test;
 
@@ -25,14 +42,14 @@ mod test;
 #[derive(Debug)]
 pub struct CorrelatorContext {
     /// Observation Metadata
-    pub metafits_context: MetafitsContext,
+    pub metafits_context: Arc<MetafitsContext>,
     /// Version of the correlator format
     pub corr_version: CorrelatorVersion,
     /// The proper start of the observation (the time that is common to all
-    /// provided gpubox files).
+    /// provided gpubox files, or the first time of any file with `all_timesteps`).
     pub start_unix_time_ms: u64,
     /// `end_unix_time_ms` is the actual end time of the observation
-    /// i.e. start time of last common timestep plus integration time.
+    /// i.e. start time of last common (or, with `all_timesteps`, any) timestep plus integration time.
     pub end_unix_time_ms: u64,
     /// `start_unix_time_ms` but in GPS milliseconds
     pub start_gps_time_ms: u64,
@@ -46,8 +63,15 @@ pub struct CorrelatorContext {
     pub timesteps: Vec<TimeStep>,
     /// Number of coarse channels after we've validated the input gpubox files
     pub num_coarse_chans: usize,
+    /// Which HDUs exist, [timestep][coarse chan]. All of them unless the context was created
+    /// with `all_timesteps`
+    pub hdu_presence: HduPresence,
+    /// The geometry of the phase centre (LST, hour angle, parallactic angle, az/el) at each timestep
+    pub timestep_geometry: TimestepGeometry,
     /// Vector of coarse channel structs
     pub coarse_chans: Vec<CoarseChannel>,
+    /// Fine channel centre frequencies and sky order indices of `coarse_chans`, [coarse chan][fine chan]
+    pub fine_chan_table: FineChanTable,
     /// Total bandwidth of the common coarse channels which have been provided (which may be less than or equal to the bandwith in the MetafitsContext)
     pub bandwidth_hz: u32,
     /// The number of bytes taken up by a scan/timestep in each gpubox file.
@@ -70,7 +94,18 @@ pub struct CorrelatorContext {
     /// correct HDU out of all gpubox files.
     pub(crate) gpubox_time_map: BTreeMap<u64, BTreeMap<usize, (usize, usize)>>,
     /// A conversion table to optimise reading of legacy MWA HDUs
-    pub(crate) legacy_conversion_table: Vec<LegacyConversionBaseline>,
+    pub(crate) legacy_conversion_table: Arc<Vec<LegacyConversionBaseline>>,
+    /// Pool of aligned buffers that reads draw from, so that steady-state
+    /// reads reuse memory rather than allocating. May be shared with other
+    /// contexts of the same geometry.
+    pub(crate) buffer_pool: Arc<BufferPool>,
+    /// Thread pool for internal parallel work. If `None`, rayon's global pool is used.
+    pub(crate) thread_pool: Option<Arc<ThreadPool>>,
+    /// Per-NUMA-node thread and buffer pools for scan reads. If `None`, scans run in `thread_pool`.
+    pub(crate) numa_placement: Option<Arc<NumaPlacement>>,
+    /// Cache of converted data that reads are served from and added to. If `None`, reads always
+    /// go to the gpubox files.
+    pub(crate) scan_cache: Option<Arc<ScanCache>>,
 }
 
 impl CorrelatorContext {
@@ -94,25 +129,87 @@ impl CorrelatorContext {
         metafits_filename: &T,
         gpubox_filenames: &[T],
     ) -> Result<Self, MwalibError> {
-        let metafits_context = MetafitsContext::new(metafits_filename)?;
+        Self::new_with_options(
+            metafits_filename,
+            gpubox_filenames,
+            &CorrelatorContextOptions::default(),
+        )
+    }
+
+    /// From a path to a metafits file and paths to gpubox files, create an `CorrelatorContext`,
+    /// using the supplied options.
+    ///
+    /// # Arguments
+    ///
+    /// * `metafits_filename` - filename of metafits file as a path or string.
+    ///
+    /// * `gpubox_filenames` - slice of filenames of gpubox files as paths or strings.
+    ///
+    /// * `options` - a `CorrelatorContextOptions` controlling how the context does its work.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing a populated CorrelatorContext object if Ok.
+    ///
+    ///
+    pub fn new_with_options<T: AsRef<std::path::Path>>(
+        metafits_filename: &T,
+        gpubox_filenames: &[T],
+        options: &CorrelatorContextOptions,
+    ) -> Result<Self, MwalibError> {
+        if options.verify_checksums {
+            verify_file_checksums(metafits_filename)?;
+        }
+        let metafits_context = Arc::new(MetafitsContext::new(metafits_filename)?);
 
-        // Re-open metafits file
-        let mut metafits_fptr = fits_open!(&metafits_filename)?;
-        let metafits_hdu = fits_open_hdu!(&mut metafits_fptr, 0)?;
+        Self::new_with_metafits_context(metafits_context, gpubox_filenames, options)
+    }
 
+    /// From an already populated `MetafitsContext` and paths to gpubox files, create a
+    /// `CorrelatorContext`, using the supplied options. The metafits file is not read again.
+    ///
+    /// Contexts created from the same `Arc<MetafitsContext>` (e.g. one per shard or per coarse
+    /// channel) share one copy of the metadata and of the legacy conversion table.
+    ///
+    /// # Arguments
+    ///
+    /// * `metafits_context` - the observation's metadata, shared with the new context.
+    ///
+    /// * `gpubox_filenames` - slice of filenames of gpubox files as paths or strings.
+    ///
+    /// * `options` - a `CorrelatorContextOptions` controlling how the context does its work.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing a populated CorrelatorContext object if Ok.
+    ///
+    ///
+    pub fn new_with_metafits_context<T: AsRef<std::path::Path>>(
+        metafits_context: Arc<MetafitsContext>,
+        gpubox_filenames: &[T],
+        options: &CorrelatorContextOptions,
+    ) -> Result<Self, MwalibError> {
         if gpubox_filenames.is_empty() {
             return Err(MwalibError::Gpubox(
                 gpubox_files::error::GpuboxError::NoGpuboxes,
             ));
         }
         // Do gpubox stuff only if we have gpubox files.
-        let gpubox_info = examine_gpubox_files(&gpubox_filenames, metafits_context.obs_id)?;
+        let gpubox_info = examine_gpubox_files(
+            &gpubox_filenames,
+            metafits_context.obs_id,
+            options.thread_pool.as_deref(),
+            &options.selection,
+        )?;
         // We can unwrap here because the `gpubox_time_map` can't be empty if
         // `gpuboxes` isn't empty.
         let timesteps = TimeStep::populate_correlator_timesteps(
             &gpubox_info.time_map,
             metafits_context.sched_start_gps_time_ms,
             metafits_context.sched_start_unix_time_ms,
+            options.all_timesteps,
         )
         .unwrap();
 
@@ -120,17 +217,12 @@ impl CorrelatorContext {
 
         // Populate coarse channels
         // Get metafits info
-        let (metafits_coarse_chan_vec, metafits_coarse_chan_width_hz) =
-            CoarseChannel::get_metafits_coarse_channel_info(
-                &mut metafits_fptr,
-                &metafits_hdu,
-                metafits_context.obs_bandwidth_hz,
-            )?;
+        let metafits_coarse_chan_width_hz = metafits_context.coarse_chan_width_hz;
 
         // Process the channels based on the gpubox files we have
         let coarse_chans = CoarseChannel::populate_coarse_channels(
             gpubox_info.corr_format,
-            &metafits_coarse_chan_vec,
+            &metafits_context.metafits_coarse_chan_vec,
             metafits_coarse_chan_width_hz,
             Some(&gpubox_info.time_map),
             None,
@@ -141,8 +233,12 @@ impl CorrelatorContext {
 
         // We have enough information to validate HDU matches metafits
         if !gpubox_filenames.is_empty() {
-            let coarse_chan = coarse_chans[0].gpubox_number;
-            let (batch_index, _) = gpubox_info.time_map[&timesteps[0].unix_time_ms][&coarse_chan];
+            // With all timesteps, the first timestep may not have the first coarse channel, but
+            // it has some HDU
+            let (batch_index, _) = *gpubox_info.time_map[&timesteps[0].unix_time_ms]
+                .values()
+                .next()
+                .unwrap();
 
             let mut fptr = fits_open!(&gpubox_info.batches[batch_index].gpubox_files[0].filename)?;
 
@@ -155,11 +251,22 @@ impl CorrelatorContext {
             )?;
         }
 
+        // Only the files left after applying any selection
+        let num_gpubox_files = gpubox_info
+            .batches
+            .iter()
+            .map(|b| b.gpubox_files.len())
+            .sum();
+
         // Populate the start and end times of the observation.
         // Start= start of first timestep
         // End  = start of last timestep + integration time
         let (start_unix_time_ms, end_unix_time_ms, duration_ms) = {
-            let o = determine_obs_times(&gpubox_info.time_map, metafits_context.corr_int_time_ms)?;
+            let o = determine_obs_times(
+                &gpubox_info.time_map,
+                metafits_context.corr_int_time_ms,
+                options.all_timesteps,
+            )?;
             (o.start_millisec, o.end_millisec, o.duration_millisec)
         };
 
@@ -176,15 +283,26 @@ impl CorrelatorContext {
         );
 
         // Prepare the conversion array to convert legacy correlator format into mwax format
-        // or just leave it empty if we're in any other format
-        let legacy_conversion_table: Vec<LegacyConversionBaseline> = match gpubox_info.corr_format {
-            CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => {
-                convert::generate_conversion_array(&mut metafits_context.rf_inputs.clone())
-            }
-            _ => Vec::new(),
-        };
+        // or just leave it empty if we're in any other format. The table is shared through the
+        // metafits context, so it is only generated once per observation.
+        let legacy_conversion_table: Arc<Vec<LegacyConversionBaseline>> =
+            match gpubox_info.corr_format {
+                CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => {
+                    metafits_context.get_legacy_conversion_table()?
+                }
+                _ => Arc::new(Vec::new()),
+            };
 
-        Ok(CorrelatorContext {
+        let timestep_geometry = TimestepGeometry::new(&metafits_context, &timesteps);
+        let hdu_presence = HduPresence::new(&gpubox_info.time_map, &timesteps, &coarse_chans);
+        let fine_chan_table = FineChanTable::new(
+            &coarse_chans,
+            &metafits_context.metafits_coarse_chan_vec,
+            metafits_context.num_corr_fine_chans_per_coarse,
+            metafits_context.corr_fine_chan_width_hz,
+        );
+
+        let context = CorrelatorContext {
             metafits_context,
             corr_version: gpubox_info.corr_format,
             start_unix_time_ms,
@@ -194,22 +312,40 @@ impl CorrelatorContext {
             duration_ms,
             num_timesteps,
             timesteps,
+            timestep_geometry,
             num_coarse_chans,
+            hdu_presence,
             coarse_chans,
+            fine_chan_table,
             bandwidth_hz,
             gpubox_batches: gpubox_info.batches,
             gpubox_time_map: gpubox_info.time_map,
             num_timestep_coarse_chan_bytes: gpubox_info.hdu_size * 4,
             num_timestep_coarse_chan_floats: gpubox_info.hdu_size,
-            num_gpubox_files: gpubox_filenames.len(),
+            num_gpubox_files,
             legacy_conversion_table,
-        })
+            buffer_pool: Arc::new(BufferPool::new()),
+            thread_pool: options.thread_pool.clone(),
+            numa_placement: options.numa_placement.clone(),
+            scan_cache: options.scan_cache.clone(),
+        };
+
+        // Each file is verified once, here, so reads do not re-read HDUs to sum them
+        if options.verify_checksums {
+            context.verify_files_checksums(context.get_gpubox_filenames())?;
+        }
+
+        Ok(context)
     }
 
     /// Read a single timestep for a single coarse channel
     /// The output visibilities are in order:
     /// [baseline][frequency][pol][r][i]
     ///
+    /// This allocates a new vector on every call, as the caller owns the result. Hot loops should
+    /// use `read_by_baseline_into_buffer` with a buffer they reuse, or `read_by_baseline_pooled`,
+    /// whose buffers come from (and go back to) the context's `BufferPool`.
+    ///
     /// # Arguments
     ///
     /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
@@ -225,67 +361,25 @@ impl CorrelatorContext {
     ///
     ///
     pub fn read_by_baseline(
-        &mut self,
+        &self,
         timestep_index: usize,
         coarse_chan_index: usize,
     ) -> Result<Vec<f32>, GpuboxError> {
-        // Validate the timestep
-        if timestep_index > self.num_timesteps - 1 {
-            return Err(GpuboxError::InvalidTimeStepIndex(self.num_timesteps - 1));
-        }
-
-        // Validate the coarse chan
-        if coarse_chan_index > self.num_coarse_chans - 1 {
-            return Err(GpuboxError::InvalidCoarseChanIndex(
-                self.num_coarse_chans - 1,
-            ));
-        }
-
-        // Output buffer for read in data
-        let output_buffer: Vec<f32>;
+        let mut output_buffer = vec![0.; self.num_timestep_coarse_chan_floats];
 
-        // Lookup the coarse channel we need
-        let coarse_chan = self.coarse_chans[coarse_chan_index].gpubox_number;
-        let (batch_index, hdu_index) =
-            self.gpubox_time_map[&self.timesteps[timestep_index].unix_time_ms][&coarse_chan];
-
-        if self.gpubox_batches.is_empty() {
-            return Err(GpuboxError::NoGpuboxes);
-        }
-        let mut fptr =
-            fits_open!(&self.gpubox_batches[batch_index].gpubox_files[coarse_chan_index].filename)?;
-        let hdu = fits_open_hdu!(&mut fptr, hdu_index)?;
-        output_buffer = get_fits_image!(&mut fptr, &hdu)?;
-        // If legacy correlator, then convert the HDU into the correct output format
-        if self.corr_version == CorrelatorVersion::OldLegacy
-            || self.corr_version == CorrelatorVersion::Legacy
-        {
-            // Prepare temporary buffer, if we are reading legacy correlator files
-            let mut temp_buffer = vec![
-                0.;
-                self.metafits_context.num_corr_fine_chans_per_coarse
-                    * self.metafits_context.num_visibility_pols
-                    * self.metafits_context.num_baselines
-                    * 2
-            ];
-
-            convert::convert_legacy_hdu_to_mwax_baseline_order(
-                &self.legacy_conversion_table,
-                &output_buffer,
-                &mut temp_buffer,
-                self.metafits_context.num_corr_fine_chans_per_coarse,
-            );
+        self.read_by_baseline_into_buffer(timestep_index, coarse_chan_index, &mut output_buffer)?;
 
-            Ok(temp_buffer)
-        } else {
-            Ok(output_buffer)
-        }
+        Ok(output_buffer)
     }
 
     /// Read a single timestep for a single coarse channel
     /// The output visibilities are in order:
     /// [frequency][baseline][pol][r][i]
     ///
+    /// This allocates a new vector on every call, as the caller owns the result. Hot loops should
+    /// use `read_by_frequency_into_buffer` with a buffer they reuse, or `read_by_frequency_pooled`,
+    /// whose buffers come from (and go back to) the context's `BufferPool`.
+    ///
     /// # Arguments
     ///
     /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
@@ -301,70 +395,1572 @@ impl CorrelatorContext {
     ///
     ///
     pub fn read_by_frequency(
-        &mut self,
+        &self,
         timestep_index: usize,
         coarse_chan_index: usize,
     ) -> Result<Vec<f32>, GpuboxError> {
-        // Validate the timestep
-        if timestep_index > self.num_timesteps - 1 {
-            return Err(GpuboxError::InvalidTimeStepIndex(self.num_timesteps - 1));
-        }
+        let mut output_buffer = vec![0.; self.num_timestep_coarse_chan_floats];
 
-        // Validate the coarse chan
-        if coarse_chan_index > self.num_coarse_chans - 1 {
-            return Err(GpuboxError::InvalidCoarseChanIndex(
-                self.num_coarse_chans - 1,
-            ));
-        }
+        self.read_by_frequency_into_buffer(timestep_index, coarse_chan_index, &mut output_buffer)?;
 
-        // Output buffer for read in data
-        let output_buffer: Vec<f32>;
+        Ok(output_buffer)
+    }
 
-        // Prepare temporary buffer
-        let mut temp_buffer = vec![
-            0.;
-            self.metafits_context.num_corr_fine_chans_per_coarse
-                * self.metafits_context.num_visibility_pols
-                * self.metafits_context.num_baselines
-                * 2
-        ];
+    /// Read a single timestep for a single coarse channel into a buffer taken
+    /// from this context's `BufferPool`. The buffer is returned to the pool
+    /// when it is dropped, so steady-state reads do not allocate.
+    /// The output visibilities are in order:
+    /// [baseline][frequency][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
+    ///                      to the element within mwalibContext.timesteps.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel. This corresponds
+    ///                      to the element within mwalibContext.coarse_chans.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a `PooledBuffer` of 32 bit floats containing the data in [baseline][frequency][pol][r][i] order, if Ok.
+    ///
+    ///
+    pub fn read_by_baseline_pooled(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    ) -> Result<PooledBuffer, GpuboxError> {
+        self.install(|| {
+            self.read_pooled(timestep_index, coarse_chan_index, false, &self.buffer_pool)
+        })
+    }
 
-        // Lookup the coarse channel we need
-        let coarse_chan = self.coarse_chans[coarse_chan_index].gpubox_number;
-        let (batch_index, hdu_index) =
-            self.gpubox_time_map[&self.timesteps[timestep_index].unix_time_ms][&coarse_chan];
+    /// Read a single timestep for a single coarse channel into a buffer taken
+    /// from this context's `BufferPool`. The buffer is returned to the pool
+    /// when it is dropped, so steady-state reads do not allocate.
+    /// The output visibilities are in order:
+    /// [frequency][baseline][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
+    ///                      to the element within mwalibContext.timesteps.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel. This corresponds
+    ///                      to the element within mwalibContext.coarse_chans.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a `PooledBuffer` of 32 bit floats containing the data in [frequency][baseline][pol][r][i] order, if Ok.
+    ///
+    ///
+    pub fn read_by_frequency_pooled(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    ) -> Result<PooledBuffer, GpuboxError> {
+        self.install(|| {
+            self.read_pooled(timestep_index, coarse_chan_index, true, &self.buffer_pool)
+        })
+    }
 
-        if self.gpubox_batches.is_empty() {
-            return Err(GpuboxError::NoGpuboxes);
-        }
-        let mut fptr =
-            fits_open!(&self.gpubox_batches[batch_index].gpubox_files[coarse_chan_index].filename)?;
-        let hdu = fits_open_hdu!(&mut fptr, hdu_index)?;
-        output_buffer = get_fits_image!(&mut fptr, &hdu)?;
-        // If legacy correlator, then convert the HDU into the correct output format
-        if self.corr_version == CorrelatorVersion::OldLegacy
-            || self.corr_version == CorrelatorVersion::Legacy
-        {
-            convert::convert_legacy_hdu_to_mwax_frequency_order(
-                &self.legacy_conversion_table,
-                &output_buffer,
-                &mut temp_buffer,
-                self.metafits_context.num_corr_fine_chans_per_coarse,
-            );
+    /// Read a single timestep for a single coarse channel into a caller supplied buffer.
+    /// The output visibilities are in order:
+    /// [baseline][frequency][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
+    ///                      to the element within mwalibContext.timesteps.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel. This corresponds
+    ///                      to the element within mwalibContext.coarse_chans.
+    ///
+    /// * `buffer` - slice of at least `num_timestep_coarse_chan_floats` floats. Only the first
+    ///              `num_timestep_coarse_chan_floats` floats are written to.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub fn read_by_baseline_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        self.install(|| {
+            self.read_into_buffer(
+                timestep_index,
+                coarse_chan_index,
+                buffer,
+                false,
+                &self.buffer_pool,
+            )
+        })
+    }
 
-            Ok(temp_buffer)
-        } else {
-            // Do conversion for mwax (it is in baseline order, we want it in freq order)
-            convert::convert_mwax_hdu_to_frequency_order(
-                &output_buffer,
-                &mut temp_buffer,
-                self.metafits_context.num_baselines,
-                self.metafits_context.num_corr_fine_chans_per_coarse,
-                self.metafits_context.num_visibility_pols,
-            );
+    /// Read a single timestep for a single coarse channel into a caller supplied buffer.
+    /// The output visibilities are in order:
+    /// [frequency][baseline][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
+    ///                      to the element within mwalibContext.timesteps.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel. This corresponds
+    ///                      to the element within mwalibContext.coarse_chans.
+    ///
+    /// * `buffer` - slice of at least `num_timestep_coarse_chan_floats` floats. Only the first
+    ///              `num_timestep_coarse_chan_floats` floats are written to.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub fn read_by_frequency_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        self.install(|| {
+            self.read_into_buffer(
+                timestep_index,
+                coarse_chan_index,
+                buffer,
+                true,
+                &self.buffer_pool,
+            )
+        })
+    }
+
+    /// Read a range of baselines of a single timestep for a single coarse channel into a caller
+    /// supplied buffer. If the data is in the context's scan cache, only those baselines are read
+    /// from it (and only the blocks holding them are decompressed); otherwise the whole HDU is read.
+    /// The output visibilities are in order:
+    /// [baseline][frequency][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `baselines` - range of baseline indices to read.
+    ///
+    /// * `buffer` - slice of at least `baselines.len()` * fine chans * pols * 2 floats.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub fn read_by_baseline_rows_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        baselines: Range<usize>,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        self.install(|| {
+            self.read_rows_into_buffer(timestep_index, coarse_chan_index, baselines, buffer, false)
+        })
+    }
+
+    /// Read a range of fine channels of a single timestep for a single coarse channel into a
+    /// caller supplied buffer. See `read_by_baseline_rows_into_buffer`.
+    /// The output visibilities are in order:
+    /// [frequency][baseline][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `fine_chans` - range of fine channel indices (within the coarse channel) to read.
+    ///
+    /// * `buffer` - slice of at least `fine_chans.len()` * baselines * pols * 2 floats.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub fn read_by_frequency_rows_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        fine_chans: Range<usize>,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        self.install(|| {
+            self.read_rows_into_buffer(timestep_index, coarse_chan_index, fine_chans, buffer, true)
+        })
+    }
 
-            Ok(temp_buffer)
+    /// Read only the autocorrelations of a single timestep for a single coarse channel into a
+    /// caller supplied buffer. For MWAX HDUs only the rows of the auto baselines are read (and
+    /// only the tiles of a compressed image holding them are decompressed); legacy HDUs are read
+    /// whole, but only the autocorrelations are converted.
+    /// The output visibilities are in order:
+    /// [antenna][frequency][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `buffer` - slice of at least num_ants * fine chans * pols * 2 floats.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub fn read_autos_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        let metafits_context = &self.metafits_context;
+        let floats_per_ant = metafits_context.num_corr_fine_chans_per_coarse
+            * metafits_context.num_visibility_pols
+            * 2;
+        let expected_len = metafits_context.num_ants * floats_per_ant;
+        if buffer.len() < expected_len {
+            return Err(GpuboxError::InvalidBufferSize {
+                buffer_len: buffer.len(),
+                expected_len,
+            });
         }
+        let buffer = &mut buffer[..expected_len];
+
+        self.install(|| {
+            match self.corr_version {
+                CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => {
+                    let mut hdu_buffer = self.buffer_pool.get(self.num_timestep_coarse_chan_floats);
+                    self.read_hdu_into_buffer(timestep_index, coarse_chan_index, &mut hdu_buffer)?;
+                    self.convert_hdu_autos_into_buffer(&hdu_buffer, buffer);
+                }
+                CorrelatorVersion::V2 => {
+                    let (gpubox_file, hdu_index) =
+                        self.get_gpubox_file_and_hdu(timestep_index, coarse_chan_index)?;
+                    let mut fptr = fits_open!(&gpubox_file.filename)?;
+                    let hdu = fits_open_hdu!(&mut fptr, hdu_index)?;
+                    // MWAX HDUs are in baseline order, one row per baseline
+                    let num_ants = metafits_context.num_ants;
+                    let auto_baselines = (0..num_ants).filter_map(|ant_index| {
+                        get_baseline_from_antennas(ant_index, ant_index, num_ants)
+                    });
+                    for (baseline_index, output_ant) in
+                        auto_baselines.zip(buffer.chunks_exact_mut(floats_per_ant))
+                    {
+                        get_fits_float_image_range_into_buffer!(
+                            &mut fptr,
+                            &hdu,
+                            baseline_index * floats_per_ant,
+                            output_ant
+                        )?;
+                    }
+                }
+            }
+
+            Ok(())
+        })
+    }
+
+    /// Build an `AntennaRemap` to read visibilities for some antennas, in a chosen order, with
+    /// `read_by_baseline_remapped_into_buffer` or `read_by_frequency_remapped_into_buffer`. For
+    /// legacy data the remap is composed with the legacy conversion table here, once.
+    ///
+    /// # Arguments
+    ///
+    /// * `antenna_indices` - index within the antenna array of each output antenna, in output
+    ///                       order. This can be a permutation of all the antennas or a subset.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `AntennaRemap`, or a `BaselineError` if an antenna index is out of
+    ///   range or repeated.
+    ///
+    ///
+    pub fn get_antenna_remap(
+        &self,
+        antenna_indices: &[usize],
+    ) -> Result<AntennaRemap, BaselineError> {
+        self.get_antenna_remap_with_convention(antenna_indices, VisibilityConvention::default())
+    }
+
+    /// Build an `AntennaRemap`, as `get_antenna_remap` does, whose output has a chosen conjugation
+    /// and baseline triangle. The convention is folded into the remap (and, for legacy data, the
+    /// composed conversion table), so it costs nothing at read time. To read all the antennas in
+    /// another convention, pass every antenna index in order.
+    ///
+    /// # Arguments
+    ///
+    /// * `antenna_indices` - index within the antenna array of each output antenna, in output
+    ///                       order.
+    ///
+    /// * `convention` - the conjugation and baseline triangle to output.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `AntennaRemap`, or a `BaselineError` if an antenna index is out of
+    ///   range or repeated.
+    ///
+    ///
+    pub fn get_antenna_remap_with_convention(
+        &self,
+        antenna_indices: &[usize],
+        convention: VisibilityConvention,
+    ) -> Result<AntennaRemap, BaselineError> {
+        let legacy_conversion_table = match self.corr_version {
+            CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => {
+                Some(self.legacy_conversion_table.as_slice())
+            }
+            CorrelatorVersion::V2 => None,
+        };
+
+        AntennaRemap::new(
+            antenna_indices.to_vec(),
+            self.metafits_context.num_ants,
+            convention,
+            legacy_conversion_table,
+        )
+    }
+
+    /// Build an `AntennaRemap` which orders all the antennas by tile id. See `get_antenna_remap`.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `AntennaRemap`.
+    ///
+    ///
+    pub fn get_antenna_remap_by_tile_id(&self) -> Result<AntennaRemap, BaselineError> {
+        let antennas = &self.metafits_context.antennas;
+        let mut antenna_indices: Vec<usize> = (0..antennas.len()).collect();
+        antenna_indices.sort_by_key(|a| antennas[*a].tile_id);
+
+        self.get_antenna_remap(&antenna_indices)
+    }
+
+    /// Build an `AntennaRemap` of the named tiles, in the order given. See `get_antenna_remap`.
+    ///
+    /// # Arguments
+    ///
+    /// * `tile_names` - the tile name of each output antenna, in output order.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `AntennaRemap`, or a `BaselineError` if a tile is not in the
+    ///   observation or is repeated.
+    ///
+    ///
+    pub fn get_antenna_remap_by_tile_names<T: AsRef<str>>(
+        &self,
+        tile_names: &[T],
+    ) -> Result<AntennaRemap, BaselineError> {
+        let antennas = &self.metafits_context.antennas;
+        let antenna_indices = tile_names
+            .iter()
+            .map(|name| {
+                antennas
+                    .iter()
+                    .position(|a| a.tile_name == name.as_ref())
+                    .ok_or_else(|| BaselineError::UnknownTileName(name.as_ref().to_string()))
+            })
+            .collect::<Result<Vec<usize>, BaselineError>>()?;
+
+        self.get_antenna_remap(&antenna_indices)
+    }
+
+    /// Read a single timestep for a single coarse channel into a caller supplied buffer, with the
+    /// antennas reordered (or a subarray taken) by `remap`. The data is reordered once, straight
+    /// from the raw HDU.
+    /// The output visibilities are in order:
+    /// [baseline][frequency][pol][r][i]
+    /// where the baselines are those of `remap.baselines`.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `remap` - an `AntennaRemap` from this context's `get_antenna_remap`.
+    ///
+    /// * `buffer` - slice of at least `remap.num_baselines()` * fine chans * pols * 2 floats.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub fn read_by_baseline_remapped_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        remap: &AntennaRemap,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        self.read_remapped_into_buffer(timestep_index, coarse_chan_index, remap, buffer, false)
+    }
+
+    /// Read a single timestep for a single coarse channel into a caller supplied buffer, with the
+    /// antennas reordered (or a subarray taken) by `remap`. See
+    /// `read_by_baseline_remapped_into_buffer`.
+    /// The output visibilities are in order:
+    /// [frequency][baseline][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `remap` - an `AntennaRemap` from this context's `get_antenna_remap`.
+    ///
+    /// * `buffer` - slice of at least `remap.num_baselines()` * fine chans * pols * 2 floats.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub fn read_by_frequency_remapped_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        remap: &AntennaRemap,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        self.read_remapped_into_buffer(timestep_index, coarse_chan_index, remap, buffer, true)
+    }
+
+    /// Read a single timestep for all coarse channels (a "scan"), reading the coarse channels in parallel.
+    /// Each coarse channel's data is in its own `PooledBuffer`, in order:
+    /// [baseline][frequency][pol][r][i]
+    ///
+    /// If the context was created with a `NumaPlacement`, each coarse channel is read by threads pinned to
+    /// its NUMA node, into buffers first touched (and therefore resident) on that node.
+    ///
+    /// Coarse channels with no HDU at this timestep (see `hdu_presence`) are filled with zeros.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
+    ///                      to the element within mwalibContext.timesteps.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a vector of `PooledBuffer`s, one per coarse channel (indexed the same as
+    ///   mwalibContext.coarse_chans), if Ok.
+    ///
+    ///
+    pub fn read_scan_by_baseline(
+        &self,
+        timestep_index: usize,
+    ) -> Result<Vec<PooledBuffer>, GpuboxError> {
+        self.read_scan(timestep_index, false)
+    }
+
+    /// Read a single timestep for all coarse channels (a "scan"), reading the coarse channels in parallel.
+    /// Each coarse channel's data is in its own `PooledBuffer`, in order:
+    /// [frequency][baseline][pol][r][i]
+    ///
+    /// If the context was created with a `NumaPlacement`, each coarse channel is read by threads pinned to
+    /// its NUMA node, into buffers first touched (and therefore resident) on that node.
+    ///
+    /// Coarse channels with no HDU at this timestep (see `hdu_presence`) are filled with zeros.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep. This corresponds
+    ///                      to the element within mwalibContext.timesteps.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a vector of `PooledBuffer`s, one per coarse channel (indexed the same as
+    ///   mwalibContext.coarse_chans), if Ok.
+    ///
+    ///
+    pub fn read_scan_by_frequency(
+        &self,
+        timestep_index: usize,
+    ) -> Result<Vec<PooledBuffer>, GpuboxError> {
+        self.read_scan(timestep_index, true)
+    }
+
+    /// Returns the `BufferPool` this context draws its read buffers from.
+    pub fn buffer_pool(&self) -> &Arc<BufferPool> {
+        &self.buffer_pool
+    }
+
+    /// Replace the `BufferPool` this context draws its read buffers from. Use this to share
+    /// one pool between several contexts with the same HDU geometry.
+    ///
+    /// # Arguments
+    ///
+    /// * `buffer_pool` - the pool to use for subsequent reads.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Nothing
+    ///
+    ///
+    pub fn set_buffer_pool(&mut self, buffer_pool: Arc<BufferPool>) {
+        self.buffer_pool = buffer_pool;
+    }
+
+    /// Returns the thread pool this context runs its parallel work in, or `None` if it uses
+    /// rayon's global pool.
+    pub fn thread_pool(&self) -> Option<&Arc<ThreadPool>> {
+        self.thread_pool.as_ref()
+    }
+
+    /// Run `op` in this context's thread pool (or rayon's global pool if it has none). Any rayon
+    /// parallel iterators used inside `op` also run in that pool.
+    ///
+    /// # Arguments
+    ///
+    /// * `op` - the work to do.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Whatever `op` returns.
+    ///
+    ///
+    pub(crate) fn install<OP, R>(&self, op: OP) -> R
+    where
+        OP: FnOnce() -> R + Send,
+        R: Send,
+    {
+        thread_pool::install(self.thread_pool.as_deref(), op)
+    }
+
+    /// Split this observation's work units into `num_shards` shards of whole gpubox files,
+    /// balanced by byte volume. Each shard has every batch's file for its coarse channels, so its
+    /// files can be opened as a context of their own. See `shard::plan_shards`.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_shards` - number of shards to make.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing `num_shards` `Shard`s, or a `ShardError`.
+    ///
+    ///
+    pub fn plan_shards(&self, num_shards: usize) -> Result<Vec<Shard>, ShardError> {
+        let mut files: Vec<ShardFile> = Vec::new();
+
+        for (batch_index, batch) in self.gpubox_batches.iter().enumerate() {
+            for gpubox_file in &batch.gpubox_files {
+                let coarse_chan_index = match self
+                    .coarse_chans
+                    .iter()
+                    .position(|c| c.gpubox_number == gpubox_file.channel_identifier)
+                {
+                    Some(c) => c,
+                    None => continue,
+                };
+
+                let (timestep_times_ms, work_units): (Vec<u64>, Vec<WorkUnit>) = self
+                    .get_gpubox_file_timestep_indices(batch_index, gpubox_file.channel_identifier)
+                    .into_iter()
+                    .map(|timestep_index| {
+                        (
+                            self.timesteps[timestep_index].unix_time_ms,
+                            WorkUnit {
+                                timestep_index,
+                                coarse_chan_index,
+                            },
+                        )
+                    })
+                    .unzip();
+
+                files.push(ShardFile {
+                    filename: gpubox_file.filename.clone(),
+                    channel_identifier: gpubox_file.channel_identifier,
+                    num_bytes: (work_units.len() * self.num_timestep_coarse_chan_bytes) as u64,
+                    timestep_times_ms,
+                    work_units,
+                });
+            }
+        }
+
+        shard::plan_shards(files, num_shards)
+    }
+
+    /// Returns true if one of the context's gpubox files has the HDU of a timestep and coarse channel.
+    pub(crate) fn has_hdu(&self, timestep_index: usize, coarse_chan_index: usize) -> bool {
+        self.hdu_presence
+            .is_present(timestep_index, coarse_chan_index)
+    }
+
+    /// Returns the work units of every timestep and coarse channel which has an HDU, timestep
+    /// major. Contexts opened with all timesteps may have timesteps missing some coarse channels;
+    /// these are the work units which can be read.
+    pub fn get_work_units(&self) -> Vec<WorkUnit> {
+        (0..self.num_timesteps)
+            .flat_map(|timestep_index| {
+                (0..self.num_coarse_chans).map(move |coarse_chan_index| WorkUnit {
+                    timestep_index,
+                    coarse_chan_index,
+                })
+            })
+            .filter(|w| self.has_hdu(w.timestep_index, w.coarse_chan_index))
+            .collect()
+    }
+
+    /// Get the timesteps within a range which have an HDU for a coarse channel.
+    ///
+    /// # Arguments
+    ///
+    /// * `coarse_chan_index` - index within the context's coarse_chans.
+    ///
+    /// * `timestep_indices` - the range of timestep indices to look in.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The indices of the timesteps, in time order.
+    ///
+    ///
+    pub(crate) fn get_hdu_timestep_indices(
+        &self,
+        coarse_chan_index: usize,
+        timestep_indices: Range<usize>,
+    ) -> Vec<usize> {
+        timestep_indices
+            .filter(|t| self.has_hdu(*t, coarse_chan_index))
+            .collect()
+    }
+
+    /// Get the timesteps whose HDU for a channel lives in a particular batch's gpubox file.
+    ///
+    /// # Arguments
+    ///
+    /// * `batch_index` - index within `gpubox_batches`.
+    ///
+    /// * `channel_identifier` - the file's channel, as in `GpuBoxFile::channel_identifier`.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The indices of the timesteps, in time order.
+    ///
+    ///
+    pub(crate) fn get_gpubox_file_timestep_indices(
+        &self,
+        batch_index: usize,
+        channel_identifier: usize,
+    ) -> Vec<usize> {
+        self.timesteps
+            .iter()
+            .enumerate()
+            .filter(|(_, timestep)| {
+                matches!(
+                    self.gpubox_time_map
+                        .get(&timestep.unix_time_ms)
+                        .and_then(|m| m.get(&channel_identifier)),
+                    Some((b, _)) if *b == batch_index
+                )
+            })
+            .map(|(timestep_index, _)| timestep_index)
+            .collect()
+    }
+
+    /// Get the work units of a shard, indexed against this context. The shard may come from a
+    /// plan made on another context of the same observation, e.g. this context may have been
+    /// opened with only the shard's files. Work units this context does not have are left out.
+    ///
+    /// # Arguments
+    ///
+    /// * `shard` - the shard.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The shard's work units, grouped by file.
+    ///
+    ///
+    pub fn get_shard_work_units(&self, shard: &Shard) -> Vec<WorkUnit> {
+        shard
+            .get_work_unit_keys()
+            .iter()
+            .filter_map(|(channel_identifier, unix_time_ms)| {
+                Some(WorkUnit {
+                    timestep_index: self
+                        .timesteps
+                        .iter()
+                        .position(|t| t.unix_time_ms == *unix_time_ms)?,
+                    coarse_chan_index: self
+                        .coarse_chans
+                        .iter()
+                        .position(|c| c.gpubox_number == *channel_identifier)?,
+                })
+            })
+            .filter(|w| self.has_hdu(w.timestep_index, w.coarse_chan_index))
+            .collect()
+    }
+
+    /// Returns the scan cache this context's reads are served from, if it has one.
+    pub fn scan_cache(&self) -> Option<&Arc<ScanCache>> {
+        self.scan_cache.as_ref()
+    }
+
+    /// Verify the FITS checksums of every HDU of the metafits file and of every gpubox file,
+    /// checking the files in parallel. HDUs without checksums are not verified.
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a `ChecksumSummary` totalled over all files, or the `GpuboxError`
+    ///   of a HDU which failed verification.
+    ///
+    ///
+    pub fn verify_checksums(&self) -> Result<ChecksumSummary, GpuboxError> {
+        let mut filenames = vec![self.metafits_context.metafits_filename.as_str()];
+        filenames.extend(self.get_gpubox_filenames());
+
+        self.verify_files_checksums(filenames)
+    }
+
+    /// The filenames of every gpubox file, in batch order.
+    fn get_gpubox_filenames(&self) -> Vec<&str> {
+        self.gpubox_batches
+            .iter()
+            .flat_map(|b| b.gpubox_files.iter().map(|f| f.filename.as_str()))
+            .collect()
+    }
+
+    /// Verify the FITS checksums of every HDU of some files, checking the files in parallel.
+    ///
+    /// # Arguments
+    ///
+    /// * `filenames` - the FITS files to verify.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a `ChecksumSummary` totalled over the files, or the `GpuboxError`
+    ///   of a HDU which failed verification.
+    ///
+    ///
+    fn verify_files_checksums(&self, filenames: Vec<&str>) -> Result<ChecksumSummary, GpuboxError> {
+        let summaries = self.install(|| {
+            filenames
+                .par_iter()
+                .map(verify_file_checksums)
+                .collect::<Result<Vec<ChecksumSummary>, GpuboxError>>()
+        })?;
+
+        Ok(summaries
+            .iter()
+            .fold(ChecksumSummary::default(), |total, s| ChecksumSummary {
+                num_files: total.num_files + s.num_files,
+                num_hdus: total.num_hdus + s.num_hdus,
+                num_hdus_verified: total.num_hdus_verified + s.num_hdus_verified,
+            }))
+    }
+
+    /// Read a single timestep for a single coarse channel from the scan cache, without copying it.
+    /// On a cache miss the data is read, converted and added to the cache first.
+    /// The output visibilities are in order:
+    /// [baseline][frequency][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing the cache's memory mapped copy of the data, if Ok. Fails with
+    ///   `GpuboxError::NoScanCache` if the context has no scan cache.
+    ///
+    ///
+    pub fn read_by_baseline_cached(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    ) -> Result<CachedChunk, GpuboxError> {
+        self.read_cached(timestep_index, coarse_chan_index, false)
+    }
+
+    /// Read a single timestep for a single coarse channel from the scan cache, without copying it.
+    /// On a cache miss the data is read, converted and added to the cache first.
+    /// The output visibilities are in order:
+    /// [frequency][baseline][pol][r][i]
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing the cache's memory mapped copy of the data, if Ok. Fails with
+    ///   `GpuboxError::NoScanCache` if the context has no scan cache.
+    ///
+    ///
+    pub fn read_by_frequency_cached(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    ) -> Result<CachedChunk, GpuboxError> {
+        self.read_cached(timestep_index, coarse_chan_index, true)
+    }
+
+    /// Returns the NUMA placement of this context's scan reads, if it has one.
+    pub fn numa_placement(&self) -> Option<&Arc<NumaPlacement>> {
+        self.numa_placement.as_ref()
+    }
+
+    /// Read all coarse channels of one timestep in parallel. See `read_scan_by_baseline`.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a vector of `PooledBuffer`s, one per coarse channel, if Ok.
+    ///
+    ///
+    fn read_scan(
+        &self,
+        timestep_index: usize,
+        by_frequency: bool,
+    ) -> Result<Vec<PooledBuffer>, GpuboxError> {
+        // Validate the timestep
+        if timestep_index > self.num_timesteps - 1 {
+            return Err(GpuboxError::InvalidTimeStepIndex(self.num_timesteps - 1));
+        }
+
+        match &self.numa_placement {
+            None => self.install(|| {
+                (0..self.num_coarse_chans)
+                    .into_par_iter()
+                    .map(|coarse_chan_index| {
+                        self.read_pooled_or_zeroed(
+                            timestep_index,
+                            coarse_chan_index,
+                            by_frequency,
+                            &self.buffer_pool,
+                        )
+                    })
+                    .collect()
+            }),
+            Some(numa) => {
+                // Each node reads its own coarse channels on its own pinned workers, and
+                // allocates from its own buffer pool, so the pages of each buffer are first
+                // touched on (and so belong to) that node. The nodes run concurrently.
+                let per_node_results: Vec<Vec<(usize, Result<PooledBuffer, GpuboxError>)>> = self
+                    .install(|| {
+                        (0..numa.num_nodes())
+                            .into_par_iter()
+                            .map(|node_index| {
+                                let coarse_chan_indices: Vec<usize> = (0..self.num_coarse_chans)
+                                    .filter(|c| numa.get_coarse_chan_node(*c) == node_index)
+                                    .collect();
+
+                                numa.thread_pools[node_index].install(|| {
+                                    coarse_chan_indices
+                                        .into_par_iter()
+                                        .map(|coarse_chan_index| {
+                                            (
+                                                coarse_chan_index,
+                                                self.read_pooled_or_zeroed(
+                                                    timestep_index,
+                                                    coarse_chan_index,
+                                                    by_frequency,
+                                                    &numa.buffer_pools[node_index],
+                                                ),
+                                            )
+                                        })
+                                        .collect()
+                                })
+                            })
+                            .collect()
+                    });
+
+                // Put the coarse channels back in order
+                let mut results: Vec<Option<Result<PooledBuffer, GpuboxError>>> =
+                    (0..self.num_coarse_chans).map(|_| None).collect();
+                for (coarse_chan_index, result) in per_node_results.into_iter().flatten() {
+                    results[coarse_chan_index] = Some(result);
+                }
+
+                results.into_iter().map(|r| r.unwrap()).collect()
+            }
+        }
+    }
+
+    /// Get a single timestep for a single coarse channel from the scan cache, reading it into the
+    /// cache first if needed. See `read_by_baseline_cached`.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing the cache's memory mapped copy of the data, if Ok.
+    ///
+    ///
+    fn read_cached(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        by_frequency: bool,
+    ) -> Result<CachedChunk, GpuboxError> {
+        let scan_cache = match &self.scan_cache {
+            Some(s) => s,
+            None => return Err(GpuboxError::NoScanCache),
+        };
+        // Validates the indices too
+        let key = self.get_scan_cache_key(timestep_index, coarse_chan_index, by_frequency)?;
+
+        if let Some(chunk) = scan_cache.get(&key)? {
+            return Ok(chunk);
+        }
+
+        // This adds the data to the cache
+        self.install(|| {
+            self.read_pooled(
+                timestep_index,
+                coarse_chan_index,
+                by_frequency,
+                &self.buffer_pool,
+            )
+        })?;
+
+        match scan_cache.get(&key)? {
+            Some(chunk) => Ok(chunk),
+            None => Err(GpuboxError::ScanCache(ScanCacheError::ChunkTooLarge {
+                num_bytes: self.num_timestep_coarse_chan_bytes as u64,
+                max_bytes: scan_cache.max_bytes(),
+            })),
+        }
+    }
+
+    /// Read a range of rows (baselines, or fine channels if `by_frequency`) of a single timestep
+    /// for a single coarse channel, in the current thread pool. See `read_by_baseline_rows_into_buffer`.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `rows` - range of rows to read.
+    ///
+    /// * `buffer` - slice of at least `rows.len()` rows.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    fn read_rows_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        rows: Range<usize>,
+        buffer: &mut [f32],
+        by_frequency: bool,
+    ) -> Result<(), GpuboxError> {
+        let row_floats = self.get_row_floats(by_frequency);
+        let num_rows = self.num_timestep_coarse_chan_floats / row_floats;
+        if rows.start > rows.end || rows.end > num_rows {
+            return Err(GpuboxError::InvalidRowRange {
+                start: rows.start,
+                end: rows.end,
+                num_rows,
+            });
+        }
+        if buffer.len() < rows.len() * row_floats {
+            return Err(GpuboxError::InvalidBufferSize {
+                buffer_len: buffer.len(),
+                expected_len: rows.len() * row_floats,
+            });
+        }
+        let buffer = &mut buffer[..rows.len() * row_floats];
+
+        if let Some(scan_cache) = &self.scan_cache {
+            let key = self.get_scan_cache_key(timestep_index, coarse_chan_index, by_frequency)?;
+            if scan_cache.get_rows(&key, rows.clone(), buffer)? {
+                return Ok(());
+            }
+        }
+
+        // Read the whole HDU (which adds it to any scan cache) and take the rows from it
+        let data = self.read_pooled(
+            timestep_index,
+            coarse_chan_index,
+            by_frequency,
+            &self.buffer_pool,
+        )?;
+        buffer.copy_from_slice(&data[rows.start * row_floats..rows.end * row_floats]);
+
+        Ok(())
+    }
+
+    /// Returns the number of floats in a row of converted data: a baseline (fine chans * pols * 2)
+    /// in baseline order, or a fine channel (baselines * pols * 2) in frequency order.
+    fn get_row_floats(&self, by_frequency: bool) -> usize {
+        let num_rows = if by_frequency {
+            self.metafits_context.num_corr_fine_chans_per_coarse
+        } else {
+            self.metafits_context.num_baselines
+        };
+
+        self.num_timestep_coarse_chan_floats / num_rows
+    }
+
+    /// Read a single timestep for a single coarse channel into a buffer from `buffer_pool`, in the
+    /// current thread pool.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    /// * `buffer_pool` - pool to take the output and any scratch buffers from.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a `PooledBuffer` of the data, if Ok.
+    ///
+    ///
+    fn read_pooled(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        by_frequency: bool,
+        buffer_pool: &Arc<BufferPool>,
+    ) -> Result<PooledBuffer, GpuboxError> {
+        let mut output_buffer = buffer_pool.get(self.num_timestep_coarse_chan_floats);
+
+        self.read_into_buffer(
+            timestep_index,
+            coarse_chan_index,
+            &mut output_buffer,
+            by_frequency,
+            buffer_pool,
+        )?;
+
+        Ok(output_buffer)
+    }
+
+    /// As `read_pooled`, but a timestep and coarse channel with no HDU gives a buffer of zeros
+    /// rather than an error.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    /// * `buffer_pool` - pool to take the output and any scratch buffers from.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing a `PooledBuffer` of the data, if Ok.
+    ///
+    ///
+    fn read_pooled_or_zeroed(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        by_frequency: bool,
+        buffer_pool: &Arc<BufferPool>,
+    ) -> Result<PooledBuffer, GpuboxError> {
+        if self.has_hdu(timestep_index, coarse_chan_index) {
+            return self.read_pooled(timestep_index, coarse_chan_index, by_frequency, buffer_pool);
+        }
+
+        // Pooled buffers are reused, so may hold an earlier read
+        let mut output_buffer = buffer_pool.get(self.num_timestep_coarse_chan_floats);
+        output_buffer.iter_mut().for_each(|x| *x = 0.);
+
+        Ok(output_buffer)
+    }
+
+    /// Read a single timestep for a single coarse channel into a caller supplied buffer, converting
+    /// it to the requested order, in the current thread pool.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `buffer` - slice of at least `num_timestep_coarse_chan_floats` floats.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    /// * `buffer_pool` - pool to take any scratch buffers from.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    fn read_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        buffer: &mut [f32],
+        by_frequency: bool,
+        buffer_pool: &Arc<BufferPool>,
+    ) -> Result<(), GpuboxError> {
+        self.validate_read_buffer(buffer.len())?;
+        let output_buffer = &mut buffer[..self.num_timestep_coarse_chan_floats];
+
+        // Serve the data from the scan cache if it has it
+        let scan_cache_key = match &self.scan_cache {
+            Some(scan_cache) => {
+                let key =
+                    self.get_scan_cache_key(timestep_index, coarse_chan_index, by_frequency)?;
+                if let Some(chunk) = scan_cache.get(&key)? {
+                    output_buffer.copy_from_slice(&chunk);
+                    return Ok(());
+                }
+                Some(key)
+            }
+            None => None,
+        };
+
+        let is_legacy = self.corr_version == CorrelatorVersion::OldLegacy
+            || self.corr_version == CorrelatorVersion::Legacy;
+
+        if !is_legacy && !by_frequency {
+            // MWAX HDUs are already in baseline order, so can be read straight into the output
+            self.read_hdu_into_buffer(timestep_index, coarse_chan_index, output_buffer)?;
+        } else {
+            // Otherwise read the raw HDU into a scratch buffer from the pool and convert it
+            let mut hdu_buffer = buffer_pool.get(self.num_timestep_coarse_chan_floats);
+            self.read_hdu_into_buffer(timestep_index, coarse_chan_index, &mut hdu_buffer)?;
+
+            self.convert_hdu_into_buffer(&hdu_buffer, output_buffer, by_frequency);
+        }
+
+        if let (Some(scan_cache), Some(key)) = (&self.scan_cache, scan_cache_key) {
+            scan_cache.insert_rows(&key, output_buffer, self.get_row_floats(by_frequency))?;
+        }
+
+        Ok(())
+    }
+
+    /// Read a single timestep for a single coarse channel into a caller supplied buffer, through an
+    /// `AntennaRemap`.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `remap` - an `AntennaRemap` from this context's `get_antenna_remap`.
+    ///
+    /// * `buffer` - slice of at least `remap.num_baselines()` * fine chans * pols * 2 floats.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    fn read_remapped_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        remap: &AntennaRemap,
+        buffer: &mut [f32],
+        by_frequency: bool,
+    ) -> Result<(), GpuboxError> {
+        let is_legacy = self.corr_version == CorrelatorVersion::OldLegacy
+            || self.corr_version == CorrelatorVersion::Legacy;
+        let kind = |legacy: bool| if legacy { "legacy" } else { "MWAX" };
+        if remap.num_input_ants != self.metafits_context.num_ants
+            || remap.legacy_conversion_table.is_some() != is_legacy
+        {
+            return Err(GpuboxError::AntennaRemapMismatch {
+                remap_num_ants: remap.num_input_ants,
+                remap_kind: kind(remap.legacy_conversion_table.is_some()),
+                num_ants: self.metafits_context.num_ants,
+                kind: kind(is_legacy),
+            });
+        }
+
+        let num_fine_chans = self.metafits_context.num_corr_fine_chans_per_coarse;
+        let expected_len =
+            remap.num_baselines() * num_fine_chans * self.metafits_context.num_visibility_pols * 2;
+        if buffer.len() < expected_len {
+            return Err(GpuboxError::InvalidBufferSize {
+                buffer_len: buffer.len(),
+                expected_len,
+            });
+        }
+        let output_buffer = &mut buffer[..expected_len];
+
+        let mut hdu_buffer = self.buffer_pool.get(self.num_timestep_coarse_chan_floats);
+        self.read_hdu_into_buffer(timestep_index, coarse_chan_index, &mut hdu_buffer)?;
+
+        self.install(|| match (&remap.legacy_conversion_table, by_frequency) {
+            (Some(table), false) => convert::convert_legacy_hdu_to_mwax_baseline_order(
+                table,
+                &hdu_buffer,
+                output_buffer,
+                self.metafits_context.num_baselines,
+                num_fine_chans,
+            ),
+            (Some(table), true) => convert::convert_legacy_hdu_to_mwax_frequency_order(
+                table,
+                &hdu_buffer,
+                output_buffer,
+                self.metafits_context.num_baselines,
+                num_fine_chans,
+            ),
+            (None, false) => baseline::remap_mwax_hdu_to_baseline_order(
+                remap,
+                &hdu_buffer,
+                output_buffer,
+                num_fine_chans,
+            ),
+            (None, true) => baseline::remap_mwax_hdu_to_frequency_order(
+                remap,
+                &hdu_buffer,
+                output_buffer,
+                num_fine_chans,
+            ),
+        });
+
+        Ok(())
+    }
+
+    /// Build the scan cache key for a single timestep and coarse channel in one order. The key
+    /// identifies the gpubox file and HDU the data comes from and, for legacy data, the metafits
+    /// file the conversion depends on, so a changed file never matches an old chunk.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `by_frequency` - if true, the key is for [frequency][baseline][pol][r][i] order, otherwise [baseline][frequency][pol][r][i].
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing the key, if Ok.
+    ///
+    ///
+    fn get_scan_cache_key(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        by_frequency: bool,
+    ) -> Result<String, GpuboxError> {
+        let (gpubox_file, hdu_index) =
+            self.get_gpubox_file_and_hdu(timestep_index, coarse_chan_index)?;
+
+        let metafits_identity = match self.corr_version {
+            CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => {
+                scan_cache::get_file_identity(&self.metafits_context.metafits_filename)?
+            }
+            _ => String::new(),
+        };
+
+        Ok(format!(
+            "correlator|{}|hdu {}|{}|{} floats|{}",
+            scan_cache::get_file_identity(&gpubox_file.filename)?,
+            hdu_index,
+            if by_frequency {
+                "frequency"
+            } else {
+                "baseline"
+            },
+            self.num_timestep_coarse_chan_floats,
+            metafits_identity
+        ))
+    }
+
+    /// Convert one raw gpubox HDU (as read from disk) into [baseline][frequency][pol][r][i] or
+    /// [frequency][baseline][pol][r][i] order, in the current thread pool.
+    ///
+    /// # Arguments
+    ///
+    /// * `hdu_buffer` - the raw HDU data, `num_timestep_coarse_chan_floats` floats.
+    ///
+    /// * `output_buffer` - slice of `num_timestep_coarse_chan_floats` floats to write the converted data into.
+    ///
+    /// * `by_frequency` - if true, output is [frequency][baseline][pol][r][i], otherwise [baseline][frequency][pol][r][i].
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Nothing
+    ///
+    ///
+    pub(crate) fn convert_hdu_into_buffer(
+        &self,
+        hdu_buffer: &[f32],
+        output_buffer: &mut [f32],
+        by_frequency: bool,
+    ) {
+        let is_legacy = self.corr_version == CorrelatorVersion::OldLegacy
+            || self.corr_version == CorrelatorVersion::Legacy;
+
+        match (is_legacy, by_frequency) {
+            (true, false) => convert::convert_legacy_hdu_to_mwax_baseline_order(
+                &self.legacy_conversion_table,
+                hdu_buffer,
+                output_buffer,
+                self.metafits_context.num_baselines,
+                self.metafits_context.num_corr_fine_chans_per_coarse,
+            ),
+            (true, true) => convert::convert_legacy_hdu_to_mwax_frequency_order(
+                &self.legacy_conversion_table,
+                hdu_buffer,
+                output_buffer,
+                self.metafits_context.num_baselines,
+                self.metafits_context.num_corr_fine_chans_per_coarse,
+            ),
+            // Do conversion for mwax (it is in baseline order, we want it in freq order)
+            (false, true) => convert::convert_mwax_hdu_to_frequency_order(
+                hdu_buffer,
+                output_buffer,
+                self.metafits_context.num_baselines,
+                self.metafits_context.num_corr_fine_chans_per_coarse,
+                self.metafits_context.num_visibility_pols,
+            ),
+            // mwax is already in baseline order
+            (false, false) => output_buffer.copy_from_slice(hdu_buffer),
+        }
+    }
+
+    /// Gather the autocorrelations of a raw HDU, already read, into a buffer. Cross correlations
+    /// are not converted.
+    ///
+    /// # Arguments
+    ///
+    /// * `hdu_buffer` - slice of `num_timestep_coarse_chan_floats` floats read from a gpubox HDU.
+    ///
+    /// * `output_buffer` - slice of num_ants * fine chans * pols * 2 floats to write the
+    ///                     autocorrelations into, in [antenna][frequency][pol][r][i] order.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Nothing
+    ///
+    ///
+    pub(crate) fn convert_hdu_autos_into_buffer(
+        &self,
+        hdu_buffer: &[f32],
+        output_buffer: &mut [f32],
+    ) {
+        let metafits_context = &self.metafits_context;
+        match self.corr_version {
+            CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy => {
+                convert::convert_legacy_hdu_autos(
+                    &self.legacy_conversion_table,
+                    hdu_buffer,
+                    output_buffer,
+                    metafits_context.num_baselines,
+                    metafits_context.num_corr_fine_chans_per_coarse,
+                )
+            }
+            // mwax is in baseline order, so copy the auto baselines' rows
+            CorrelatorVersion::V2 => {
+                let floats_per_baseline = metafits_context.num_corr_fine_chans_per_coarse
+                    * metafits_context.num_visibility_pols
+                    * 2;
+                let auto_rows = hdu_buffer
+                    .chunks_exact(floats_per_baseline)
+                    .zip(metafits_context.baselines.iter())
+                    .filter(|(_, b)| b.ant1_index == b.ant2_index)
+                    .map(|(row, _)| row);
+                for (row, output_ant) in
+                    auto_rows.zip(output_buffer.chunks_exact_mut(floats_per_baseline))
+                {
+                    output_ant.copy_from_slice(row);
+                }
+            }
+        }
+    }
+
+    /// Checks that a caller supplied buffer is big enough to hold one timestep/coarse channel.
+    ///
+    /// # Arguments
+    ///
+    /// * `buffer_len` - length of the caller's buffer, in floats.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing `Ok` if it is big enough, or `GpuboxError::InvalidBufferSize` if not.
+    ///
+    ///
+    fn validate_read_buffer(&self, buffer_len: usize) -> Result<(), GpuboxError> {
+        if buffer_len < self.num_timestep_coarse_chan_floats {
+            return Err(GpuboxError::InvalidBufferSize {
+                buffer_len,
+                expected_len: self.num_timestep_coarse_chan_floats,
+            });
+        }
+
+        Ok(())
+    }
+
+    /// Read the raw (unconverted) HDU for a single timestep and coarse channel into a buffer.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    /// * `buffer` - slice of at least `num_timestep_coarse_chan_floats` floats.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok.
+    ///
+    ///
+    pub(crate) fn read_hdu_into_buffer(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        buffer: &mut [f32],
+    ) -> Result<(), GpuboxError> {
+        let (gpubox_file, hdu_index) =
+            self.get_gpubox_file_and_hdu(timestep_index, coarse_chan_index)?;
+        let mut fptr = fits_open!(&gpubox_file.filename)?;
+        let hdu = fits_open_hdu!(&mut fptr, hdu_index)?;
+        get_fits_float_image_into_buffer!(&mut fptr, &hdu, buffer)?;
+
+        Ok(())
+    }
+
+    /// Find the gpubox file and HDU holding a single timestep and coarse channel.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the timestep array for the desired timestep.
+    ///
+    /// * `coarse_chan_index` - index within the coarse_chan array for the desired coarse channel.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing the gpubox file and the HDU index within it, if Ok.
+    ///
+    ///
+    fn get_gpubox_file_and_hdu(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    ) -> Result<(&GpuBoxFile, usize), GpuboxError> {
+        // Validate the timestep
+        if timestep_index > self.num_timesteps - 1 {
+            return Err(GpuboxError::InvalidTimeStepIndex(self.num_timesteps - 1));
+        }
+
+        // Validate the coarse chan
+        if coarse_chan_index > self.num_coarse_chans - 1 {
+            return Err(GpuboxError::InvalidCoarseChanIndex(
+                self.num_coarse_chans - 1,
+            ));
+        }
+
+        // Lookup the coarse channel we need
+        let coarse_chan = self.coarse_chans[coarse_chan_index].gpubox_number;
+        let (batch_index, hdu_index) = match self
+            .gpubox_time_map
+            .get(&self.timesteps[timestep_index].unix_time_ms)
+            .and_then(|m| m.get(&coarse_chan))
+        {
+            Some(h) => *h,
+            None => {
+                return Err(GpuboxError::MissingHdu {
+                    timestep_index,
+                    coarse_chan_index,
+                })
+            }
+        };
+
+        // Find the file by channel rather than position, as a batch need not hold every channel
+        let gpubox_file = match self.gpubox_batches.get(batch_index).and_then(|b| {
+            b.gpubox_files
+                .iter()
+                .find(|f| f.channel_identifier == coarse_chan)
+        }) {
+            Some(f) => f,
+            None => {
+                return Err(GpuboxError::NoDataForTimeStepCoarseChannel {
+                    timestep_index,
+                    coarse_chan_index,
+                })
+            }
+        };
+
+        Ok((gpubox_file, hdu_index))
     }
 
     /// Validates the first HDU of a gpubox file against metafits metadata
@@ -0,0 +1,223 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Options which control how a `CorrelatorContext` is built and does its work.
+ */
+use std::ops::Range;
+use std::sync::Arc;
+
+use rayon::ThreadPool;
+
+use crate::gpubox_files::GpuboxSelection;
+use crate::numa::NumaPlacement;
+use crate::scan_cache::ScanCache;
+use crate::thread_pool::*;
+
+///
+/// Options for `CorrelatorContext::new_with_options`. The defaults give the same
+/// behaviour as `CorrelatorContext::new`.
+///
+#[derive(Clone, Debug, Default)]
+pub struct CorrelatorContextOptions {
+    /// Thread pool in which all of the context's internal parallel work (time
+    /// map creation, conversions, scans) runs. If `None`, rayon's global pool is used.
+    pub thread_pool: Option<Arc<ThreadPool>>,
+    /// Per-NUMA-node placement for scan reads. If `None`, scans run in `thread_pool`
+    /// and draw buffers from the context's own `BufferPool`.
+    pub numa_placement: Option<Arc<NumaPlacement>>,
+    /// Which channels and times the context examines. By default, everything supplied.
+    pub selection: GpuboxSelection,
+    /// Cache of converted data that reads are served from and added to. If `None`, reads always
+    /// go to the gpubox files.
+    pub scan_cache: Option<Arc<ScanCache>>,
+    /// Verify the DATASUM and CHECKSUM of every metafits and gpubox HDU when the context is
+    /// created.
+    pub verify_checksums: bool,
+    /// Keep every timestep any gpubox file has, rather than only those common to all files.
+    /// `CorrelatorContext::hdu_presence` records which HDUs exist.
+    pub all_timesteps: bool,
+}
+
+impl CorrelatorContextOptions {
+    /// Create a new set of options with default values.
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Run the context's parallel work in an existing rayon thread pool.
+    ///
+    /// # Arguments
+    ///
+    /// * `thread_pool` - the pool to use. It may be shared with other contexts or the caller's own work.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated options.
+    ///
+    ///
+    pub fn with_thread_pool(mut self, thread_pool: Arc<ThreadPool>) -> Self {
+        self.thread_pool = Some(thread_pool);
+        self
+    }
+
+    /// Run the context's parallel work in a new thread pool of `num_threads`
+    /// threads, optionally pinned to particular CPUs.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_threads` - number of worker threads.
+    ///
+    /// * `cpu_affinity` - CPUs to pin the workers to (see `build_thread_pool`). May be empty.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the updated options, or a `ThreadPoolError`.
+    ///
+    ///
+    pub fn with_num_threads(
+        self,
+        num_threads: usize,
+        cpu_affinity: &[usize],
+    ) -> Result<Self, ThreadPoolError> {
+        let thread_pool = build_thread_pool(num_threads, cpu_affinity)?;
+
+        Ok(self.with_thread_pool(Arc::new(thread_pool)))
+    }
+
+    /// Read scans NUMA-locally: each coarse channel is read by threads pinned to one node, into
+    /// buffers allocated (first touched) on that node.
+    ///
+    /// # Arguments
+    ///
+    /// * `numa_placement` - the per-node pools and coarse channel to node mapping to use.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated options.
+    ///
+    ///
+    pub fn with_numa_placement(mut self, numa_placement: Arc<NumaPlacement>) -> Self {
+        self.numa_placement = Some(numa_placement);
+        self
+    }
+
+    /// Read scans NUMA-locally on this machine's detected topology (see `with_numa_placement`).
+    ///
+    /// # Arguments
+    ///
+    /// * `coarse_chan_nodes` - node index for each coarse channel, or an empty slice to assign
+    ///                         coarse channels to nodes round robin.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the updated options, or a `ThreadPoolError`.
+    ///
+    ///
+    pub fn with_numa(self, coarse_chan_nodes: &[usize]) -> Result<Self, ThreadPoolError> {
+        let numa_placement = NumaPlacement::detect(coarse_chan_nodes)?;
+
+        Ok(self.with_numa_placement(Arc::new(numa_placement)))
+    }
+
+    /// Only use the gpubox files for these channels. Other files are filtered out by filename
+    /// and are never opened.
+    ///
+    /// # Arguments
+    ///
+    /// * `channel_identifiers` - channels as they appear in the gpubox filenames: the gpubox number
+    ///                           for legacy files, or the receiver channel number for MWAX files.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated options.
+    ///
+    ///
+    pub fn with_gpubox_channels(mut self, channel_identifiers: &[usize]) -> Self {
+        self.selection.channel_identifiers = Some(channel_identifiers.to_vec());
+        self
+    }
+
+    /// Only index the HDUs which start inside a time range. Files with no HDUs in the range are
+    /// left out of the context.
+    ///
+    /// # Arguments
+    ///
+    /// * `unix_time_range_ms` - range of HDU start times, as UNIX times in milliseconds. The start
+    ///                          is inclusive and the end exclusive.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated options.
+    ///
+    ///
+    pub fn with_unix_time_range_ms(mut self, unix_time_range_ms: Range<u64>) -> Self {
+        self.selection.unix_time_range_ms = Some(unix_time_range_ms);
+        self
+    }
+
+    /// Serve reads from a cache of converted data, adding to it on each miss. The cache may be
+    /// shared with other contexts.
+    ///
+    /// # Arguments
+    ///
+    /// * `scan_cache` - the cache to use.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated options.
+    ///
+    ///
+    pub fn with_scan_cache(mut self, scan_cache: Arc<ScanCache>) -> Self {
+        self.scan_cache = Some(scan_cache);
+        self
+    }
+
+    /// Verify FITS checksums when the context is created: every HDU of the metafits file and of
+    /// each gpubox file is verified once, in parallel, so that later reads need not re-read HDUs
+    /// to sum them. A mismatch is returned as a `GpuboxError`. HDUs without checksums are not
+    /// verified.
+    ///
+    /// # Arguments
+    ///
+    /// * `verify_checksums` - true to verify checksums.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated options.
+    ///
+    ///
+    pub fn with_checksum_verification(mut self, verify_checksums: bool) -> Self {
+        self.verify_checksums = verify_checksums;
+        self
+    }
+
+    /// Keep the union of the gpubox files' timesteps rather than their intersection, so that
+    /// data at the ragged start and end of an observation (or around a missing HDU) is not
+    /// dropped. Which HDUs exist is recorded in `CorrelatorContext::hdu_presence`; scans zero-fill
+    /// missing HDUs and single HDU reads of them return `GpuboxError::MissingHdu`.
+    ///
+    /// # Arguments
+    ///
+    /// * `all_timesteps` - true to keep every timestep.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated options.
+    ///
+    ///
+    pub fn with_all_timesteps(mut self, all_timesteps: bool) -> Self {
+        self.all_timesteps = all_timesteps;
+        self
+    }
+}
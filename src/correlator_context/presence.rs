@@ -0,0 +1,101 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Which (timestep, coarse channel) HDUs a `CorrelatorContext` has.
+
+By default a context only has the timesteps common to all of its gpubox files, but with
+`CorrelatorContextOptions::with_all_timesteps` it keeps every timestep any file has, so some HDUs
+are missing. The presence of each HDU is a bit, [timestep][coarse chan], built once from the time
+map when the context is created, so checking an HDU is a shift and a mask rather than two map
+lookups. Scans zero-fill missing HDUs, and readers of whole observations (datasets, uvfits,
+statistics) skip or zero them using the bitmap.
+ */
+use std::collections::BTreeMap;
+
+use crate::coarse_channel::CoarseChannel;
+use crate::timestep::TimeStep;
+
+/// A bitmap of the HDUs present for each timestep and coarse channel.
+#[derive(Clone, Debug, Default, PartialEq, Eq)]
+pub struct HduPresence {
+    /// Number of timesteps
+    pub num_timesteps: usize,
+    /// Number of coarse channels
+    pub num_coarse_chans: usize,
+    /// The bits, [timestep][coarse chan], packed into words from the least significant bit
+    bits: Vec<u64>,
+}
+
+impl HduPresence {
+    /// Build the presence bitmap of a context's timesteps and coarse channels.
+    ///
+    /// # Arguments
+    ///
+    /// * `gpubox_time_map` - the context's map of unix times to the gpubox numbers with an HDU at that time.
+    ///
+    /// * `timesteps` - the context's timesteps.
+    ///
+    /// * `coarse_chans` - the context's coarse channels.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A populated `HduPresence`.
+    ///
+    ///
+    pub(crate) fn new(
+        gpubox_time_map: &BTreeMap<u64, BTreeMap<usize, (usize, usize)>>,
+        timesteps: &[TimeStep],
+        coarse_chans: &[CoarseChannel],
+    ) -> Self {
+        let mut presence = HduPresence {
+            num_timesteps: timesteps.len(),
+            num_coarse_chans: coarse_chans.len(),
+            bits: vec![0; (timesteps.len() * coarse_chans.len() + 63) / 64],
+        };
+
+        for (timestep_index, timestep) in timesteps.iter().enumerate() {
+            if let Some(chans) = gpubox_time_map.get(&timestep.unix_time_ms) {
+                for (coarse_chan_index, coarse_chan) in coarse_chans.iter().enumerate() {
+                    if chans.contains_key(&coarse_chan.gpubox_number) {
+                        let bit = timestep_index * presence.num_coarse_chans + coarse_chan_index;
+                        presence.bits[bit / 64] |= 1 << (bit % 64);
+                    }
+                }
+            }
+        }
+
+        presence
+    }
+
+    /// Returns true if there is an HDU for a timestep and coarse channel. Indices out of range
+    /// have no HDU.
+    pub fn is_present(&self, timestep_index: usize, coarse_chan_index: usize) -> bool {
+        if timestep_index >= self.num_timesteps || coarse_chan_index >= self.num_coarse_chans {
+            return false;
+        }
+        let bit = timestep_index * self.num_coarse_chans + coarse_chan_index;
+
+        self.bits[bit / 64] >> (bit % 64) & 1 == 1
+    }
+
+    /// Returns true if a timestep has an HDU for every coarse channel.
+    pub fn is_timestep_complete(&self, timestep_index: usize) -> bool {
+        (0..self.num_coarse_chans).all(|c| self.is_present(timestep_index, c))
+    }
+
+    /// Returns the number of HDUs present.
+    pub fn get_num_present(&self) -> usize {
+        self.bits.iter().map(|w| w.count_ones() as usize).sum()
+    }
+
+    /// Returns the (timestep index, coarse chan index) of every missing HDU, in order.
+    pub fn get_missing(&self) -> Vec<(usize, usize)> {
+        (0..self.num_timesteps)
+            .flat_map(|t| (0..self.num_coarse_chans).map(move |c| (t, c)))
+            .filter(|(t, c)| !self.is_present(*t, *c))
+            .collect()
+    }
+}
@@ -93,7 +93,7 @@ fn test_read_by_frequency_invalid_inputs() {
 
     // Open a context and load in a test metafits and gpubox file
     let gpuboxfiles = vec![mwax_filename];
-    let mut context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
         .expect("Failed to create CorrelatorContext");
 
     // 99999 is invalid as a timestep for this observation
@@ -120,7 +120,7 @@ fn test_read_by_baseline_invalid_inputs() {
 
     // Open a context and load in a test metafits and gpubox file
     let gpuboxfiles = vec![mwax_filename];
-    let mut context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
         .expect("Failed to create CorrelatorContext");
 
     // 99999 is invalid as a timestep for this observation
@@ -155,7 +155,7 @@ fn test_mwa_legacy_read() {
     //
     // Open a context and load in a test metafits and gpubox file
     let gpuboxfiles = vec![mwax_filename];
-    let mut context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
         .expect("Failed to create CorrelatorContext");
 
     // Read and convert first HDU by baseline
@@ -202,7 +202,7 @@ fn test_mwax_read() {
     //
     // Open a context and load in a test metafits and gpubox file
     let gpuboxfiles = vec![mwax_filename];
-    let mut context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
         .expect("Failed to create CorrelatorContext");
 
     // Read and convert first HDU by baseline
@@ -479,3 +479,816 @@ fn test_validate_hdu_axes_naxis_mismatches_v2() {
         }
     ));
 }
+
+#[test]
+fn test_read_into_buffer_and_pooled() {
+    // Reads into a caller buffer and into a pooled buffer should give the same
+    // data as the allocating reads, for both legacy and mwax.
+    let inputs = vec![
+        (
+            "test_files/1101503312_1_timestep/1101503312.metafits",
+            "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits",
+        ),
+        (
+            "test_files/1244973688_1_timestep/1244973688.metafits",
+            "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits",
+        ),
+    ];
+
+    for (metafits_filename, gpubox_filename) in inputs {
+        let gpuboxfiles = vec![gpubox_filename];
+        let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+            .expect("Failed to create CorrelatorContext");
+
+        let data_by_bl = context.read_by_baseline(0, 0).expect("Error!");
+        let data_by_freq = context.read_by_frequency(0, 0).expect("Error!");
+
+        // Into a caller supplied buffer
+        let mut buffer = vec![0.; context.num_timestep_coarse_chan_floats];
+        context
+            .read_by_baseline_into_buffer(0, 0, &mut buffer)
+            .expect("Error!");
+        assert_eq!(buffer, data_by_bl);
+        context
+            .read_by_frequency_into_buffer(0, 0, &mut buffer)
+            .expect("Error!");
+        assert_eq!(buffer, data_by_freq);
+
+        // Into pooled buffers
+        {
+            let pooled_by_bl = context.read_by_baseline_pooled(0, 0).expect("Error!");
+            assert_eq!(pooled_by_bl.to_vec(), data_by_bl);
+            let pooled_by_freq = context.read_by_frequency_pooled(0, 0).expect("Error!");
+            assert_eq!(pooled_by_freq.to_vec(), data_by_freq);
+        }
+
+        // Once dropped, the buffers are back in the pool for the next read
+        assert!(
+            context
+                .buffer_pool()
+                .num_free_buffers(context.num_timestep_coarse_chan_floats)
+                >= 2
+        );
+    }
+}
+
+#[test]
+fn test_read_into_buffer_too_small() {
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+
+    let gpuboxfiles = vec![mwax_filename];
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+
+    let mut buffer = vec![0.; context.num_timestep_coarse_chan_floats - 1];
+
+    assert!(matches!(
+        context
+            .read_by_baseline_into_buffer(0, 0, &mut buffer)
+            .unwrap_err(),
+        GpuboxError::InvalidBufferSize { .. }
+    ));
+    assert!(matches!(
+        context
+            .read_by_frequency_into_buffer(0, 0, &mut buffer)
+            .unwrap_err(),
+        GpuboxError::InvalidBufferSize { .. }
+    ));
+}
+
+#[test]
+fn test_shared_buffer_pool() {
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+
+    let gpuboxfiles = vec![mwax_filename];
+    let context1 = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let mut context2 = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+
+    // Share the first context's pool with the second
+    context2.set_buffer_pool(Arc::clone(context1.buffer_pool()));
+    assert!(Arc::ptr_eq(context1.buffer_pool(), context2.buffer_pool()));
+
+    let num_floats = context1.num_timestep_coarse_chan_floats;
+    let first_ptr = {
+        let data = context1.read_by_frequency_pooled(0, 0).expect("Error!");
+        data.as_ptr()
+    };
+
+    // context2 should now reuse the buffer context1 returned to the pool
+    let data = context2.read_by_frequency_pooled(0, 0).expect("Error!");
+    assert_eq!(data.len(), num_floats);
+    assert!(data.as_ptr() == first_ptr || context2.buffer_pool().num_free_buffers(num_floats) > 0);
+}
+
+#[test]
+fn test_context_new_with_thread_pool() {
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+    let gpuboxfiles = vec![mwax_filename];
+
+    // Default context uses the global pool
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    assert!(context.thread_pool().is_none());
+    let data_global = context.read_by_frequency(0, 0).expect("Error!");
+
+    // Context with its own pool of 2 threads
+    let options = CorrelatorContextOptions::new()
+        .with_num_threads(2, &[])
+        .expect("Failed to build thread pool");
+    let context =
+        CorrelatorContext::new_with_options(&mwax_metafits_filename, &gpuboxfiles, &options)
+            .expect("Failed to create CorrelatorContext");
+    assert_eq!(context.thread_pool().unwrap().current_num_threads(), 2);
+    assert_eq!(context.install(rayon::current_num_threads), 2);
+
+    // Reads give the same result regardless of the pool
+    let data_pool = context.read_by_frequency(0, 0).expect("Error!");
+    assert_eq!(data_global, data_pool);
+
+    // A pool can be shared between contexts
+    let shared_options = CorrelatorContextOptions::new()
+        .with_thread_pool(Arc::clone(context.thread_pool().unwrap()));
+    let context2 =
+        CorrelatorContext::new_with_options(&mwax_metafits_filename, &gpuboxfiles, &shared_options)
+            .expect("Failed to create CorrelatorContext");
+    assert!(Arc::ptr_eq(
+        context.thread_pool().unwrap(),
+        context2.thread_pool().unwrap()
+    ));
+}
+
+#[test]
+fn test_read_scan_with_and_without_numa() {
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+    let gpuboxfiles = vec![mwax_filename];
+
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    assert!(context.numa_placement().is_none());
+    let data_by_bl = context.read_by_baseline(0, 0).expect("Error!");
+    let data_by_freq = context.read_by_frequency(0, 0).expect("Error!");
+
+    let scan = context.read_scan_by_baseline(0).expect("Error!");
+    assert_eq!(scan.len(), context.num_coarse_chans);
+    assert_eq!(scan[0].to_vec(), data_by_bl);
+
+    // Place the scan on a (fake) two node topology, with this coarse channel on the second node
+    let topology = NumaTopology {
+        nodes: vec![
+            NumaNode {
+                id: 0,
+                cpus: vec![0],
+            },
+            NumaNode {
+                id: 1,
+                cpus: vec![0],
+            },
+        ],
+    };
+    let numa_placement = NumaPlacement::new(topology, &[1]).expect("Failed to place");
+    let options = CorrelatorContextOptions::new().with_numa_placement(Arc::new(numa_placement));
+    let numa_context =
+        CorrelatorContext::new_with_options(&mwax_metafits_filename, &gpuboxfiles, &options)
+            .expect("Failed to create CorrelatorContext");
+    let numa = numa_context.numa_placement().unwrap();
+
+    {
+        let scan = numa_context.read_scan_by_frequency(0).expect("Error!");
+        assert_eq!(scan[0].to_vec(), data_by_freq);
+        assert!(Arc::ptr_eq(scan[0].pool(), &numa.buffer_pools[1]));
+    }
+
+    // The buffer went back to the second node's pool, not the context's own pool
+    assert!(
+        numa.buffer_pools[1].num_free_buffers(numa_context.num_timestep_coarse_chan_floats) >= 1
+    );
+    assert_eq!(
+        numa.buffer_pools[0].num_free_buffers(numa_context.num_timestep_coarse_chan_floats),
+        0
+    );
+
+    assert!(matches!(
+        numa_context.read_scan_by_baseline(1).unwrap_err(),
+        GpuboxError::InvalidTimeStepIndex(_)
+    ));
+}
+
+#[test]
+fn test_plan_shards() {
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+    let gpuboxfiles = vec![mwax_filename];
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+
+    let shards = context.plan_shards(2).expect("Failed to plan shards");
+
+    // One file, so one shard gets everything
+    assert_eq!(shards.len(), 2);
+    assert_eq!(shards[0].get_filenames(), vec![mwax_filename]);
+    assert_eq!(shards[0].files[0].channel_identifier, 114);
+    assert_eq!(
+        shards[0].get_work_units(),
+        vec![WorkUnit {
+            timestep_index: 0,
+            coarse_chan_index: 0
+        }]
+    );
+    assert_eq!(
+        shards[0].num_bytes,
+        context.num_timestep_coarse_chan_bytes as u64
+    );
+    assert!(shards[1].files.is_empty());
+
+    // A context opened on just the shard's files finds the same work units
+    let shard_context = CorrelatorContext::new(
+        &mwax_metafits_filename.to_string(),
+        &shards[0].get_filenames(),
+    )
+    .expect("Failed to create CorrelatorContext");
+    assert_eq!(
+        shard_context.get_shard_work_units(&shards[0]),
+        shards[0].get_work_units()
+    );
+    assert!(shard_context.get_shard_work_units(&shards[1]).is_empty());
+}
+
+#[test]
+fn test_plan_shards_multiple_batches() {
+    // 2 coarse channels x 2 batches, made from copies of the MWAX test file. The second batch's
+    // HDU is 1 second later.
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+    let dir = tempdir::TempDir::new("mwalib_shard_test").unwrap();
+    let mut gpuboxfiles: Vec<String> = Vec::new();
+    for channel in &[114, 115] {
+        for batch in 0..2 {
+            let filename = dir
+                .path()
+                .join(format!(
+                    "1244973688_20190619100110_ch{}_00{}.fits",
+                    channel, batch
+                ))
+                .to_str()
+                .unwrap()
+                .to_string();
+            std::fs::copy(mwax_filename, &filename).unwrap();
+            if batch == 1 {
+                let mut fptr = fitsio::FitsFile::edit(&filename).unwrap();
+                let hdu = fptr.hdu(1).unwrap();
+                let time: i64 = hdu.read_key(&mut fptr, "TIME").unwrap();
+                hdu.write_key(&mut fptr, "TIME", time + 1).unwrap();
+            }
+            gpuboxfiles.push(filename);
+        }
+    }
+    let context = CorrelatorContext::new(&mwax_metafits_filename.to_string(), &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    assert_eq!(context.gpubox_batches.len(), 2);
+    assert_eq!(context.num_timesteps, 2);
+    assert_eq!(context.num_coarse_chans, 2);
+
+    let shards = context.plan_shards(2).expect("Failed to plan shards");
+
+    // Each shard has both batches of one channel, and opens as a context of its own
+    for (shard, channel) in shards.iter().zip(&[114, 115]) {
+        assert_eq!(shard.files.len(), 2);
+        assert!(shard.files.iter().all(|f| f.channel_identifier == *channel));
+
+        let shard_context =
+            CorrelatorContext::new(&mwax_metafits_filename.to_string(), &shard.get_filenames())
+                .expect("Failed to create CorrelatorContext");
+        assert_eq!(shard_context.gpubox_batches.len(), 2);
+        assert_eq!(shard_context.num_coarse_chans, 1);
+
+        let shard_work_units = shard_context.get_shard_work_units(shard);
+        assert_eq!(shard_work_units.len(), 2);
+        for work_unit in shard_work_units {
+            shard_context
+                .read_by_baseline(work_unit.timestep_index, work_unit.coarse_chan_index)
+                .expect("Error!");
+        }
+    }
+}
+
+#[test]
+fn test_context_new_with_selection() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpubox_filename =
+        "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits";
+    let gpuboxfiles = vec![gpubox_filename];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let unix_time_ms = context.timesteps[0].unix_time_ms;
+
+    // Selecting the channel and time we have gives the same context
+    let options = CorrelatorContextOptions::new()
+        .with_gpubox_channels(&[1])
+        .with_unix_time_range_ms(unix_time_ms..unix_time_ms + 1);
+    let selected_context =
+        CorrelatorContext::new_with_options(&metafits_filename, &gpuboxfiles, &options)
+            .expect("Failed to create CorrelatorContext");
+    assert_eq!(selected_context.num_timesteps, 1);
+    assert_eq!(selected_context.num_coarse_chans, 1);
+    assert_eq!(selected_context.num_gpubox_files, 1);
+
+    // A channel we don't have
+    let options = CorrelatorContextOptions::new().with_gpubox_channels(&[2]);
+    assert!(matches!(
+        CorrelatorContext::new_with_options(&metafits_filename, &gpuboxfiles, &options)
+            .unwrap_err(),
+        MwalibError::Gpubox(GpuboxError::NoGpuboxesSelected)
+    ));
+
+    // A time range we don't have
+    let options =
+        CorrelatorContextOptions::new().with_unix_time_range_ms(unix_time_ms + 1..unix_time_ms + 2);
+    assert!(matches!(
+        CorrelatorContext::new_with_options(&metafits_filename, &gpuboxfiles, &options)
+            .unwrap_err(),
+        MwalibError::Gpubox(GpuboxError::NoTimestepsSelected)
+    ));
+}
+
+#[test]
+fn test_context_new_with_shared_metafits_context() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpubox_filename =
+        "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits";
+    let gpuboxfiles = vec![gpubox_filename];
+
+    let metafits_context = Arc::new(
+        MetafitsContext::new(&metafits_filename).expect("Failed to create MetafitsContext"),
+    );
+    let options = CorrelatorContextOptions::new();
+
+    let context1 = CorrelatorContext::new_with_metafits_context(
+        Arc::clone(&metafits_context),
+        &gpuboxfiles,
+        &options,
+    )
+    .expect("Failed to create CorrelatorContext");
+    let context2 = CorrelatorContext::new_with_metafits_context(
+        Arc::clone(&metafits_context),
+        &gpuboxfiles,
+        &options,
+    )
+    .expect("Failed to create CorrelatorContext");
+
+    // One copy of the metadata and of the conversion table
+    assert!(Arc::ptr_eq(&context1.metafits_context, &metafits_context));
+    assert!(Arc::ptr_eq(
+        &context1.metafits_context,
+        &context2.metafits_context
+    ));
+    assert!(Arc::ptr_eq(
+        &context1.legacy_conversion_table,
+        &context2.legacy_conversion_table
+    ));
+    assert_eq!(
+        context1.legacy_conversion_table.len(),
+        metafits_context.num_baselines
+    );
+
+    // Same data as a context which reads the metafits itself
+    let context3 = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    assert_eq!(context1.num_coarse_chans, context3.num_coarse_chans);
+    assert_eq!(
+        context1.coarse_chans[0].rec_chan_number,
+        context3.coarse_chans[0].rec_chan_number
+    );
+    assert_eq!(
+        context1.read_by_baseline(0, 0).expect("Error!"),
+        context3.read_by_baseline(0, 0).expect("Error!")
+    );
+}
+
+#[test]
+fn test_read_with_scan_cache() {
+    // Reads through the cache should give the same data as uncached reads, and the second
+    // context should be served entirely from the chunks the first one wrote.
+    let inputs = vec![
+        (
+            "test_files/1101503312_1_timestep/1101503312.metafits",
+            "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits",
+        ),
+        (
+            "test_files/1244973688_1_timestep/1244973688.metafits",
+            "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits",
+        ),
+    ];
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let scan_cache = Arc::new(ScanCache::open(dir.path(), 1 << 30).unwrap());
+
+    for (metafits_filename, gpubox_filename) in inputs {
+        let gpuboxfiles = vec![gpubox_filename];
+        let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+            .expect("Failed to create CorrelatorContext");
+        let data_by_bl = context.read_by_baseline(0, 0).expect("Error!");
+        let data_by_freq = context.read_by_frequency(0, 0).expect("Error!");
+        assert!(matches!(
+            context.read_by_baseline_cached(0, 0).unwrap_err(),
+            GpuboxError::NoScanCache
+        ));
+
+        let options = CorrelatorContextOptions::new().with_scan_cache(scan_cache.clone());
+        let num_chunks = scan_cache.num_chunks();
+        for _ in 0..2 {
+            let cached_context =
+                CorrelatorContext::new_with_options(&metafits_filename, &gpuboxfiles, &options)
+                    .expect("Failed to create CorrelatorContext");
+            let mut buffer = vec![0.; cached_context.num_timestep_coarse_chan_floats];
+            cached_context
+                .read_by_baseline_into_buffer(0, 0, &mut buffer)
+                .expect("Error!");
+            assert_eq!(buffer, data_by_bl);
+            assert_eq!(
+                &cached_context
+                    .read_by_frequency_cached(0, 0)
+                    .expect("Error!")[..],
+                &data_by_freq[..]
+            );
+
+            // One chunk per order, written by the first context only
+            assert_eq!(scan_cache.num_chunks(), num_chunks + 2);
+        }
+    }
+}
+
+#[test]
+fn test_read_rows_with_compressed_scan_cache() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let scan_cache = Arc::new(
+        ScanCache::open(dir.path(), 1 << 30)
+            .unwrap()
+            .with_codec(ChunkCodec::ShuffleZstd),
+    );
+    let options = CorrelatorContextOptions::new().with_scan_cache(scan_cache.clone());
+    let context = CorrelatorContext::new_with_options(&metafits_filename, &gpuboxfiles, &options)
+        .expect("Failed to create CorrelatorContext");
+    let num_fine_chans = context.metafits_context.num_corr_fine_chans_per_coarse;
+    let baseline_floats = num_fine_chans * context.metafits_context.num_visibility_pols * 2;
+    let fine_chan_floats = context.num_timestep_coarse_chan_floats / num_fine_chans;
+
+    let mut data_by_bl = vec![0.; context.num_timestep_coarse_chan_floats];
+    context
+        .read_by_baseline_into_buffer(0, 0, &mut data_by_bl)
+        .expect("Error!");
+    let mut data_by_freq = vec![0.; context.num_timestep_coarse_chan_floats];
+    context
+        .read_by_frequency_into_buffer(0, 0, &mut data_by_freq)
+        .expect("Error!");
+    assert_eq!(scan_cache.num_chunks(), 2);
+    assert!(scan_cache.num_bytes() < 2 * context.num_timestep_coarse_chan_bytes as u64);
+
+    // Served from the compressed chunks
+    let mut baselines = vec![0.; 3 * baseline_floats];
+    context
+        .read_by_baseline_rows_into_buffer(0, 0, 10..13, &mut baselines)
+        .expect("Error!");
+    assert_eq!(
+        baselines,
+        &data_by_bl[10 * baseline_floats..13 * baseline_floats]
+    );
+    let mut fine_chans = vec![0.; 2 * fine_chan_floats];
+    context
+        .read_by_frequency_rows_into_buffer(0, 0, 5..7, &mut fine_chans)
+        .expect("Error!");
+    assert_eq!(
+        fine_chans,
+        &data_by_freq[5 * fine_chan_floats..7 * fine_chan_floats]
+    );
+
+    assert!(matches!(
+        context
+            .read_by_frequency_rows_into_buffer(0, 0, 0..num_fine_chans + 1, &mut fine_chans)
+            .unwrap_err(),
+        GpuboxError::InvalidRowRange { .. }
+    ));
+}
+
+#[test]
+fn test_verify_checksums() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let options = CorrelatorContextOptions::new().with_checksum_verification(true);
+    let context = CorrelatorContext::new_with_options(&metafits_filename, &gpuboxfiles, &options)
+        .expect("Failed to create CorrelatorContext");
+
+    // The test files have no checksums, so the context is created and nothing is verified
+    let data = context.read_by_baseline(0, 0).expect("Error!");
+    assert_eq!(data.len(), context.num_timestep_coarse_chan_floats);
+    let summary = context.verify_checksums().expect("Error!");
+    assert_eq!(summary.num_files, 2);
+    assert!(summary.num_hdus > 2);
+    assert_eq!(summary.num_hdus_verified, 0);
+}
+
+#[test]
+fn test_read_remapped() {
+    // For legacy (the remap composed with the conversion table) and MWAX, a remapped read matches
+    // remapping the converted data
+    let observations = [
+        (
+            "test_files/1101503312_1_timestep/1101503312.metafits",
+            "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits",
+        ),
+        (
+            "test_files/1244973688_1_timestep/1244973688.metafits",
+            "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits",
+        ),
+    ];
+    for (metafits_filename, gpubox_filename) in observations.iter() {
+        let context = CorrelatorContext::new(metafits_filename, &[gpubox_filename])
+            .expect("Failed to create CorrelatorContext");
+        let num_fine_chans = context.metafits_context.num_corr_fine_chans_per_coarse;
+        let data_by_bl = context.read_by_baseline(0, 0).unwrap();
+
+        // A reversed subarray, so most baselines are swapped
+        let antenna_indices: Vec<usize> = (0..context.metafits_context.num_ants)
+            .rev()
+            .step_by(3)
+            .collect();
+        let remap = context.get_antenna_remap(&antenna_indices).unwrap();
+        let mwax_remap = AntennaRemap::new(
+            antenna_indices,
+            context.metafits_context.num_ants,
+            VisibilityConvention::default(),
+            None,
+        )
+        .unwrap();
+        let mut expected = vec![0.; remap.num_baselines() * num_fine_chans * 8];
+        baseline::remap_mwax_hdu_to_baseline_order(
+            &mwax_remap,
+            &data_by_bl,
+            &mut expected,
+            num_fine_chans,
+        );
+
+        let mut by_bl = vec![0.; expected.len()];
+        context
+            .read_by_baseline_remapped_into_buffer(0, 0, &remap, &mut by_bl)
+            .unwrap();
+        assert_eq!(by_bl, expected);
+
+        let mut by_freq = vec![0.; expected.len()];
+        context
+            .read_by_frequency_remapped_into_buffer(0, 0, &remap, &mut by_freq)
+            .unwrap();
+        let mut expected_by_freq = vec![0.; expected.len()];
+        baseline::remap_mwax_hdu_to_frequency_order(
+            &mwax_remap,
+            &data_by_bl,
+            &mut expected_by_freq,
+            num_fine_chans,
+        );
+        assert_eq!(by_freq, expected_by_freq);
+
+        // Too small a buffer
+        assert!(matches!(
+            context.read_by_baseline_remapped_into_buffer(0, 0, &remap, &mut by_bl[1..]),
+            Err(GpuboxError::InvalidBufferSize { .. })
+        ));
+    }
+}
+
+#[test]
+fn test_get_antenna_remap() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let antennas = &context.metafits_context.antennas;
+
+    let remap = context.get_antenna_remap_by_tile_id().unwrap();
+    assert_eq!(
+        remap.num_baselines(),
+        context.metafits_context.num_baselines
+    );
+    assert!(remap
+        .antenna_indices
+        .windows(2)
+        .all(|w| antennas[w[0]].tile_id < antennas[w[1]].tile_id));
+
+    let tile_names = [&antennas[5].tile_name, &antennas[2].tile_name];
+    let remap = context
+        .get_antenna_remap_by_tile_names(&tile_names)
+        .unwrap();
+    assert_eq!(remap.antenna_indices, vec![5, 2]);
+    assert_eq!(remap.num_baselines(), 3);
+    assert!(remap.baselines[1].swapped);
+
+    assert!(matches!(
+        context.get_antenna_remap_by_tile_names(&["NotATile"]),
+        Err(BaselineError::UnknownTileName(_))
+    ));
+
+    // A remap of another observation's antennas is rejected
+    let other = AntennaRemap::new(vec![0, 1], 4, VisibilityConvention::default(), None).unwrap();
+    assert!(matches!(
+        context.read_by_baseline_remapped_into_buffer(0, 0, &other, &mut [0.; 3 * 128 * 8]),
+        Err(GpuboxError::AntennaRemapMismatch { .. })
+    ));
+}
+
+#[test]
+fn test_read_remapped_with_convention() {
+    // Reading the whole lower triangle, conjugated, gives each visibility V_ab of the standard
+    // read as V_ba: for crosses only xy and yx are exchanged, and autos are conjugated
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let num_fine_chans = context.metafits_context.num_corr_fine_chans_per_coarse;
+    let data_by_bl = context.read_by_baseline(0, 0).unwrap();
+
+    let convention = VisibilityConvention {
+        conjugation: ConjugationConvention::Conjugated,
+        triangle: BaselineTriangle::Lower,
+    };
+    let antenna_indices: Vec<usize> = (0..context.metafits_context.num_ants).collect();
+    let remap = context
+        .get_antenna_remap_with_convention(&antenna_indices, convention)
+        .unwrap();
+    assert_eq!(
+        remap.num_baselines(),
+        context.metafits_context.num_baselines
+    );
+
+    let mut by_bl = vec![0.; context.num_timestep_coarse_chan_floats];
+    context
+        .read_by_baseline_remapped_into_buffer(0, 0, &remap, &mut by_bl)
+        .unwrap();
+    let floats_per_baseline = num_fine_chans * 8;
+    for (output, baseline) in by_bl
+        .chunks_exact(floats_per_baseline)
+        .zip(remap.baselines.iter())
+    {
+        assert!(baseline.ant1_index >= baseline.ant2_index);
+        let source_index = baseline.source_baseline_index * floats_per_baseline;
+        let input = &data_by_bl[source_index..source_index + floats_per_baseline];
+        for (o, i) in output.chunks_exact(8).zip(input.chunks_exact(8)) {
+            if baseline.ant1_index == baseline.ant2_index {
+                assert_eq!(o, [i[0], -i[1], i[2], -i[3], i[4], -i[5], i[6], -i[7]]);
+            } else {
+                assert_eq!(o, [i[0], i[1], i[4], i[5], i[2], i[3], i[6], i[7]]);
+            }
+        }
+    }
+}
+
+#[test]
+fn test_hdu_presence() {
+    // gpubox 1 has all 3 times, gpubox 2 the first 2, gpubox 3 only the last
+    let mut gpubox_time_map = BTreeMap::new();
+    for (i, gpubox_numbers) in [vec![1, 2], vec![1, 2], vec![1, 3]].iter().enumerate() {
+        let mut new_time_tree = BTreeMap::new();
+        for gpubox_number in gpubox_numbers {
+            new_time_tree.insert(*gpubox_number, (0, i + 1));
+        }
+        gpubox_time_map.insert(1_381_844_923_000 + 500 * i as u64, new_time_tree);
+    }
+    let timesteps: Vec<TimeStep> = (0..3)
+        .map(|i| TimeStep {
+            unix_time_ms: 1_381_844_923_000 + 500 * i,
+            gps_time_ms: 1_065_880_139_000 + 500 * i,
+        })
+        .collect();
+    let coarse_chans: Vec<CoarseChannel> = (1..=3)
+        .map(|n| CoarseChannel::new(n - 1, 108 + n, n, 1_280_000))
+        .collect();
+
+    let presence = HduPresence::new(&gpubox_time_map, &timesteps, &coarse_chans);
+    assert_eq!(presence.num_timesteps, 3);
+    assert_eq!(presence.num_coarse_chans, 3);
+    assert_eq!(presence.get_num_present(), 6);
+    assert_eq!(presence.get_missing(), vec![(0, 2), (1, 2), (2, 1)]);
+    assert!(presence.is_present(0, 0));
+    assert!(presence.is_present(2, 2));
+    assert!(!presence.is_present(2, 1));
+    assert!(!presence.is_timestep_complete(0));
+    // Out of range
+    assert!(!presence.is_present(3, 0));
+    assert!(!presence.is_present(0, 3));
+
+    // A timestep the time map doesn't have at all
+    let mut timesteps = timesteps;
+    timesteps.push(TimeStep {
+        unix_time_ms: 1_381_844_924_500,
+        gps_time_ms: 1_065_880_140_500,
+    });
+    let presence = HduPresence::new(&gpubox_time_map, &timesteps, &coarse_chans[..1]);
+    assert!(presence.is_timestep_complete(2));
+    assert!(!presence.is_timestep_complete(3));
+    assert_eq!(presence.get_missing(), vec![(3, 0)]);
+}
+
+#[test]
+fn test_read_missing_hdu() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpubox_filename =
+        "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits";
+    let gpuboxfiles = vec![gpubox_filename];
+    let options = CorrelatorContextOptions::new().with_all_timesteps(true);
+    let mut context =
+        CorrelatorContext::new_with_options(&metafits_filename, &gpuboxfiles, &options)
+            .expect("Failed to create CorrelatorContext");
+    assert_eq!(context.num_timesteps, 1);
+    assert!(context.hdu_presence.get_missing().is_empty());
+
+    // Give the context a second timestep which no gpubox file has
+    let last = context.timesteps[0].clone();
+    context.timesteps.push(TimeStep {
+        unix_time_ms: last.unix_time_ms + context.metafits_context.corr_int_time_ms,
+        gps_time_ms: last.gps_time_ms + context.metafits_context.corr_int_time_ms,
+    });
+    context.num_timesteps = context.timesteps.len();
+    context.hdu_presence = HduPresence::new(
+        &context.gpubox_time_map,
+        &context.timesteps,
+        &context.coarse_chans,
+    );
+    assert_eq!(context.hdu_presence.get_missing(), vec![(1, 0)]);
+
+    // Single HDU reads are an error rather than a panic
+    assert!(matches!(
+        context.read_by_baseline(1, 0),
+        Err(GpuboxError::MissingHdu {
+            timestep_index: 1,
+            coarse_chan_index: 0
+        })
+    ));
+
+    // Scans zero-fill, even into a buffer the pool has reused
+    let scan = context.read_scan_by_baseline(0).expect("Error!");
+    assert!(scan[0].iter().any(|x| *x != 0.));
+    drop(scan);
+    let scan = context.read_scan_by_baseline(1).expect("Error!");
+    assert_eq!(scan.len(), 1);
+    assert_eq!(scan[0].len(), context.num_timestep_coarse_chan_floats);
+    assert!(scan[0].iter().all(|x| *x == 0.));
+
+    // Only work units with an HDU are handed out, and pipelines only read those by default
+    let work_units = vec![WorkUnit {
+        timestep_index: 0,
+        coarse_chan_index: 0,
+    }];
+    assert_eq!(context.get_work_units(), work_units);
+    let num_blocks = crate::pipeline::Pipeline::new(&context)
+        .run(|_| -> Result<(), GpuboxError> { Ok(()) })
+        .expect("Error!")
+        .len();
+    assert_eq!(num_blocks, 1);
+
+    // Lag spectra treat the missing HDU as a gap of zeros
+    let lags = crate::lag_transform::get_lag_spectra(
+        &context,
+        1,
+        &[0],
+        crate::lag_transform::LagWindow::Rectangular,
+    )
+    .expect("Error!");
+    assert!(lags.data.iter().all(|x| *x == 0.));
+}
+
+#[test]
+fn test_read_missing_gpubox_file() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let mut context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+
+    // The HDU is indexed, but its file has gone from the batch
+    context.gpubox_batches[0].gpubox_files.clear();
+    assert!(matches!(
+        context.read_by_baseline(0, 0),
+        Err(GpuboxError::NoDataForTimeStepCoarseChannel {
+            timestep_index: 0,
+            coarse_chan_index: 0
+        })
+    ));
+
+    // As is the batch itself
+    context.gpubox_batches.clear();
+    assert!(matches!(
+        context.read_by_frequency(0, 0),
+        Err(GpuboxError::NoDataForTimeStepCoarseChannel {
+            timestep_index: 0,
+            coarse_chan_index: 0
+        })
+    ));
+}
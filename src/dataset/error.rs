@@ -0,0 +1,66 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with writing and reading chunked visibility datasets.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum DatasetError {
+    /// Error when a chunk dimension is zero.
+    #[error("Invalid chunk shape {chunk_shape:?}: every dimension must be at least 1")]
+    InvalidChunkShape { chunk_shape: [usize; 5] },
+
+    /// Error when the output directory already holds a dataset and overwriting was not asked for.
+    #[error("A dataset already exists in {0}")]
+    OutputExists(String),
+
+    /// Error when a dataset's metadata is missing a field, or is for another data type or byte order.
+    #[error("Invalid dataset metadata in {filename}: {reason}")]
+    InvalidMetadata {
+        filename: String,
+        reason: &'static str,
+    },
+
+    /// Error when a dataset's metadata cannot be written as, or read from, JSON.
+    #[error("Could not write or parse dataset metadata {filename}: {source}")]
+    Json {
+        filename: String,
+        source: serde_json::Error,
+    },
+
+    /// Error when a range to read is outside the dataset.
+    #[error("Range {start}..{end} of dimension {dim} is outside the dataset, which has {len} elements in that dimension")]
+    InvalidRange {
+        dim: usize,
+        start: usize,
+        end: usize,
+        len: usize,
+    },
+
+    /// Error when the output buffer is not the size of the data being read.
+    #[error("Invalid buffer size provided. The buffer holds {buffer_len} floats but {expected_len} are being read")]
+    InvalidBufferSize {
+        buffer_len: usize,
+        expected_len: usize,
+    },
+
+    /// Error when a chunk file is not the size of a chunk.
+    #[error("Chunk file {filename} is {num_bytes} bytes, but chunks are {expected_bytes} bytes")]
+    InvalidChunkFile {
+        filename: String,
+        num_bytes: usize,
+        expected_bytes: usize,
+    },
+
+    /// An IO error writing or reading the dataset.
+    #[error("Dataset IO error: {0}")]
+    Io(#[from] std::io::Error),
+
+    /// An error derived from `GpuboxError`, from reading the visibilities.
+    #[error("{0}")]
+    Gpubox(#[from] crate::gpubox_files::error::GpuboxError),
+}
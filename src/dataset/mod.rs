@@ -0,0 +1,726 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+A chunked, uncompressed on-disk copy of a `CorrelatorContext`'s visibilities, for repeated analysis.
+
+A dataset is a directory laid out as a Zarr (v2) array, so it can also be opened with Zarr readers:
+
+* `.zarray` - the array metadata: shape [time][coarse_chan][fine_chan][baseline][pol], chunk
+  shape, and data type (complex64 in the writing machine's byte order, with no compression).
+* `.zattrs` - the dimension names and the observation's times, channels, polarisations and baselines.
+* `t.c.f.b.p` - one file per chunk, named by its index in each dimension. Every chunk file holds a
+  whole chunk in C order, with the parts beyond the edges of the array zeroed.
+
+Each scan (all coarse channels of a timestep) is read once, and its part of every chunk it covers
+is written in parallel, so only one scan is held in memory at a time. Timesteps and coarse
+channels with no data are written as zeros.
+
+`Dataset` reads any hyper-rectangle of the array by memory mapping only the chunks it touches.
+ */
+pub mod error;
+pub use error::DatasetError;
+
+use std::fs::{self, File};
+use std::ops::{Deref, Range};
+use std::os::unix::fs::FileExt;
+use std::path::{Path, PathBuf};
+use std::{fmt, mem};
+
+use rayon::prelude::*;
+use serde::{Deserialize, Serialize};
+
+use crate::correlator_context::CorrelatorContext;
+use crate::misc::{as_u8_slice, MappedFile};
+
+#[cfg(test)]
+mod test;
+
+/// Names of the dataset's dimensions, in order
+pub const DATASET_DIMENSIONS: [&str; 5] = ["time", "coarse_chan", "fine_chan", "baseline", "pol"];
+/// Name of the file holding the array metadata
+const ZARRAY_FILENAME: &str = ".zarray";
+/// Name of the file holding the observation metadata
+const ZATTRS_FILENAME: &str = ".zattrs";
+
+/// The Zarr (v2) array metadata in `.zarray`. Fields this crate does not use are ignored when
+/// reading, so metadata from other writers can be read.
+#[derive(Clone, Debug, PartialEq, Serialize, Deserialize)]
+struct ZArray {
+    zarr_format: u32,
+    shape: Vec<usize>,
+    chunks: Vec<usize>,
+    dtype: String,
+    /// Compressor configuration; null for uncompressed chunks
+    compressor: Option<serde_json::Value>,
+    fill_value: Option<serde_json::Value>,
+    filters: Option<Vec<serde_json::Value>>,
+    order: String,
+    /// Separator of chunk indices in chunk filenames; "." if not given
+    #[serde(default = "get_default_dimension_separator")]
+    dimension_separator: String,
+}
+
+fn get_default_dimension_separator() -> String {
+    ".".to_string()
+}
+
+/// The observation metadata in a dataset's `.zattrs`.
+#[derive(Clone, Debug, Default, PartialEq, Serialize, Deserialize)]
+pub struct ZAttrs {
+    /// Names of the array's dimensions, read by xarray
+    #[serde(rename = "_ARRAY_DIMENSIONS")]
+    pub array_dimensions: Vec<String>,
+    /// Observation id
+    pub obs_id: u32,
+    /// UNIX time of the start of each timestep, in milliseconds
+    pub unix_time_ms: Vec<u64>,
+    /// Correlator integration time, in milliseconds
+    pub int_time_ms: u64,
+    /// Receiver channel number of each coarse channel
+    pub rec_chan_numbers: Vec<usize>,
+    /// Correlator fine channel width, in Hz
+    pub fine_chan_width_hz: u32,
+    /// Name of each visibility pol
+    pub pols: Vec<String>,
+    /// Antenna indices of each baseline
+    pub baseline_antennas: Vec<[usize; 2]>,
+}
+
+impl ZAttrs {
+    /// The observation metadata of a context.
+    fn new(context: &CorrelatorContext) -> Self {
+        let metafits_context = &context.metafits_context;
+        ZAttrs {
+            array_dimensions: DATASET_DIMENSIONS.iter().map(|d| d.to_string()).collect(),
+            obs_id: metafits_context.obs_id,
+            unix_time_ms: context.timesteps.iter().map(|t| t.unix_time_ms).collect(),
+            int_time_ms: metafits_context.corr_int_time_ms,
+            rec_chan_numbers: context
+                .coarse_chans
+                .iter()
+                .map(|c| c.rec_chan_number)
+                .collect(),
+            fine_chan_width_hz: metafits_context.corr_fine_chan_width_hz,
+            pols: metafits_context
+                .visibility_pols
+                .iter()
+                .map(|p| p.polarisation.clone())
+                .collect(),
+            baseline_antennas: metafits_context
+                .baselines
+                .iter()
+                .map(|b| [b.ant1_index, b.ant2_index])
+                .collect(),
+        }
+    }
+}
+
+/// Write metadata as JSON, as Zarr readers expect.
+fn write_json<T: Serialize>(path: &Path, value: &T) -> Result<(), DatasetError> {
+    let mut json = serde_json::to_string_pretty(value).map_err(|source| DatasetError::Json {
+        filename: path.display().to_string(),
+        source,
+    })?;
+    json.push('\n');
+    fs::write(path, json)?;
+
+    Ok(())
+}
+
+/// Read metadata written as JSON.
+fn read_json<T: for<'de> Deserialize<'de>>(path: &Path) -> Result<T, DatasetError> {
+    let json = fs::read_to_string(path)?;
+    serde_json::from_str(&json).map_err(|source| DatasetError::Json {
+        filename: path.display().to_string(),
+        source,
+    })
+}
+
+/// The Zarr data type of complex64 in this machine's byte order
+fn get_dtype() -> &'static str {
+    if cfg!(target_endian = "little") {
+        "<c8"
+    } else {
+        ">c8"
+    }
+}
+
+/// Options for `write_dataset`.
+#[derive(Clone, Debug)]
+pub struct DatasetWriterOptions {
+    /// Size of each chunk in [time][coarse_chan][fine_chan][baseline][pol]. Sizes larger than the
+    /// array are reduced to the array's size.
+    pub chunk_shape: [usize; 5],
+    /// Replace a dataset already in the output directory, rather than failing.
+    pub overwrite: bool,
+}
+
+impl Default for DatasetWriterOptions {
+    /// One chunk per timestep and coarse channel, like a gpubox HDU
+    fn default() -> Self {
+        DatasetWriterOptions {
+            chunk_shape: [1, 1, usize::MAX, usize::MAX, usize::MAX],
+            overwrite: false,
+        }
+    }
+}
+
+/// Write a `CorrelatorContext`'s visibilities to a chunked dataset. See the module documentation.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to write. All of its timesteps and coarse channels are written.
+///
+/// * `dir` - directory to write the dataset into. Created if it does not exist.
+///
+/// * `options` - see `DatasetWriterOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing the written `Dataset`, open for reading, or a `DatasetError`.
+///
+///
+pub fn write_dataset<P: AsRef<Path>>(
+    context: &CorrelatorContext,
+    dir: P,
+    options: &DatasetWriterOptions,
+) -> Result<Dataset, DatasetError> {
+    let dir = dir.as_ref();
+    let metafits_context = &context.metafits_context;
+    let shape = [
+        context.num_timesteps,
+        context.num_coarse_chans,
+        metafits_context.num_corr_fine_chans_per_coarse,
+        metafits_context.num_baselines,
+        metafits_context.num_visibility_pols,
+    ];
+    let chunk_shape = get_clamped_chunk_shape(&shape, &options.chunk_shape)?;
+
+    create_dataset_dir(
+        dir,
+        &shape,
+        &chunk_shape,
+        &ZAttrs::new(context),
+        options.overwrite,
+    )?;
+
+    for timestep_index in 0..context.num_timesteps {
+        // Scans zero-fill the coarse channels with no HDU; leave those out of the dataset
+        let scan = context.read_scan_by_frequency(timestep_index)?;
+        let blocks: Vec<Option<&[f32]>> = scan
+            .iter()
+            .enumerate()
+            .map(|(coarse_chan_index, block)| {
+                match context.has_hdu(timestep_index, coarse_chan_index) {
+                    true => Some(&block[..]),
+                    false => None,
+                }
+            })
+            .collect();
+        context.install(|| {
+            write_timestep_chunks(dir, &shape, &chunk_shape, timestep_index, &blocks)
+        })?;
+    }
+
+    Dataset::open(dir)
+}
+
+/// Check a chunk shape and reduce it to fit the array.
+fn get_clamped_chunk_shape(
+    shape: &[usize; 5],
+    chunk_shape: &[usize; 5],
+) -> Result<[usize; 5], DatasetError> {
+    if chunk_shape.contains(&0) {
+        return Err(DatasetError::InvalidChunkShape {
+            chunk_shape: *chunk_shape,
+        });
+    }
+    let mut clamped = *chunk_shape;
+    for (chunk_len, len) in clamped.iter_mut().zip(shape) {
+        *chunk_len = (*chunk_len).min((*len).max(1));
+    }
+
+    Ok(clamped)
+}
+
+/// Number of chunks along each dimension
+pub(crate) fn get_num_chunks(shape: &[usize; 5], chunk_shape: &[usize; 5]) -> [usize; 5] {
+    let mut num_chunks = [0; 5];
+    for dim in 0..5 {
+        num_chunks[dim] = (shape[dim] + chunk_shape[dim] - 1) / chunk_shape[dim];
+    }
+    num_chunks
+}
+
+/// The elements of a dimension in a chunk, not including padding beyond the array's edge
+fn get_chunk_range(
+    shape: &[usize; 5],
+    chunk_shape: &[usize; 5],
+    dim: usize,
+    chunk_index: usize,
+) -> Range<usize> {
+    let start = chunk_index * chunk_shape[dim];
+    start..(start + chunk_shape[dim]).min(shape[dim])
+}
+
+/// Name of a chunk's file
+pub(crate) fn get_chunk_filename(chunk_index: &[usize; 5]) -> String {
+    chunk_index
+        .iter()
+        .map(|i| i.to_string())
+        .collect::<Vec<_>>()
+        .join(".")
+}
+
+/// Every combination of indices in the given ranges, last dimension fastest
+fn get_index_product(ranges: &[Range<usize>; 5]) -> Vec<[usize; 5]> {
+    let mut indices = vec![[0; 5]];
+    for (dim, range) in ranges.iter().enumerate() {
+        indices = indices
+            .into_iter()
+            .flat_map(|index| {
+                range.clone().map(move |i| {
+                    let mut index = index;
+                    index[dim] = i;
+                    index
+                })
+            })
+            .collect();
+    }
+    indices
+}
+
+/// Create (or replace) a dataset directory and write its metadata.
+///
+/// # Arguments
+///
+/// * `dir` - the dataset directory.
+///
+/// * `shape` - shape of the array.
+///
+/// * `chunk_shape` - shape of each chunk.
+///
+/// * `zattrs` - the observation metadata, written to `.zattrs`.
+///
+/// * `overwrite` - replace an existing dataset in `dir`.
+///
+///
+/// # Returns
+///
+/// * Result containing nothing if Ok, or a `DatasetError`.
+///
+///
+fn create_dataset_dir(
+    dir: &Path,
+    shape: &[usize; 5],
+    chunk_shape: &[usize; 5],
+    zattrs: &ZAttrs,
+    overwrite: bool,
+) -> Result<(), DatasetError> {
+    // Only ever remove a directory which holds a dataset
+    if dir.join(ZARRAY_FILENAME).exists() {
+        if overwrite {
+            fs::remove_dir_all(dir)?;
+        } else {
+            return Err(DatasetError::OutputExists(dir.display().to_string()));
+        }
+    }
+    fs::create_dir_all(dir)?;
+
+    let zarray = ZArray {
+        zarr_format: 2,
+        shape: shape.to_vec(),
+        chunks: chunk_shape.to_vec(),
+        dtype: get_dtype().to_string(),
+        compressor: None,
+        fill_value: None,
+        filters: None,
+        order: "C".to_string(),
+        dimension_separator: ".".to_string(),
+    };
+    write_json(&dir.join(ZARRAY_FILENAME), &zarray)?;
+    write_json(&dir.join(ZATTRS_FILENAME), zattrs)?;
+
+    Ok(())
+}
+
+/// Write one timestep's part of every chunk it is in, in parallel. The timestep's part of a chunk
+/// is contiguous in the chunk's file, so each chunk gets a single write. The first timestep of a
+/// chunk creates its file, at the chunk's full size and filled with zeros.
+///
+/// # Arguments
+///
+/// * `dir` - the dataset directory.
+///
+/// * `shape` - shape of the array.
+///
+/// * `chunk_shape` - shape of each chunk.
+///
+/// * `timestep_index` - which timestep to write. The timesteps of a chunk must be written in order.
+///
+/// * `blocks` - the timestep's visibilities for each coarse channel, in
+///              [fine_chan][baseline][pol][r, i] order, or `None` where there is no data.
+///
+///
+/// # Returns
+///
+/// * Result containing nothing if Ok, or a `DatasetError`.
+///
+///
+pub(crate) fn write_timestep_chunks(
+    dir: &Path,
+    shape: &[usize; 5],
+    chunk_shape: &[usize; 5],
+    timestep_index: usize,
+    blocks: &[Option<&[f32]>],
+) -> Result<(), DatasetError> {
+    let num_chunks = get_num_chunks(shape, chunk_shape);
+    // Floats of one timestep in a chunk
+    let slab_floats: usize = chunk_shape[1..].iter().product::<usize>() * 2;
+    let chunk_bytes = (chunk_shape[0] * slab_floats * mem::size_of::<f32>()) as u64;
+    let [_, _, _, num_baselines, num_pols] = *shape;
+    let time_chunk_index = timestep_index / chunk_shape[0];
+    let slab_index = timestep_index % chunk_shape[0];
+
+    get_index_product(&[
+        time_chunk_index..time_chunk_index + 1,
+        0..num_chunks[1],
+        0..num_chunks[2],
+        0..num_chunks[3],
+        0..num_chunks[4],
+    ])
+    .into_par_iter()
+    .try_for_each(|chunk_index| {
+        let ranges: Vec<Range<usize>> = (0..5)
+            .map(|dim| get_chunk_range(shape, chunk_shape, dim, chunk_index[dim]))
+            .collect();
+        let starts: Vec<usize> = ranges.iter().map(|r| r.start).collect();
+        let pol_floats = ranges[4].len() * 2;
+
+        let mut slab = vec![0.; slab_floats];
+        for coarse_chan_index in ranges[1].clone() {
+            let block = match blocks[coarse_chan_index] {
+                Some(block) => block,
+                None => continue,
+            };
+            for fine_chan_index in ranges[2].clone() {
+                for baseline_index in ranges[3].clone() {
+                    let src = ((fine_chan_index * num_baselines + baseline_index) * num_pols
+                        + starts[4])
+                        * 2;
+                    let dst = (((coarse_chan_index - starts[1]) * chunk_shape[2]
+                        + fine_chan_index
+                        - starts[2])
+                        * chunk_shape[3]
+                        + baseline_index
+                        - starts[3])
+                        * chunk_shape[4]
+                        * 2;
+                    slab[dst..dst + pol_floats].copy_from_slice(&block[src..src + pol_floats]);
+                }
+            }
+        }
+
+        let path = dir.join(get_chunk_filename(&chunk_index));
+        let file = match slab_index {
+            0 => {
+                let file = File::create(&path)?;
+                file.set_len(chunk_bytes)?;
+                file
+            }
+            _ => fs::OpenOptions::new().write(true).open(&path)?,
+        };
+        let slab_bytes = as_u8_slice(&slab);
+        file.write_all_at(slab_bytes, (slab_index * slab_bytes.len()) as u64)
+    })?;
+
+    Ok(())
+}
+
+/// A chunked visibility dataset, open for reading. See the module documentation.
+#[derive(Clone, Debug)]
+pub struct Dataset {
+    dir: PathBuf,
+    shape: [usize; 5],
+    chunk_shape: [usize; 5],
+}
+
+impl Dataset {
+    /// Open a dataset written by `write_dataset`.
+    ///
+    /// # Arguments
+    ///
+    /// * `dir` - the dataset directory.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `Dataset`, or a `DatasetError` if its metadata is missing or is not
+    ///   for uncompressed complex64 data in this machine's byte order.
+    ///
+    ///
+    pub fn open<P: AsRef<Path>>(dir: P) -> Result<Self, DatasetError> {
+        let dir = dir.as_ref().to_path_buf();
+        let zarray_path = dir.join(ZARRAY_FILENAME);
+        let zarray: ZArray = read_json(&zarray_path)?;
+        let invalid = |reason: &'static str| DatasetError::InvalidMetadata {
+            filename: zarray_path.display().to_string(),
+            reason,
+        };
+
+        let get_dims = |values: &[usize]| -> Option<[usize; 5]> {
+            let mut dims = [0; 5];
+            if values.len() != dims.len() {
+                return None;
+            }
+            dims.copy_from_slice(values);
+            Some(dims)
+        };
+        if zarray.zarr_format != 2 {
+            return Err(invalid("not Zarr format 2"));
+        }
+        let shape = get_dims(&zarray.shape).ok_or_else(|| invalid("no 5 dimensional shape"))?;
+        let chunk_shape =
+            get_dims(&zarray.chunks).ok_or_else(|| invalid("no 5 dimensional chunk shape"))?;
+        if chunk_shape.contains(&0) {
+            return Err(invalid("a chunk dimension is zero"));
+        }
+        if zarray.dtype != get_dtype() {
+            return Err(invalid(
+                "data type is not complex64 in this machine's byte order",
+            ));
+        }
+        if zarray.compressor.is_some() || zarray.filters.map_or(false, |f| !f.is_empty()) {
+            return Err(invalid("chunks are compressed or filtered"));
+        }
+        if zarray.order != "C" {
+            return Err(invalid("chunks are not in C order"));
+        }
+        if zarray.dimension_separator != "." {
+            return Err(invalid("chunk filenames are not separated by '.'"));
+        }
+
+        Ok(Dataset {
+            dir,
+            shape,
+            chunk_shape,
+        })
+    }
+
+    /// Returns the dataset directory.
+    pub fn dir(&self) -> &Path {
+        &self.dir
+    }
+
+    /// Returns the shape of the array: [time][coarse_chan][fine_chan][baseline][pol].
+    pub fn shape(&self) -> [usize; 5] {
+        self.shape
+    }
+
+    /// Returns the shape of each chunk.
+    pub fn chunk_shape(&self) -> [usize; 5] {
+        self.chunk_shape
+    }
+
+    /// Read the observation metadata in the dataset's `.zattrs`.
+    pub fn read_attrs(&self) -> Result<ZAttrs, DatasetError> {
+        read_json(&self.dir.join(ZATTRS_FILENAME))
+    }
+
+    /// Returns the number of chunks along each dimension.
+    pub fn num_chunks(&self) -> [usize; 5] {
+        get_num_chunks(&self.shape, &self.chunk_shape)
+    }
+
+    /// Map one chunk's file into memory.
+    ///
+    /// # Arguments
+    ///
+    /// * `chunk_index` - the chunk's index along each dimension.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the chunk (the whole chunk shape in C order, as [r, i] pairs), `None` if
+    ///   it has no file, or a `DatasetError`.
+    ///
+    ///
+    pub fn read_chunk(
+        &self,
+        chunk_index: &[usize; 5],
+    ) -> Result<Option<DatasetChunk>, DatasetError> {
+        let num_floats = self.chunk_shape.iter().product::<usize>() * 2;
+        DatasetChunk::open(&self.dir.join(get_chunk_filename(chunk_index)), num_floats)
+    }
+
+    /// Read any hyper-rectangle of the array.
+    ///
+    /// # Arguments
+    ///
+    /// * `ranges` - the elements to read along each dimension.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the visibilities as [r, i] pairs in C order over `ranges`, or a `DatasetError`.
+    ///
+    ///
+    pub fn read(&self, ranges: &[Range<usize>; 5]) -> Result<Vec<f32>, DatasetError> {
+        let mut buffer = vec![0.; ranges.iter().map(|r| r.len()).product::<usize>() * 2];
+        self.read_into_buffer(ranges, &mut buffer)?;
+        Ok(buffer)
+    }
+
+    /// Read any hyper-rectangle of the array into a caller supplied buffer. Only the chunks which
+    /// overlap `ranges` are mapped, and only the overlapping parts are copied.
+    ///
+    /// # Arguments
+    ///
+    /// * `ranges` - the elements to read along each dimension.
+    ///
+    /// * `buffer` - slice of exactly 2 floats per element in `ranges`.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing nothing if Ok, or a `DatasetError`.
+    ///
+    ///
+    pub fn read_into_buffer(
+        &self,
+        ranges: &[Range<usize>; 5],
+        buffer: &mut [f32],
+    ) -> Result<(), DatasetError> {
+        for (dim, range) in ranges.iter().enumerate() {
+            if range.start > range.end || range.end > self.shape[dim] {
+                return Err(DatasetError::InvalidRange {
+                    dim,
+                    start: range.start,
+                    end: range.end,
+                    len: self.shape[dim],
+                });
+            }
+        }
+        let lens: Vec<usize> = ranges.iter().map(|r| r.len()).collect();
+        let expected_len = lens.iter().product::<usize>() * 2;
+        if buffer.len() != expected_len {
+            return Err(DatasetError::InvalidBufferSize {
+                buffer_len: buffer.len(),
+                expected_len,
+            });
+        }
+        if expected_len == 0 {
+            return Ok(());
+        }
+
+        // Chunks without files are zeros
+        buffer.iter_mut().for_each(|v| *v = 0.);
+
+        let chunk_shape = &self.chunk_shape;
+        let mut chunk_ranges = [0..0, 0..0, 0..0, 0..0, 0..0];
+        for dim in 0..5 {
+            chunk_ranges[dim] =
+                ranges[dim].start / chunk_shape[dim]..(ranges[dim].end - 1) / chunk_shape[dim] + 1;
+        }
+
+        for chunk_index in get_index_product(&chunk_ranges) {
+            let chunk = match self.read_chunk(&chunk_index)? {
+                Some(chunk) => chunk,
+                None => continue,
+            };
+
+            // The part of the chunk inside `ranges`
+            let mut overlap = [0..0, 0..0, 0..0, 0..0, 0..0];
+            let mut chunk_starts = [0; 5];
+            for dim in 0..5 {
+                chunk_starts[dim] = chunk_index[dim] * chunk_shape[dim];
+                overlap[dim] = ranges[dim].start.max(chunk_starts[dim])
+                    ..ranges[dim].end.min(chunk_starts[dim] + chunk_shape[dim]);
+            }
+            let pol_floats = overlap[4].len() * 2;
+
+            for t in overlap[0].clone() {
+                for c in overlap[1].clone() {
+                    for f in overlap[2].clone() {
+                        for b in overlap[3].clone() {
+                            let src = (((((t - chunk_starts[0]) * chunk_shape[1] + c
+                                - chunk_starts[1])
+                                * chunk_shape[2]
+                                + f
+                                - chunk_starts[2])
+                                * chunk_shape[3]
+                                + b
+                                - chunk_starts[3])
+                                * chunk_shape[4]
+                                + overlap[4].start
+                                - chunk_starts[4])
+                                * 2;
+                            let dst = (((((t - ranges[0].start) * lens[1] + c - ranges[1].start)
+                                * lens[2]
+                                + f
+                                - ranges[2].start)
+                                * lens[3]
+                                + b
+                                - ranges[3].start)
+                                * lens[4]
+                                + overlap[4].start
+                                - ranges[4].start)
+                                * 2;
+                            buffer[dst..dst + pol_floats]
+                                .copy_from_slice(&chunk[src..src + pol_floats]);
+                        }
+                    }
+                }
+            }
+        }
+
+        Ok(())
+    }
+}
+
+/// A chunk file, mapped read-only into memory. Dereferences to the chunk's floats.
+pub struct DatasetChunk {
+    mapped: MappedFile,
+    num_floats: usize,
+}
+
+impl DatasetChunk {
+    /// Map a chunk file, checking it holds a whole chunk.
+    fn open(path: &Path, num_floats: usize) -> Result<Option<Self>, DatasetError> {
+        let file = match File::open(path) {
+            Ok(file) => file,
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(None),
+            Err(e) => return Err(e.into()),
+        };
+        let mapped = MappedFile::map(&file)?;
+        let expected_bytes = num_floats * mem::size_of::<f32>();
+        if mapped.len() != expected_bytes {
+            return Err(DatasetError::InvalidChunkFile {
+                filename: path.display().to_string(),
+                num_bytes: mapped.len(),
+                expected_bytes,
+            });
+        }
+
+        Ok(Some(DatasetChunk { mapped, num_floats }))
+    }
+}
+
+impl Deref for DatasetChunk {
+    type Target = [f32];
+
+    fn deref(&self) -> &[f32] {
+        self.mapped.get_floats(0, self.num_floats)
+    }
+}
+
+impl fmt::Debug for DatasetChunk {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("DatasetChunk")
+            .field("num_floats", &self.num_floats)
+            .finish()
+    }
+}
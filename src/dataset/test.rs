@@ -0,0 +1,261 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for chunked visibility datasets
+*/
+#[cfg(test)]
+use super::*;
+
+/// A value unique to each element and real/imaginary part
+fn get_value(index: &[usize; 5], ri: usize) -> f32 {
+    (((((index[0] * 10 + index[1]) * 10 + index[2]) * 10 + index[3]) * 10 + index[4]) * 2 + ri)
+        as f32
+}
+
+/// Write a synthetic dataset, leaving out the data of (timestep 1, coarse channel 0).
+fn write_test_dataset(dir: &Path, shape: &[usize; 5], chunk_shape: &[usize; 5]) {
+    let [num_timesteps, num_coarse_chans, num_fine_chans, num_baselines, num_pols] = *shape;
+    let chunk_shape = get_clamped_chunk_shape(shape, chunk_shape).unwrap();
+    create_dataset_dir(dir, shape, &chunk_shape, &ZAttrs::default(), false).unwrap();
+
+    // [t][c] blocks of [fine_chan][baseline][pol][r, i]
+    let blocks: Vec<Vec<Vec<f32>>> = (0..num_timesteps)
+        .map(|t| {
+            (0..num_coarse_chans)
+                .map(|c| {
+                    get_index_product(&[
+                        t..t + 1,
+                        c..c + 1,
+                        0..num_fine_chans,
+                        0..num_baselines,
+                        0..num_pols,
+                    ])
+                    .iter()
+                    .flat_map(|index| vec![get_value(index, 0), get_value(index, 1)])
+                    .collect()
+                })
+                .collect()
+        })
+        .collect();
+
+    for t in 0..num_timesteps {
+        let timestep_blocks: Vec<Option<&[f32]>> = (0..num_coarse_chans)
+            .map(|c| match (t, c) {
+                (1, 0) => None,
+                _ => Some(blocks[t][c].as_slice()),
+            })
+            .collect();
+        write_timestep_chunks(dir, shape, &chunk_shape, t, &timestep_blocks).unwrap();
+    }
+}
+
+/// Check a read of a dataset written by `write_test_dataset`
+fn check_read(dataset: &Dataset, ranges: &[Range<usize>; 5]) {
+    let data = dataset.read(ranges).unwrap();
+    let indices = get_index_product(ranges);
+    assert_eq!(data.len(), indices.len() * 2);
+
+    for (index, values) in indices.iter().zip(data.chunks_exact(2)) {
+        let expected = match (index[0], index[1]) {
+            (1, 0) => [0., 0.],
+            _ => [get_value(index, 0), get_value(index, 1)],
+        };
+        assert_eq!(values, &expected, "index {:?}", index);
+    }
+}
+
+#[test]
+fn test_dataset_round_trip() {
+    let shape = [3, 2, 4, 5, 4];
+    // Chunk shapes which do and do not divide the array, and which are larger than it
+    for chunk_shape in &[
+        [1, 1, 4, 5, 4],
+        [2, 1, 3, 2, 3],
+        [1, 2, 1, 5, 1],
+        [10, 10, 10, 10, 10],
+    ] {
+        let dir = tempdir::TempDir::new("mwalib_dataset_test").unwrap();
+        write_test_dataset(dir.path(), &shape, chunk_shape);
+
+        let dataset = Dataset::open(dir.path()).unwrap();
+        assert_eq!(dataset.shape(), shape);
+        let expected_chunk_shape = get_clamped_chunk_shape(&shape, chunk_shape).unwrap();
+        assert_eq!(dataset.chunk_shape(), expected_chunk_shape);
+        assert_eq!(
+            dataset.num_chunks(),
+            get_num_chunks(&shape, &expected_chunk_shape)
+        );
+
+        // Everything, single elements, and slices along each dimension
+        check_read(&dataset, &[0..3, 0..2, 0..4, 0..5, 0..4]);
+        check_read(&dataset, &[2..3, 1..2, 3..4, 4..5, 3..4]);
+        check_read(&dataset, &[0..3, 1..2, 2..3, 3..4, 0..1]);
+        check_read(&dataset, &[1..2, 0..2, 1..3, 2..5, 1..3]);
+        check_read(&dataset, &[0..2, 0..1, 0..4, 1..2, 0..4]);
+
+        // Empty ranges read nothing
+        assert!(dataset
+            .read(&[0..0, 0..2, 0..4, 0..5, 0..4])
+            .unwrap()
+            .is_empty());
+    }
+}
+
+#[test]
+fn test_dataset_chunk_files() {
+    let shape = [2, 1, 2, 3, 2];
+    let dir = tempdir::TempDir::new("mwalib_dataset_test").unwrap();
+    write_test_dataset(dir.path(), &shape, &[1, 1, 2, 2, 2]);
+    let dataset = Dataset::open(dir.path()).unwrap();
+
+    assert_eq!(get_chunk_filename(&[1, 0, 0, 1, 0]), "1.0.0.1.0");
+    assert!(dir.path().join("1.0.0.1.0").exists());
+
+    // The edge chunk holds one baseline of data, then zero padding
+    let chunk = dataset.read_chunk(&[0, 0, 0, 1, 0]).unwrap().unwrap();
+    assert_eq!(chunk.len(), 2 * 2 * 2 * 2);
+    assert_eq!(chunk[0], get_value(&[0, 0, 0, 2, 0], 0));
+    assert_eq!(&chunk[4..8], &[0.; 4]);
+
+    // A chunk with no file reads as zeros
+    fs::remove_file(dir.path().join("0.0.0.0.0")).unwrap();
+    assert!(dataset.read_chunk(&[0, 0, 0, 0, 0]).unwrap().is_none());
+    assert!(dataset
+        .read(&[0..1, 0..1, 0..2, 0..2, 0..2])
+        .unwrap()
+        .iter()
+        .all(|v| *v == 0.));
+
+    // A chunk file of the wrong size is an error
+    fs::write(dir.path().join("0.0.0.0.0"), [0u8; 12]).unwrap();
+    assert!(matches!(
+        dataset.read_chunk(&[0, 0, 0, 0, 0]),
+        Err(DatasetError::InvalidChunkFile { .. })
+    ));
+}
+
+#[test]
+fn test_dataset_errors() {
+    let shape = [2, 1, 2, 3, 2];
+    let dir = tempdir::TempDir::new("mwalib_dataset_test").unwrap();
+    write_test_dataset(dir.path(), &shape, &[1, 1, 2, 2, 2]);
+    let dataset = Dataset::open(dir.path()).unwrap();
+
+    assert!(matches!(
+        get_clamped_chunk_shape(&shape, &[1, 0, 1, 1, 1]),
+        Err(DatasetError::InvalidChunkShape { .. })
+    ));
+    assert!(matches!(
+        create_dataset_dir(
+            dir.path(),
+            &shape,
+            &[1, 1, 2, 2, 2],
+            &ZAttrs::default(),
+            false
+        ),
+        Err(DatasetError::OutputExists(_))
+    ));
+    assert!(matches!(
+        dataset.read(&[0..3, 0..1, 0..2, 0..3, 0..2]),
+        Err(DatasetError::InvalidRange { dim: 0, .. })
+    ));
+    let mut buffer = vec![0.; 3];
+    assert!(matches!(
+        dataset.read_into_buffer(&[0..1, 0..1, 0..1, 0..1, 0..1], &mut buffer),
+        Err(DatasetError::InvalidBufferSize { .. })
+    ));
+
+    // Data in the other byte order is not read
+    let zarray_path = dir.path().join(ZARRAY_FILENAME);
+    let zarray = fs::read_to_string(&zarray_path).unwrap();
+    let other_dtype = if get_dtype() == "<c8" { ">c8" } else { "<c8" };
+    fs::write(&zarray_path, zarray.replace(get_dtype(), other_dtype)).unwrap();
+    assert!(matches!(
+        Dataset::open(dir.path()),
+        Err(DatasetError::InvalidMetadata { .. })
+    ));
+
+    // As is compressed data, and metadata which is not JSON
+    fs::write(
+        &zarray_path,
+        zarray.replace(r#""compressor": null"#, r#""compressor": {"id": "zstd"}"#),
+    )
+    .unwrap();
+    assert!(matches!(
+        Dataset::open(dir.path()),
+        Err(DatasetError::InvalidMetadata { .. })
+    ));
+    fs::write(&zarray_path, &zarray[..zarray.len() / 2]).unwrap();
+    assert!(matches!(
+        Dataset::open(dir.path()),
+        Err(DatasetError::Json { .. })
+    ));
+}
+
+#[test]
+fn test_dataset_metadata_from_other_writers() {
+    let shape = [2, 1, 2, 3, 2];
+    let dir = tempdir::TempDir::new("mwalib_dataset_test").unwrap();
+    write_test_dataset(dir.path(), &shape, &[1, 1, 2, 2, 2]);
+
+    // Fields in another order, over several lines, with extra fields and no dimension_separator
+    let zarray = format!(
+        r#"{{"fill_value": 0.0, "order": "C",
+  "filters": [], "dtype": "{}", "zarr_format": 2,
+  "compressor": null, "attributes_for_someone_else": {{"shape": [1]}},
+  "chunks": [
+    1, 1, 2,
+    2, 2
+  ],
+  "shape": [2, 1, 2, 3, 2]}}"#,
+        get_dtype()
+    );
+    fs::write(dir.path().join(ZARRAY_FILENAME), zarray).unwrap();
+    let dataset = Dataset::open(dir.path()).unwrap();
+    assert_eq!(dataset.shape(), shape);
+    assert_eq!(dataset.chunk_shape(), [1, 1, 2, 2, 2]);
+
+    // Strings are escaped on the way out and back
+    let attrs = ZAttrs {
+        pols: vec!["X\"Y\\".to_string()],
+        ..Default::default()
+    };
+    write_json(&dir.path().join(ZATTRS_FILENAME), &attrs).unwrap();
+    assert_eq!(dataset.read_attrs().unwrap(), attrs);
+}
+
+#[test]
+fn test_write_dataset() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let data_by_freq = context.read_by_frequency(0, 0).expect("Error!");
+    let dir = tempdir::TempDir::new("mwalib_dataset_test").unwrap();
+
+    let options = DatasetWriterOptions {
+        chunk_shape: [1, 1, 16, 1000, 4],
+        ..Default::default()
+    };
+    let dataset = write_dataset(&context, dir.path(), &options).unwrap();
+    let shape = dataset.shape();
+    assert_eq!(shape[0], context.num_timesteps);
+    assert_eq!(shape[3], context.metafits_context.num_baselines);
+    let attrs = dataset.read_attrs().unwrap();
+    assert_eq!(attrs.obs_id, context.metafits_context.obs_id);
+    assert_eq!(attrs.unix_time_ms.len(), context.num_timesteps);
+
+    // The first timestep and coarse channel is the same as read_by_frequency
+    let data = dataset
+        .read(&[0..1, 0..1, 0..shape[2], 0..shape[3], 0..shape[4]])
+        .unwrap();
+    assert_eq!(data, data_by_freq);
+
+    assert!(matches!(
+        write_dataset(&context, dir.path(), &options),
+        Err(DatasetError::OutputExists(_))
+    ));
+}
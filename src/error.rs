@@ -29,6 +29,62 @@ pub enum MwalibError {
     #[error("{0}")]
     Voltage(#[from] crate::voltage_files::error::VoltageFileError),
 
+    /// An error derived from `ThreadPoolError`.
+    #[error("{0}")]
+    ThreadPool(#[from] crate::thread_pool::error::ThreadPoolError),
+
+    /// An error derived from `PipelineError`.
+    #[error("{0}")]
+    Pipeline(#[from] crate::pipeline::error::PipelineError),
+
+    /// An error derived from `CodecError`.
+    #[error("{0}")]
+    Codec(#[from] crate::codec::error::CodecError),
+
+    /// An error derived from `ScanCacheError`.
+    #[error("{0}")]
+    ScanCache(#[from] crate::scan_cache::error::ScanCacheError),
+
+    /// An error derived from `ShardError`.
+    #[error("{0}")]
+    Shard(#[from] crate::shard::error::ShardError),
+
+    /// An error derived from `MwaxWriterError`.
+    #[error("{0}")]
+    MwaxWriter(#[from] crate::mwax_writer::error::MwaxWriterError),
+
+    /// An error derived from `UvfitsError`.
+    #[error("{0}")]
+    Uvfits(#[from] crate::uvfits::error::UvfitsError),
+
+    /// An error derived from `DatasetError`.
+    #[error("{0}")]
+    Dataset(#[from] crate::dataset::error::DatasetError),
+
+    /// An error derived from `StatisticsError`.
+    #[error("{0}")]
+    Statistics(#[from] crate::statistics::error::StatisticsError),
+
+    /// An error derived from `FlaggingError`.
+    #[error("{0}")]
+    Flagging(#[from] crate::flagging::error::FlaggingError),
+
+    /// An error derived from `BadDataError`.
+    #[error("{0}")]
+    BadData(#[from] crate::bad_data::error::BadDataError),
+
+    /// An error derived from `LagTransformError`.
+    #[error("{0}")]
+    LagTransform(#[from] crate::lag_transform::error::LagTransformError),
+
+    /// An error derived from `BandpassError`.
+    #[error("{0}")]
+    Bandpass(#[from] crate::bandpass::error::BandpassError),
+
+    /// An error derived from `BaselineError`.
+    #[error("{0}")]
+    Baseline(#[from] crate::baseline::error::BaselineError),
+
     // An error associated with parsing a string into another type.
     #[error("{source_file}:{source_line}\nCouldn't parse {key} in {fits_filename} HDU {hdu_num}")]
     Parse {
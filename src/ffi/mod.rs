@@ -309,6 +309,96 @@ pub unsafe extern "C" fn mwalib_correlator_context_new(
     0
 }
 
+/// Create and return a pointer to an `CorrelatorContext` struct based on metafits and gpubox files,
+/// which runs its internal parallel work in its own thread pool.
+///
+/// # Arguments
+///
+/// * `metafits_filename` - pointer to char* buffer containing the full path and filename of a metafits file.
+///
+/// * `gpubox_filenames` - pointer to array of char* buffers containing the full path and filename of the gpubox FITS files.
+///
+/// * `gpubox_count` - length of the gpubox char* array.
+///
+/// * `num_threads` - number of threads in the context's thread pool.
+///
+/// * `cpu_affinity` - pointer to an array of CPU indices to pin the pool's threads to (thread i is pinned to
+///                    cpu_affinity[i % cpu_affinity_len]). May be NULL if `cpu_affinity_len` is 0.
+///
+/// * `cpu_affinity_len` - length of the `cpu_affinity` array. Pass 0 to leave threads unpinned.
+///
+/// * `out_correlator_context_ptr` - A Rust-owned populated `CorrelatorContext` pointer. Free with `mwalib_correlator_context_free`.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated `char*` buffer for any error messages.
+/// * `cpu_affinity` must point to at least `cpu_affinity_len` elements, or be NULL if `cpu_affinity_len` is 0.
+/// * Caller *must* call function `mwalib_correlator_context_free` to release the rust memory.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_correlator_context_new_with_threads(
+    metafits_filename: *const c_char,
+    gpubox_filenames: *mut *const c_char,
+    gpubox_count: size_t,
+    num_threads: size_t,
+    cpu_affinity: *const size_t,
+    cpu_affinity_len: size_t,
+    out_correlator_context_ptr: &mut *mut CorrelatorContext,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    let m = CStr::from_ptr(metafits_filename)
+        .to_str()
+        .unwrap()
+        .to_string();
+    let gpubox_slice = slice::from_raw_parts(gpubox_filenames, gpubox_count);
+    let mut gpubox_files = Vec::with_capacity(gpubox_count);
+    for g in gpubox_slice {
+        let s = CStr::from_ptr(*g).to_str().unwrap();
+        gpubox_files.push(s.to_string())
+    }
+    let cpus: &[usize] = if cpu_affinity.is_null() || cpu_affinity_len == 0 {
+        &[]
+    } else {
+        slice::from_raw_parts(cpu_affinity, cpu_affinity_len)
+    };
+    let options = match CorrelatorContextOptions::new().with_num_threads(num_threads, cpus) {
+        Ok(o) => o,
+        Err(e) => {
+            set_error_message(
+                &format!("{}", e),
+                error_message as *mut u8,
+                error_message_length,
+            );
+            // Return failure
+            return 1;
+        }
+    };
+    let context = match CorrelatorContext::new_with_options(&m, &gpubox_files, &options) {
+        Ok(c) => c,
+        Err(e) => {
+            set_error_message(
+                &format!("{}", e),
+                error_message as *mut u8,
+                error_message_length,
+            );
+            // Return failure
+            return 1;
+        }
+    };
+    *out_correlator_context_ptr = Box::into_raw(Box::new(context));
+    // Return success
+    0
+}
+
 /// Display an `CorrelatorContext` struct.
 ///
 ///
@@ -405,7 +495,7 @@ pub unsafe extern "C" fn mwalib_correlator_context_read_by_baseline(
         );
         return 1;
     } else {
-        &mut *correlator_context_ptr
+        &*correlator_context_ptr
     };
 
     // Don't do anything if the buffer pointer is null.
@@ -415,31 +505,19 @@ pub unsafe extern "C" fn mwalib_correlator_context_read_by_baseline(
 
     let output_slice = slice::from_raw_parts_mut(buffer_ptr, buffer_len);
 
-    // Read data in.
-    let data = match corr_context.read_by_baseline(timestep_index, coarse_chan_index) {
-        Ok(data) => data,
-        Err(e) => {
-            set_error_message(
-                &format!("{}", e),
-                error_message as *mut u8,
-                error_message_length,
-            );
-            return 1;
-        }
-    };
-
-    // If the data buffer is empty, then just return a null pointer.
-    if data.is_empty() {
+    // Read data directly into the buffer which was provided to us by caller.
+    // Any scratch space needed for conversion comes from the context's buffer pool.
+    if let Err(e) =
+        corr_context.read_by_baseline_into_buffer(timestep_index, coarse_chan_index, output_slice)
+    {
         set_error_message(
-            "mwalib_correlator_context_read_by_baseline() ERROR: no data was returned.",
+            &format!("{}", e),
             error_message as *mut u8,
             error_message_length,
         );
         return 1;
     }
 
-    // Populate the buffer which was provided to us by caller
-    output_slice[..data.len()].copy_from_slice(data.as_slice());
     // Return Success
     0
 }
@@ -497,7 +575,7 @@ pub unsafe extern "C" fn mwalib_correlator_context_read_by_frequency(
         );
         return 1;
     } else {
-        &mut *correlator_context_ptr
+        &*correlator_context_ptr
     };
     // Don't do anything if the buffer pointer is null.
     if buffer_ptr.is_null() {
@@ -506,31 +584,19 @@ pub unsafe extern "C" fn mwalib_correlator_context_read_by_frequency(
 
     let output_slice = slice::from_raw_parts_mut(buffer_ptr, buffer_len);
 
-    // Read data in.
-    let data = match corr_context.read_by_frequency(timestep_index, coarse_chan_index) {
-        Ok(data) => data,
-        Err(e) => {
-            set_error_message(
-                &format!("{}", e),
-                error_message as *mut u8,
-                error_message_length,
-            );
-            return 1;
-        }
-    };
-
-    // If the data buffer is empty, then just return a null pointer.
-    if data.is_empty() {
+    // Read data directly into the buffer which was provided to us by caller.
+    // Any scratch space needed for conversion comes from the context's buffer pool.
+    if let Err(e) =
+        corr_context.read_by_frequency_into_buffer(timestep_index, coarse_chan_index, output_slice)
+    {
         set_error_message(
-            "mwalib_correlator_context_read_by_frequency() ERROR: no data was returned.",
+            &format!("{}", e),
             error_message as *mut u8,
             error_message_length,
         );
         return 1;
     }
 
-    // Populate the buffer which was provided to us by caller
-    output_slice[..data.len()].copy_from_slice(data.as_slice());
     // Return Success
     0
 }
@@ -931,6 +997,9 @@ pub unsafe extern "C" fn mwalib_metafits_metadata_get(
             coarse_chan_width_hz,
             centre_freq_hz,
             metafits_filename,
+            metafits_coarse_chan_vec: _, // This is currently not provided to FFI as it is private
+            legacy_conversion_table: _,  // This is currently not provided to FFI as it is private
+            baseline_geometry: _,        // This is currently not provided to FFI as it is private
         } = metafits_context;
         MetafitsMetadata {
             obs_id: *obs_id,
@@ -1115,8 +1184,11 @@ pub unsafe extern "C" fn mwalib_correlator_metadata_get(
             duration_ms,
             num_timesteps,
             timesteps: _, // This is provided by the seperate timestep struct in FFI
+            timestep_geometry: _, // This is provided by mwalib_correlator_context_get_timestep_geometry
             num_coarse_chans,
             coarse_chans: _, // This is provided by the seperate coarse_chan struct in FFI
+            fine_chan_table: _, // This is provided by mwalib_correlator_context_get_fine_chan_table
+            hdu_presence: _, // This is provided by mwalib_correlator_context_get_hdu_presence
             bandwidth_hz,
             num_timestep_coarse_chan_bytes,
             num_timestep_coarse_chan_floats,
@@ -1124,6 +1196,10 @@ pub unsafe extern "C" fn mwalib_correlator_metadata_get(
             gpubox_batches: _, // This is currently not provided to FFI as it is private
             gpubox_time_map: _, // This is currently not provided to FFI as it is private
             legacy_conversion_table: _, // This is currently not provided to FFI as it is private
+            buffer_pool: _,    // This is currently not provided to FFI as it is private
+            thread_pool: _,    // This is currently not provided to FFI as it is private
+            numa_placement: _, // This is currently not provided to FFI as it is private
+            scan_cache: _,     // This is currently not provided to FFI as it is private
         } = context;
         CorrelatorMetadata {
             corr_version: *corr_version,
@@ -1279,6 +1355,7 @@ pub unsafe extern "C" fn mwalib_voltage_metadata_get(
             num_fine_chans_per_coarse,
             voltage_batches: _, // This is currently not provided to FFI as it is private
             voltage_time_map: _, // This is currently not provided to FFI as it is private
+            voltage_file_size: _, // This is currently not provided to FFI as it is private
         } = context;
         VoltageMetadata {
             corr_version: *corr_version,
@@ -2366,3 +2443,679 @@ pub unsafe extern "C" fn mwalib_visibility_pols_free(
     // Return success
     0
 }
+
+///
+/// C Representation of a `VisibilityStatistics` struct. Each statistic is an array of
+/// `num_baseline_stats` ([baseline][fine_chan][pol] order) or `num_timestep_stats`
+/// ([timestep][fine_chan][pol] order) elements.
+///
+#[repr(C)]
+pub struct VisibilityStatistics {
+    /// Number of timesteps
+    pub num_timesteps: usize,
+    /// Number of baselines
+    pub num_baselines: usize,
+    /// Number of fine channels, across all coarse channels
+    pub num_fine_chans: usize,
+    /// Number of visibility pols
+    pub num_pols: usize,
+    /// Length of each baseline_* array
+    pub num_baseline_stats: usize,
+    /// Number of (non-NaN) amplitudes in each statistic across timesteps
+    pub baseline_count: *mut u32,
+    /// Number of NaN visibilities in each statistic across timesteps
+    pub baseline_nan_count: *mut u32,
+    /// Mean amplitude across timesteps
+    pub baseline_mean: *mut c_float,
+    /// Population variance of the amplitudes across timesteps
+    pub baseline_variance: *mut c_float,
+    /// Minimum amplitude across timesteps
+    pub baseline_min: *mut c_float,
+    /// Maximum amplitude across timesteps
+    pub baseline_max: *mut c_float,
+    /// Length of each timestep_* array
+    pub num_timestep_stats: usize,
+    /// Number of (non-NaN) amplitudes in each statistic across baselines
+    pub timestep_count: *mut u32,
+    /// Number of NaN visibilities in each statistic across baselines
+    pub timestep_nan_count: *mut u32,
+    /// Mean amplitude across baselines
+    pub timestep_mean: *mut c_float,
+    /// Population variance of the amplitudes across baselines
+    pub timestep_variance: *mut c_float,
+    /// Minimum amplitude across baselines
+    pub timestep_min: *mut c_float,
+    /// Maximum amplitude across baselines
+    pub timestep_max: *mut c_float,
+}
+
+/// Compute visibility amplitude statistics of a `CorrelatorContext` in one pass over its data:
+/// count, NaN count, mean, variance, min and max per (baseline, fine channel, pol) across timesteps,
+/// and per (timestep, fine channel, pol) across baselines.
+///
+/// # Arguments
+///
+/// * `correlator_context_ptr` - pointer to an already populated `CorrelatorContext` object.
+///
+/// * `num_read_workers` - number of threads reading gpubox files.
+///
+/// * `num_convert_workers` - number of threads converting HDUs.
+///
+/// * `num_stats_workers` - number of threads accumulating statistics.
+///
+/// * `out_visibility_statistics_ptr` - A Rust-owned populated `VisibilityStatistics` struct. Free with `mwalib_visibility_statistics_free`.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated char* buffer for any error messages.
+/// * `correlator_context_ptr` must point to a populated `CorrelatorContext` object from the `mwalib_correlator_context_new` function.
+/// * Caller must call `mwalib_visibility_statistics_free` once finished, to free the rust memory.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_correlator_context_get_visibility_statistics(
+    correlator_context_ptr: *mut CorrelatorContext,
+    num_read_workers: size_t,
+    num_convert_workers: size_t,
+    num_stats_workers: size_t,
+    out_visibility_statistics_ptr: &mut *mut VisibilityStatistics,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    if correlator_context_ptr.is_null() {
+        set_error_message(
+            "mwalib_correlator_context_get_visibility_statistics() ERROR: null pointer for correlator_context_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    let context = &*correlator_context_ptr;
+
+    let options = StatisticsOptions {
+        num_read_workers,
+        num_convert_workers,
+        num_stats_workers,
+    };
+    let stats = match get_visibility_statistics(context, &options) {
+        Ok(s) => s,
+        Err(e) => {
+            set_error_message(
+                &format!("{}", e),
+                error_message as *mut u8,
+                error_message_length,
+            );
+            return 1;
+        }
+    };
+
+    // We explicitly break out the attributes so at compile time it will let us know
+    // if there have been new fields added to the rust struct.
+    let statistics::VisibilityStatistics {
+        num_timesteps,
+        num_baselines,
+        num_fine_chans,
+        num_pols,
+        baseline_stats,
+        timestep_stats,
+    } = stats;
+    let num_baseline_stats = baseline_stats.len();
+    let num_timestep_stats = timestep_stats.len();
+    let StatisticsArray {
+        count: baseline_count,
+        nan_count: baseline_nan_count,
+        mean: baseline_mean,
+        variance: baseline_variance,
+        min: baseline_min,
+        max: baseline_max,
+    } = baseline_stats;
+    let StatisticsArray {
+        count: timestep_count,
+        nan_count: timestep_nan_count,
+        mean: timestep_mean,
+        variance: timestep_variance,
+        min: timestep_min,
+        max: timestep_max,
+    } = timestep_stats;
+
+    let out_stats = VisibilityStatistics {
+        num_timesteps,
+        num_baselines,
+        num_fine_chans,
+        num_pols,
+        num_baseline_stats,
+        baseline_count: ffi_array_to_boxed_slice(baseline_count),
+        baseline_nan_count: ffi_array_to_boxed_slice(baseline_nan_count),
+        baseline_mean: ffi_array_to_boxed_slice(baseline_mean),
+        baseline_variance: ffi_array_to_boxed_slice(baseline_variance),
+        baseline_min: ffi_array_to_boxed_slice(baseline_min),
+        baseline_max: ffi_array_to_boxed_slice(baseline_max),
+        num_timestep_stats,
+        timestep_count: ffi_array_to_boxed_slice(timestep_count),
+        timestep_nan_count: ffi_array_to_boxed_slice(timestep_nan_count),
+        timestep_mean: ffi_array_to_boxed_slice(timestep_mean),
+        timestep_variance: ffi_array_to_boxed_slice(timestep_variance),
+        timestep_min: ffi_array_to_boxed_slice(timestep_min),
+        timestep_max: ffi_array_to_boxed_slice(timestep_max),
+    };
+
+    // Pass out the pointer to the rust owned data structure
+    *out_visibility_statistics_ptr = Box::into_raw(Box::new(out_stats));
+
+    // Return success
+    0
+}
+
+/// Free a previously-allocated `VisibilityStatistics` struct (and its arrays).
+///
+/// # Arguments
+///
+/// * `visibility_statistics_ptr` - pointer to an already populated `VisibilityStatistics` object
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * This must be called once caller is finished with the `VisibilityStatistics` object
+/// * `visibility_statistics_ptr` must point to a populated `VisibilityStatistics` object from the `mwalib_correlator_context_get_visibility_statistics` function.
+/// * `visibility_statistics_ptr` must not have already been freed.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_visibility_statistics_free(
+    visibility_statistics_ptr: *mut VisibilityStatistics,
+) -> i32 {
+    if visibility_statistics_ptr.is_null() {
+        return 0;
+    }
+    let stats = Box::from_raw(visibility_statistics_ptr);
+
+    // Free each array, which were all boxed slices of their length
+    let (num_baseline_stats, num_timestep_stats) =
+        (stats.num_baseline_stats, stats.num_timestep_stats);
+    for (ptr, len) in &[
+        (stats.baseline_count, num_baseline_stats),
+        (stats.baseline_nan_count, num_baseline_stats),
+        (stats.timestep_count, num_timestep_stats),
+        (stats.timestep_nan_count, num_timestep_stats),
+    ] {
+        drop(Box::from_raw(slice::from_raw_parts_mut(*ptr, *len)));
+    }
+    for (ptr, len) in &[
+        (stats.baseline_mean, num_baseline_stats),
+        (stats.baseline_variance, num_baseline_stats),
+        (stats.baseline_min, num_baseline_stats),
+        (stats.baseline_max, num_baseline_stats),
+        (stats.timestep_mean, num_timestep_stats),
+        (stats.timestep_variance, num_timestep_stats),
+        (stats.timestep_min, num_timestep_stats),
+        (stats.timestep_max, num_timestep_stats),
+    ] {
+        drop(Box::from_raw(slice::from_raw_parts_mut(*ptr, *len)));
+    }
+
+    // Return success
+    0
+}
+
+/// Lag transform visibilities in `read_by_baseline` order over their fine channels, in parallel.
+/// See `lag_transform_by_baseline`.
+///
+/// # Arguments
+///
+/// * `data_ptr` - pointer to visibilities as [baseline][fine_chan][pol][r][i].
+///
+/// * `data_len` - length of `data_ptr`, in floats.
+///
+/// * `num_baselines` - number of baselines.
+///
+/// * `num_fine_chans` - number of fine channels, which is the number of lags.
+///
+/// * `num_pols` - number of visibility pols.
+///
+/// * `window` - window to apply over the fine channels.
+///
+/// * `buffer_ptr` - pointer to caller-owned and allocated buffer of `data_len` floats, to write the
+///                  lags into as [baseline][pol][lag][r][i].
+///
+/// * `buffer_len` - length of `buffer_ptr`.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated char* buffer for any error messages.
+/// * `data_ptr` and `buffer_ptr` must point to caller-owned buffers of `data_len` and `buffer_len` floats.
+/// * `window` must be a valid `LagWindow` value.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_lag_transform_by_baseline(
+    data_ptr: *const c_float,
+    data_len: size_t,
+    num_baselines: size_t,
+    num_fine_chans: size_t,
+    num_pols: size_t,
+    window: LagWindow,
+    buffer_ptr: *mut c_float,
+    buffer_len: size_t,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    if data_ptr.is_null() || buffer_ptr.is_null() {
+        set_error_message(
+            "mwalib_lag_transform_by_baseline() ERROR: null pointer for data_ptr or buffer_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    let data = slice::from_raw_parts(data_ptr, data_len);
+    let output = slice::from_raw_parts_mut(buffer_ptr, buffer_len);
+
+    if let Err(e) = lag_transform_by_baseline(
+        data,
+        num_baselines,
+        num_fine_chans,
+        num_pols,
+        window,
+        output,
+    ) {
+        set_error_message(
+            &format!("{}", e),
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+
+    // Return success
+    0
+}
+
+/// Get the number of lags of a stitched lag transform of some coarse channels (see
+/// `mwalib_correlator_context_get_lag_spectra`), to size its buffer.
+///
+/// # Arguments
+///
+/// * `correlator_context_ptr` - pointer to an already populated `CorrelatorContext` object.
+///
+/// * `coarse_chan_indices_ptr` - pointer to indices within the coarse_chan array.
+///
+/// * `coarse_chan_indices_len` - number of coarse channel indices.
+///
+/// * `out_num_lags` - set to the number of lags.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated char* buffer for any error messages.
+/// * `correlator_context_ptr` must point to a populated object from the `mwalib_correlator_context_new` function.
+/// * `coarse_chan_indices_ptr` must point to `coarse_chan_indices_len` indices.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_correlator_context_get_num_stitched_lags(
+    correlator_context_ptr: *mut CorrelatorContext,
+    coarse_chan_indices_ptr: *const size_t,
+    coarse_chan_indices_len: size_t,
+    out_num_lags: &mut size_t,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    if correlator_context_ptr.is_null() || coarse_chan_indices_ptr.is_null() {
+        set_error_message(
+            "mwalib_correlator_context_get_num_stitched_lags() ERROR: null pointer for correlator_context_ptr or coarse_chan_indices_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    let context = &*correlator_context_ptr;
+    let coarse_chan_indices =
+        slice::from_raw_parts(coarse_chan_indices_ptr, coarse_chan_indices_len);
+
+    match get_num_stitched_lags(context, coarse_chan_indices) {
+        Ok(num_lags) => *out_num_lags = num_lags,
+        Err(e) => {
+            set_error_message(
+                &format!("{}", e),
+                error_message as *mut u8,
+                error_message_length,
+            );
+            return 1;
+        }
+    }
+
+    // Return success
+    0
+}
+
+/// Read a timestep of some coarse channels, stitch their fine channels into one band and lag
+/// transform it, in parallel. See `get_lag_spectra_into_buffer`.
+///
+/// # Arguments
+///
+/// * `correlator_context_ptr` - pointer to an already populated `CorrelatorContext` object.
+///
+/// * `timestep_index` - index within the timestep array for the desired timestep.
+///
+/// * `coarse_chan_indices_ptr` - pointer to indices within the coarse_chan array, in any order.
+///
+/// * `coarse_chan_indices_len` - number of coarse channel indices.
+///
+/// * `window` - window to apply over the stitched band.
+///
+/// * `buffer_ptr` - pointer to caller-owned and allocated buffer of at least
+///                  num_baselines * num_visibility_pols * num_lags * 2 floats (see
+///                  `mwalib_correlator_context_get_num_stitched_lags`), to write the lags into as
+///                  [baseline][pol][lag][r][i].
+///
+/// * `buffer_len` - length of `buffer_ptr`.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated char* buffer for any error messages.
+/// * `correlator_context_ptr` must point to a populated object from the `mwalib_correlator_context_new` function.
+/// * `coarse_chan_indices_ptr` must point to `coarse_chan_indices_len` indices.
+/// * `window` must be a valid `LagWindow` value.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_correlator_context_get_lag_spectra(
+    correlator_context_ptr: *mut CorrelatorContext,
+    timestep_index: size_t,
+    coarse_chan_indices_ptr: *const size_t,
+    coarse_chan_indices_len: size_t,
+    window: LagWindow,
+    buffer_ptr: *mut c_float,
+    buffer_len: size_t,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    if correlator_context_ptr.is_null() || coarse_chan_indices_ptr.is_null() || buffer_ptr.is_null()
+    {
+        set_error_message(
+            "mwalib_correlator_context_get_lag_spectra() ERROR: null pointer for correlator_context_ptr, coarse_chan_indices_ptr or buffer_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    let context = &*correlator_context_ptr;
+    let coarse_chan_indices =
+        slice::from_raw_parts(coarse_chan_indices_ptr, coarse_chan_indices_len);
+    let output = slice::from_raw_parts_mut(buffer_ptr, buffer_len);
+
+    if let Err(e) =
+        get_lag_spectra_into_buffer(context, timestep_index, coarse_chan_indices, window, output)
+    {
+        set_error_message(
+            &format!("{}", e),
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+
+    // Return success
+    0
+}
+
+/// Copy the geometry of the phase centre at each timestep of a `CorrelatorContext` into caller
+/// supplied arrays, one element per timestep. See `TimestepGeometry`.
+///
+/// # Arguments
+///
+/// * `correlator_context_ptr` - pointer to an already populated `CorrelatorContext` object.
+///
+/// * `lst_rad_ptr` - pointer to caller-owned array of `num_timesteps` doubles for the LSTs, or null.
+///
+/// * `hour_angle_rad_ptr` - pointer to caller-owned array of `num_timesteps` doubles for the hour angles, or null.
+///
+/// * `parallactic_angle_rad_ptr` - pointer to caller-owned array of `num_timesteps` doubles for the parallactic angles, or null.
+///
+/// * `azimuth_rad_ptr` - pointer to caller-owned array of `num_timesteps` doubles for the azimuths, or null.
+///
+/// * `elevation_rad_ptr` - pointer to caller-owned array of `num_timesteps` doubles for the elevations, or null.
+///
+/// * `num_timesteps` - length of each array; must be the context's number of timesteps.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated char* buffer for any error messages.
+/// * `correlator_context_ptr` must point to a populated object from the `mwalib_correlator_context_new` function.
+/// * Each non-null array pointer must point to a caller-owned array of `num_timesteps` doubles.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_correlator_context_get_timestep_geometry(
+    correlator_context_ptr: *mut CorrelatorContext,
+    lst_rad_ptr: *mut f64,
+    hour_angle_rad_ptr: *mut f64,
+    parallactic_angle_rad_ptr: *mut f64,
+    azimuth_rad_ptr: *mut f64,
+    elevation_rad_ptr: *mut f64,
+    num_timesteps: size_t,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    if correlator_context_ptr.is_null() {
+        set_error_message(
+            "mwalib_correlator_context_get_timestep_geometry() ERROR: null pointer for correlator_context_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    let context = &*correlator_context_ptr;
+
+    if num_timesteps != context.num_timesteps {
+        set_error_message(
+            &format!(
+                "mwalib_correlator_context_get_timestep_geometry() ERROR: num_timesteps is {} but the context has {} timesteps",
+                num_timesteps, context.num_timesteps
+            ),
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+
+    let geometry = &context.timestep_geometry;
+    for (ptr, values) in &[
+        (lst_rad_ptr, &geometry.lst_rad),
+        (hour_angle_rad_ptr, &geometry.hour_angle_rad),
+        (parallactic_angle_rad_ptr, &geometry.parallactic_angle_rad),
+        (azimuth_rad_ptr, &geometry.azimuth_rad),
+        (elevation_rad_ptr, &geometry.elevation_rad),
+    ] {
+        if !ptr.is_null() {
+            slice::from_raw_parts_mut(*ptr, num_timesteps).copy_from_slice(values);
+        }
+    }
+
+    // Return success
+    0
+}
+
+/// Copy the fine channel table of a `CorrelatorContext` into caller supplied arrays, in
+/// [coarse_chan][fine_chan] order with the coarse channels as in `mwalib_correlator_coarse_channels_get`.
+/// See `FineChanTable`.
+///
+/// # Arguments
+///
+/// * `correlator_context_ptr` - pointer to an already populated `CorrelatorContext` object.
+///
+/// * `freqs_hz_ptr` - pointer to caller-owned array of `num_fine_chans` doubles for the fine channel centre frequencies, or null.
+///
+/// * `sky_fine_chan_indices_ptr` - pointer to caller-owned array of `num_fine_chans` indices for the fine channels' positions
+///                                 across all of the metafits' fine channels in sky frequency order, or null.
+///
+/// * `num_fine_chans` - length of each array; must be the context's number of coarse channels times fine channels per coarse channel.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated char* buffer for any error messages.
+/// * `correlator_context_ptr` must point to a populated object from the `mwalib_correlator_context_new` function.
+/// * Each non-null array pointer must point to a caller-owned array of `num_fine_chans` elements.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_correlator_context_get_fine_chan_table(
+    correlator_context_ptr: *mut CorrelatorContext,
+    freqs_hz_ptr: *mut f64,
+    sky_fine_chan_indices_ptr: *mut size_t,
+    num_fine_chans: size_t,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    if correlator_context_ptr.is_null() {
+        set_error_message(
+            "mwalib_correlator_context_get_fine_chan_table() ERROR: null pointer for correlator_context_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    let table = &(*correlator_context_ptr).fine_chan_table;
+
+    if num_fine_chans != table.freqs_hz.len() {
+        set_error_message(
+            &format!(
+                "mwalib_correlator_context_get_fine_chan_table() ERROR: num_fine_chans is {} but the context has {} fine channels",
+                num_fine_chans,
+                table.freqs_hz.len()
+            ),
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+
+    if !freqs_hz_ptr.is_null() {
+        slice::from_raw_parts_mut(freqs_hz_ptr, num_fine_chans).copy_from_slice(&table.freqs_hz);
+    }
+    if !sky_fine_chan_indices_ptr.is_null() {
+        slice::from_raw_parts_mut(sky_fine_chan_indices_ptr, num_fine_chans)
+            .copy_from_slice(&table.sky_fine_chan_indices);
+    }
+
+    // Return success
+    0
+}
+
+/// Copy which HDUs a `CorrelatorContext` has into a caller supplied array of flags, in
+/// [timestep][coarse_chan] order: 1 if some gpubox file has the HDU, otherwise 0. Every HDU is
+/// present unless the context keeps all timesteps. See `HduPresence`.
+///
+/// # Arguments
+///
+/// * `correlator_context_ptr` - pointer to an already populated `CorrelatorContext` object.
+///
+/// * `presence_ptr` - pointer to caller-owned array of `num_hdus` bytes.
+///
+/// * `num_hdus` - length of the array; must be the context's number of timesteps times coarse channels.
+///
+/// * `error_message` - pointer to already allocated buffer for any error messages to be returned to the caller.
+///
+/// * `error_message_length` - length of error_message char* buffer.
+///
+///
+/// # Returns
+///
+/// * 0 on success, non-zero on failure
+///
+///
+/// # Safety
+/// * `error_message` *must* point to an already allocated char* buffer for any error messages.
+/// * `correlator_context_ptr` must point to a populated object from the `mwalib_correlator_context_new` function.
+/// * `presence_ptr` must point to a caller-owned array of `num_hdus` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn mwalib_correlator_context_get_hdu_presence(
+    correlator_context_ptr: *mut CorrelatorContext,
+    presence_ptr: *mut u8,
+    num_hdus: size_t,
+    error_message: *const c_char,
+    error_message_length: size_t,
+) -> i32 {
+    if correlator_context_ptr.is_null() {
+        set_error_message(
+            "mwalib_correlator_context_get_hdu_presence() ERROR: null pointer for correlator_context_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    if presence_ptr.is_null() {
+        set_error_message(
+            "mwalib_correlator_context_get_hdu_presence() ERROR: null pointer for presence_ptr passed in",
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+    let presence = &(*correlator_context_ptr).hdu_presence;
+
+    if num_hdus != presence.num_timesteps * presence.num_coarse_chans {
+        set_error_message(
+            &format!(
+                "mwalib_correlator_context_get_hdu_presence() ERROR: num_hdus is {} but the context has {} HDUs",
+                num_hdus,
+                presence.num_timesteps * presence.num_coarse_chans
+            ),
+            error_message as *mut u8,
+            error_message_length,
+        );
+        return 1;
+    }
+
+    let out = slice::from_raw_parts_mut(presence_ptr, num_hdus);
+    for (i, flag) in out.iter_mut().enumerate() {
+        *flag =
+            presence.is_present(i / presence.num_coarse_chans, i % presence.num_coarse_chans) as u8;
+    }
+
+    // Return success
+    0
+}
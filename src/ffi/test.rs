@@ -527,6 +527,99 @@ fn test_mwalib_correlator_context_new_invalid() {
     }
 }
 
+#[test]
+fn test_mwalib_correlator_context_new_with_threads_valid() {
+    // This tests for a valid correlator context with its own thread pool
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    let metafits_file =
+        CString::new("test_files/1101503312_1_timestep/1101503312.metafits").unwrap();
+    let metafits_file_ptr = metafits_file.as_ptr();
+
+    let gpubox_file =
+        CString::new("test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits")
+            .unwrap();
+    let gpubox_files: Vec<*const c_char> = vec![gpubox_file.as_ptr()];
+
+    let gpubox_files_ptr = gpubox_files.as_ptr() as *mut *const c_char;
+
+    let cpus: Vec<size_t> = vec![0];
+
+    unsafe {
+        // Create a CorrelatorContext
+        let mut correlator_context_ptr: *mut CorrelatorContext = std::ptr::null_mut();
+        let retval = mwalib_correlator_context_new_with_threads(
+            metafits_file_ptr,
+            gpubox_files_ptr,
+            1,
+            2,
+            cpus.as_ptr(),
+            cpus.len(),
+            &mut correlator_context_ptr,
+            error_message_ptr,
+            error_len,
+        );
+
+        // Check return value of mwalib_correlator_context_new_with_threads
+        assert_eq!(
+            retval, 0,
+            "mwalib_correlator_context_new_with_threads failure"
+        );
+
+        // Check we got valid CorrelatorContext pointer, with a thread pool
+        let context_ptr = correlator_context_ptr.as_mut();
+        assert!(context_ptr.is_some());
+        let context = context_ptr.unwrap();
+        assert_eq!(context.thread_pool().unwrap().current_num_threads(), 2);
+
+        // Now ensure we can free the rust memory
+        assert_eq!(mwalib_correlator_context_free(context), 0);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_new_with_threads_invalid() {
+    // Zero threads is invalid
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    let metafits_file =
+        CString::new("test_files/1101503312_1_timestep/1101503312.metafits").unwrap();
+    let metafits_file_ptr = metafits_file.as_ptr();
+
+    let gpubox_file =
+        CString::new("test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits")
+            .unwrap();
+    let gpubox_files: Vec<*const c_char> = vec![gpubox_file.as_ptr()];
+
+    let gpubox_files_ptr = gpubox_files.as_ptr() as *mut *const c_char;
+
+    unsafe {
+        let mut correlator_context_ptr: *mut CorrelatorContext = std::ptr::null_mut();
+        let retval = mwalib_correlator_context_new_with_threads(
+            metafits_file_ptr,
+            gpubox_files_ptr,
+            1,
+            0,
+            std::ptr::null(),
+            0,
+            &mut correlator_context_ptr,
+            error_message_ptr,
+            error_len,
+        );
+
+        // Check return value of mwalib_correlator_context_new_with_threads
+        assert_ne!(retval, 0);
+
+        // Check error message
+        let c_str: &CStr = CStr::from_ptr(error_message_ptr);
+        assert!(!c_str.to_str().unwrap().trim().is_empty());
+    }
+}
+
 #[test]
 fn test_mwalib_correlator_context_display() {
     let correlator_context_ptr: *mut CorrelatorContext = get_test_correlator_context();
@@ -2351,3 +2444,354 @@ fn test_mwalib_visibilitypols_get_null_context() {
         );
     }
 }
+
+#[test]
+fn test_mwalib_correlator_context_get_visibility_statistics_valid() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    unsafe {
+        let context = get_test_correlator_context();
+
+        let mut stats_ptr: &mut *mut VisibilityStatistics = &mut std::ptr::null_mut();
+        let retval = mwalib_correlator_context_get_visibility_statistics(
+            context,
+            1,
+            1,
+            2,
+            &mut stats_ptr,
+            error_message_ptr,
+            error_len,
+        );
+        assert_eq!(
+            retval, 0,
+            "mwalib_correlator_context_get_visibility_statistics did not return success"
+        );
+
+        let stats = &**stats_ptr;
+        assert_eq!(stats.num_timesteps, 1);
+        assert_eq!(stats.num_baselines, 8256);
+        assert_eq!(
+            stats.num_baseline_stats,
+            stats.num_baselines * stats.num_fine_chans * stats.num_pols
+        );
+        assert_eq!(
+            stats.num_timestep_stats,
+            stats.num_fine_chans * stats.num_pols
+        );
+        // One timestep, so each baseline statistic is a single visibility
+        let baseline_count = slice::from_raw_parts(stats.baseline_count, stats.num_baseline_stats);
+        assert!(baseline_count.iter().all(|c| *c <= 1));
+        assert_eq!(*stats.timestep_count + *stats.timestep_nan_count, 8256);
+
+        // Now ensure we can free the rust memory
+        assert_eq!(mwalib_visibility_statistics_free(*stats_ptr), 0);
+
+        // Now ensure we don't panic if we try to free a null pointer
+        assert_eq!(mwalib_visibility_statistics_free(std::ptr::null_mut()), 0);
+
+        mwalib_correlator_context_free(context);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_visibility_statistics_null_context() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    unsafe {
+        let mut stats_ptr: &mut *mut VisibilityStatistics = &mut std::ptr::null_mut();
+        let retval = mwalib_correlator_context_get_visibility_statistics(
+            std::ptr::null_mut(),
+            1,
+            1,
+            1,
+            &mut stats_ptr,
+            error_message_ptr,
+            error_len,
+        );
+
+        // We should get a non-zero return code and no statistics
+        assert_ne!(retval, 0);
+        assert!(stats_ptr.is_null());
+    }
+}
+
+#[test]
+fn test_mwalib_lag_transform_by_baseline() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    // 1 baseline of 4 fine channels and 1 pol, which is constant so transforms to zero delay
+    let data: Vec<f32> = vec![1., 0., 1., 0., 1., 0., 1., 0.];
+    let mut output = vec![0.; 8];
+
+    unsafe {
+        let retval = mwalib_lag_transform_by_baseline(
+            data.as_ptr(),
+            data.len(),
+            1,
+            4,
+            1,
+            LagWindow::Rectangular,
+            output.as_mut_ptr(),
+            output.len(),
+            error_message_ptr,
+            error_len,
+        );
+        assert_eq!(
+            retval, 0,
+            "mwalib_lag_transform_by_baseline did not return success"
+        );
+        assert_eq!(output, vec![0., 0., 0., 0., 4., 0., 0., 0.]);
+
+        // Mismatched buffers are an error
+        let retval = mwalib_lag_transform_by_baseline(
+            data.as_ptr(),
+            data.len(),
+            1,
+            4,
+            1,
+            LagWindow::Hann,
+            output.as_mut_ptr(),
+            4,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_lag_spectra_null_context() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+    let coarse_chan_indices: Vec<size_t> = vec![0];
+    let mut buffer = vec![0.; 8];
+    let mut num_lags: size_t = 0;
+
+    unsafe {
+        let retval = mwalib_correlator_context_get_num_stitched_lags(
+            std::ptr::null_mut(),
+            coarse_chan_indices.as_ptr(),
+            coarse_chan_indices.len(),
+            &mut num_lags,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+        assert_eq!(num_lags, 0);
+
+        let retval = mwalib_correlator_context_get_lag_spectra(
+            std::ptr::null_mut(),
+            0,
+            coarse_chan_indices.as_ptr(),
+            coarse_chan_indices.len(),
+            LagWindow::Hann,
+            buffer.as_mut_ptr(),
+            buffer.len(),
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_timestep_geometry_valid() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    unsafe {
+        let context = get_test_correlator_context();
+        let num_timesteps = (*context).num_timesteps;
+        let mut lst_rad = vec![0.; num_timesteps];
+        let mut elevation_rad = vec![0.; num_timesteps];
+
+        // Only the arrays asked for are written
+        let retval = mwalib_correlator_context_get_timestep_geometry(
+            context,
+            lst_rad.as_mut_ptr(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            elevation_rad.as_mut_ptr(),
+            num_timesteps,
+            error_message_ptr,
+            error_len,
+        );
+        assert_eq!(
+            retval, 0,
+            "mwalib_correlator_context_get_timestep_geometry did not return success"
+        );
+        assert_eq!(lst_rad, (*context).timestep_geometry.lst_rad);
+        assert_eq!(elevation_rad, (*context).timestep_geometry.elevation_rad);
+
+        // The arrays must have an element per timestep
+        let retval = mwalib_correlator_context_get_timestep_geometry(
+            context,
+            lst_rad.as_mut_ptr(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            num_timesteps + 1,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+
+        mwalib_correlator_context_free(context);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_timestep_geometry_null_context() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+    let mut lst_rad = vec![0.; 1];
+
+    unsafe {
+        let retval = mwalib_correlator_context_get_timestep_geometry(
+            std::ptr::null_mut(),
+            lst_rad.as_mut_ptr(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            std::ptr::null_mut(),
+            1,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_fine_chan_table_valid() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    unsafe {
+        let context = get_test_correlator_context();
+        let num_fine_chans = (*context).fine_chan_table.freqs_hz.len();
+        let mut freqs_hz = vec![0.; num_fine_chans];
+        let mut sky_fine_chan_indices: Vec<size_t> = vec![0; num_fine_chans];
+
+        let retval = mwalib_correlator_context_get_fine_chan_table(
+            context,
+            freqs_hz.as_mut_ptr(),
+            sky_fine_chan_indices.as_mut_ptr(),
+            num_fine_chans,
+            error_message_ptr,
+            error_len,
+        );
+        assert_eq!(
+            retval, 0,
+            "mwalib_correlator_context_get_fine_chan_table did not return success"
+        );
+        assert_eq!(freqs_hz, (*context).fine_chan_table.freqs_hz);
+        assert_eq!(
+            sky_fine_chan_indices,
+            (*context).fine_chan_table.sky_fine_chan_indices
+        );
+
+        // The arrays must have an element per fine channel
+        let retval = mwalib_correlator_context_get_fine_chan_table(
+            context,
+            freqs_hz.as_mut_ptr(),
+            std::ptr::null_mut(),
+            num_fine_chans - 1,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+
+        mwalib_correlator_context_free(context);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_fine_chan_table_null_context() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+    let mut freqs_hz = vec![0.; 1];
+
+    unsafe {
+        let retval = mwalib_correlator_context_get_fine_chan_table(
+            std::ptr::null_mut(),
+            freqs_hz.as_mut_ptr(),
+            std::ptr::null_mut(),
+            1,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_hdu_presence_valid() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+
+    unsafe {
+        let context = get_test_correlator_context();
+        let num_hdus = (*context).num_timesteps * (*context).num_coarse_chans;
+        let mut presence: Vec<u8> = vec![0; num_hdus];
+
+        let retval = mwalib_correlator_context_get_hdu_presence(
+            context,
+            presence.as_mut_ptr(),
+            num_hdus,
+            error_message_ptr,
+            error_len,
+        );
+        assert_eq!(
+            retval, 0,
+            "mwalib_correlator_context_get_hdu_presence did not return success"
+        );
+        // The test context only has common timesteps
+        assert!(presence.iter().all(|p| *p == 1));
+
+        // The array must have an element per HDU
+        let retval = mwalib_correlator_context_get_hdu_presence(
+            context,
+            presence.as_mut_ptr(),
+            num_hdus + 1,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+
+        mwalib_correlator_context_free(context);
+    }
+}
+
+#[test]
+fn test_mwalib_correlator_context_get_hdu_presence_null_context() {
+    let error_len: size_t = 128;
+    let error_message = CString::new(" ".repeat(error_len)).unwrap();
+    let error_message_ptr = error_message.as_ptr() as *const c_char;
+    let mut presence: Vec<u8> = vec![0; 1];
+
+    unsafe {
+        let retval = mwalib_correlator_context_get_hdu_presence(
+            std::ptr::null_mut(),
+            presence.as_mut_ptr(),
+            1,
+            error_message_ptr,
+            error_len,
+        );
+        assert_ne!(retval, 0);
+    }
+}
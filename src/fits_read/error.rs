@@ -38,6 +38,29 @@ pub enum FitsError {
         source_line: u32,
     },
 
+    /// Error when a buffer supplied to read an image into is too small.
+    #[error("{source_file}:{source_line}\n{fits_filename} HDU {hdu_num}: Image has {image_size} elements but the supplied buffer only holds {buffer_size}")]
+    ImageBufferSize {
+        image_size: usize,
+        buffer_size: usize,
+        fits_filename: String,
+        hdu_num: usize,
+        source_file: &'static str,
+        source_line: u32,
+    },
+
+    /// Error when a range of an image to read is outside the image.
+    #[error("{source_file}:{source_line}\n{fits_filename} HDU {hdu_num}: Image has {image_size} elements but {num_elements} from element {first_element} were requested")]
+    ImageRange {
+        first_element: usize,
+        num_elements: usize,
+        image_size: usize,
+        fits_filename: String,
+        hdu_num: usize,
+        source_file: &'static str,
+        source_line: u32,
+    },
+
     /// Failure to read a long string.
     #[error("{source_file}:{source_line}\n{fits_filename} HDU {hdu_num}: Couldn't read a long string from {key}")]
     LongString {
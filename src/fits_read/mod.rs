@@ -12,7 +12,7 @@ use std::ffi::*;
 use std::ptr;
 
 use fitsio::{hdu::*, FitsFile};
-use fitsio_sys::{ffgkls, fitsfile};
+use fitsio_sys::{ffgkls, ffgpve, ffmahd, fitsfile};
 use libc::c_char;
 
 #[cfg(test)]
@@ -248,6 +248,62 @@ macro_rules! get_fits_image {
     };
 }
 
+/// Given a FITS file pointer and a HDU, read the associated image of floats
+/// into an existing buffer, rather than allocating a new vector.
+///
+/// # Arguments
+///
+/// * `fits_fptr` - A reference to the `FITSFile` object.
+///
+/// * `hdu` - A reference to the HDU containing the image.
+///
+/// * `buffer` - A mutable slice of f32 at least as large as the image.
+///
+///
+/// # Returns
+///
+/// * A Result containing nothing or an error.
+///
+#[macro_export]
+macro_rules! get_fits_float_image_into_buffer {
+    ($fptr:expr, $hdu:expr, $buffer:expr) => {
+        _get_fits_float_image_into_buffer($fptr, $hdu, $buffer, file!(), line!())
+    };
+}
+
+/// Given a FITS file pointer and a HDU, read a contiguous range of the
+/// associated image of floats into an existing buffer. Only the tiles of a
+/// compressed image which hold the range are decompressed.
+///
+/// # Arguments
+///
+/// * `fits_fptr` - A reference to the `FITSFile` object.
+///
+/// * `hdu` - A reference to the HDU containing the image.
+///
+/// * `first_element` - The (0-based) index of the first element to read.
+///
+/// * `buffer` - A mutable slice of f32; its length is the number of elements to read.
+///
+///
+/// # Returns
+///
+/// * A Result containing nothing or an error.
+///
+#[macro_export]
+macro_rules! get_fits_float_image_range_into_buffer {
+    ($fptr:expr, $hdu:expr, $first_element:expr, $buffer:expr) => {
+        _get_fits_float_image_range_into_buffer(
+            $fptr,
+            $hdu,
+            $first_element,
+            $buffer,
+            file!(),
+            line!(),
+        )
+    };
+}
+
 /// Open a fits file.
 ///
 /// To only be used internally; use the `fits_open!` macro instead.
@@ -507,6 +563,143 @@ pub fn _get_fits_image<T: fitsio::images::ReadImage>(
     }
 }
 
+/// Read the data out of a HDU's float image into a supplied buffer.
+///
+/// To only be used internally; use the `get_fits_float_image_into_buffer!`
+/// macro instead.
+#[doc(hidden)]
+pub fn _get_fits_float_image_into_buffer(
+    fits_fptr: &mut FitsFile,
+    hdu: &FitsHdu,
+    buffer: &mut [f32],
+    source_file: &'static str,
+    source_line: u32,
+) -> Result<(), FitsError> {
+    let image_size: usize = match &hdu.info {
+        HduInfo::ImageInfo { shape, .. } => shape.iter().product(),
+        _ => {
+            return Err(FitsError::NotImage {
+                fits_filename: fits_fptr.filename.clone(),
+                hdu_num: hdu.number + 1,
+                source_file,
+                source_line,
+            })
+        }
+    };
+
+    if buffer.len() < image_size {
+        return Err(FitsError::ImageBufferSize {
+            image_size,
+            buffer_size: buffer.len(),
+            fits_filename: fits_fptr.filename.clone(),
+            hdu_num: hdu.number + 1,
+            source_file,
+            source_line,
+        });
+    }
+
+    read_float_pixels(
+        fits_fptr,
+        hdu,
+        0,
+        &mut buffer[..image_size],
+        source_file,
+        source_line,
+    )
+}
+
+/// Read a contiguous range of a HDU's float image into a supplied buffer.
+///
+/// To only be used internally; use the `get_fits_float_image_range_into_buffer!`
+/// macro instead.
+#[doc(hidden)]
+pub fn _get_fits_float_image_range_into_buffer(
+    fits_fptr: &mut FitsFile,
+    hdu: &FitsHdu,
+    first_element: usize,
+    buffer: &mut [f32],
+    source_file: &'static str,
+    source_line: u32,
+) -> Result<(), FitsError> {
+    let image_size: usize = match &hdu.info {
+        HduInfo::ImageInfo { shape, .. } => shape.iter().product(),
+        _ => {
+            return Err(FitsError::NotImage {
+                fits_filename: fits_fptr.filename.clone(),
+                hdu_num: hdu.number + 1,
+                source_file,
+                source_line,
+            })
+        }
+    };
+
+    if first_element + buffer.len() > image_size {
+        return Err(FitsError::ImageRange {
+            first_element,
+            num_elements: buffer.len(),
+            image_size,
+            fits_filename: fits_fptr.filename.clone(),
+            hdu_num: hdu.number + 1,
+            source_file,
+            source_line,
+        });
+    }
+
+    read_float_pixels(
+        fits_fptr,
+        hdu,
+        first_element,
+        buffer,
+        source_file,
+        source_line,
+    )
+}
+
+/// Read `buffer.len()` floats of a HDU's image, starting at `first_element` (0-based).
+fn read_float_pixels(
+    fits_fptr: &mut FitsFile,
+    hdu: &FitsHdu,
+    first_element: usize,
+    buffer: &mut [f32],
+    source_file: &'static str,
+    source_line: u32,
+) -> Result<(), FitsError> {
+    // fitsio does not provide a way to read an image into an existing buffer,
+    // so call cfitsio directly. Make sure we are on the right HDU first.
+    let mut status = 0;
+    let mut any_null = 0;
+    unsafe {
+        let fptr = fits_fptr.as_raw();
+        ffmahd(fptr, (hdu.number + 1) as i32, ptr::null_mut(), &mut status);
+        if status == 0 {
+            ffgpve(
+                fptr,
+                0,
+                first_element as i64 + 1,
+                buffer.len() as i64,
+                0.0,
+                buffer.as_mut_ptr(),
+                &mut any_null,
+                &mut status,
+            );
+        }
+    }
+
+    match status {
+        0 => Ok(()),
+        _ => Err(FitsError::Fitsio {
+            fits_error: fitsio::errors::Error::Fits(fitsio::errors::FitsError {
+                status,
+                message: format!("cfitsio returned status {} reading image", status),
+            }),
+            fits_filename: fits_fptr.filename.clone(),
+            hdu_num: hdu.number + 1,
+            source_file,
+            source_line,
+        }),
+    }
+}
+
 /// Get a long string from a FITS file. The supplied FITS file pointer *must* be
 /// using the appropriate HDU already, or this function will fail.
 ///
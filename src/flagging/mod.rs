@@ -0,0 +1,685 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+SumThreshold RFI flagging (Offringa et al. 2010, as in AOFlagger) of a `CorrelatorContext`.
+
+Data is read in frequency order through a `Pipeline` and collected into blocks of
+`num_timesteps_per_block` timesteps of one coarse channel. Each baseline and pol of a block is a
+time x frequency plane of visibility amplitudes, which is flagged on its own:
+
+1. NaN and infinite amplitudes, and timesteps with no data, are flagged.
+2. Each fine channel's median over time is subtracted, which removes the bandpass.
+3. Fine channels whose median stands out from their neighbours' are flagged entirely. These
+   are the persistent narrowband lines that step 2 would otherwise hide.
+4. SumThreshold runs along frequency and then time, for windows of 1, 2, 4, ... up to
+   `max_window` samples. A window is flagged when the mean of its unflagged residuals is over
+   `base_threshold` robust standard deviations, with the threshold divided by
+   `threshold_factor` each time the window doubles.
+
+The planes of a block are flagged in parallel in the context's thread pool, and the time
+direction passes run across all fine channels at once, so they vectorise. Flagging never
+depends on the order or the threads the work runs on, so results are deterministic.
+ */
+pub mod error;
+pub use error::FlaggingError;
+
+use std::collections::HashMap;
+use std::sync::Mutex;
+
+use rayon::prelude::*;
+
+use crate::correlator_context::CorrelatorContext;
+use crate::pipeline::{Pipeline, VisibilityBlock, WorkUnit};
+
+#[cfg(test)]
+mod test;
+
+/// Scale from the median absolute deviation to the standard deviation of a normal distribution
+const MAD_TO_SIGMA: f32 = 1.4826;
+
+/// Number of pairs of neighbouring fine channels a channel's median is predicted from
+const CHAN_PROFILE_HALF_WIDTH: usize = 3;
+
+/// Options for `flag_visibilities`.
+#[derive(Clone, Debug)]
+pub struct FlaggerOptions {
+    /// Threshold for a single sample, in robust standard deviations of a plane's residuals.
+    pub base_threshold: f32,
+    /// The threshold is divided by this every time the window size doubles.
+    pub threshold_factor: f32,
+    /// Largest SumThreshold window, in samples.
+    pub max_window: usize,
+    /// Number of timesteps flagged together. Longer blocks find weaker, longer-lived RFI.
+    pub num_timesteps_per_block: usize,
+    /// Flag a visibility in every pol if it is flagged in any pol.
+    pub combine_pols: bool,
+    /// Number of threads reading gpubox files.
+    pub num_read_workers: usize,
+    /// Number of threads converting HDUs into frequency order.
+    pub num_convert_workers: usize,
+}
+
+impl Default for FlaggerOptions {
+    fn default() -> Self {
+        FlaggerOptions {
+            base_threshold: 6.,
+            threshold_factor: 1.5,
+            max_window: 32,
+            num_timesteps_per_block: 32,
+            combine_pols: true,
+            num_read_workers: 2,
+            num_convert_workers: 2,
+        }
+    }
+}
+
+/// One flag bit per visibility of every HDU of a `CorrelatorContext`.
+///
+/// The bitmap of an HDU is aligned with `read_by_frequency` output: bit `i` (bit `i % 64` of word
+/// `i / 64`) is the visibility at [frequency][baseline][pol] index `i`, i.e. floats `2i` and `2i + 1`.
+/// HDUs with no data are entirely flagged.
+#[derive(Clone, Debug, PartialEq)]
+pub struct VisibilityFlags {
+    /// Number of timesteps
+    pub num_timesteps: usize,
+    /// Number of coarse channels
+    pub num_coarse_chans: usize,
+    /// Number of fine channels in each coarse channel
+    pub num_fine_chans_per_coarse: usize,
+    /// Number of baselines
+    pub num_baselines: usize,
+    /// Number of visibility pols
+    pub num_pols: usize,
+    /// Number of u64 words in each HDU's bitmap
+    words_per_hdu: usize,
+    /// The bitmaps of each HDU, in [timestep][coarse_chan] order
+    bitmaps: Vec<u64>,
+}
+
+impl VisibilityFlags {
+    /// Create flags for every HDU, with everything flagged.
+    fn new(
+        num_timesteps: usize,
+        num_coarse_chans: usize,
+        num_fine_chans_per_coarse: usize,
+        num_baselines: usize,
+        num_pols: usize,
+    ) -> Self {
+        let num_hdu_visibilities = num_fine_chans_per_coarse * num_baselines * num_pols;
+        let words_per_hdu = (num_hdu_visibilities + 63) / 64;
+        let mut hdu_bitmap = vec![!0u64; words_per_hdu];
+        // Bits past the last visibility are never set
+        if num_hdu_visibilities % 64 != 0 {
+            hdu_bitmap[words_per_hdu - 1] = (1 << (num_hdu_visibilities % 64)) - 1;
+        }
+
+        VisibilityFlags {
+            num_timesteps,
+            num_coarse_chans,
+            num_fine_chans_per_coarse,
+            num_baselines,
+            num_pols,
+            words_per_hdu,
+            bitmaps: hdu_bitmap.repeat(num_timesteps * num_coarse_chans),
+        }
+    }
+
+    /// Number of visibilities (flag bits) in each HDU.
+    pub fn get_num_hdu_visibilities(&self) -> usize {
+        self.num_fine_chans_per_coarse * self.num_baselines * self.num_pols
+    }
+
+    /// The flag bitmap of one timestep and coarse channel. See the struct documentation for the layout.
+    pub fn get_hdu_bitmap(&self, timestep_index: usize, coarse_chan_index: usize) -> &[u64] {
+        let hdu_index = timestep_index * self.num_coarse_chans + coarse_chan_index;
+        &self.bitmaps[hdu_index * self.words_per_hdu..][..self.words_per_hdu]
+    }
+
+    fn get_hdu_bitmap_mut(
+        &mut self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    ) -> &mut [u64] {
+        let hdu_index = timestep_index * self.num_coarse_chans + coarse_chan_index;
+        &mut self.bitmaps[hdu_index * self.words_per_hdu..][..self.words_per_hdu]
+    }
+
+    /// Returns true if a visibility is flagged.
+    ///
+    /// # Arguments
+    ///
+    /// * `timestep_index` - index within the context's timesteps.
+    ///
+    /// * `coarse_chan_index` - index within the context's coarse_chans.
+    ///
+    /// * `fine_chan_index` - fine channel within the coarse channel.
+    ///
+    /// * `baseline_index` - index within the baselines.
+    ///
+    /// * `pol_index` - index within the visibility pols.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * true if the visibility is flagged.
+    ///
+    ///
+    pub fn is_flagged(
+        &self,
+        timestep_index: usize,
+        coarse_chan_index: usize,
+        fine_chan_index: usize,
+        baseline_index: usize,
+        pol_index: usize,
+    ) -> bool {
+        let bit =
+            (fine_chan_index * self.num_baselines + baseline_index) * self.num_pols + pol_index;
+        self.get_hdu_bitmap(timestep_index, coarse_chan_index)[bit / 64] & (1 << (bit % 64)) != 0
+    }
+
+    /// Total number of flagged visibilities.
+    pub fn get_num_flagged(&self) -> usize {
+        self.bitmaps.iter().map(|w| w.count_ones() as usize).sum()
+    }
+}
+
+/// The timesteps of one coarse channel which are flagged together
+struct FlagGroup {
+    first_timestep_index: usize,
+    /// One block per timestep, None for timesteps with no data or not yet read
+    blocks: Vec<Option<VisibilityBlock>>,
+    num_remaining: usize,
+}
+
+/// Flag RFI in every timestep, coarse channel, baseline and pol of a context. See the module documentation.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to flag.
+///
+/// * `options` - see `FlaggerOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing the `VisibilityFlags`, or a `FlaggingError`.
+///
+///
+pub fn flag_visibilities(
+    context: &CorrelatorContext,
+    options: &FlaggerOptions,
+) -> Result<VisibilityFlags, FlaggingError> {
+    if !(options.base_threshold > 0.) {
+        return Err(FlaggingError::InvalidOptions {
+            reason: "base_threshold must be positive",
+        });
+    }
+    if !(options.threshold_factor >= 1.) {
+        return Err(FlaggingError::InvalidOptions {
+            reason: "threshold_factor must be at least 1",
+        });
+    }
+    if options.max_window == 0 || options.num_timesteps_per_block == 0 {
+        return Err(FlaggingError::InvalidOptions {
+            reason: "max_window and num_timesteps_per_block must be at least 1",
+        });
+    }
+
+    let metafits_context = &context.metafits_context;
+    let mut flags = VisibilityFlags::new(
+        context.num_timesteps,
+        context.num_coarse_chans,
+        metafits_context.num_corr_fine_chans_per_coarse,
+        metafits_context.num_baselines,
+        metafits_context.num_visibility_pols,
+    );
+
+    // Read each group's timesteps one after the other, so groups finish in turn and only about
+    // one is held at a time
+    let block_len = options.num_timesteps_per_block;
+    let mut groups = HashMap::new();
+    let mut work_units = Vec::new();
+    for first_timestep_index in (0..context.num_timesteps).step_by(block_len) {
+        let timestep_range =
+            first_timestep_index..(first_timestep_index + block_len).min(context.num_timesteps);
+        for coarse_chan_index in 0..context.num_coarse_chans {
+            let num_work_units = work_units.len();
+            work_units.extend(
+                context
+                    .get_hdu_timestep_indices(coarse_chan_index, timestep_range.clone())
+                    .into_iter()
+                    .map(|timestep_index| WorkUnit {
+                        timestep_index,
+                        coarse_chan_index,
+                    }),
+            );
+            if work_units.len() > num_work_units {
+                groups.insert(
+                    (first_timestep_index, coarse_chan_index),
+                    FlagGroup {
+                        first_timestep_index,
+                        blocks: timestep_range.clone().map(|_| None).collect(),
+                        num_remaining: work_units.len() - num_work_units,
+                    },
+                );
+            }
+        }
+    }
+
+    let pending = Mutex::new(groups);
+    let results = Pipeline::new(context)
+        .with_work_units(work_units)
+        .by_frequency(true)
+        .with_workers(options.num_read_workers, options.num_convert_workers, 1)
+        .run(
+            |block| -> Result<Vec<(WorkUnit, Vec<u64>)>, FlaggingError> {
+                let work_unit = block.work_unit;
+                let key = (
+                    work_unit.timestep_index - work_unit.timestep_index % block_len,
+                    work_unit.coarse_chan_index,
+                );
+                let complete = {
+                    let mut pending = pending.lock().unwrap();
+                    let group = pending.get_mut(&key).unwrap();
+                    group.blocks[work_unit.timestep_index - group.first_timestep_index] =
+                        Some(block);
+                    group.num_remaining -= 1;
+                    match group.num_remaining {
+                        0 => pending.remove(&key),
+                        _ => None,
+                    }
+                };
+
+                Ok(match complete {
+                    Some(group) => flag_group(context, &group, options),
+                    None => Vec::new(),
+                })
+            },
+        )?;
+
+    for (work_unit, bitmap) in results.into_iter().flatten() {
+        flags
+            .get_hdu_bitmap_mut(work_unit.timestep_index, work_unit.coarse_chan_index)
+            .copy_from_slice(&bitmap);
+    }
+
+    Ok(flags)
+}
+
+/// Flag every baseline and pol of a complete group, in parallel.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` the group was read from.
+///
+/// * `group` - the group, with a block for every timestep that has data.
+///
+/// * `options` - see `FlaggerOptions`.
+///
+///
+/// # Returns
+///
+/// * The flag bitmap of each block in the group.
+///
+///
+fn flag_group(
+    context: &CorrelatorContext,
+    group: &FlagGroup,
+    options: &FlaggerOptions,
+) -> Vec<(WorkUnit, Vec<u64>)> {
+    let metafits_context = &context.metafits_context;
+    let num_fine_chans = metafits_context.num_corr_fine_chans_per_coarse;
+    let num_baselines = metafits_context.num_baselines;
+    let num_pols = metafits_context.num_visibility_pols;
+    let num_rows = group.blocks.len();
+    let plane_len = num_rows * num_fine_chans;
+
+    context.install(|| {
+        // The flags of each baseline, in [pol][timestep][fine_chan] order
+        let baseline_flags: Vec<Vec<bool>> = (0..num_baselines)
+            .into_par_iter()
+            .map(|baseline_index| {
+                let mut values = vec![0.; plane_len];
+                let mut flags = vec![false; num_pols * plane_len];
+                for (pol_index, plane_flags) in flags.chunks_exact_mut(plane_len).enumerate() {
+                    for (row, block) in group.blocks.iter().enumerate() {
+                        let row_values = &mut values[row * num_fine_chans..][..num_fine_chans];
+                        let row_flags = &mut plane_flags[row * num_fine_chans..][..num_fine_chans];
+                        match block {
+                            Some(block) => {
+                                for (fine_chan_index, value) in row_values.iter_mut().enumerate() {
+                                    let i = ((fine_chan_index * num_baselines + baseline_index)
+                                        * num_pols
+                                        + pol_index)
+                                        * 2;
+                                    *value = (block.data[i] * block.data[i]
+                                        + block.data[i + 1] * block.data[i + 1])
+                                        .sqrt();
+                                }
+                            }
+                            None => row_flags.iter_mut().for_each(|f| *f = true),
+                        }
+                    }
+                    flag_plane(&values, plane_flags, num_fine_chans, options);
+                }
+
+                if options.combine_pols && num_pols > 1 {
+                    let (first, rest) = flags.split_at_mut(plane_len);
+                    for pol_flags in rest.chunks_exact(plane_len) {
+                        first.iter_mut().zip(pol_flags).for_each(|(a, b)| *a |= b);
+                    }
+                    for pol_flags in rest.chunks_exact_mut(plane_len) {
+                        pol_flags.copy_from_slice(first);
+                    }
+                }
+                flags
+            })
+            .collect();
+
+        // Gather each timestep's flags into a bitmap in [frequency][baseline][pol] order
+        let num_hdu_visibilities = num_fine_chans * num_baselines * num_pols;
+        group
+            .blocks
+            .par_iter()
+            .enumerate()
+            .filter_map(|(row, block)| {
+                let block = block.as_ref()?;
+                let mut bitmap = vec![0u64; (num_hdu_visibilities + 63) / 64];
+                for (baseline_index, flags) in baseline_flags.iter().enumerate() {
+                    for (pol_index, plane_flags) in flags.chunks_exact(plane_len).enumerate() {
+                        let row_flags = &plane_flags[row * num_fine_chans..][..num_fine_chans];
+                        for (fine_chan_index, flag) in row_flags.iter().enumerate() {
+                            if *flag {
+                                let bit = (fine_chan_index * num_baselines + baseline_index)
+                                    * num_pols
+                                    + pol_index;
+                                bitmap[bit / 64] |= 1 << (bit % 64);
+                            }
+                        }
+                    }
+                }
+                Some((block.work_unit, bitmap))
+            })
+            .collect()
+    })
+}
+
+/// Returns the median of some values, reordering them.
+/// NaN if there are none.
+pub(crate) fn get_median(values: &mut [f32]) -> f32 {
+    if values.is_empty() {
+        return f32::NAN;
+    }
+    let mid = values.len() / 2;
+    values.select_nth_unstable_by(mid, |a, b| a.partial_cmp(b).unwrap());
+    match values.len() % 2 {
+        1 => values[mid],
+        // The values before mid are now all no bigger than values[mid]
+        _ => (values[..mid].iter().fold(f32::NEG_INFINITY, |a, b| a.max(*b)) + values[mid]) / 2.,
+    }
+}
+
+/// Returns the robust standard deviation (scaled median absolute deviation) of some values, reordering them.
+fn get_robust_sigma(values: &mut [f32]) -> f32 {
+    let median = get_median(values);
+    values.iter_mut().for_each(|v| *v = (*v - median).abs());
+    get_median(values) * MAD_TO_SIGMA
+}
+
+/// Flag a time x frequency plane of amplitudes. See the module documentation for the steps.
+///
+/// # Arguments
+///
+/// * `values` - the amplitudes, in [time][frequency] order.
+///
+/// * `flags` - flags of `values`, in the same order. Samples already flagged are left out of
+///             every statistic, and newly flagged samples are added.
+///
+/// * `num_cols` - number of fine channels.
+///
+/// * `options` - see `FlaggerOptions`.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+pub(crate) fn flag_plane(
+    values: &[f32],
+    flags: &mut [bool],
+    num_cols: usize,
+    options: &FlaggerOptions,
+) {
+    assert_eq!(values.len(), flags.len());
+    let num_rows = values.len() / num_cols;
+    values
+        .iter()
+        .zip(flags.iter_mut())
+        .for_each(|(v, f)| *f |= !v.is_finite());
+
+    // Subtract each channel's median over time
+    let mut scratch = Vec::with_capacity(values.len());
+    let chan_medians: Vec<f32> = (0..num_cols)
+        .map(|col| {
+            scratch.clear();
+            scratch.extend(
+                (0..num_rows)
+                    .map(|row| row * num_cols + col)
+                    .filter(|i| !flags[*i])
+                    .map(|i| values[i]),
+            );
+            get_median(&mut scratch)
+        })
+        .collect();
+    let residuals: Vec<f32> = values
+        .iter()
+        .zip(flags.iter())
+        .enumerate()
+        .map(|(i, (v, f))| {
+            if *f {
+                0.
+            } else {
+                v - chan_medians[i % num_cols]
+            }
+        })
+        .collect();
+
+    scratch.clear();
+    scratch.extend(
+        residuals
+            .iter()
+            .zip(flags.iter())
+            .filter(|(_, f)| !**f)
+            .map(|(r, _)| *r),
+    );
+    let sigma = get_robust_sigma(&mut scratch);
+
+    flag_chan_profile(&chan_medians, flags, num_cols, options);
+    // Everything is flagged, or the residuals are constant (e.g. all zeros, or one timestep)
+    if !(sigma > 0.) {
+        return;
+    }
+
+    let mut new_flags = flags.to_vec();
+    let mut window = 1;
+    let mut threshold = options.base_threshold * sigma;
+    while window <= options.max_window && (window <= num_cols || window <= num_rows) {
+        if window <= num_cols {
+            sum_threshold_frequency(
+                &residuals,
+                flags,
+                &mut new_flags,
+                num_cols,
+                window,
+                threshold,
+            );
+            flags.copy_from_slice(&new_flags);
+        }
+        if window <= num_rows {
+            sum_threshold_time(
+                &residuals,
+                flags,
+                &mut new_flags,
+                num_cols,
+                window,
+                threshold,
+            );
+            flags.copy_from_slice(&new_flags);
+        }
+        window *= 2;
+        threshold /= options.threshold_factor;
+    }
+}
+
+/// Flag whole channels whose median over time is an outlier compared to the channels around it.
+fn flag_chan_profile(
+    chan_medians: &[f32],
+    flags: &mut [bool],
+    num_cols: usize,
+    options: &FlaggerOptions,
+) {
+    let mut scratch = Vec::with_capacity(CHAN_PROFILE_HALF_WIDTH);
+    let deviations: Vec<f32> = (0..num_cols)
+        .map(|col| {
+            // Predict the channel linearly from pairs of channels k away, around it where
+            // possible and from one side at the edges, so that bandpass slopes cancel
+            scratch.clear();
+            for k in 1..=CHAN_PROFILE_HALF_WIDTH {
+                let prediction = if col >= k && col + k < num_cols {
+                    (chan_medians[col - k] + chan_medians[col + k]) / 2.
+                } else if col + 2 * k < num_cols {
+                    2. * chan_medians[col + k] - chan_medians[col + 2 * k]
+                } else if col >= 2 * k {
+                    2. * chan_medians[col - k] - chan_medians[col - 2 * k]
+                } else {
+                    continue;
+                };
+                if !prediction.is_nan() {
+                    scratch.push(prediction);
+                }
+            }
+            chan_medians[col] - get_median(&mut scratch)
+        })
+        .collect();
+
+    scratch.clear();
+    scratch.extend(deviations.iter().filter(|d| !d.is_nan()));
+    let sigma = get_robust_sigma(&mut scratch);
+    if !(sigma > 0.) {
+        return;
+    }
+
+    for (col, deviation) in deviations.iter().enumerate() {
+        if deviation.abs() > options.base_threshold * sigma {
+            flags
+                .iter_mut()
+                .skip(col)
+                .step_by(num_cols)
+                .for_each(|f| *f = true);
+        }
+    }
+}
+
+/// One SumThreshold pass along each row (frequency) of a plane.
+///
+/// # Arguments
+///
+/// * `residuals` - the plane's residuals, in [time][frequency] order.
+///
+/// * `flags` - flags before this pass. Flagged samples are left out of window sums.
+///
+/// * `new_flags` - flags to add this pass's flags to.
+///
+/// * `num_cols` - number of fine channels.
+///
+/// * `window` - number of samples in each window.
+///
+/// * `threshold` - flag a window if the mean of its unflagged residuals is further than this from 0.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+fn sum_threshold_frequency(
+    residuals: &[f32],
+    flags: &[bool],
+    new_flags: &mut [bool],
+    num_cols: usize,
+    window: usize,
+    threshold: f32,
+) {
+    for ((row, row_flags), row_new_flags) in residuals
+        .chunks_exact(num_cols)
+        .zip(flags.chunks_exact(num_cols))
+        .zip(new_flags.chunks_exact_mut(num_cols))
+    {
+        let mut sum = 0.;
+        let mut count = 0;
+        for i in 0..num_cols {
+            if !row_flags[i] {
+                sum += row[i];
+                count += 1;
+            }
+            if i >= window && !row_flags[i - window] {
+                sum -= row[i - window];
+                count -= 1;
+            }
+            if i + 1 >= window && count > 0 && sum.abs() > count as f32 * threshold {
+                row_new_flags[i + 1 - window..=i]
+                    .iter_mut()
+                    .for_each(|f| *f = true);
+            }
+        }
+    }
+}
+
+/// One SumThreshold pass along each column (time) of a plane. Windows slide down all columns at
+/// once, so each step is a pass over whole rows. The arguments are as for `sum_threshold_frequency`.
+fn sum_threshold_time(
+    residuals: &[f32],
+    flags: &[bool],
+    new_flags: &mut [bool],
+    num_cols: usize,
+    window: usize,
+    threshold: f32,
+) {
+    let num_rows = residuals.len() / num_cols;
+    let mut sums = vec![0f32; num_cols];
+    let mut counts = vec![0i32; num_cols];
+    // Add (sign 1) or remove (sign -1) a row's unflagged residuals
+    let add_row = |sums: &mut [f32], counts: &mut [i32], row: usize, sign: i32| {
+        let row_residuals = &residuals[row * num_cols..][..num_cols];
+        let row_flags = &flags[row * num_cols..][..num_cols];
+        for (((sum, count), r), f) in sums
+            .iter_mut()
+            .zip(counts.iter_mut())
+            .zip(row_residuals)
+            .zip(row_flags)
+        {
+            let weight = sign * !*f as i32;
+            *sum += weight as f32 * r;
+            *count += weight;
+        }
+    };
+
+    for row in 0..num_rows {
+        add_row(&mut sums, &mut counts, row, 1);
+        if row >= window {
+            add_row(&mut sums, &mut counts, row - window, -1);
+        }
+        if row + 1 >= window {
+            for (col, (sum, count)) in sums.iter().zip(counts.iter()).enumerate() {
+                if *count > 0 && sum.abs() > *count as f32 * threshold {
+                    for flag_row in row + 1 - window..=row {
+                        new_flags[flag_row * num_cols + col] = true;
+                    }
+                }
+            }
+        }
+    }
+}
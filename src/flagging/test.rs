@@ -0,0 +1,218 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for RFI flagging
+*/
+#[cfg(test)]
+use super::*;
+
+const NUM_ROWS: usize = 64;
+const NUM_COLS: usize = 64;
+
+/// A deterministic plane of unit Gaussian noise on top of a bandpass-like slope across channels
+fn get_noise_plane(seed: u64) -> Vec<f32> {
+    let mut state = seed;
+    let mut uniform = move || {
+        // 64 bit LCG (Knuth's MMIX constants), top 53 bits as a float in (0, 1]
+        state = state
+            .wrapping_mul(6_364_136_223_846_793_005)
+            .wrapping_add(1_442_695_040_888_963_407);
+        ((state >> 11) as f64 + 1.) / (1u64 << 53) as f64
+    };
+
+    (0..NUM_ROWS * NUM_COLS)
+        .map(|i| {
+            // Box-Muller
+            let gaussian =
+                (-2. * uniform().ln()).sqrt() * (2. * std::f64::consts::PI * uniform()).cos();
+            let col = i % NUM_COLS;
+            (100. + 20. * (col as f64 / NUM_COLS as f64 * 3.).sin() + gaussian) as f32
+        })
+        .collect()
+}
+
+fn count_flags(flags: &[bool], indices: impl Iterator<Item = usize>) -> (usize, usize) {
+    let mut total = 0;
+    let mut flagged = 0;
+    for i in indices {
+        total += 1;
+        flagged += flags[i] as usize;
+    }
+    (flagged, total)
+}
+
+#[test]
+fn test_flag_plane_noise_only() {
+    // Pure noise should hardly be flagged
+    for seed in 0..4 {
+        let values = get_noise_plane(seed);
+        let mut flags = vec![false; values.len()];
+        flag_plane(&values, &mut flags, NUM_COLS, &FlaggerOptions::default());
+        let (flagged, total) = count_flags(&flags, 0..values.len());
+        assert!(
+            flagged * 200 < total,
+            "{} of {} noise samples flagged",
+            flagged,
+            total
+        );
+    }
+}
+
+#[test]
+fn test_flag_plane_injected_rfi() {
+    let mut values = get_noise_plane(42);
+    let at = |row: usize, col: usize| row * NUM_COLS + col;
+
+    // A strong single sample
+    values[at(10, 5)] += 30.;
+    // A weak broadband burst, at 4 sigma per sample
+    for col in 0..NUM_COLS {
+        values[at(40, col)] += 4.;
+    }
+    // A weak intermittent narrowband line, at 3 sigma per sample
+    for row in 10..30 {
+        values[at(row, 50)] += 3.;
+    }
+    // A persistent narrowband line, hidden from SumThreshold by the channel background
+    for row in 0..NUM_ROWS {
+        values[at(row, 20)] += 3.;
+    }
+    // A NaN
+    values[at(60, 60)] = f32::NAN;
+
+    let mut flags = vec![false; values.len()];
+    flag_plane(&values, &mut flags, NUM_COLS, &FlaggerOptions::default());
+
+    assert!(flags[at(10, 5)]);
+    assert!(flags[at(60, 60)]);
+    let (flagged, total) = count_flags(&flags, (0..NUM_COLS).map(|c| at(40, c)));
+    assert!(flagged * 10 >= total * 9, "burst: {} of {}", flagged, total);
+    let (flagged, total) = count_flags(&flags, (10..30).map(|r| at(r, 50)));
+    assert!(flagged * 10 >= total * 9, "line: {} of {}", flagged, total);
+    let (flagged, total) = count_flags(&flags, (0..NUM_ROWS).map(|r| at(r, 20)));
+    assert_eq!(flagged, total, "persistent line");
+
+    // Little else is flagged
+    let (flagged, total) = count_flags(
+        &flags,
+        (0..values.len()).filter(|i| {
+            let (row, col) = (i / NUM_COLS, i % NUM_COLS);
+            row != 40 && col != 20 && !(col == 50 && (10..30).contains(&row))
+        }),
+    );
+    assert!(
+        flagged * 50 < total,
+        "{} of {} clean samples",
+        flagged,
+        total
+    );
+}
+
+#[test]
+fn test_flag_plane_edge_cases() {
+    let options = FlaggerOptions::default();
+
+    // Existing flags are kept, and a constant plane flags nothing more
+    let values = vec![1.; 8 * 4];
+    let mut flags = vec![false; values.len()];
+    flags[3] = true;
+    flag_plane(&values, &mut flags, 4, &options);
+    assert_eq!(flags.iter().filter(|f| **f).count(), 1);
+
+    // Everything flagged already
+    let mut flags = vec![true; values.len()];
+    flag_plane(&values, &mut flags, 4, &options);
+    assert!(flags.iter().all(|f| *f));
+
+    // A single timestep still flags along frequency
+    let mut values: Vec<f32> = (0..64).map(|i| (i % 7) as f32).collect();
+    values[30] = 1000.;
+    let mut flags = vec![false; values.len()];
+    flag_plane(&values, &mut flags, 64, &options);
+    assert!(flags[30]);
+}
+
+#[test]
+fn test_sum_threshold_windows() {
+    // 1 row of residuals: a run of 4 at 2.0 is over a threshold of 1.5 for windows of 4, but
+    // the single values are not over a threshold of 3
+    let residuals = [0., 0., 2., 2., 2., 2., 0., 0.];
+    let flags = [false; 8];
+    let mut new_flags = [false; 8];
+    sum_threshold_frequency(&residuals, &flags, &mut new_flags, 8, 1, 3.);
+    assert_eq!(new_flags, [false; 8]);
+    sum_threshold_frequency(&residuals, &flags, &mut new_flags, 8, 4, 1.5);
+    assert_eq!(
+        new_flags,
+        [false, false, true, true, true, true, false, false]
+    );
+
+    // The same along time, as 1 column; flagged samples are left out of the window means
+    let mut flags = [false; 8];
+    flags[3] = true;
+    let mut new_flags = flags;
+    sum_threshold_time(&residuals, &flags, &mut new_flags, 1, 4, 1.5);
+    assert_eq!(
+        new_flags,
+        [false, false, true, true, true, true, false, false]
+    );
+}
+
+#[test]
+fn test_visibility_flags() {
+    let mut flags = VisibilityFlags::new(2, 3, 4, 5, 4);
+    assert_eq!(flags.get_num_hdu_visibilities(), 80);
+    assert_eq!(flags.get_hdu_bitmap(1, 2).len(), 2);
+    // Everything starts flagged, but only real visibilities
+    assert_eq!(flags.get_num_flagged(), 2 * 3 * 80);
+
+    let bitmap = flags.get_hdu_bitmap_mut(1, 2);
+    bitmap.iter_mut().for_each(|w| *w = 0);
+    // Fine channel 2, baseline 3, pol 1
+    let bit = (2 * 5 + 3) * 4 + 1;
+    bitmap[bit / 64] |= 1 << (bit % 64);
+    assert!(flags.is_flagged(1, 2, 2, 3, 1));
+    assert!(!flags.is_flagged(1, 2, 2, 3, 0));
+    assert!(flags.is_flagged(1, 1, 2, 3, 0));
+    assert_eq!(flags.get_num_flagged(), 5 * 80 + 1);
+}
+
+#[test]
+fn test_flag_visibilities() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let data = context.read_by_frequency_pooled(0, 0).expect("Error!");
+
+    let flags = flag_visibilities(&context, &FlaggerOptions::default()).unwrap();
+    assert_eq!(flags.num_baselines, 8256);
+    assert_eq!(flags.get_num_hdu_visibilities() * 2, data.len());
+    // NaN visibilities are always flagged
+    for (i, vis) in data.chunks_exact(2).enumerate() {
+        if vis[0].is_nan() || vis[1].is_nan() {
+            let bitmap = flags.get_hdu_bitmap(0, 0);
+            assert_ne!(bitmap[i / 64] & (1 << (i % 64)), 0);
+        }
+    }
+
+    // Flags do not depend on how the work is shared out
+    let options = FlaggerOptions {
+        num_read_workers: 1,
+        num_convert_workers: 3,
+        ..Default::default()
+    };
+    assert_eq!(flag_visibilities(&context, &options).unwrap(), flags);
+
+    let options = FlaggerOptions {
+        threshold_factor: 0.5,
+        ..Default::default()
+    };
+    assert!(matches!(
+        flag_visibilities(&context, &options),
+        Err(FlaggingError::InvalidOptions { .. })
+    ));
+}
@@ -0,0 +1,158 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Per-timestep geometry of the phase centre: local sidereal time, hour angle, parallactic angle,
+azimuth and elevation.
+
+The metafits gives the LST at the scheduled start of the observation; the LST of any other time
+is advanced from it at the sidereal rate, so the two always agree. Each timestep's geometry is for
+the centroid of its integration. Values are stored as contiguous arrays (one element per timestep)
+and computed a quantity at a time over the whole array, so the loops vectorise and consumers can
+index them directly rather than recomputing them per baseline.
+ */
+use std::f64::consts::PI;
+
+use crate::metafits_context::MetafitsContext;
+use crate::timestep::TimeStep;
+use crate::MWA_LATITUDE_RADIANS;
+
+#[cfg(test)]
+mod test;
+
+/// Radians of Earth rotation relative to the stars per second of UT1
+/// (2 pi * 1.00273781191135448 / 86400)
+pub const SIDEREAL_RATE_RAD_PER_S: f64 = 2. * PI * 1.002_737_811_911_354_5 / 86400.;
+
+/// The geometry of the phase centre at each of a context's timesteps. Each array has one element
+/// per timestep, in timestep order.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct TimestepGeometry {
+    /// RA of the phase centre (the tile pointing centre if the metafits has no phase centre)
+    pub ra_rad: f64,
+    /// Dec of the phase centre (the tile pointing centre if the metafits has no phase centre)
+    pub dec_rad: f64,
+    /// Local sidereal time, in [0, 2 pi)
+    pub lst_rad: Vec<f64>,
+    /// Hour angle of the phase centre, in [-pi, pi)
+    pub hour_angle_rad: Vec<f64>,
+    /// Parallactic angle of the phase centre, in (-pi, pi]
+    pub parallactic_angle_rad: Vec<f64>,
+    /// Azimuth of the phase centre (east of north), in [0, 2 pi)
+    pub azimuth_rad: Vec<f64>,
+    /// Elevation (altitude) of the phase centre
+    pub elevation_rad: Vec<f64>,
+}
+
+impl TimestepGeometry {
+    /// Compute the geometry of the phase centre at the centroid of each timestep.
+    ///
+    /// # Arguments
+    ///
+    /// * `metafits_context` - the observation's `MetafitsContext`.
+    ///
+    /// * `timesteps` - the timesteps. Each one's integration is `corr_int_time_ms` long.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A populated `TimestepGeometry`.
+    ///
+    ///
+    pub fn new(metafits_context: &MetafitsContext, timesteps: &[TimeStep]) -> Self {
+        let half_int_time_ms = metafits_context.corr_int_time_ms as f64 / 2.;
+        let lst_rad: Vec<f64> = timesteps
+            .iter()
+            .map(|t| get_lst_rad(metafits_context, t.unix_time_ms as f64 + half_int_time_ms))
+            .collect();
+
+        let ra_rad = metafits_context
+            .ra_phase_center_degrees
+            .unwrap_or(metafits_context.ra_tile_pointing_degrees)
+            .to_radians();
+        let dec_rad = metafits_context
+            .dec_phase_center_degrees
+            .unwrap_or(metafits_context.dec_tile_pointing_degrees)
+            .to_radians();
+
+        Self::from_lsts(lst_rad, ra_rad, dec_rad, MWA_LATITUDE_RADIANS)
+    }
+
+    /// Compute the geometry of a source at some LSTs.
+    ///
+    /// # Arguments
+    ///
+    /// * `lst_rad` - the local sidereal times.
+    ///
+    /// * `ra_rad` - RA of the source.
+    ///
+    /// * `dec_rad` - Dec of the source.
+    ///
+    /// * `latitude_rad` - latitude of the observer.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A populated `TimestepGeometry`, with an element per LST.
+    ///
+    ///
+    pub fn from_lsts(lst_rad: Vec<f64>, ra_rad: f64, dec_rad: f64, latitude_rad: f64) -> Self {
+        let (sin_dec, cos_dec) = dec_rad.sin_cos();
+        let (sin_lat, cos_lat) = latitude_rad.sin_cos();
+        let tan_lat = latitude_rad.tan();
+
+        let hour_angle_rad: Vec<f64> = lst_rad
+            .iter()
+            .map(|lst| (lst - ra_rad + PI).rem_euclid(2. * PI) - PI)
+            .collect();
+        let sin_cos_ha: Vec<(f64, f64)> = hour_angle_rad.iter().map(|h| h.sin_cos()).collect();
+
+        let elevation_rad = sin_cos_ha
+            .iter()
+            .map(|(_, cos_ha)| (sin_lat * sin_dec + cos_lat * cos_dec * cos_ha).asin())
+            .collect();
+        let azimuth_rad = sin_cos_ha
+            .iter()
+            .map(|(sin_ha, cos_ha)| {
+                (-cos_dec * sin_ha)
+                    .atan2(sin_dec * cos_lat - cos_dec * sin_lat * cos_ha)
+                    .rem_euclid(2. * PI)
+            })
+            .collect();
+        let parallactic_angle_rad = sin_cos_ha
+            .iter()
+            .map(|(sin_ha, cos_ha)| sin_ha.atan2(tan_lat * cos_dec - sin_dec * cos_ha))
+            .collect();
+
+        TimestepGeometry {
+            ra_rad,
+            dec_rad,
+            lst_rad,
+            hour_angle_rad,
+            parallactic_angle_rad,
+            azimuth_rad,
+            elevation_rad,
+        }
+    }
+}
+
+/// The local sidereal time at a UNIX time, advanced from the metafits' LST at the scheduled start
+/// of the observation.
+///
+/// # Arguments
+///
+/// * `metafits_context` - the observation's `MetafitsContext`.
+///
+/// * `unix_time_ms` - the UNIX time, in milliseconds.
+///
+///
+/// # Returns
+///
+/// * The LST in radians, in [0, 2 pi).
+///
+///
+pub fn get_lst_rad(metafits_context: &MetafitsContext, unix_time_ms: f64) -> f64 {
+    let elapsed_s = (unix_time_ms - metafits_context.sched_start_unix_time_ms as f64) / 1000.;
+    (metafits_context.lst_rad + elapsed_s * SIDEREAL_RATE_RAD_PER_S).rem_euclid(2. * PI)
+}
@@ -0,0 +1,110 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for per-timestep geometry
+*/
+#[cfg(test)]
+use super::*;
+use float_cmp::*;
+
+fn assert_close(a: f64, b: f64) {
+    assert!(
+        approx_eq!(f64, a, b, epsilon = 1e-9),
+        "{} is not close to {}",
+        a,
+        b
+    );
+}
+
+#[test]
+fn test_geometry_on_meridian() {
+    // A source on the meridian culminates at 90 degrees less its distance from the zenith
+    let latitude = MWA_LATITUDE_RADIANS;
+    let geometry = TimestepGeometry::from_lsts(vec![1.0], 1.0, latitude + 0.2, latitude);
+    assert_close(geometry.hour_angle_rad[0], 0.);
+    assert_close(geometry.elevation_rad[0], PI / 2. - 0.2);
+    // North of the zenith, so due north with a parallactic angle of 180 degrees
+    assert_close(geometry.azimuth_rad[0], 0.);
+    assert_close(geometry.parallactic_angle_rad[0].abs(), PI);
+
+    let geometry = TimestepGeometry::from_lsts(vec![1.0], 1.0, latitude - 0.2, latitude);
+    assert_close(geometry.azimuth_rad[0], PI);
+    assert_close(geometry.parallactic_angle_rad[0], 0.);
+}
+
+#[test]
+fn test_geometry_rising_and_setting() {
+    // A source on the celestial equator rises due east at an hour angle of -6 hours, and sets
+    // due west at +6 hours
+    let lsts = vec![0., PI];
+    let geometry = TimestepGeometry::from_lsts(lsts, PI / 2., 0., MWA_LATITUDE_RADIANS);
+    assert_close(geometry.hour_angle_rad[0], -PI / 2.);
+    assert_close(geometry.hour_angle_rad[1], PI / 2.);
+    for elevation in &geometry.elevation_rad {
+        assert_close(*elevation, 0.);
+    }
+    assert_close(geometry.azimuth_rad[0], PI / 2.);
+    assert_close(geometry.azimuth_rad[1], 3. * PI / 2.);
+
+    // The parallactic angle is antisymmetric about the meridian
+    assert_close(
+        geometry.parallactic_angle_rad[0],
+        -geometry.parallactic_angle_rad[1],
+    );
+    assert!(geometry.parallactic_angle_rad[1] > 0.);
+}
+
+#[test]
+fn test_hour_angle_wraps() {
+    let geometry = TimestepGeometry::from_lsts(vec![0.1], 2. * PI - 0.1, 0., MWA_LATITUDE_RADIANS);
+    assert_close(geometry.hour_angle_rad[0], 0.2);
+    let geometry = TimestepGeometry::from_lsts(vec![2. * PI - 0.1], 0.1, 0., MWA_LATITUDE_RADIANS);
+    assert_close(geometry.hour_angle_rad[0], -0.2);
+}
+
+#[test]
+fn test_timestep_geometry() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let context =
+        MetafitsContext::new(&metafits_filename).expect("Failed to create MetafitsContext");
+
+    // The LST at the scheduled start is the metafits' LST
+    assert_close(
+        get_lst_rad(&context, context.sched_start_unix_time_ms as f64),
+        context.lst_rad,
+    );
+    // One sidereal day later, the LST is the same again
+    assert_close(
+        get_lst_rad(
+            &context,
+            context.sched_start_unix_time_ms as f64 + 2. * PI / SIDEREAL_RATE_RAD_PER_S * 1000.,
+        ),
+        context.lst_rad,
+    );
+
+    let timesteps: Vec<TimeStep> = (0..3)
+        .map(|i| TimeStep {
+            unix_time_ms: context.sched_start_unix_time_ms + i * context.corr_int_time_ms,
+            gps_time_ms: context.sched_start_gps_time_ms + i * context.corr_int_time_ms,
+        })
+        .collect();
+    let geometry = TimestepGeometry::new(&context, &timesteps);
+    assert_eq!(geometry.lst_rad.len(), 3);
+    assert_eq!(geometry.elevation_rad.len(), 3);
+
+    // Each timestep is at its centroid
+    let int_time_s = context.corr_int_time_ms as f64 / 1000.;
+    assert_close(
+        geometry.lst_rad[0],
+        context.lst_rad + int_time_s / 2. * SIDEREAL_RATE_RAD_PER_S,
+    );
+    assert_close(
+        geometry.hour_angle_rad[2] - geometry.hour_angle_rad[1],
+        int_time_s * SIDEREAL_RATE_RAD_PER_S,
+    );
+
+    // This observation is at the zenith
+    assert!(geometry.elevation_rad[0] > 89.5_f64.to_radians());
+}
@@ -0,0 +1,240 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Verification of the FITS checksums (the DATASUM and CHECKSUM keywords) of gpubox and metafits HDUs.
+
+A HDU's DATASUM is the 32 bit ones' complement sum of its data unit, as big endian words; its
+CHECKSUM is set so that the whole HDU (header and data) sums to -0 (0xffffffff). Both are computed
+over the bytes as stored, so for tile compressed HDUs they cover the compressed table. HDUs with
+neither keyword are not verified.
+ */
+use std::fs::File;
+use std::io::{Read, Seek, SeekFrom};
+use std::ops::Range;
+use std::path::Path;
+
+use fitsio::FitsFile;
+use fitsio_sys::ffghadll;
+
+use super::error::GpuboxError;
+use crate::fits_read::error::FitsError;
+use crate::*;
+
+/// Size of the reads made when summing a HDU's bytes; a whole number of 2880 byte FITS blocks.
+const CHECKSUM_READ_BYTES: usize = 2880 * 128;
+
+/// The number of HDUs in files whose checksums were verified.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ChecksumSummary {
+    /// Number of files checked
+    pub num_files: usize,
+    /// Number of HDUs in those files
+    pub num_hdus: usize,
+    /// Number of HDUs which had a DATASUM or CHECKSUM, and so were verified
+    pub num_hdus_verified: usize,
+}
+
+/// Add two 32 bit ones' complement numbers.
+pub fn add_ones_complement(a: u32, b: u32) -> u32 {
+    let (sum, carry) = a.overflowing_add(b);
+    sum + carry as u32
+}
+
+/// The 32 bit ones' complement sum of some bytes, as big endian words.
+///
+/// Words are summed into 8 independent 64 bit lanes with the carries folded in at the end, so the
+/// loop has no dependency between consecutive words and is vectorised.
+///
+/// # Arguments
+///
+/// * `bytes` - the bytes to sum. The length must be a multiple of 4, which it is for whole FITS blocks.
+///
+///
+/// # Returns
+///
+/// * The sum.
+///
+///
+pub fn get_ones_complement_sum(bytes: &[u8]) -> u32 {
+    debug_assert_eq!(bytes.len() % 4, 0);
+
+    let mut lanes = [0_u64; 8];
+    let mut chunks = bytes.chunks_exact(32);
+    for chunk in &mut chunks {
+        for (lane, word) in lanes.iter_mut().zip(chunk.chunks_exact(4)) {
+            *lane += u32::from_be_bytes([word[0], word[1], word[2], word[3]]) as u64;
+        }
+    }
+    let tail: u64 = chunks
+        .remainder()
+        .chunks_exact(4)
+        .map(|word| u32::from_be_bytes([word[0], word[1], word[2], word[3]]) as u64)
+        .sum();
+
+    // Each lane holds at most len / 32 words, so this cannot overflow for any real HDU
+    let mut sum = lanes.iter().sum::<u64>() + tail;
+    while sum >> 32 != 0 {
+        sum = (sum & 0xffff_ffff) + (sum >> 32);
+    }
+    sum as u32
+}
+
+/// Reads byte ranges of a file and sums them.
+pub(crate) struct ChecksumReader {
+    filename: String,
+    file: File,
+    buffer: Vec<u8>,
+}
+
+impl ChecksumReader {
+    /// Open a file to sum byte ranges of.
+    pub(crate) fn open(filename: &str) -> Result<Self, GpuboxError> {
+        let file = File::open(filename).map_err(|source| GpuboxError::ChecksumRead {
+            filename: filename.to_string(),
+            source,
+        })?;
+
+        Ok(ChecksumReader {
+            filename: filename.to_string(),
+            file,
+            buffer: vec![0; CHECKSUM_READ_BYTES],
+        })
+    }
+
+    /// The ones' complement sum of a range of the file's bytes.
+    fn get_sum(&mut self, range: Range<u64>) -> Result<u32, GpuboxError> {
+        let filename = &self.filename;
+        let read_error = |source| GpuboxError::ChecksumRead {
+            filename: filename.clone(),
+            source,
+        };
+        self.file
+            .seek(SeekFrom::Start(range.start))
+            .map_err(read_error)?;
+
+        let mut sum = 0;
+        let mut remaining = (range.end - range.start) as usize;
+        while remaining > 0 {
+            let chunk = &mut self.buffer[..remaining.min(CHECKSUM_READ_BYTES)];
+            self.file.read_exact(chunk).map_err(read_error)?;
+            sum = add_ones_complement(sum, get_ones_complement_sum(chunk));
+            remaining -= chunk.len();
+        }
+        Ok(sum)
+    }
+}
+
+/// Verify the DATASUM and CHECKSUM of one HDU, if it has them.
+///
+/// # Arguments
+///
+/// * `fptr` - the open FITS file.
+///
+/// * `reader` - a `ChecksumReader` of the same file.
+///
+/// * `hdu_index` - the index of the HDU to verify (0 is the primary HDU).
+///
+///
+/// # Returns
+///
+/// * Result containing true if the HDU was verified, false if it has no checksums, or a
+///   `GpuboxError::DatasumMismatch` or `GpuboxError::ChecksumMismatch` if verification fails.
+///
+///
+pub(crate) fn verify_hdu_checksums(
+    fptr: &mut FitsFile,
+    reader: &mut ChecksumReader,
+    hdu_index: usize,
+) -> Result<bool, GpuboxError> {
+    let hdu = fits_open_hdu!(fptr, hdu_index)?;
+    let datasum: Option<u32> = get_optional_fits_key!(fptr, &hdu, "DATASUM")?;
+    let checksum: Option<String> = get_optional_fits_key!(fptr, &hdu, "CHECKSUM")?;
+    if datasum.is_none() && checksum.is_none() {
+        return Ok(false);
+    }
+
+    // The byte offsets of the header, data, and the end of the (padded) data
+    let (mut header_start, mut data_start, mut data_end) = (0, 0, 0);
+    let mut status = 0;
+    unsafe {
+        ffghadll(
+            fptr.as_raw(),
+            &mut header_start,
+            &mut data_start,
+            &mut data_end,
+            &mut status,
+        );
+    }
+    if status != 0 {
+        return Err(FitsError::Fitsio {
+            fits_error: fitsio::errors::Error::Fits(fitsio::errors::FitsError {
+                status,
+                message: format!("cfitsio returned status {} finding HDU offsets", status),
+            }),
+            fits_filename: fptr.filename.clone(),
+            hdu_num: hdu_index + 1,
+            source_file: file!(),
+            source_line: line!(),
+        }
+        .into());
+    }
+
+    let data_sum = reader.get_sum(data_start as u64..data_end as u64)?;
+    if let Some(expected) = datasum {
+        if data_sum != expected {
+            return Err(GpuboxError::DatasumMismatch {
+                filename: reader.filename.clone(),
+                hdu_num: hdu_index + 1,
+                expected,
+                computed: data_sum,
+            });
+        }
+    }
+    if checksum.is_some() {
+        let sum = add_ones_complement(
+            reader.get_sum(header_start as u64..data_start as u64)?,
+            data_sum,
+        );
+        if sum != 0xffff_ffff {
+            return Err(GpuboxError::ChecksumMismatch {
+                filename: reader.filename.clone(),
+                hdu_num: hdu_index + 1,
+                sum,
+            });
+        }
+    }
+
+    Ok(true)
+}
+
+/// Verify the checksums of every HDU in a FITS file.
+///
+/// # Arguments
+///
+/// * `filename` - the FITS file.
+///
+///
+/// # Returns
+///
+/// * Result containing a `ChecksumSummary` of the file, or a `GpuboxError` for the first HDU
+///   which fails verification.
+///
+///
+pub fn verify_file_checksums<T: AsRef<Path>>(filename: T) -> Result<ChecksumSummary, GpuboxError> {
+    let mut fptr = fits_open!(&filename)?;
+    let mut reader = ChecksumReader::open(&fptr.filename.clone())?;
+    let num_hdus = fptr.iter().count();
+
+    let mut summary = ChecksumSummary {
+        num_files: 1,
+        num_hdus,
+        num_hdus_verified: 0,
+    };
+    for hdu_index in 0..num_hdus {
+        summary.num_hdus_verified +=
+            verify_hdu_checksums(&mut fptr, &mut reader, hdu_index)? as usize;
+    }
+    Ok(summary)
+}
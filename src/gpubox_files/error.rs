@@ -16,9 +16,21 @@ pub enum GpuboxError {
     #[error("Invalid coarse chan index provided. The coarse chan index must be between 0 and {0}")]
     InvalidCoarseChanIndex(usize),
 
+    #[error("Invalid buffer size provided. The buffer holds {buffer_len} floats but at least {expected_len} are required")]
+    InvalidBufferSize {
+        buffer_len: usize,
+        expected_len: usize,
+    },
+
     #[error("No gpubox / mwax fits files were supplied")]
     NoGpuboxes,
 
+    #[error("None of the supplied gpubox / mwax fits files are for the selected channels")]
+    NoGpuboxesSelected,
+
+    #[error("None of the supplied gpubox / mwax fits files have HDUs in the selected time range")]
+    NoTimestepsSelected,
+
     #[error("There are a mixture of gpubox filename types!")]
     Mixture,
 
@@ -92,7 +104,77 @@ maybe you have a mix of different files?"#)]
         metafits_baselines: usize,
     },
 
+    /// Error when a range of baselines or fine channels is outside a coarse channel's data.
+    #[error(
+        "Rows {start}..{end} were requested but a timestep of a coarse channel has {num_rows} rows"
+    )]
+    InvalidRowRange {
+        start: usize,
+        end: usize,
+        num_rows: usize,
+    },
+
+    /// Error when an antenna remap was built for a context of another observation or correlator.
+    #[error("The antenna remap was built for {remap_num_ants} antennas ({remap_kind} data), but this context has {num_ants} antennas ({kind} data)")]
+    AntennaRemapMismatch {
+        remap_num_ants: usize,
+        remap_kind: &'static str,
+        num_ants: usize,
+        kind: &'static str,
+    },
+
+    /// Error when reading an HDU which no gpubox file has (possible for contexts with all timesteps).
+    #[error("No gpubox file has an HDU for timestep index {timestep_index} and coarse channel index {coarse_chan_index}")]
+    MissingHdu {
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    },
+
+    /// Error when the HDU of a timestep and coarse channel is indexed, but its gpubox file is not
+    /// in the batch the index points to.
+    #[error("No gpubox file holds the data for timestep index {timestep_index} and coarse channel index {coarse_chan_index}")]
+    NoDataForTimeStepCoarseChannel {
+        timestep_index: usize,
+        coarse_chan_index: usize,
+    },
+
+    /// Error when legacy data cannot be converted because the rf inputs do not fill whole fine PFBs.
+    #[error("Legacy correlator data needs a multiple of 64 rf inputs (32 tiles) to be converted, but the metafits has {0}")]
+    InvalidLegacyRfInputCount(usize),
+
+    /// Error when a scan cache read is asked of a context without a scan cache.
+    #[error("This context has no scan cache")]
+    NoScanCache,
+
+    /// Error when the data of a HDU does not sum to its DATASUM.
+    #[error("HDU {hdu_num} of {filename} failed checksum verification: its data sums to {computed} but DATASUM is {expected}")]
+    DatasumMismatch {
+        filename: String,
+        hdu_num: usize,
+        expected: u32,
+        computed: u32,
+    },
+
+    /// Error when the header and data of a HDU with a CHECKSUM do not sum to -0.
+    #[error("HDU {hdu_num} of {filename} failed checksum verification: it sums to {sum:#010x} rather than 0xffffffff")]
+    ChecksumMismatch {
+        filename: String,
+        hdu_num: usize,
+        sum: u32,
+    },
+
+    /// Error when a file cannot be read to verify its checksums.
+    #[error("Could not read {filename} to verify its checksums: {source}")]
+    ChecksumRead {
+        filename: String,
+        source: std::io::Error,
+    },
+
     /// An error derived from `FitsError`.
     #[error("{0}")]
     Fits(#[from] crate::fits_read::error::FitsError),
+
+    /// An error derived from `ScanCacheError`.
+    #[error("{0}")]
+    ScanCache(#[from] crate::scan_cache::error::ScanCacheError),
 }
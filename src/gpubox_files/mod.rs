@@ -5,10 +5,12 @@
 /*!
 Functions for organising and checking the consistency of gpubox files.
 */
+pub mod checksum;
 pub mod error;
 
 use std::collections::BTreeMap;
 use std::fmt;
+use std::ops::Range;
 use std::path::Path;
 
 use fitsio::{hdu::FitsHdu, FitsFile};
@@ -16,6 +18,7 @@ use rayon::prelude::*;
 use regex::Regex;
 
 use crate::*;
+pub use checksum::{verify_file_checksums, ChecksumSummary};
 pub use error::GpuboxError;
 
 #[cfg(test)]
@@ -129,6 +132,37 @@ lazy_static::lazy_static! {
 /// indices.
 pub(crate) type GpuboxTimeMap = BTreeMap<u64, BTreeMap<usize, (usize, usize)>>;
 
+/// Restricts which gpubox files and HDUs are examined when a context is created.
+/// The default selects everything.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct GpuboxSelection {
+    /// Only examine gpubox files for these channels, as parsed from the filenames: the
+    /// gpubox number for legacy files (e.g. 5 for "gpubox05") or the receiver channel
+    /// number for MWAX files (e.g. 114 for "ch114"). `None` selects all channels.
+    pub channel_identifiers: Option<Vec<usize>>,
+    /// Only index HDUs whose start time (UNIX time in milliseconds) is in this range.
+    /// `None` selects all times.
+    pub unix_time_range_ms: Option<Range<u64>>,
+}
+
+impl GpuboxSelection {
+    /// Returns true if files for this channel identifier are selected
+    pub fn contains_channel(&self, channel_identifier: usize) -> bool {
+        match &self.channel_identifiers {
+            Some(c) => c.contains(&channel_identifier),
+            None => true,
+        }
+    }
+
+    /// Returns true if an HDU starting at this UNIX time (in milliseconds) is selected
+    pub fn contains_unix_time_ms(&self, unix_time_ms: u64) -> bool {
+        match &self.unix_time_range_ms {
+            Some(r) => r.contains(&unix_time_ms),
+            None => true,
+        }
+    }
+}
+
 /// A little struct to help us not get confused when dealing with the returned
 /// values from complex functions.
 pub(crate) struct GpuboxInfo {
@@ -216,6 +250,12 @@ fn convert_temp_gpuboxes(temp_gpuboxes: Vec<TempGpuBoxFile>) -> Vec<GpuBoxBatch>
 ///
 /// * `metafits_obs_id` - The obs_id reported from the metafits file primary HDU
 ///
+/// * `thread_pool` - Optional thread pool in which to read the gpubox files in parallel. If `None`
+///                   rayon's global pool is used.
+///
+/// * `selection` - Which channels and times to examine. Files for other channels are never opened,
+///                 and files with no HDUs in the time range are left out.
+///
 /// # Returns
 ///
 /// * A Result containing a vector of GPUBoxBatch structs, the MWA Correlator
@@ -226,10 +266,33 @@ fn convert_temp_gpuboxes(temp_gpuboxes: Vec<TempGpuBoxFile>) -> Vec<GpuBoxBatch>
 pub(crate) fn examine_gpubox_files<T: AsRef<Path>>(
     gpubox_filenames: &[T],
     metafits_obs_id: u32,
+    thread_pool: Option<&rayon::ThreadPool>,
+    selection: &GpuboxSelection,
 ) -> Result<GpuboxInfo, GpuboxError> {
-    let (temp_gpuboxes, corr_format, _) = determine_gpubox_batches(gpubox_filenames)?;
+    let (mut temp_gpuboxes, corr_format, _) = determine_gpubox_batches(gpubox_filenames)?;
+
+    // Drop unselected channels using only the channel parsed from each filename
+    temp_gpuboxes.retain(|g| selection.contains_channel(g.channel_identifier));
+    if temp_gpuboxes.is_empty() {
+        return Err(GpuboxError::NoGpuboxesSelected);
+    }
+
+    let time_map = thread_pool::install(thread_pool, || {
+        create_time_map(&temp_gpuboxes, corr_format, selection)
+    })?;
+    if time_map.is_empty() {
+        return Err(GpuboxError::NoTimestepsSelected);
+    }
 
-    let time_map = create_time_map(&temp_gpuboxes, corr_format)?;
+    // Drop files which have no HDUs in the selected time range, so they are not opened again
+    // below. Their (now empty) batches are kept so that batch numbers still index the batches.
+    if selection.unix_time_range_ms.is_some() {
+        temp_gpuboxes.retain(|g| {
+            time_map.values().any(
+                |m| matches!(m.get(&g.channel_identifier), Some((b, _)) if *b == g.batch_number),
+            )
+        });
+    }
 
     let mut batches = convert_temp_gpuboxes(temp_gpuboxes);
 
@@ -451,6 +514,8 @@ fn determine_hdu_time(
 ///
 /// * `correlator_version` - enum telling us which correlator version the observation was created by.
 ///
+/// * `unix_time_range_ms` - if given, only HDUs starting in this range are included.
+///
 ///
 /// # Returns
 ///
@@ -460,12 +525,16 @@ fn determine_hdu_time(
 fn map_unix_times_to_hdus(
     gpubox_fptr: &mut FitsFile,
     correlator_version: CorrelatorVersion,
+    unix_time_range_ms: Option<&Range<u64>>,
 ) -> Result<BTreeMap<u64, usize>, FitsError> {
     let mut map = BTreeMap::new();
     let last_hdu_index = gpubox_fptr.iter().count();
     // The new correlator has a "weights" HDU in each alternating HDU. Skip
-    // those.
-    let step_size = if correlator_version == CorrelatorVersion::V2 {
+    // those. Files converted from the legacy format may have been written
+    // without them; then the second HDU is the same shape as the first.
+    let step_size = if correlator_version == CorrelatorVersion::V2
+        && mwax_has_weights_hdus(gpubox_fptr, last_hdu_index)?
+    {
         2
     } else {
         1
@@ -475,12 +544,50 @@ fn map_unix_times_to_hdus(
     for hdu_index in (1..last_hdu_index).step_by(step_size) {
         let hdu = fits_open_hdu!(gpubox_fptr, hdu_index)?;
         let time = determine_hdu_time(gpubox_fptr, &hdu)?;
+        if let Some(range) = unix_time_range_ms {
+            // HDUs are written in time order, so nothing after this one can be in range
+            if time >= range.end {
+                break;
+            }
+            if time < range.start {
+                continue;
+            }
+        }
         map.insert(time, hdu_index);
     }
 
     Ok(map)
 }
 
+/// Determine whether an MWAX gpubox file has a weights HDU after each visibility HDU, by
+/// comparing the widths of its first two image HDUs (weights HDUs are only one float per
+/// polarisation wide).
+///
+///
+/// # Arguments
+///
+/// * `gpubox_fptr` - A FitsFile reference to this gpubox file.
+///
+/// * `num_hdus` - The number of HDUs in the file, including the primary HDU.
+///
+///
+/// # Returns
+///
+/// * A Result containing true if the file has weights HDUs, or an error.
+///
+///
+fn mwax_has_weights_hdus(gpubox_fptr: &mut FitsFile, num_hdus: usize) -> Result<bool, FitsError> {
+    if num_hdus < 3 {
+        return Ok(true);
+    }
+    let first_hdu = fits_open_hdu!(gpubox_fptr, 1)?;
+    let first_naxis1: usize = get_required_fits_key!(gpubox_fptr, &first_hdu, "NAXIS1")?;
+    let second_hdu = fits_open_hdu!(gpubox_fptr, 2)?;
+    let second_naxis1: usize = get_required_fits_key!(gpubox_fptr, &second_hdu, "NAXIS1")?;
+
+    Ok(first_naxis1 != second_naxis1)
+}
+
 /// Validate that the correlator version we worked out from the filename does not contradict
 /// the CORR_VER key from MWAX files or absence of that key for legacy correlator.
 ///
@@ -586,6 +693,8 @@ fn validate_gpubox_metadata_obs_id(
 ///
 /// * `correlator_version` - enum telling us which correlator version the observation was created by.
 ///
+/// * `selection` - Only HDUs inside its time range are indexed.
+///
 ///
 /// # Returns
 ///
@@ -595,6 +704,7 @@ fn validate_gpubox_metadata_obs_id(
 fn create_time_map(
     gpuboxes: &[TempGpuBoxFile],
     correlator_version: CorrelatorVersion,
+    selection: &GpuboxSelection,
 ) -> Result<GpuboxTimeMap, GpuboxError> {
     // Ugly hack to open up all the HDUs of the gpubox files in parallel. We
     // can't do this over the `GPUBoxBatch` or `GPUBoxFile` structs because they
@@ -623,7 +733,12 @@ fn create_time_map(
             }
 
             // Get the UNIX times from each of the HDUs of this `FitsFile`.
-            map_unix_times_to_hdus(&mut fptr, correlator_version).map_err(GpuboxError::from)
+            map_unix_times_to_hdus(
+                &mut fptr,
+                correlator_version,
+                selection.unix_time_range_ms.as_ref(),
+            )
+            .map_err(GpuboxError::from)
         })
         .collect::<Vec<Result<BTreeMap<u64, usize>, GpuboxError>>>();
 
@@ -660,7 +775,8 @@ fn create_time_map(
 ///
 /// In this example, we start collecting data from time=2, and end at time=e,
 /// because these are the first and last places that all gpubox files have
-/// data. All dangling data is ignored.
+/// data. All dangling data is ignored, unless `all_timesteps` is set, in which
+/// case we start at time=0 and end at time=f.
 ///
 /// See tests of this function or `obs_context.rs` for examples of constructing
 /// the input to this function.
@@ -672,6 +788,8 @@ fn create_time_map(
 ///
 /// * `integration_time_ms` - Correlator dump time (so we know the gap between timesteps)
 ///
+/// * `all_timesteps` - if true, span the times of any gpubox file rather than only those common to all of them.
+///
 /// # Returns
 ///
 /// * A struct containing the start and end times based on what we actually got, so all coarse channels match.
@@ -680,6 +798,7 @@ fn create_time_map(
 pub(crate) fn determine_obs_times(
     gpubox_time_map: &GpuboxTimeMap,
     integration_time_ms: u64,
+    all_timesteps: bool,
 ) -> Result<ObsTimes, GpuboxError> {
     // Find the maximum number of gpubox files, and assume that this is the
     // total number of input gpubox files.
@@ -694,7 +813,7 @@ pub(crate) fn determine_obs_times(
 
     let mut i = gpubox_time_map
         .iter()
-        .filter(|(_, submap)| submap.len() == size);
+        .filter(|(_, submap)| all_timesteps || submap.len() == size);
     // unwrap is safe because an empty map is checked above.
     let proper_start_millisec = i.next().map(|(time, _)| *time).unwrap();
     let proper_end_millisec = match i.last().map(|(time, _)| *time) {
@@ -8,6 +8,7 @@ Unit tests for gpubox file metadata
 #[cfg(test)]
 use super::*;
 use crate::misc::test::*;
+use checksum::*;
 use fitsio::images::{ImageDescription, ImageType};
 use std::time::SystemTime;
 
@@ -394,12 +395,55 @@ fn test_map_unix_times_to_hdus_test() {
             expected.insert(time * 1000 + millitime, i + 1);
         }
 
-        let result = map_unix_times_to_hdus(fptr, CorrelatorVersion::Legacy);
+        let result = map_unix_times_to_hdus(fptr, CorrelatorVersion::Legacy, None);
         assert!(result.is_ok());
         assert_eq!(result.unwrap(), expected);
+
+        // Only the middle HDU starts inside this range
+        let range = 1_381_844_924_000..1_381_844_950_000;
+        let result = map_unix_times_to_hdus(fptr, CorrelatorVersion::Legacy, Some(&range));
+        let mut expected_in_range = BTreeMap::new();
+        expected_in_range.insert(1_381_844_924_000, 2);
+        assert_eq!(result.unwrap(), expected_in_range);
     });
 }
 
+#[test]
+fn test_gpubox_selection() {
+    let selection = GpuboxSelection::default();
+    assert!(selection.contains_channel(1));
+    assert!(selection.contains_unix_time_ms(0));
+
+    let selection = GpuboxSelection {
+        channel_identifiers: Some(vec![5, 6, 7, 8]),
+        unix_time_range_ms: Some(1000..31000),
+    };
+    assert!(selection.contains_channel(5));
+    assert!(!selection.contains_channel(9));
+    assert!(!selection.contains_unix_time_ms(999));
+    assert!(selection.contains_unix_time_ms(1000));
+    assert!(selection.contains_unix_time_ms(30999));
+    assert!(!selection.contains_unix_time_ms(31000));
+}
+
+#[test]
+fn test_examine_gpubox_files_no_channels_selected() {
+    // The files are filtered on their filenames, so they don't need to exist
+    let files = vec![
+        "1065880128_20131015134930_gpubox01_00.fits",
+        "1065880128_20131015134930_gpubox02_00.fits",
+    ];
+    let selection = GpuboxSelection {
+        channel_identifiers: Some(vec![3]),
+        unix_time_range_ms: None,
+    };
+
+    assert!(matches!(
+        examine_gpubox_files(&files, 1_065_880_128, None, &selection),
+        Err(GpuboxError::NoGpuboxesSelected)
+    ));
+}
+
 #[test]
 fn test_determine_obs_times_test_many_timesteps() {
     // Create two files, with mostly overlapping times, but also a little
@@ -437,7 +481,7 @@ fn test_determine_obs_times_test_many_timesteps() {
     // == 1_381_844_925_500 - 1_381_844_923_500 + 500
     let expected_duration = 2500;
 
-    let result = determine_obs_times(&input, integration_time_ms);
+    let result = determine_obs_times(&input, integration_time_ms, false);
     assert!(result.is_ok());
     let result = result.unwrap();
     assert_eq!(result.start_millisec, expected_start);
@@ -478,7 +522,7 @@ fn test_determine_obs_times_test_one_timestep() {
     // == 1_381_844_923_500 - 1_381_844_923_500 + 500
     let expected_duration = 500;
 
-    let result = determine_obs_times(&input, integration_time_ms);
+    let result = determine_obs_times(&input, integration_time_ms, false);
     assert!(result.is_ok());
     let result = result.unwrap();
     assert_eq!(result.start_millisec, expected_start);
@@ -486,6 +530,37 @@ fn test_determine_obs_times_test_one_timestep() {
     assert_eq!(result.duration_millisec, expected_duration);
 }
 
+#[test]
+fn test_determine_obs_times_test_all_timesteps() {
+    // Two files with a dangling time at the start (gpubox 0) and end (gpubox 1);
+    // with all_timesteps, the dangling times are kept.
+    let integration_time_ms = 500;
+
+    let mut input = BTreeMap::new();
+    let mut new_time_tree = BTreeMap::new();
+    new_time_tree.insert(0, (0, 1));
+    input.insert(1_381_844_923_000, new_time_tree);
+
+    let mut new_time_tree = BTreeMap::new();
+    new_time_tree.insert(0, (0, 2));
+    new_time_tree.insert(1, (0, 1));
+    input.insert(1_381_844_923_500, new_time_tree);
+
+    let mut new_time_tree = BTreeMap::new();
+    new_time_tree.insert(1, (0, 2));
+    input.insert(1_381_844_924_000, new_time_tree);
+
+    let result = determine_obs_times(&input, integration_time_ms, true).unwrap();
+    assert_eq!(result.start_millisec, 1_381_844_923_000);
+    assert_eq!(result.end_millisec, 1_381_844_924_500);
+    assert_eq!(result.duration_millisec, 1500);
+
+    let result = determine_obs_times(&input, integration_time_ms, false).unwrap();
+    assert_eq!(result.start_millisec, 1_381_844_923_500);
+    assert_eq!(result.end_millisec, 1_381_844_924_000);
+    assert_eq!(result.duration_millisec, 500);
+}
+
 #[test]
 fn test_validate_gpubox_metadata_correlator_version() {
     // with_temp_file creates a temp dir and temp file, then removes them once out of scope
@@ -619,3 +694,108 @@ fn test_validate_gpubox_metadata_obsid() {
         },
     );
 }
+
+#[test]
+fn test_ones_complement_sum() {
+    assert_eq!(add_ones_complement(1, 2), 3);
+    // The carry out of the top bit wraps around
+    assert_eq!(add_ones_complement(0xffff_ffff, 2), 2);
+    assert_eq!(add_ones_complement(0xffff_fffe, 1), 0xffff_ffff);
+
+    assert_eq!(get_ones_complement_sum(&[]), 0);
+    assert_eq!(get_ones_complement_sum(&[0, 0, 1, 2, 0, 0, 0, 3]), 0x0105);
+    // Words are big endian
+    assert_eq!(get_ones_complement_sum(&[1, 0, 0, 0]), 0x0100_0000);
+
+    // The lanes agree with summing one word at a time, including the tail after the lanes
+    let bytes: Vec<u8> = (0..2880 + 12).map(|i| (i * 37 % 251) as u8).collect();
+    let expected = bytes.chunks_exact(4).fold(0, |sum, word| {
+        add_ones_complement(
+            sum,
+            u32::from_be_bytes([word[0], word[1], word[2], word[3]]),
+        )
+    });
+    assert_eq!(get_ones_complement_sum(&bytes), expected);
+
+    // Sums of parts combine into the sum of the whole
+    let (first, second) = bytes.split_at(1440);
+    assert_eq!(
+        add_ones_complement(
+            get_ones_complement_sum(first),
+            get_ones_complement_sum(second)
+        ),
+        expected
+    );
+}
+
+/// Write a FITS file with a float image HDU, with or without checksums
+fn write_checksum_test_file(filename: &Path, with_checksums: bool) {
+    let mut fptr = fitsio::FitsFile::create(filename)
+        .open()
+        .expect("Couldn't create FITS file");
+    let image_description = ImageDescription {
+        data_type: ImageType::Float,
+        dimensions: &[16, 10],
+    };
+    let hdu = fptr
+        .create_image("EXTNAME".to_string(), &image_description)
+        .unwrap();
+    let data: Vec<f32> = (0..160).map(|i| i as f32 * 0.25 - 7.).collect();
+    hdu.write_image(&mut fptr, &data).unwrap();
+
+    if with_checksums {
+        for hdu_index in 0..2 {
+            fits_open_hdu!(&mut fptr, hdu_index).unwrap();
+            let mut status = 0;
+            unsafe {
+                fitsio_sys::ffpcks(fptr.as_raw(), &mut status);
+            }
+            assert_eq!(status, 0);
+        }
+    }
+}
+
+#[test]
+fn test_verify_file_checksums() {
+    let dir = tempdir::TempDir::new("mwalib_checksum_test").unwrap();
+
+    // Without checksums nothing is verified
+    let filename = dir.path().join("no_checksums.fits");
+    write_checksum_test_file(&filename, false);
+    assert_eq!(
+        verify_file_checksums(&filename).unwrap(),
+        ChecksumSummary {
+            num_files: 1,
+            num_hdus: 2,
+            num_hdus_verified: 0
+        }
+    );
+
+    let filename = dir.path().join("checksums.fits");
+    write_checksum_test_file(&filename, true);
+    assert_eq!(
+        verify_file_checksums(&filename).unwrap().num_hdus_verified,
+        2
+    );
+
+    // Flip a bit in the last data block, which is HDU 2's
+    let mut bytes = std::fs::read(&filename).unwrap();
+    let index = bytes.len() - 2880 + 100;
+    bytes[index] ^= 0x10;
+    std::fs::write(&filename, &bytes).unwrap();
+    assert!(matches!(
+        verify_file_checksums(&filename),
+        Err(GpuboxError::DatasumMismatch { hdu_num: 2, .. })
+    ));
+
+    // A changed header (here the padding after END) fails the CHECKSUM, but not the DATASUM
+    bytes[index] ^= 0x10;
+    let header_index = bytes.len() - 2880 - 1;
+    assert_eq!(bytes[header_index], b' ');
+    bytes[header_index] = b'X';
+    std::fs::write(&filename, &bytes).unwrap();
+    assert!(matches!(
+        verify_file_checksums(&filename),
+        Err(GpuboxError::ChecksumMismatch { hdu_num: 2, .. })
+    ));
+}
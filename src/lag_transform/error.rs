@@ -0,0 +1,35 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with lag (delay) transforms.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum LagTransformError {
+    /// Error when a dimension of the data to transform is 0.
+    #[error("Cannot lag transform data with {num_baselines} baselines, {num_chans} channels and {num_pols} pols")]
+    InvalidDimensions {
+        num_baselines: usize,
+        num_chans: usize,
+        num_pols: usize,
+    },
+
+    /// Error when an input or output buffer is not the size the dimensions require.
+    #[error("Invalid buffer size provided. The buffer holds {buffer_len} floats but {expected_len} are required")]
+    InvalidBufferSize {
+        buffer_len: usize,
+        expected_len: usize,
+    },
+
+    /// Error when no coarse channels are given to stitch together.
+    #[error("At least one coarse channel is required")]
+    NoCoarseChans,
+
+    /// An error derived from `GpuboxError`.
+    #[error("{0}")]
+    Gpubox(#[from] crate::gpubox_files::error::GpuboxError),
+}
@@ -0,0 +1,452 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Lag (delay) transforms of visibilities over the fine channel axis, for delay spectra and cable
+reflection diagnostics.
+
+Each baseline and pol's complex spectrum is optionally windowed, Fourier transformed over
+frequency and written out contiguously as [baseline][pol][lag][r][i], with the lags in increasing
+delay order (zero delay at index `num_lags / 2`, like numpy's `fftshift`). Baselines are
+transformed in parallel in the current rayon thread pool, each worker reusing its own working
+space. The FFTs are `rustfft`'s; each thread keeps one planner, which caches the plan of every
+length it has been asked for. The transform is unnormalised: X(tau) = sum over channels of w(f) V(f) e^(2 pi i f tau),
+so a visibility with a phase slope of e^(-2 pi i f tau0) (a delay of tau0) peaks at lag tau0.
+
+`get_lag_spectra` stitches coarse channels into one band before transforming. Coarse channels
+are placed by receiver channel number, so missing coarse channels (whether not asked for, or with
+no HDU at the timestep) are gaps of zeros and the lags stay correct. Non-finite visibilities are treated as missing.
+
+Visibilities are complex, so this is a complex to complex transform; the lags of a real spectrum
+(e.g. an auto-correlation's XX) are conjugate symmetric.
+ */
+pub mod error;
+pub use error::LagTransformError;
+
+use std::cell::RefCell;
+use std::f64::consts::PI;
+use std::sync::Arc;
+
+use rayon::prelude::*;
+use rustfft::num_complex::Complex32;
+use rustfft::{Fft, FftPlanner};
+
+use crate::correlator_context::CorrelatorContext;
+use crate::gpubox_files::GpuboxError;
+
+#[cfg(test)]
+mod test;
+
+thread_local! {
+    /// Plans the lag transform FFTs. The planner caches each length's plan, so every transform of
+    /// a length after the first reuses it.
+    static FFT_PLANNER: RefCell<FftPlanner<f32>> = RefCell::new(FftPlanner::new());
+}
+
+/// The forward FFT plan for a number of lags, from this thread's planner.
+fn get_fft_plan(num_lags: usize) -> Arc<dyn Fft<f32>> {
+    FFT_PLANNER.with(|planner| planner.borrow_mut().plan_fft_forward(num_lags))
+}
+
+/// A window applied over the channels of a spectrum before it is lag transformed.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum LagWindow {
+    /// No window
+    Rectangular,
+    /// Hann (raised cosine) window
+    Hann,
+    /// 4 term Blackman-Harris window, for high dynamic range
+    BlackmanHarris,
+}
+
+impl LagWindow {
+    /// The window's weight for each of `num_chans` channels.
+    pub fn get_weights(&self, num_chans: usize) -> Vec<f32> {
+        // Cosine series coefficients
+        let coefficients: &[f64] = match self {
+            LagWindow::Rectangular => &[1.],
+            LagWindow::Hann => &[0.5, 0.5],
+            LagWindow::BlackmanHarris => &[0.35875, 0.48829, 0.14128, 0.01168],
+        };
+
+        if num_chans == 1 {
+            return vec![1.];
+        }
+        let denominator = (num_chans - 1) as f64;
+        (0..num_chans)
+            .map(|n| {
+                let x = 2. * PI * n as f64 / denominator;
+                coefficients
+                    .iter()
+                    .enumerate()
+                    .map(|(k, a)| match k % 2 {
+                        0 => a * (k as f64 * x).cos(),
+                        _ => -a * (k as f64 * x).cos(),
+                    })
+                    .sum::<f64>() as f32
+            })
+            .collect()
+    }
+}
+
+/// The lag transformed visibilities of one timestep.
+#[derive(Clone, Debug)]
+pub struct LagSpectra {
+    /// Number of baselines
+    pub num_baselines: usize,
+    /// Number of visibility pols
+    pub num_pols: usize,
+    /// Number of lags, which is the number of channels transformed (including any gaps)
+    pub num_lags: usize,
+    /// Delay of each lag, in seconds
+    pub lag_delays_s: Vec<f64>,
+    /// Lags as [baseline][pol][lag][r][i]
+    pub data: Vec<f32>,
+}
+
+/// The delays of the lags of a transform, in increasing order.
+///
+/// # Arguments
+///
+/// * `num_lags` - number of lags (channels transformed).
+///
+/// * `chan_width_hz` - width of each channel.
+///
+///
+/// # Returns
+///
+/// * The delay of each lag in seconds. Lag `num_lags / 2` is zero delay.
+///
+///
+pub fn get_lag_delays_s(num_lags: usize, chan_width_hz: f64) -> Vec<f64> {
+    let bandwidth_hz = num_lags as f64 * chan_width_hz;
+    (0..num_lags)
+        .map(|j| (j as f64 - (num_lags / 2) as f64) / bandwidth_hz)
+        .collect()
+}
+
+/// A band of channels to transform, e.g. one coarse channel of `read_by_baseline` output.
+struct Band<'a> {
+    /// [baseline][chan][pol][r][i]
+    data: &'a [f32],
+    /// Index of the band's first channel within the (stitched) spectrum
+    chan_offset: usize,
+}
+
+/// Lag transform stitched bands. See the module documentation.
+///
+/// # Arguments
+///
+/// * `bands` - the bands, each of `num_band_chans` channels, at their offsets in the spectrum.
+///
+/// * `num_band_chans` - number of channels in each band.
+///
+/// * `num_pols` - number of visibility pols.
+///
+/// * `weights` - window weight of each channel of the spectrum. Its length is the number of lags.
+///
+/// * `output` - [baseline][pol][lag][r][i] buffer; its length sets the number of baselines.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+fn transform_bands(
+    bands: &[Band],
+    num_band_chans: usize,
+    num_pols: usize,
+    weights: &[f32],
+    output: &mut [f32],
+) {
+    let num_lags = weights.len();
+    let plan = get_fft_plan(num_lags);
+    let band_baseline_floats = num_band_chans * num_pols * 2;
+    let lag_floats = num_lags * 2;
+    // Lag j is FFT bin (j + shift) % num_lags
+    let shift = num_lags - num_lags / 2;
+
+    output
+        .par_chunks_mut(num_pols * lag_floats)
+        .enumerate()
+        .for_each_init(
+            || {
+                (
+                    vec![Complex32::default(); num_lags],
+                    vec![Complex32::default(); plan.get_inplace_scratch_len()],
+                )
+            },
+            |(spectrum, scratch), (baseline_index, baseline_output)| {
+                for (pol, pol_output) in baseline_output.chunks_exact_mut(lag_floats).enumerate() {
+                    spectrum.iter_mut().for_each(|c| *c = Complex32::default());
+                    for band in bands {
+                        let baseline_data = &band.data[baseline_index * band_baseline_floats..]
+                            [..band_baseline_floats];
+                        let chans = &mut spectrum[band.chan_offset..][..num_band_chans];
+                        let band_weights = &weights[band.chan_offset..][..num_band_chans];
+                        for ((c, vis), w) in chans
+                            .iter_mut()
+                            .zip(baseline_data.chunks_exact(num_pols * 2))
+                            .zip(band_weights)
+                        {
+                            let (re, im) = (vis[pol * 2], vis[pol * 2 + 1]);
+                            // Conjugated, so the forward FFT gives the conjugate of the lags
+                            if re.is_finite() && im.is_finite() {
+                                *c = Complex32::new(re * w, -im * w);
+                            }
+                        }
+                    }
+
+                    plan.process_with_scratch(spectrum, scratch);
+
+                    let shifted = spectrum[shift..].iter().chain(spectrum[..shift].iter());
+                    for (out, c) in pol_output.chunks_exact_mut(2).zip(shifted) {
+                        out[0] = c.re;
+                        out[1] = -c.im;
+                    }
+                }
+            },
+        );
+}
+
+/// Lag transform visibilities in `read_by_baseline` order, over their fine channels. Runs in
+/// the current rayon thread pool.
+///
+/// # Arguments
+///
+/// * `data` - visibilities as [baseline][fine_chan][pol][r][i].
+///
+/// * `num_baselines` - number of baselines.
+///
+/// * `num_fine_chans` - number of fine channels, which is the number of lags.
+///
+/// * `num_pols` - number of visibility pols.
+///
+/// * `window` - window to apply over the fine channels.
+///
+/// * `output` - buffer of the same size as `data`, written as [baseline][pol][lag][r][i].
+///
+///
+/// # Returns
+///
+/// * Result containing nothing, or a `LagTransformError` if the dimensions or buffers are invalid.
+///
+///
+pub fn lag_transform_by_baseline(
+    data: &[f32],
+    num_baselines: usize,
+    num_fine_chans: usize,
+    num_pols: usize,
+    window: LagWindow,
+    output: &mut [f32],
+) -> Result<(), LagTransformError> {
+    if num_baselines == 0 || num_fine_chans == 0 || num_pols == 0 {
+        return Err(LagTransformError::InvalidDimensions {
+            num_baselines,
+            num_chans: num_fine_chans,
+            num_pols,
+        });
+    }
+    let expected_len = num_baselines * num_fine_chans * num_pols * 2;
+    for buffer_len in &[data.len(), output.len()] {
+        if *buffer_len != expected_len {
+            return Err(LagTransformError::InvalidBufferSize {
+                buffer_len: *buffer_len,
+                expected_len,
+            });
+        }
+    }
+
+    let bands = [Band {
+        data,
+        chan_offset: 0,
+    }];
+    transform_bands(
+        &bands,
+        num_fine_chans,
+        num_pols,
+        &window.get_weights(num_fine_chans),
+        output,
+    );
+
+    Ok(())
+}
+
+/// The number of lags of a stitched transform of some coarse channels: the fine channels from
+/// the lowest to the highest receiver channel, including any gaps.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext`.
+///
+/// * `coarse_chan_indices` - indices within the context's coarse_chans.
+///
+///
+/// # Returns
+///
+/// * Result containing the number of lags, or a `LagTransformError`.
+///
+///
+pub fn get_num_stitched_lags(
+    context: &CorrelatorContext,
+    coarse_chan_indices: &[usize],
+) -> Result<usize, LagTransformError> {
+    let rec_chans = get_rec_chans(context, coarse_chan_indices)?;
+    let (first, last) = (rec_chans[0], rec_chans[rec_chans.len() - 1]);
+
+    Ok((last - first + 1) * context.metafits_context.num_corr_fine_chans_per_coarse)
+}
+
+/// The receiver channel numbers of some coarse channels, sorted, after checking the indices.
+fn get_rec_chans(
+    context: &CorrelatorContext,
+    coarse_chan_indices: &[usize],
+) -> Result<Vec<usize>, LagTransformError> {
+    if coarse_chan_indices.is_empty() {
+        return Err(LagTransformError::NoCoarseChans);
+    }
+    let mut rec_chans = Vec::with_capacity(coarse_chan_indices.len());
+    for coarse_chan_index in coarse_chan_indices {
+        match context.coarse_chans.get(*coarse_chan_index) {
+            Some(c) => rec_chans.push(c.rec_chan_number),
+            None => {
+                return Err(
+                    GpuboxError::InvalidCoarseChanIndex(context.num_coarse_chans - 1).into(),
+                )
+            }
+        }
+    }
+    rec_chans.sort_unstable();
+
+    Ok(rec_chans)
+}
+
+/// Read a timestep of some coarse channels, stitch their fine channels into one band and lag
+/// transform it. See the module documentation.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to read from.
+///
+/// * `timestep_index` - index within the context's timesteps.
+///
+/// * `coarse_chan_indices` - indices within the context's coarse_chans, in any order.
+///
+/// * `window` - window to apply over the stitched band.
+///
+/// * `buffer` - buffer of at least num_baselines * num_pols * `get_num_stitched_lags` * 2 floats,
+///              written as [baseline][pol][lag][r][i].
+///
+///
+/// # Returns
+///
+/// * Result containing the number of lags, or a `LagTransformError`.
+///
+///
+pub fn get_lag_spectra_into_buffer(
+    context: &CorrelatorContext,
+    timestep_index: usize,
+    coarse_chan_indices: &[usize],
+    window: LagWindow,
+    buffer: &mut [f32],
+) -> Result<usize, LagTransformError> {
+    let metafits_context = &context.metafits_context;
+    let num_fine_chans = metafits_context.num_corr_fine_chans_per_coarse;
+    let num_pols = metafits_context.num_visibility_pols;
+    let rec_chans = get_rec_chans(context, coarse_chan_indices)?;
+    let num_lags = get_num_stitched_lags(context, coarse_chan_indices)?;
+    let expected_len = metafits_context.num_baselines * num_pols * num_lags * 2;
+    if buffer.len() < expected_len {
+        return Err(LagTransformError::InvalidBufferSize {
+            buffer_len: buffer.len(),
+            expected_len,
+        });
+    }
+
+    context.install(|| {
+        // Coarse channels with no HDU are left out of the bands, so they are gaps of zeros
+        let coarse_chan_data = coarse_chan_indices
+            .par_iter()
+            .map(|coarse_chan_index| {
+                match context.read_by_baseline_pooled(timestep_index, *coarse_chan_index) {
+                    Ok(data) => Ok(Some(data)),
+                    Err(GpuboxError::MissingHdu { .. }) => Ok(None),
+                    Err(e) => Err(e),
+                }
+            })
+            .collect::<Result<Vec<_>, _>>()?;
+        let bands: Vec<Band> = coarse_chan_indices
+            .iter()
+            .zip(&coarse_chan_data)
+            .filter_map(|(coarse_chan_index, data)| {
+                Some(Band {
+                    data: data.as_ref()?,
+                    chan_offset: (context.coarse_chans[*coarse_chan_index].rec_chan_number
+                        - rec_chans[0])
+                        * num_fine_chans,
+                })
+            })
+            .collect();
+
+        transform_bands(
+            &bands,
+            num_fine_chans,
+            num_pols,
+            &window.get_weights(num_lags),
+            &mut buffer[..expected_len],
+        );
+        Ok(num_lags)
+    })
+}
+
+/// Read a timestep of some coarse channels, stitch their fine channels into one band and lag
+/// transform it. See `get_lag_spectra_into_buffer`.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to read from.
+///
+/// * `timestep_index` - index within the context's timesteps.
+///
+/// * `coarse_chan_indices` - indices within the context's coarse_chans, in any order.
+///
+/// * `window` - window to apply over the stitched band.
+///
+///
+/// # Returns
+///
+/// * Result containing the `LagSpectra`, or a `LagTransformError`.
+///
+///
+pub fn get_lag_spectra(
+    context: &CorrelatorContext,
+    timestep_index: usize,
+    coarse_chan_indices: &[usize],
+    window: LagWindow,
+) -> Result<LagSpectra, LagTransformError> {
+    let metafits_context = &context.metafits_context;
+    let num_lags = get_num_stitched_lags(context, coarse_chan_indices)?;
+    let mut data =
+        vec![
+            0.;
+            metafits_context.num_baselines * metafits_context.num_visibility_pols * num_lags * 2
+        ];
+    get_lag_spectra_into_buffer(
+        context,
+        timestep_index,
+        coarse_chan_indices,
+        window,
+        &mut data,
+    )?;
+
+    Ok(LagSpectra {
+        num_baselines: metafits_context.num_baselines,
+        num_pols: metafits_context.num_visibility_pols,
+        num_lags,
+        lag_delays_s: get_lag_delays_s(num_lags, metafits_context.corr_fine_chan_width_hz as f64),
+        data,
+    })
+}
@@ -0,0 +1,160 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for lag transforms
+*/
+#[cfg(test)]
+use super::*;
+use float_cmp::*;
+
+#[test]
+fn test_window_weights() {
+    assert_eq!(LagWindow::Rectangular.get_weights(4), vec![1.; 4]);
+    assert_eq!(LagWindow::Hann.get_weights(1), vec![1.]);
+
+    let hann = LagWindow::Hann.get_weights(5);
+    for (w, expected) in hann.iter().zip(&[0., 0.5, 1., 0.5, 0.]) {
+        assert!(approx_eq!(f32, *w, *expected, epsilon = 1e-6));
+    }
+
+    // Blackman-Harris is symmetric, peaks at 1 and is nearly 0 at the ends
+    let blackman_harris = LagWindow::BlackmanHarris.get_weights(9);
+    assert!(approx_eq!(f32, blackman_harris[4], 1., epsilon = 1e-6));
+    assert!(blackman_harris[0] < 1e-4);
+    for i in 0..4 {
+        assert!(approx_eq!(
+            f32,
+            blackman_harris[i],
+            blackman_harris[8 - i],
+            epsilon = 1e-6
+        ));
+    }
+}
+
+#[test]
+fn test_lag_delays() {
+    let delays = get_lag_delays_s(4, 10_000.);
+    assert_eq!(delays, vec![-50e-6, -25e-6, 0., 25e-6]);
+    let delays = get_lag_delays_s(5, 10_000.);
+    assert!(approx_eq!(f64, delays[2], 0., F64Margin::default()));
+    assert!(approx_eq!(f64, delays[0], -40e-6, epsilon = 1e-12));
+}
+
+#[test]
+fn test_lag_transform_by_baseline() {
+    // 2 baselines, 32 channels, 2 pols. Baseline 1 pol 0 is a pure delay of 3 lags: its
+    // spectrum is e^(-2 pi i 3 f / 32), which transforms to a spike at lag +3.
+    let (num_baselines, num_chans, num_pols) = (2, 32, 2);
+    let mut data = vec![0.; num_baselines * num_chans * num_pols * 2];
+    for chan in 0..num_chans {
+        let phase = -2. * PI * 3. * chan as f64 / num_chans as f64;
+        let index = ((num_chans + chan) * num_pols) * 2;
+        data[index] = phase.cos() as f32;
+        data[index + 1] = phase.sin() as f32;
+        // Baseline 0 pol 1 is constant, so all of its power is at zero delay
+        data[(chan * num_pols + 1) * 2] = 2.;
+    }
+    // A NaN visibility is treated as missing, rather than spreading to every lag
+    data[((num_chans + 5) * num_pols + 1) * 2] = f32::NAN;
+
+    let mut output = vec![0.; data.len()];
+    lag_transform_by_baseline(
+        &data,
+        num_baselines,
+        num_chans,
+        num_pols,
+        LagWindow::Rectangular,
+        &mut output,
+    )
+    .unwrap();
+
+    let get_lag = |baseline: usize, pol: usize, lag: usize| {
+        let index = ((baseline * num_pols + pol) * num_chans + lag) * 2;
+        (output[index], output[index + 1])
+    };
+    for lag in 0..num_chans {
+        let (re, im) = get_lag(1, 0, lag);
+        let expected = if lag == num_chans / 2 + 3 { 32. } else { 0. };
+        assert!(approx_eq!(f32, re, expected, epsilon = 1e-4));
+        assert!(approx_eq!(f32, im, 0., epsilon = 1e-4));
+
+        let (re, _) = get_lag(0, 1, lag);
+        let expected = if lag == num_chans / 2 { 64. } else { 0. };
+        assert!(approx_eq!(f32, re, expected, epsilon = 1e-4));
+
+        assert_eq!(get_lag(0, 0, lag), (0., 0.));
+        assert!(get_lag(1, 1, lag).0.is_finite());
+    }
+
+    // A window lowers the sidelobes of a delay which is not a whole number of lags
+    for chan in 0..num_chans {
+        let phase = -2. * PI * 3.5 * chan as f64 / num_chans as f64;
+        let index = ((num_chans + chan) * num_pols) * 2;
+        data[index] = phase.cos() as f32;
+        data[index + 1] = phase.sin() as f32;
+    }
+    let far_sidelobe = |window: LagWindow| {
+        let mut output = vec![0.; data.len()];
+        lag_transform_by_baseline(&data, 2, 32, 2, window, &mut output).unwrap();
+        let index = ((num_pols) * num_chans) * 2;
+        output[index].hypot(output[index + 1])
+    };
+    assert!(far_sidelobe(LagWindow::BlackmanHarris) < far_sidelobe(LagWindow::Rectangular) / 100.);
+}
+
+#[test]
+fn test_lag_transform_invalid() {
+    let data = vec![0.; 64];
+    let mut output = vec![0.; 64];
+    assert!(matches!(
+        lag_transform_by_baseline(&data, 0, 8, 4, LagWindow::Hann, &mut output),
+        Err(LagTransformError::InvalidDimensions { .. })
+    ));
+    assert!(matches!(
+        lag_transform_by_baseline(&data, 1, 8, 4, LagWindow::Hann, &mut output[..32]),
+        Err(LagTransformError::InvalidBufferSize {
+            buffer_len: 32,
+            expected_len: 64
+        })
+    ));
+}
+
+#[test]
+fn test_get_lag_spectra() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let num_baselines = context.metafits_context.num_baselines;
+    let num_fine_chans = context.metafits_context.num_corr_fine_chans_per_coarse;
+    let num_pols = context.metafits_context.num_visibility_pols;
+
+    assert_eq!(
+        get_num_stitched_lags(&context, &[0]).unwrap(),
+        num_fine_chans
+    );
+    assert!(matches!(
+        get_num_stitched_lags(&context, &[]),
+        Err(LagTransformError::NoCoarseChans)
+    ));
+
+    // One coarse channel is the same as transforming read_by_baseline output
+    let spectra = get_lag_spectra(&context, 0, &[0], LagWindow::Hann).unwrap();
+    assert_eq!(spectra.num_lags, num_fine_chans);
+    assert_eq!(spectra.lag_delays_s[num_fine_chans / 2], 0.);
+    let data = context.read_by_baseline_pooled(0, 0).unwrap();
+    let mut expected = vec![0.; data.len()];
+    lag_transform_by_baseline(
+        &data,
+        num_baselines,
+        num_fine_chans,
+        num_pols,
+        LagWindow::Hann,
+        &mut expected,
+    )
+    .unwrap();
+    assert_eq!(spectra.data, expected);
+}
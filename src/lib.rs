@@ -7,18 +7,34 @@ Definitions for what we expose to the library
 Public items will be exposed as mwalib::module.
 */
 mod antenna;
+mod bad_data;
+mod bandpass;
 mod baseline;
+mod buffer_pool;
 mod coarse_channel;
+mod codec;
 mod convert;
 mod correlator_context;
+mod dataset;
 mod error;
 mod ffi;
 mod fits_read;
+mod flagging;
+mod geometry;
 mod gpubox_files;
+mod lag_transform;
 mod metafits_context;
 mod misc;
+mod mwax_writer;
+mod numa;
+mod pipeline;
 mod rfinput;
+mod scan_cache;
+mod shard;
+mod statistics;
+mod thread_pool;
 mod timestep;
+mod uvfits;
 mod visibility_pol;
 mod voltage_context;
 mod voltage_files;
@@ -34,18 +50,57 @@ pub const COAX_V_FACTOR: f64 = 1.204;
 
 // Re-exports (public to other crates and in a flat structure)
 pub use antenna::Antenna;
-pub use baseline::Baseline;
-pub use coarse_channel::CoarseChannel;
-pub use correlator_context::CorrelatorContext;
+pub use bad_data::{
+    find_bad_data, get_hdu_bad_data, BadDataError, BadDataOptions, BadDataReport, HduBadData,
+};
+pub use bandpass::{
+    summarise_bandpasses, BandpassError, BandpassOptions, BandpassSummary, NUM_BANDPASS_POLS,
+};
+pub use baseline::{
+    get_index_ranges, select_baselines, AntennaRemap, Baseline, BaselineError, BaselineGeometry,
+    BaselineSelection, BaselineTriangle, ConjugationConvention, RemappedBaseline,
+    VisibilityConvention,
+};
+pub use buffer_pool::{AlignedBuffer, BufferAlignment, BufferPool, PooledBuffer};
+pub use coarse_channel::{CoarseChannel, FineChanTable};
+pub use codec::{
+    compress_rows, compress_rows_with_block_bytes, decompress_into, decompress_rows_into,
+    get_compressed_shape, ChunkCodec, CodecError,
+};
+pub use correlator_context::{CorrelatorContext, CorrelatorContextOptions, HduPresence};
+pub use dataset::{
+    write_dataset, Dataset, DatasetChunk, DatasetError, DatasetWriterOptions, ZAttrs,
+    DATASET_DIMENSIONS,
+};
 pub use error::MwalibError;
 pub use fits_read::*;
+pub use flagging::{flag_visibilities, FlaggerOptions, FlaggingError, VisibilityFlags};
+pub use geometry::{get_lst_rad, TimestepGeometry, SIDEREAL_RATE_RAD_PER_S};
+pub use gpubox_files::{verify_file_checksums, ChecksumSummary, GpuboxSelection};
+pub use lag_transform::{
+    get_lag_delays_s, get_lag_spectra, get_lag_spectra_into_buffer, get_num_stitched_lags,
+    lag_transform_by_baseline, LagSpectra, LagTransformError, LagWindow,
+};
 pub use metafits_context::{CorrelatorVersion, MetafitsContext};
 pub use misc::*;
+pub use mwax_writer::{write_mwax_gpubox_files, MwaxWriterError, MwaxWriterOptions};
+pub use numa::{NumaNode, NumaPlacement, NumaTopology};
+pub use pipeline::{Pipeline, PipelineError, VisibilityBlock, WorkUnit};
 pub use rfinput::{Pol, Rfinput};
+pub use scan_cache::{CachedChunk, ScanCache, ScanCacheError};
+pub use shard::{get_shard, plan_shards, Shard, ShardError, ShardFile};
+pub use statistics::{
+    get_visibility_statistics, StatisticsArray, StatisticsError, StatisticsOptions,
+    VisibilityStatistics,
+};
+pub use thread_pool::{build_thread_pool, set_current_thread_affinity, ThreadPoolError};
 pub use timestep::TimeStep;
+pub use uvfits::{write_uvfits, UvfitsError, UvfitsWriterOptions};
 pub use visibility_pol::VisibilityPol;
 pub use voltage_context::VoltageContext;
 
 // So that callers don't use a different version of fitsio, export them here.
 pub use fitsio;
 pub use fitsio_sys;
+// Likewise for rayon, so that thread pools passed to mwalib are compatible.
+pub use rayon;
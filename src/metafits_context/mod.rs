@@ -6,12 +6,15 @@
 The main interface to MWA data.
  */
 use std::fmt;
+use std::sync::{Arc, Mutex};
 
 use chrono::{DateTime, Duration, FixedOffset};
 
 use crate::antenna::*;
 use crate::baseline::*;
 use crate::coarse_channel::*;
+use crate::convert::LegacyConversionBaseline;
+use crate::gpubox_files::GpuboxError;
 use crate::rfinput::*;
 use crate::visibility_pol::*;
 use crate::*;
@@ -174,6 +177,14 @@ pub struct MetafitsContext {
     pub visibility_pols: Vec<VisibilityPol>,
     /// Filename of the metafits we were given
     pub metafits_filename: String,
+    /// Receiver channel numbers of the coarse channels, in the order listed in the metafits
+    pub(crate) metafits_coarse_chan_vec: Vec<usize>,
+    /// Legacy correlator conversion table, generated on first use. It is shared by every clone of
+    /// this context, and by every `CorrelatorContext` sharing it through an `Arc`.
+    pub(crate) legacy_conversion_table: Arc<Mutex<Option<Arc<Vec<LegacyConversionBaseline>>>>>,
+    /// Geometry of the baselines, for selecting them. Generated on first use and shared in the same
+    /// way as `legacy_conversion_table`.
+    pub(crate) baseline_geometry: Arc<Mutex<Option<Arc<BaselineGeometry>>>>,
 }
 
 impl MetafitsContext {
@@ -246,7 +257,7 @@ impl MetafitsContext {
 
         // `num_baselines` is the number of cross-correlations + the number of
         // auto-correlations.
-        let num_baselines = (num_antennas / 2) * (num_antennas + 1);
+        let num_baselines = get_baseline_count(num_antennas);
 
         // The FREQCENT value in the metafits is in units of kHz - make it Hz.
         let centre_freq_hz: u32 = {
@@ -426,6 +437,9 @@ impl MetafitsContext {
             baselines,
             num_visibility_pols,
             visibility_pols,
+            metafits_coarse_chan_vec,
+            legacy_conversion_table: Arc::new(Mutex::new(None)),
+            baseline_geometry: Arc::new(Mutex::new(None)),
         })
     }
 
@@ -448,29 +462,66 @@ impl MetafitsContext {
         &self,
         corr_version: CorrelatorVersion,
     ) -> Result<Vec<CoarseChannel>, MwalibError> {
-        // Reopen metafits
-        let mut metafits_fptr = fits_open!(&self.metafits_filename)?;
-        let metafits_hdu = fits_open_hdu!(&mut metafits_fptr, 0)?;
-
-        // Get metafits info
-        let (metafits_coarse_chan_vec, metafits_coarse_chan_width_hz) =
-            CoarseChannel::get_metafits_coarse_channel_info(
-                &mut metafits_fptr,
-                &metafits_hdu,
-                self.obs_bandwidth_hz,
-            )?;
-
         // Process the channels based on the gpubox files we have
         let coarse_chans = CoarseChannel::populate_coarse_channels(
             corr_version,
-            &metafits_coarse_chan_vec,
-            metafits_coarse_chan_width_hz,
+            &self.metafits_coarse_chan_vec,
+            self.coarse_chan_width_hz,
             None,
             None,
         )?;
 
         Ok(coarse_chans)
     }
+
+    /// Returns the legacy correlator conversion table for this observation, generating it on
+    /// the first successful call. Later calls (from any context sharing this one) return the same
+    /// table.
+    pub(crate) fn get_legacy_conversion_table(
+        &self,
+    ) -> Result<Arc<Vec<LegacyConversionBaseline>>, GpuboxError> {
+        let mut table = self.legacy_conversion_table.lock().unwrap();
+        if let Some(table) = table.as_ref() {
+            return Ok(Arc::clone(table));
+        }
+
+        let new_table = Arc::new(convert::generate_conversion_array(
+            &mut self.rf_inputs.clone(),
+        )?);
+        *table = Some(Arc::clone(&new_table));
+        Ok(new_table)
+    }
+
+    /// Returns the geometry (separations, lengths, orientations and flags) of this observation's
+    /// baselines, generating it on the first call. Later calls (from any context sharing this
+    /// one) return the same geometry.
+    pub fn get_baseline_geometry(&self) -> Arc<BaselineGeometry> {
+        let mut geometry = self.baseline_geometry.lock().unwrap();
+
+        Arc::clone(geometry.get_or_insert_with(|| {
+            Arc::new(BaselineGeometry::new(&self.antennas, &self.baselines))
+        }))
+    }
+
+    /// Select baselines by length, orientation, antennas, tile names, flags, or autos and crosses.
+    ///
+    /// # Arguments
+    ///
+    /// * `selection` - which baselines to select. See `BaselineSelection`.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the indices (within `baselines`) of the selected baselines in ascending
+    ///   order, or a `BaselineError` if an antenna index or tile name is not in the observation.
+    ///
+    ///
+    pub fn select_baselines(
+        &self,
+        selection: &BaselineSelection,
+    ) -> Result<Vec<usize>, BaselineError> {
+        baseline::select_baselines(&self.get_baseline_geometry(), &self.antennas, selection)
+    }
 }
 
 /// Implements fmt::Display for MetafitsContext struct
@@ -323,3 +323,64 @@ fn test_correlator_version_display_old_legacy() {
 
     assert_eq!(format!("{}", cv), "v1 Legacy (no file indices)");
 }
+
+#[test]
+fn test_get_legacy_conversion_table_shared() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let context =
+        MetafitsContext::new(&metafits_filename).expect("Failed to create MetafitsContext");
+
+    let table1 = context.get_legacy_conversion_table().unwrap();
+    assert_eq!(table1.len(), context.num_baselines);
+
+    // Later calls, including on clones, return the same table rather than a new one
+    let table2 = context.get_legacy_conversion_table().unwrap();
+    let table3 = context.clone().get_legacy_conversion_table().unwrap();
+    assert!(Arc::ptr_eq(&table1, &table2));
+    assert!(Arc::ptr_eq(&table1, &table3));
+}
+
+#[test]
+fn test_select_baselines() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let context =
+        MetafitsContext::new(&metafits_filename).expect("Failed to create MetafitsContext");
+
+    // The geometry is built once and shared by clones
+    let geometry = context.get_baseline_geometry();
+    assert!(Arc::ptr_eq(
+        &geometry,
+        &context.clone().get_baseline_geometry()
+    ));
+    assert_eq!(geometry.length_m.len(), context.num_baselines);
+
+    let autos = context
+        .select_baselines(&BaselineSelection {
+            crosses: false,
+            ..Default::default()
+        })
+        .unwrap();
+    assert_eq!(autos.len(), context.num_ants);
+    assert!(autos
+        .iter()
+        .all(|b| context.baselines[*b].ant1_index == context.baselines[*b].ant2_index));
+
+    // Short baselines, whose lengths agree with the antenna positions
+    let short = context
+        .select_baselines(&BaselineSelection {
+            max_length_m: 50.,
+            autos: false,
+            ..Default::default()
+        })
+        .unwrap();
+    for b in short {
+        let baseline = &context.baselines[b];
+        let ant1 = &context.antennas[baseline.ant1_index].rfinput_x;
+        let ant2 = &context.antennas[baseline.ant2_index].rfinput_x;
+        let length_m = ((ant2.east_m - ant1.east_m).powi(2)
+            + (ant2.north_m - ant1.north_m).powi(2)
+            + (ant2.height_m - ant1.height_m).powi(2))
+        .sqrt();
+        assert!(length_m <= 50.);
+    }
+}
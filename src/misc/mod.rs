@@ -6,7 +6,8 @@
 General helper/utility methods
 */
 use crate::antenna;
-use std::{mem, slice};
+use std::fs::File;
+use std::{mem, ptr, slice};
 
 #[cfg(test)]
 pub(crate) mod test;
@@ -42,6 +43,89 @@ pub fn as_u8_slice(v: &[f32]) -> &[u8] {
     unsafe { slice::from_raw_parts(v.as_ptr() as *const u8, v.len() * element_size) }
 }
 
+/// A whole file mapped read-only into memory, as used by the scan cache and datasets. The
+/// mapping stays valid if the file is deleted or replaced, and is released when this is dropped.
+pub(crate) struct MappedFile {
+    ptr: *mut libc::c_void,
+    len: usize,
+}
+
+// The mapping is read-only and owned by this struct
+unsafe impl Send for MappedFile {}
+unsafe impl Sync for MappedFile {}
+
+impl MappedFile {
+    /// Map the whole of an open file.
+    ///
+    /// # Arguments
+    ///
+    /// * `file` - the file. It may be closed once mapped.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the mapping, or an IO error.
+    ///
+    ///
+    pub(crate) fn map(file: &File) -> std::io::Result<Self> {
+        let len = file.metadata()?.len() as usize;
+        // mmap can't map nothing
+        if len == 0 {
+            return Ok(MappedFile {
+                ptr: ptr::null_mut(),
+                len,
+            });
+        }
+
+        let ptr = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                std::os::unix::io::AsRawFd::as_raw_fd(file),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(std::io::Error::last_os_error());
+        }
+
+        Ok(MappedFile { ptr, len })
+    }
+
+    /// Returns the length of the file in bytes
+    pub(crate) fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Returns the whole file
+    pub(crate) fn get_bytes(&self) -> &[u8] {
+        match self.len {
+            0 => &[],
+            _ => unsafe { slice::from_raw_parts(self.ptr as *const u8, self.len) },
+        }
+    }
+
+    /// Returns `num_floats` floats starting `offset` bytes into the file. The mapping is page
+    /// aligned, so the floats are aligned if `offset` is a multiple of 4.
+    pub(crate) fn get_floats(&self, offset: usize, num_floats: usize) -> &[f32] {
+        let bytes = &self.get_bytes()[offset..offset + num_floats * mem::size_of::<f32>()];
+        assert_eq!(offset % mem::align_of::<f32>(), 0);
+        unsafe { slice::from_raw_parts(bytes.as_ptr() as *const f32, num_floats) }
+    }
+}
+
+impl Drop for MappedFile {
+    fn drop(&mut self) {
+        if self.len > 0 {
+            unsafe {
+                libc::munmap(self.ptr, self.len);
+            }
+        }
+    }
+}
+
 /// Given the number of antennas, calculate the number of baselines (cross+autos)
 ///
 /// # Arguments
@@ -83,18 +167,31 @@ pub fn get_baseline_count(antennas: usize) -> usize {
 /// * An Option containing antenna1 index and antenna2 index if baseline exists, or None if doesn't exist.
 ///
 pub fn get_antennas_from_baseline(baseline: usize, num_antennas: usize) -> Option<(usize, usize)> {
-    let ant1 = (-0.5
-        * ((4 * num_antennas * num_antennas + 4 * num_antennas - 8 * baseline + 1) as f32).sqrt()
-        + num_antennas as f32
-        + 1. / 2.) as usize;
-
-    let ant2 = baseline - (ant1 * num_antennas - (ant1 * ant1 + ant1) / 2);
+    if baseline >= get_baseline_count(num_antennas) {
+        return None;
+    }
 
-    if ant1 > num_antennas - 1 || ant2 > num_antennas - 1 {
-        None
-    } else {
-        Some((ant1, ant2))
+    // Invert get_first_baseline. The square root is only an estimate (f64 loses precision for
+    // very large arrays), so step to the antenna whose baselines hold this one.
+    let n = (2 * num_antennas + 1) as f64;
+    let estimate = (n - (n * n - 8. * baseline as f64).max(0.).sqrt()) / 2.;
+    let mut ant1 = (estimate as usize).min(num_antennas - 1);
+    while get_first_baseline(ant1, num_antennas) > baseline {
+        ant1 -= 1;
     }
+    while ant1 + 1 < num_antennas && get_first_baseline(ant1 + 1, num_antennas) <= baseline {
+        ant1 += 1;
+    }
+
+    Some((
+        ant1,
+        ant1 + baseline - get_first_baseline(ant1, num_antennas),
+    ))
+}
+
+/// The index of an antenna's first baseline (its autocorrelation) in the upper triangle.
+fn get_first_baseline(antenna: usize, num_antennas: usize) -> usize {
+    antenna * num_antennas - antenna * antenna.saturating_sub(1) / 2
 }
 
 /// Given two antenna indicies, return the baseline index.
@@ -117,18 +214,12 @@ pub fn get_baseline_from_antennas(
     antenna2: usize,
     num_antennas: usize,
 ) -> Option<usize> {
-    let mut baseline_index = 0;
-    for ant1 in 0..num_antennas {
-        for ant2 in ant1..num_antennas {
-            if ant1 == antenna1 && ant2 == antenna2 {
-                return Some(baseline_index);
-            }
-            baseline_index += 1;
-        }
+    // Only the upper triangle (antenna1 <= antenna2) has baselines
+    if antenna1 > antenna2 || antenna2 >= num_antennas {
+        return None;
     }
 
-    // Baseline was not found at all
-    None
+    Some(get_first_baseline(antenna1, num_antennas) + antenna2 - antenna1)
 }
 
 /// Given two antenna names and the vector of Antenna structs from metafits, return the baseline index.
@@ -151,8 +242,6 @@ pub fn get_baseline_from_antenna_names(
     antenna2_tile_name: String,
     antennas: &[antenna::Antenna],
 ) -> usize {
-    let mut baseline_index = 0;
-
     let antenna1_index = antennas
         .iter()
         .position(|a| a.tile_name == antenna1_tile_name)
@@ -162,17 +251,11 @@ pub fn get_baseline_from_antenna_names(
         .position(|a| a.tile_name == antenna2_tile_name)
         .unwrap();
 
-    for ant1 in 0..antennas.len() {
-        for ant2 in ant1..antennas.len() {
-            if ant1 == antenna1_index && ant2 == antenna2_index {
-                return baseline_index;
-            }
-            baseline_index += 1;
-        }
+    match get_baseline_from_antennas(antenna1_index, antenna2_index, antennas.len()) {
+        Some(baseline_index) => baseline_index,
+        // Baseline was not found at all
+        None => unreachable!("Baseline was not found"),
     }
-
-    // Baseline was not found at all
-    unreachable!("Baseline was not found")
 }
 
 /// Returns a UNIX time given a GPStime
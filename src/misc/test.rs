@@ -79,12 +79,47 @@ fn test_get_antennas_from_baseline() {
     assert_eq!(None, get_antennas_from_baseline(8256, 128));
 }
 
+#[test]
+fn test_baseline_antennas_round_trip_large_arrays() {
+    // Every baseline of odd, 512 tile and very large arrays maps to its antennas and back
+    for num_antennas in &[1, 3, 129, 512] {
+        let mut baseline = 0;
+        for ant1 in 0..*num_antennas {
+            for ant2 in ant1..*num_antennas {
+                assert_eq!(
+                    Some((ant1, ant2)),
+                    get_antennas_from_baseline(baseline, *num_antennas)
+                );
+                assert_eq!(
+                    Some(baseline),
+                    get_baseline_from_antennas(ant1, ant2, *num_antennas)
+                );
+                baseline += 1;
+            }
+        }
+        assert_eq!(None, get_antennas_from_baseline(baseline, *num_antennas));
+    }
+
+    // Where an f32 square root would pick the wrong antenna
+    let num_antennas = 8192;
+    for ant1 in &[0, 1, 4095, 8190, 8191] {
+        for ant2 in &[*ant1, 8191] {
+            let baseline = get_baseline_from_antennas(*ant1, *ant2, num_antennas).unwrap();
+            assert_eq!(
+                Some((*ant1, *ant2)),
+                get_antennas_from_baseline(baseline, num_antennas)
+            );
+        }
+    }
+}
+
 #[test]
 fn test_get_baseline_from_antennas() {
     assert_eq!(Some(0), get_baseline_from_antennas(0, 0, 128));
     assert_eq!(Some(128), get_baseline_from_antennas(1, 1, 128));
     assert_eq!(Some(8255), get_baseline_from_antennas(127, 127, 128));
     assert_eq!(None, get_baseline_from_antennas(128, 128, 128));
+    assert_eq!(None, get_baseline_from_antennas(1, 0, 128));
 }
 
 #[test]
@@ -0,0 +1,32 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with writing MWAX format gpubox files.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum MwaxWriterError {
+    /// Error when the context is not of legacy correlator data.
+    #[error("Only legacy correlator observations can be converted to MWAX format")]
+    NotLegacy,
+
+    /// Error when an output file exists and overwriting was not asked for.
+    #[error("Output file {0} already exists")]
+    OutputExists(String),
+
+    /// An IO error creating the output directory or removing an existing output file.
+    #[error("MWAX writer IO error: {0}")]
+    Io(#[from] std::io::Error),
+
+    /// An error derived from `GpuboxError`, from reading the legacy data.
+    #[error("{0}")]
+    Gpubox(#[from] crate::gpubox_files::error::GpuboxError),
+
+    /// An error derived from `FitsError`, from writing an output file.
+    #[error("{0}")]
+    Fits(#[from] crate::fits_read::error::FitsError),
+}
@@ -0,0 +1,300 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Convert legacy correlator observations into MWAX format gpubox files.
+
+Each legacy gpubox file becomes one MWAX file for the same coarse channel and batch, named
+`<obsid>_<datetime>_ch<receiver channel>_<batch>.fits`. Every HDU is converted into MWAX
+baseline order with the context's legacy conversion table, and is written with the same
+`TIME` and `MILLITIM` as the HDU it came from, so a `CorrelatorContext` opened on the output
+has the same timesteps and coarse channels and reads back the same visibilities.
+
+Files are written in parallel in the context's thread pool, one file per worker. Each worker
+streams its file one HDU at a time through a single buffer from the context's `BufferPool`,
+so memory use depends on the number of workers, not on the size of the observation.
+ */
+pub mod error;
+pub use error::MwaxWriterError;
+
+use std::fs;
+use std::path::{Path, PathBuf};
+
+use fitsio::images::{ImageDescription, ImageType};
+use fitsio::FitsFile;
+use lazy_static::lazy_static;
+use rayon::prelude::*;
+use regex::Regex;
+
+use crate::correlator_context::CorrelatorContext;
+use crate::fits_read::error::FitsError;
+use crate::metafits_context::CorrelatorVersion;
+
+#[cfg(test)]
+mod test;
+
+lazy_static! {
+    /// The date and time part of a legacy gpubox filename
+    static ref RE_LEGACY_DATETIME: Regex = Regex::new(r"\d{10}_(?P<datetime>\d{14})_gpubox").unwrap();
+}
+
+/// Options for `write_mwax_gpubox_files`.
+#[derive(Clone, Debug)]
+pub struct MwaxWriterOptions {
+    /// Write a weights HDU after each visibility HDU, as the MWAX correlator does. Legacy data
+    /// has no weights, so these are all 1.0. `CorrelatorContext` reads files with or without them.
+    pub write_weights: bool,
+    /// Replace output files which already exist, rather than failing.
+    pub overwrite: bool,
+}
+
+impl Default for MwaxWriterOptions {
+    fn default() -> Self {
+        MwaxWriterOptions {
+            write_weights: true,
+            overwrite: false,
+        }
+    }
+}
+
+/// One output file: the legacy file it comes from and the timesteps in it
+struct MwaxOutputFile {
+    filename: PathBuf,
+    rec_chan_number: usize,
+    coarse_chan_index: usize,
+    timestep_indices: Vec<usize>,
+}
+
+/// Convert a legacy correlator observation into MWAX format gpubox files. See the module documentation.
+///
+/// # Arguments
+///
+/// * `context` - a `CorrelatorContext` of legacy correlator data. Only the files (and channels and
+///               times) the context was opened with are converted.
+///
+/// * `output_dir` - directory to write the files into. Created if it does not exist.
+///
+/// * `options` - see `MwaxWriterOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing the names of the files written (in batch, then channel order), or a `MwaxWriterError`.
+///
+///
+pub fn write_mwax_gpubox_files<P: AsRef<Path>>(
+    context: &CorrelatorContext,
+    output_dir: P,
+    options: &MwaxWriterOptions,
+) -> Result<Vec<String>, MwaxWriterError> {
+    if !matches!(
+        context.corr_version,
+        CorrelatorVersion::OldLegacy | CorrelatorVersion::Legacy
+    ) {
+        return Err(MwaxWriterError::NotLegacy);
+    }
+    fs::create_dir_all(&output_dir)?;
+
+    let output_files = get_output_files(context, output_dir.as_ref());
+    for output_file in &output_files {
+        if output_file.filename.exists() {
+            if options.overwrite {
+                fs::remove_file(&output_file.filename)?;
+            } else {
+                return Err(MwaxWriterError::OutputExists(
+                    output_file.filename.display().to_string(),
+                ));
+            }
+        }
+    }
+
+    context.install(|| {
+        output_files
+            .par_iter()
+            .map(|output_file| write_mwax_file(context, output_file, options))
+            .collect::<Result<Vec<()>, MwaxWriterError>>()
+    })?;
+
+    Ok(output_files
+        .iter()
+        .map(|f| f.filename.display().to_string())
+        .collect())
+}
+
+/// Work out the output file for each of the context's gpubox files.
+fn get_output_files(context: &CorrelatorContext, output_dir: &Path) -> Vec<MwaxOutputFile> {
+    let mut output_files = Vec::new();
+
+    for (batch_index, batch) in context.gpubox_batches.iter().enumerate() {
+        for gpubox_file in &batch.gpubox_files {
+            let coarse_chan_index = match context
+                .coarse_chans
+                .iter()
+                .position(|c| c.gpubox_number == gpubox_file.channel_identifier)
+            {
+                Some(c) => c,
+                None => continue,
+            };
+            let timestep_indices = context
+                .get_gpubox_file_timestep_indices(batch_index, gpubox_file.channel_identifier);
+            if timestep_indices.is_empty() {
+                continue;
+            }
+
+            // Keep the legacy file's date and time, so the files of an observation still agree
+            let datetime = match RE_LEGACY_DATETIME.captures(&gpubox_file.filename) {
+                Some(caps) => caps["datetime"].to_string(),
+                None => format_unix_time_ms(context.start_unix_time_ms),
+            };
+            let rec_chan_number = context.coarse_chans[coarse_chan_index].rec_chan_number;
+
+            output_files.push(MwaxOutputFile {
+                filename: output_dir.join(format!(
+                    "{}_{}_ch{:03}_{:03}.fits",
+                    context.metafits_context.obs_id, datetime, rec_chan_number, batch.batch_number
+                )),
+                rec_chan_number,
+                coarse_chan_index,
+                timestep_indices,
+            });
+        }
+    }
+
+    output_files
+}
+
+/// Format a UNIX time as the YYYYMMDDhhmmss used in gpubox filenames.
+fn format_unix_time_ms(unix_time_ms: u64) -> String {
+    chrono::NaiveDateTime::from_timestamp((unix_time_ms / 1000) as i64, 0)
+        .format("%Y%m%d%H%M%S")
+        .to_string()
+}
+
+/// Wrap a fitsio error while writing an output file.
+fn make_fits_error(
+    fits_error: fitsio::errors::Error,
+    filename: &Path,
+    hdu_num: usize,
+    source_line: u32,
+) -> FitsError {
+    FitsError::Fitsio {
+        fits_error,
+        fits_filename: filename.display().to_string(),
+        hdu_num,
+        source_file: file!(),
+        source_line,
+    }
+}
+
+/// Write one MWAX gpubox file, streaming its HDUs one at a time.
+///
+/// # Arguments
+///
+/// * `context` - the legacy `CorrelatorContext`.
+///
+/// * `output_file` - the file to write and the timesteps to put in it.
+///
+/// * `options` - see `MwaxWriterOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing nothing if Ok, or a `MwaxWriterError`.
+///
+///
+fn write_mwax_file(
+    context: &CorrelatorContext,
+    output_file: &MwaxOutputFile,
+    options: &MwaxWriterOptions,
+) -> Result<(), MwaxWriterError> {
+    let filename = &output_file.filename;
+    let metafits_context = &context.metafits_context;
+    let num_baselines = metafits_context.num_baselines;
+    let baseline_floats = context.num_timestep_coarse_chan_floats / num_baselines;
+
+    let mut fptr = FitsFile::create(filename)
+        .open()
+        .map_err(|e| FitsError::Open {
+            fits_error: e,
+            fits_filename: filename.display().to_string(),
+            source_file: file!(),
+            source_line: line!(),
+        })?;
+
+    // The primary HDU holds only the keys needed to identify the file
+    let first_time_ms = context.timesteps[output_file.timestep_indices[0]].unix_time_ms;
+    let primary_hdu = fptr
+        .primary_hdu()
+        .map_err(|e| make_fits_error(e, filename, 1, line!()))?;
+    for (key, value) in &[
+        ("OBSID", metafits_context.obs_id as i64),
+        ("CORR_VER", 2),
+        ("TIME", (first_time_ms / 1000) as i64),
+        ("MILLITIM", (first_time_ms % 1000) as i64),
+        ("COARSE_CHAN", output_file.rec_chan_number as i64),
+        (
+            "NFINECHS",
+            metafits_context.num_corr_fine_chans_per_coarse as i64,
+        ),
+    ] {
+        primary_hdu
+            .write_key(&mut fptr, key, *value)
+            .map_err(|e| make_fits_error(e, filename, 1, line!()))?;
+    }
+
+    let weights = if options.write_weights {
+        vec![1.0f32; num_baselines * metafits_context.num_visibility_pols]
+    } else {
+        Vec::new()
+    };
+    let mut buffer = context
+        .buffer_pool
+        .get(context.num_timestep_coarse_chan_floats);
+    let mut hdu_num = 1;
+
+    for timestep_index in &output_file.timestep_indices {
+        context.read_by_baseline_into_buffer(
+            *timestep_index,
+            output_file.coarse_chan_index,
+            &mut buffer,
+        )?;
+        let unix_time_ms = context.timesteps[*timestep_index].unix_time_ms;
+
+        // NAXIS1 = fine chans * pols * 2, NAXIS2 = baselines
+        let mut hdus: Vec<(&str, [usize; 2], &[f32])> = vec![(
+            "DATA",
+            [num_baselines, baseline_floats],
+            &buffer[..context.num_timestep_coarse_chan_floats],
+        )];
+        if options.write_weights {
+            // NAXIS1 = pols, NAXIS2 = baselines
+            hdus.push((
+                "WEIGHTS",
+                [num_baselines, metafits_context.num_visibility_pols],
+                &weights,
+            ));
+        }
+
+        for (extname, dimensions, data) in hdus {
+            hdu_num += 1;
+            let hdu = fptr
+                .create_image(
+                    extname.to_string(),
+                    &ImageDescription {
+                        data_type: ImageType::Float,
+                        dimensions: &dimensions,
+                    },
+                )
+                .map_err(|e| make_fits_error(e, filename, hdu_num, line!()))?;
+            hdu.write_key(&mut fptr, "TIME", (unix_time_ms / 1000) as i64)
+                .map_err(|e| make_fits_error(e, filename, hdu_num, line!()))?;
+            hdu.write_key(&mut fptr, "MILLITIM", (unix_time_ms % 1000) as i64)
+                .map_err(|e| make_fits_error(e, filename, hdu_num, line!()))?;
+            hdu.write_image(&mut fptr, data)
+                .map_err(|e| make_fits_error(e, filename, hdu_num, line!()))?;
+        }
+    }
+
+    Ok(())
+}
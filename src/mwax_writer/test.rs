@@ -0,0 +1,84 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for writing MWAX format gpubox files
+*/
+#[cfg(test)]
+use super::*;
+
+#[test]
+fn test_write_mwax_gpubox_files() {
+    // The converted files, with or without weights, should read back exactly as the legacy file does
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let legacy_context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let data_by_bl = legacy_context.read_by_baseline(0, 0).expect("Error!");
+    let data_by_freq = legacy_context.read_by_frequency(0, 0).expect("Error!");
+
+    for write_weights in &[true, false] {
+        let dir = tempdir::TempDir::new("mwalib_mwax_writer_test").unwrap();
+        let options = MwaxWriterOptions {
+            write_weights: *write_weights,
+            ..Default::default()
+        };
+        let output_files = write_mwax_gpubox_files(&legacy_context, dir.path(), &options)
+            .expect("Failed to write MWAX files");
+        assert_eq!(output_files.len(), 1);
+        assert!(output_files[0].ends_with(&format!(
+            "1101503312_20141201210818_ch{:03}_000.fits",
+            legacy_context.coarse_chans[0].rec_chan_number
+        )));
+
+        let output_files: Vec<&str> = output_files.iter().map(|f| f.as_str()).collect();
+        let mwax_context = CorrelatorContext::new(&metafits_filename, &output_files)
+            .expect("Failed to open converted files");
+        assert_eq!(mwax_context.corr_version, CorrelatorVersion::V2);
+        assert_eq!(mwax_context.num_timesteps, legacy_context.num_timesteps);
+        assert_eq!(
+            mwax_context.timesteps[0].unix_time_ms,
+            legacy_context.timesteps[0].unix_time_ms
+        );
+        assert_eq!(
+            mwax_context.num_coarse_chans,
+            legacy_context.num_coarse_chans
+        );
+        assert_eq!(
+            mwax_context.read_by_baseline(0, 0).expect("Error!"),
+            data_by_bl
+        );
+        assert_eq!(
+            mwax_context.read_by_frequency(0, 0).expect("Error!"),
+            data_by_freq
+        );
+
+        // Writing again needs overwrite
+        assert!(matches!(
+            write_mwax_gpubox_files(&legacy_context, dir.path(), &options),
+            Err(MwaxWriterError::OutputExists(_))
+        ));
+        let options = MwaxWriterOptions {
+            overwrite: true,
+            ..options
+        };
+        assert!(write_mwax_gpubox_files(&legacy_context, dir.path(), &options).is_ok());
+    }
+}
+
+#[test]
+fn test_write_mwax_gpubox_files_not_legacy() {
+    let metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let dir = tempdir::TempDir::new("mwalib_mwax_writer_test").unwrap();
+
+    assert!(matches!(
+        write_mwax_gpubox_files(&context, dir.path(), &MwaxWriterOptions::default()),
+        Err(MwaxWriterError::NotLegacy)
+    ));
+}
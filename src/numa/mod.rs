@@ -0,0 +1,298 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+NUMA topology discovery and per-node placement of read threads and buffers.
+
+On multi-socket machines, memory belongs to the node whose CPU first touched it.
+A `NumaPlacement` gives each node its own pinned thread pool and its own buffer
+pool, so that a coarse channel read on a node is also allocated (and first
+touched) on that node.
+ */
+use std::fmt;
+use std::fs;
+use std::path::Path;
+use std::sync::Arc;
+
+use rayon::ThreadPool;
+
+use crate::buffer_pool::BufferPool;
+use crate::thread_pool::{build_thread_pool, ThreadPoolError};
+
+#[cfg(test)]
+mod test;
+
+/// Where Linux describes the NUMA nodes of the machine
+pub const SYSFS_NODE_PATH: &str = "/sys/devices/system/node";
+
+/// A single NUMA node and the CPUs which belong to it
+#[derive(Clone, Debug, PartialEq)]
+pub struct NumaNode {
+    /// Node number, as used by the operating system
+    pub id: usize,
+    /// CPUs belonging to this node
+    pub cpus: Vec<usize>,
+}
+
+/// The NUMA nodes of a machine, sorted by node id
+#[derive(Clone, Debug, PartialEq)]
+pub struct NumaTopology {
+    pub nodes: Vec<NumaNode>,
+}
+
+impl NumaTopology {
+    /// Detect the NUMA topology of this machine. If it cannot be determined (e.g. not Linux, or no
+    /// sysfs), the machine is treated as a single node containing every online CPU.
+    ///
+    /// # Arguments
+    ///
+    /// * None
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A `NumaTopology` with at least one node.
+    ///
+    ///
+    pub fn detect() -> Self {
+        Self::from_sysfs(Path::new(SYSFS_NODE_PATH))
+            .unwrap_or_else(|| Self::single_node(get_num_online_cpus()))
+    }
+
+    /// Read a NUMA topology from a sysfs style directory containing `node<N>/cpulist` files.
+    ///
+    /// # Arguments
+    ///
+    /// * `node_path` - path to the directory containing the `node<N>` directories.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A `NumaTopology` if at least one node with CPUs was found, otherwise None.
+    ///
+    ///
+    pub fn from_sysfs(node_path: &Path) -> Option<Self> {
+        let mut nodes: Vec<NumaNode> = fs::read_dir(node_path)
+            .ok()?
+            .filter_map(|entry| {
+                let entry = entry.ok()?;
+                let id: usize = entry
+                    .file_name()
+                    .to_str()?
+                    .strip_prefix("node")?
+                    .parse()
+                    .ok()?;
+                let cpu_list = fs::read_to_string(entry.path().join("cpulist")).ok()?;
+                let cpus = parse_cpu_list(&cpu_list)?;
+
+                // Memory-only nodes have no CPUs to run readers on
+                if cpus.is_empty() {
+                    None
+                } else {
+                    Some(NumaNode { id, cpus })
+                }
+            })
+            .collect();
+
+        if nodes.is_empty() {
+            return None;
+        }
+
+        nodes.sort_by_key(|n| n.id);
+        Some(NumaTopology { nodes })
+    }
+
+    /// Create a topology with one node containing CPUs 0 to `num_cpus` - 1.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_cpus` - number of CPUs. At least one CPU is always included.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A `NumaTopology` with one node.
+    ///
+    ///
+    pub fn single_node(num_cpus: usize) -> Self {
+        NumaTopology {
+            nodes: vec![NumaNode {
+                id: 0,
+                cpus: (0..num_cpus.max(1)).collect(),
+            }],
+        }
+    }
+
+    /// Returns the number of nodes
+    pub fn num_nodes(&self) -> usize {
+        self.nodes.len()
+    }
+
+    /// Returns the index (within `nodes`) of the node which owns a CPU, if any
+    pub fn get_node_index_of_cpu(&self, cpu: usize) -> Option<usize> {
+        self.nodes.iter().position(|n| n.cpus.contains(&cpu))
+    }
+}
+
+impl fmt::Display for NumaTopology {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        for node in &self.nodes {
+            writeln!(f, "node{}: cpus {:?}", node.id, node.cpus)?;
+        }
+        Ok(())
+    }
+}
+
+/// Parse a Linux CPU list such as "0-3,8-11,16".
+///
+/// # Arguments
+///
+/// * `cpu_list` - the CPU list string. Surrounding whitespace is ignored.
+///
+///
+/// # Returns
+///
+/// * The CPUs in the list, in the order given, or None if the list is malformed.
+///
+///
+pub fn parse_cpu_list(cpu_list: &str) -> Option<Vec<usize>> {
+    let mut cpus = Vec::new();
+
+    for range in cpu_list.trim().split(',').filter(|r| !r.is_empty()) {
+        match range.split_once('-') {
+            Some((first, last)) => {
+                let first: usize = first.trim().parse().ok()?;
+                let last: usize = last.trim().parse().ok()?;
+                if last < first {
+                    return None;
+                }
+                cpus.extend(first..=last);
+            }
+            None => cpus.push(range.trim().parse().ok()?),
+        }
+    }
+
+    Some(cpus)
+}
+
+/// Returns the number of online CPUs, or 1 if it cannot be determined.
+pub fn get_num_online_cpus() -> usize {
+    #[cfg(unix)]
+    {
+        let num_cpus = unsafe { libc::sysconf(libc::_SC_NPROCESSORS_ONLN) };
+        if num_cpus > 0 {
+            return num_cpus as usize;
+        }
+    }
+    1
+}
+
+/// Returns the CPU the calling thread is currently running on, if it can be determined.
+pub fn get_current_cpu() -> Option<usize> {
+    #[cfg(target_os = "linux")]
+    {
+        let cpu = unsafe { libc::sched_getcpu() };
+        if cpu >= 0 {
+            return Some(cpu as usize);
+        }
+    }
+    None
+}
+
+/// Per-node thread pools and buffer pools, plus a mapping of coarse channels to nodes.
+pub struct NumaPlacement {
+    /// The topology the placement was built for
+    pub topology: NumaTopology,
+    /// One thread pool per node, with every worker pinned to that node's CPUs
+    pub thread_pools: Vec<Arc<ThreadPool>>,
+    /// One buffer pool per node. Buffers are allocated by that node's workers.
+    pub buffer_pools: Vec<Arc<BufferPool>>,
+    /// Node index (within `topology.nodes`) for each coarse channel. If empty, or shorter
+    /// than the number of coarse channels, unlisted channels are assigned round robin.
+    pub coarse_chan_nodes: Vec<usize>,
+}
+
+impl NumaPlacement {
+    /// Create a placement, with one thread per CPU on each node.
+    ///
+    /// # Arguments
+    ///
+    /// * `topology` - the NUMA topology to place work on.
+    ///
+    /// * `coarse_chan_nodes` - node index (within `topology.nodes`) for each coarse channel, indexed
+    ///                         the same as the context's coarse_chans. Pass an empty slice to assign
+    ///                         coarse channels to nodes round robin.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `NumaPlacement`, or a `ThreadPoolError` if a node index is invalid or
+    ///   a pool could not be built.
+    ///
+    ///
+    pub fn new(
+        topology: NumaTopology,
+        coarse_chan_nodes: &[usize],
+    ) -> Result<Self, ThreadPoolError> {
+        if topology.nodes.is_empty() {
+            return Err(ThreadPoolError::NoThreads);
+        }
+
+        if let Some(node) = coarse_chan_nodes
+            .iter()
+            .find(|n| **n >= topology.num_nodes())
+        {
+            return Err(ThreadPoolError::InvalidNumaNode {
+                node: *node,
+                num_nodes: topology.num_nodes(),
+            });
+        }
+
+        let thread_pools = topology
+            .nodes
+            .iter()
+            .map(|node| build_thread_pool(node.cpus.len(), &node.cpus).map(Arc::new))
+            .collect::<Result<Vec<_>, _>>()?;
+
+        let buffer_pools = topology
+            .nodes
+            .iter()
+            .map(|_| Arc::new(BufferPool::new()))
+            .collect();
+
+        Ok(NumaPlacement {
+            topology,
+            thread_pools,
+            buffer_pools,
+            coarse_chan_nodes: coarse_chan_nodes.to_vec(),
+        })
+    }
+
+    /// Create a placement for this machine's detected topology. See `NumaPlacement::new`.
+    pub fn detect(coarse_chan_nodes: &[usize]) -> Result<Self, ThreadPoolError> {
+        Self::new(NumaTopology::detect(), coarse_chan_nodes)
+    }
+
+    /// Returns the number of nodes
+    pub fn num_nodes(&self) -> usize {
+        self.topology.num_nodes()
+    }
+
+    /// Returns the node index (within `topology.nodes`) a coarse channel is read on
+    pub fn get_coarse_chan_node(&self, coarse_chan_index: usize) -> usize {
+        match self.coarse_chan_nodes.get(coarse_chan_index) {
+            Some(node) => *node,
+            None => coarse_chan_index % self.num_nodes(),
+        }
+    }
+}
+
+impl fmt::Debug for NumaPlacement {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("NumaPlacement")
+            .field("topology", &self.topology)
+            .field("coarse_chan_nodes", &self.coarse_chan_nodes)
+            .finish()
+    }
+}
@@ -0,0 +1,87 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for NUMA topology and placement
+*/
+#[cfg(test)]
+use super::*;
+
+#[test]
+fn test_parse_cpu_list() {
+    assert_eq!(parse_cpu_list("0").unwrap(), vec![0]);
+    assert_eq!(parse_cpu_list("0-3\n").unwrap(), vec![0, 1, 2, 3]);
+    assert_eq!(parse_cpu_list("0-1,8-9,16").unwrap(), vec![0, 1, 8, 9, 16]);
+    assert!(parse_cpu_list("").unwrap().is_empty());
+
+    assert!(parse_cpu_list("a").is_none());
+    assert!(parse_cpu_list("3-1").is_none());
+}
+
+#[test]
+fn test_topology_from_sysfs() {
+    let dir = tempdir::TempDir::new("mwalib_numa_test").unwrap();
+
+    for (node, cpu_list) in &[("node1", "4-7\n"), ("node0", "0-3\n"), ("node2", "\n")] {
+        let node_dir = dir.path().join(node);
+        std::fs::create_dir(&node_dir).unwrap();
+        std::fs::write(node_dir.join("cpulist"), cpu_list).unwrap();
+    }
+    // Other entries in the directory are ignored
+    std::fs::write(dir.path().join("possible"), "0-2\n").unwrap();
+
+    let topology = NumaTopology::from_sysfs(dir.path()).unwrap();
+
+    // node2 has no CPUs, so is left out. Nodes are sorted by id.
+    assert_eq!(topology.num_nodes(), 2);
+    assert_eq!(topology.nodes[0].id, 0);
+    assert_eq!(topology.nodes[0].cpus, vec![0, 1, 2, 3]);
+    assert_eq!(topology.nodes[1].id, 1);
+    assert_eq!(topology.get_node_index_of_cpu(5), Some(1));
+    assert_eq!(topology.get_node_index_of_cpu(8), None);
+
+    assert!(NumaTopology::from_sysfs(&dir.path().join("missing")).is_none());
+}
+
+#[test]
+fn test_topology_detect() {
+    let topology = NumaTopology::detect();
+
+    assert!(topology.num_nodes() >= 1);
+    assert!(topology.nodes.iter().all(|n| !n.cpus.is_empty()));
+}
+
+#[test]
+fn test_placement_coarse_chan_nodes() {
+    let topology = NumaTopology {
+        nodes: vec![
+            NumaNode {
+                id: 0,
+                cpus: vec![0],
+            },
+            NumaNode {
+                id: 1,
+                cpus: vec![0],
+            },
+        ],
+    };
+
+    // Explicit mapping for the first two channels, round robin after that
+    let placement = NumaPlacement::new(topology.clone(), &[1, 1]).unwrap();
+    assert_eq!(placement.num_nodes(), 2);
+    assert_eq!(placement.thread_pools.len(), 2);
+    assert_eq!(placement.buffer_pools.len(), 2);
+    assert_eq!(placement.get_coarse_chan_node(0), 1);
+    assert_eq!(placement.get_coarse_chan_node(1), 1);
+    assert_eq!(placement.get_coarse_chan_node(2), 0);
+    assert_eq!(placement.get_coarse_chan_node(3), 1);
+
+    assert!(matches!(
+        NumaPlacement::new(topology, &[0, 2]).unwrap_err(),
+        ThreadPoolError::InvalidNumaNode {
+            node: 2,
+            num_nodes: 2
+        }
+    ));
+}
@@ -0,0 +1,32 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with running a read/convert/user pipeline.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum PipelineError {
+    /// Error when a stage is configured with zero workers.
+    #[error("The {stage} stage of a pipeline must have at least one worker")]
+    NoWorkers { stage: &'static str },
+
+    /// Error when the queues between stages are configured with zero depth.
+    #[error("The queue depth of a pipeline must be at least 1")]
+    NoQueueDepth,
+
+    /// An error derived from `GpuboxError`, from the read stage.
+    #[error("{0}")]
+    Gpubox(#[from] crate::gpubox_files::error::GpuboxError),
+
+    /// An error returned by the user stage.
+    #[error("User stage failed: {0}")]
+    User(Box<dyn std::error::Error + Send + Sync>),
+
+    /// Error when a worker thread panics.
+    #[error("A pipeline worker thread panicked")]
+    WorkerPanicked,
+}
@@ -0,0 +1,435 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+A bounded producer/consumer pipeline over a `CorrelatorContext`.
+
+Work flows through three stages, each with its own worker threads:
+
+* read - reads the raw HDU for a (timestep, coarse channel) from its gpubox file.
+* convert - converts the raw HDU into baseline or frequency order, then applies any corrections.
+* user - the caller's function, given each converted `VisibilityBlock`.
+
+The stages are connected by bounded queues of `PooledBuffer`s. When a stage falls behind,
+the queue in front of it fills and the stage before it blocks, so the number of buffers in
+flight (and therefore memory use) is bounded no matter how many work units there are.
+
+The user stage's results go through a bounded queue to the calling thread, which puts them back
+in work unit order and hands each to the caller as soon as every result before it has been. Work
+units are only released to the read stage as results are handed over, so a slow consumer (or one
+slow block) holds up the readers rather than letting results pile up.
+ */
+pub mod error;
+pub use error::PipelineError;
+
+use std::collections::BTreeMap;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Mutex;
+
+use crossbeam_channel::{bounded, unbounded, Sender};
+
+use crate::buffer_pool::PooledBuffer;
+use crate::correlator_context::CorrelatorContext;
+
+#[cfg(test)]
+mod test;
+
+/// Default depth of the queues between stages
+pub const DEFAULT_PIPELINE_QUEUE_DEPTH: usize = 4;
+
+/// A single timestep of a single coarse channel
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash, PartialOrd, Ord)]
+pub struct WorkUnit {
+    /// Index within the context's timesteps
+    pub timestep_index: usize,
+    /// Index within the context's coarse_chans
+    pub coarse_chan_index: usize,
+}
+
+/// The converted visibilities of one `WorkUnit`, as passed to corrections and the user stage
+pub struct VisibilityBlock {
+    /// The timestep and coarse channel this data is for
+    pub work_unit: WorkUnit,
+    /// If true, `data` is in [frequency][baseline][pol][r][i] order, otherwise [baseline][frequency][pol][r][i]
+    pub by_frequency: bool,
+    /// The visibilities. The buffer returns to the context's `BufferPool` when the block is dropped.
+    pub data: PooledBuffer,
+}
+
+/// A correction applied to each block in the convert stage, after conversion
+type Correction<'a> = Box<dyn Fn(&mut VisibilityBlock) + Send + Sync + 'a>;
+
+/// Runs a function when dropped, including while unwinding from a panic.
+struct OnDrop<F: FnMut()>(F);
+
+impl<F: FnMut()> Drop for OnDrop<F> {
+    fn drop(&mut self) {
+        (self.0)()
+    }
+}
+
+/// Builder and runner for a read/convert/user pipeline. See the module documentation.
+pub struct Pipeline<'a> {
+    context: &'a CorrelatorContext,
+    work_units: Vec<WorkUnit>,
+    by_frequency: bool,
+    queue_depth: usize,
+    num_read_workers: usize,
+    num_convert_workers: usize,
+    num_user_workers: usize,
+    corrections: Vec<Correction<'a>>,
+}
+
+impl<'a> Pipeline<'a> {
+    /// Create a pipeline over every timestep and coarse channel of a context which has an HDU
+    /// (timestep major, see `CorrelatorContext::get_work_units`), producing baseline ordered data,
+    /// with one worker per stage.
+    ///
+    /// # Arguments
+    ///
+    /// * `context` - the `CorrelatorContext` to read. Buffers come from its `BufferPool` and
+    ///               conversions run in its thread pool.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A new `Pipeline`
+    ///
+    ///
+    pub fn new(context: &'a CorrelatorContext) -> Self {
+        Pipeline {
+            context,
+            work_units: context.get_work_units(),
+            by_frequency: false,
+            queue_depth: DEFAULT_PIPELINE_QUEUE_DEPTH,
+            num_read_workers: 1,
+            num_convert_workers: 1,
+            num_user_workers: 1,
+            corrections: Vec::new(),
+        }
+    }
+
+    /// Only process these work units. Results are returned in this order.
+    pub fn with_work_units(mut self, work_units: Vec<WorkUnit>) -> Self {
+        self.work_units = work_units;
+        self
+    }
+
+    /// Produce data in [frequency][baseline][pol][r][i] order rather than [baseline][frequency][pol][r][i].
+    pub fn by_frequency(mut self, by_frequency: bool) -> Self {
+        self.by_frequency = by_frequency;
+        self
+    }
+
+    /// Set the maximum number of blocks waiting in each queue between stages.
+    pub fn with_queue_depth(mut self, queue_depth: usize) -> Self {
+        self.queue_depth = queue_depth;
+        self
+    }
+
+    /// Set the number of worker threads in each stage.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_read_workers` - number of threads reading gpubox files.
+    ///
+    /// * `num_convert_workers` - number of threads converting and correcting.
+    ///
+    /// * `num_user_workers` - number of threads running the user function.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated `Pipeline`
+    ///
+    ///
+    pub fn with_workers(
+        mut self,
+        num_read_workers: usize,
+        num_convert_workers: usize,
+        num_user_workers: usize,
+    ) -> Self {
+        self.num_read_workers = num_read_workers;
+        self.num_convert_workers = num_convert_workers;
+        self.num_user_workers = num_user_workers;
+        self
+    }
+
+    /// Add a correction, applied in the convert stage to each block after conversion. Corrections
+    /// run in the order they are added.
+    pub fn with_correction<F>(mut self, correction: F) -> Self
+    where
+        F: Fn(&mut VisibilityBlock) + Send + Sync + 'a,
+    {
+        self.corrections.push(Box::new(correction));
+        self
+    }
+
+    /// Returns the most buffers the pipeline can hold at once. The context's `BufferPool` should
+    /// be allowed to keep at least this many buffers for steady-state runs not to allocate.
+    pub fn get_max_buffers_in_flight(&self) -> usize {
+        // Each reader holds one, each converter holds a raw and a converted buffer, each user
+        // worker holds one, plus whatever is in the two queues.
+        self.num_read_workers
+            + 2 * self.num_convert_workers
+            + self.num_user_workers
+            + 2 * self.queue_depth
+    }
+
+    /// Run the pipeline, calling `user_fn` for every work unit's block, and wait for it to finish.
+    /// If any stage fails, the pipeline stops early and the first error is returned. The results
+    /// are collected; use `run_for_each` to consume them as they come instead.
+    ///
+    /// # Arguments
+    ///
+    /// * `user_fn` - function run by the user stage workers. It may be called concurrently.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing the values returned by `user_fn`, in work unit order, if Ok.
+    ///
+    ///
+    pub fn run<F, R, E>(self, user_fn: F) -> Result<Vec<R>, PipelineError>
+    where
+        F: Fn(VisibilityBlock) -> Result<R, E> + Send + Sync,
+        R: Send,
+        E: Into<Box<dyn std::error::Error + Send + Sync>>,
+    {
+        let mut results = Vec::with_capacity(self.work_units.len());
+        self.run_for_each(user_fn, |result| -> Result<(), E> {
+            results.push(result);
+            Ok(())
+        })?;
+
+        Ok(results)
+    }
+
+    /// Run the pipeline, calling `user_fn` for every work unit's block, and `result_fn` on the
+    /// calling thread with each of `user_fn`'s results, in work unit order, as soon as it is
+    /// ready. Results are held only until the ones before them arrive, and readers are held up
+    /// while the caller is busy, so memory use does not grow with the number of work units. If
+    /// any stage (or `result_fn`) fails, the pipeline stops early and the first error is returned.
+    ///
+    /// # Arguments
+    ///
+    /// * `user_fn` - function run by the user stage workers. It may be called concurrently.
+    ///
+    /// * `result_fn` - function given each result of `user_fn`, in work unit order.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * A Result containing nothing if Ok, or the first `PipelineError`.
+    ///
+    ///
+    pub fn run_for_each<F, C, R, E, CE>(
+        self,
+        user_fn: F,
+        mut result_fn: C,
+    ) -> Result<(), PipelineError>
+    where
+        F: Fn(VisibilityBlock) -> Result<R, E> + Send + Sync,
+        C: FnMut(R) -> Result<(), CE>,
+        R: Send,
+        E: Into<Box<dyn std::error::Error + Send + Sync>>,
+        CE: Into<Box<dyn std::error::Error + Send + Sync>>,
+    {
+        for (stage, num_workers) in &[
+            ("read", self.num_read_workers),
+            ("convert", self.num_convert_workers),
+            ("user", self.num_user_workers),
+        ] {
+            if *num_workers == 0 {
+                return Err(PipelineError::NoWorkers { stage });
+            }
+        }
+        if self.queue_depth == 0 {
+            return Err(PipelineError::NoQueueDepth);
+        }
+
+        let context = self.context;
+        let by_frequency = self.by_frequency;
+        let corrections = &self.corrections;
+        let user_fn = &user_fn;
+        let num_floats = context.num_timestep_coarse_chan_floats;
+        // Work units released but not yet handed to `result_fn`: enough to keep every worker
+        // and queue busy, including the results queue.
+        let window = self.get_max_buffers_in_flight() + self.queue_depth;
+
+        // Work units are released by the calling thread as results are handed over. Dropping the
+        // sender (which a failing stage does) makes the readers stop.
+        let (work_tx, work_rx) = unbounded::<(usize, WorkUnit)>();
+        let work_tx: &Mutex<Option<Sender<(usize, WorkUnit)>>> = &Mutex::new(Some(work_tx));
+        let (raw_tx, raw_rx) = bounded::<(usize, WorkUnit, PooledBuffer)>(self.queue_depth);
+        let (block_tx, block_rx) = bounded::<(usize, VisibilityBlock)>(self.queue_depth);
+        let (result_tx, result_rx) = bounded::<(usize, R)>(self.queue_depth);
+
+        // Set as soon as any stage fails, so that the others stop taking new work.
+        let failed = &AtomicBool::new(false);
+        let first_error: &Mutex<Option<PipelineError>> = &Mutex::new(None);
+        let fail = |error: PipelineError| {
+            let mut first_error = first_error.lock().unwrap();
+            if first_error.is_none() {
+                *first_error = Some(error);
+            }
+            failed.store(true, Ordering::SeqCst);
+            work_tx.lock().unwrap().take();
+        };
+        let fail = &fail;
+        // Workers which panic stop the pipeline, as the work units they held will never finish
+        let fail_on_panic = || {
+            if std::thread::panicking() {
+                fail(PipelineError::WorkerPanicked);
+            }
+        };
+
+        let scope_result = crossbeam_utils::thread::scope(|scope| {
+            // Read stage
+            for _ in 0..self.num_read_workers {
+                let work_rx = work_rx.clone();
+                let raw_tx = raw_tx.clone();
+                scope.spawn(move |_| {
+                    let _fail_on_panic = OnDrop(fail_on_panic);
+                    for (index, work_unit) in work_rx.iter() {
+                        if failed.load(Ordering::SeqCst) {
+                            break;
+                        }
+                        let mut raw = context.buffer_pool.get(num_floats);
+                        if let Err(e) = context.read_hdu_into_buffer(
+                            work_unit.timestep_index,
+                            work_unit.coarse_chan_index,
+                            &mut raw,
+                        ) {
+                            fail(e.into());
+                            break;
+                        }
+                        // The send only fails if every converter has stopped
+                        if raw_tx.send((index, work_unit, raw)).is_err() {
+                            break;
+                        }
+                    }
+                });
+            }
+
+            // Convert stage
+            for _ in 0..self.num_convert_workers {
+                let raw_rx = raw_rx.clone();
+                let block_tx = block_tx.clone();
+                scope.spawn(move |_| {
+                    let _fail_on_panic = OnDrop(fail_on_panic);
+                    for (index, work_unit, raw) in raw_rx.iter() {
+                        if failed.load(Ordering::SeqCst) {
+                            break;
+                        }
+                        let mut data = context.buffer_pool.get(num_floats);
+                        context.install(|| {
+                            context.convert_hdu_into_buffer(&raw, &mut data, by_frequency)
+                        });
+                        // Give the raw buffer back before waiting on the next stage
+                        drop(raw);
+
+                        let mut block = VisibilityBlock {
+                            work_unit,
+                            by_frequency,
+                            data,
+                        };
+                        for correction in corrections {
+                            correction(&mut block);
+                        }
+
+                        if block_tx.send((index, block)).is_err() {
+                            break;
+                        }
+                    }
+                });
+            }
+
+            // User stage
+            for _ in 0..self.num_user_workers {
+                let block_rx = block_rx.clone();
+                let result_tx = result_tx.clone();
+                scope.spawn(move |_| {
+                    let _fail_on_panic = OnDrop(fail_on_panic);
+                    for (index, block) in block_rx.iter() {
+                        if failed.load(Ordering::SeqCst) {
+                            break;
+                        }
+                        match user_fn(block) {
+                            // The send only fails if the calling thread has stopped receiving
+                            Ok(result) => {
+                                if result_tx.send((index, result)).is_err() {
+                                    break;
+                                }
+                            }
+                            Err(e) => {
+                                fail(PipelineError::User(e.into()));
+                                break;
+                            }
+                        }
+                    }
+                });
+            }
+
+            // Only the workers hold queue ends now, so each queue closes when the stage
+            // feeding it finishes (or when the stage draining it has stopped).
+            drop(work_rx);
+            drop(raw_tx);
+            drop(raw_rx);
+            drop(block_tx);
+            drop(block_rx);
+            drop(result_tx);
+
+            // Close the work queue however the calling thread stops, even by panicking, so the
+            // workers can finish and the scope can be joined
+            let _close_work = OnDrop(|| {
+                work_tx.lock().unwrap().take();
+            });
+
+            let mut work_units = self.work_units.iter().copied().enumerate();
+            let release =
+                |count: usize, work_units: &mut dyn Iterator<Item = (usize, WorkUnit)>| {
+                    let mut work_tx = work_tx.lock().unwrap();
+                    for work in work_units.take(count) {
+                        if let Some(tx) = work_tx.as_ref() {
+                            // The readers hold the receiver until the sender is dropped
+                            let _ = tx.send(work);
+                        }
+                    }
+                    if work_units.size_hint().1 == Some(0) {
+                        work_tx.take();
+                    }
+                };
+            release(window, &mut work_units);
+
+            // Put results back in order, handing each over once all those before it have been
+            let mut pending: BTreeMap<usize, R> = BTreeMap::new();
+            let mut next_index = 0;
+            for (index, result) in result_rx.iter() {
+                if failed.load(Ordering::SeqCst) {
+                    // Keep receiving so the user stage is never blocked, until the queue closes
+                    continue;
+                }
+                pending.insert(index, result);
+                while let Some(result) = pending.remove(&next_index) {
+                    next_index += 1;
+                    if let Err(e) = result_fn(result) {
+                        fail(PipelineError::User(e.into()));
+                        break;
+                    }
+                    release(1, &mut work_units);
+                }
+            }
+        });
+
+        if scope_result.is_err() {
+            return Err(PipelineError::WorkerPanicked);
+        }
+        if let Some(error) = first_error.lock().unwrap().take() {
+            return Err(error);
+        }
+
+        Ok(())
+    }
+}
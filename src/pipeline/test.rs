@@ -0,0 +1,177 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for the read/convert/user pipeline
+*/
+#[cfg(test)]
+use super::*;
+#[cfg(test)]
+use crate::gpubox_files::GpuboxError;
+
+#[test]
+fn test_pipeline_matches_reads() {
+    // Legacy and mwax, by baseline and by frequency
+    let inputs = vec![
+        (
+            "test_files/1101503312_1_timestep/1101503312.metafits",
+            "test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits",
+        ),
+        (
+            "test_files/1244973688_1_timestep/1244973688.metafits",
+            "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits",
+        ),
+    ];
+
+    for (metafits_filename, gpubox_filename) in inputs {
+        let gpuboxfiles = vec![gpubox_filename];
+        let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+            .expect("Failed to create CorrelatorContext");
+        let data_by_bl = context.read_by_baseline(0, 0).expect("Error!");
+        let data_by_freq = context.read_by_frequency(0, 0).expect("Error!");
+
+        for (by_frequency, expected) in &[(false, &data_by_bl), (true, &data_by_freq)] {
+            let results = Pipeline::new(&context)
+                .by_frequency(*by_frequency)
+                .with_workers(2, 2, 2)
+                .with_queue_depth(1)
+                .run(|block| -> Result<_, GpuboxError> {
+                    assert_eq!(block.by_frequency, *by_frequency);
+                    Ok((block.work_unit, block.data.to_vec()))
+                })
+                .expect("Pipeline failed");
+
+            assert_eq!(results.len(), 1);
+            assert_eq!(
+                results[0].0,
+                WorkUnit {
+                    timestep_index: 0,
+                    coarse_chan_index: 0
+                }
+            );
+            assert_eq!(&results[0].1, *expected);
+        }
+    }
+}
+
+#[test]
+fn test_pipeline_corrections_and_order() {
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+    let gpuboxfiles = vec![mwax_filename];
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let data = context.read_by_baseline(0, 0).expect("Error!");
+
+    let work_unit = WorkUnit {
+        timestep_index: 0,
+        coarse_chan_index: 0,
+    };
+
+    // Corrections run in order: (x + 1) * 2
+    let results = Pipeline::new(&context)
+        .with_work_units(vec![work_unit; 5])
+        .with_correction(|block| block.data.iter_mut().for_each(|x| *x += 1.))
+        .with_correction(|block| block.data.iter_mut().for_each(|x| *x *= 2.))
+        .with_workers(1, 3, 2)
+        .run(|block| -> Result<_, GpuboxError> { Ok(block.data[0]) })
+        .expect("Pipeline failed");
+
+    assert_eq!(results, vec![(data[0] + 1.) * 2.; 5]);
+
+    // Results can be consumed as they come rather than collected; a small queue depth with more
+    // work units than fit in the pipeline exercises the back-pressure on the readers
+    let mut num_results = 0;
+    Pipeline::new(&context)
+        .with_work_units(vec![work_unit; 30])
+        .with_workers(2, 3, 4)
+        .with_queue_depth(1)
+        .run_for_each(
+            |block| -> Result<_, GpuboxError> { Ok(block.work_unit) },
+            |result| -> Result<(), GpuboxError> {
+                assert_eq!(result, work_unit);
+                num_results += 1;
+                Ok(())
+            },
+        )
+        .expect("Pipeline failed");
+    assert_eq!(num_results, 30);
+
+    // Buffers all went back to the pool
+    assert!(context.buffer_pool().num_free_buffers(data.len()) > 0);
+}
+
+#[test]
+fn test_pipeline_errors() {
+    let mwax_metafits_filename = "test_files/1244973688_1_timestep/1244973688.metafits";
+    let mwax_filename = "test_files/1244973688_1_timestep/1244973688_20190619100110_ch114_000.fits";
+    let gpuboxfiles = vec![mwax_filename];
+    let context = CorrelatorContext::new(&mwax_metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+
+    // Bad options
+    assert!(matches!(
+        Pipeline::new(&context)
+            .with_workers(1, 0, 1)
+            .run(|_| -> Result<(), GpuboxError> { Ok(()) })
+            .unwrap_err(),
+        PipelineError::NoWorkers { stage: "convert" }
+    ));
+    assert!(matches!(
+        Pipeline::new(&context)
+            .with_queue_depth(0)
+            .run(|_| -> Result<(), GpuboxError> { Ok(()) })
+            .unwrap_err(),
+        PipelineError::NoQueueDepth
+    ));
+
+    // Read stage error
+    let bad_work_unit = WorkUnit {
+        timestep_index: 1,
+        coarse_chan_index: 0,
+    };
+    assert!(matches!(
+        Pipeline::new(&context)
+            .with_work_units(vec![bad_work_unit; 20])
+            .run(|_| -> Result<(), GpuboxError> { Ok(()) })
+            .unwrap_err(),
+        PipelineError::Gpubox(GpuboxError::InvalidTimeStepIndex(_))
+    ));
+
+    // User stage error stops the pipeline rather than deadlocking it
+    let good_work_unit = WorkUnit {
+        timestep_index: 0,
+        coarse_chan_index: 0,
+    };
+    assert!(matches!(
+        Pipeline::new(&context)
+            .with_work_units(vec![good_work_unit; 20])
+            .with_queue_depth(1)
+            .run(|_| -> Result<(), GpuboxError> { Err(GpuboxError::NoGpuboxes) })
+            .unwrap_err(),
+        PipelineError::User(_)
+    ));
+
+    // So does a result consumer error, after which no more results are handed over
+    let mut num_results = 0;
+    assert!(matches!(
+        Pipeline::new(&context)
+            .with_work_units(vec![good_work_unit; 20])
+            .with_workers(2, 2, 2)
+            .with_queue_depth(1)
+            .run_for_each(
+                |_| -> Result<(), GpuboxError> { Ok(()) },
+                |_| -> Result<(), GpuboxError> {
+                    num_results += 1;
+                    match num_results {
+                        5 => Err(GpuboxError::NoGpuboxes),
+                        _ => Ok(()),
+                    }
+                },
+            )
+            .unwrap_err(),
+        PipelineError::User(_)
+    ));
+    assert_eq!(num_results, 5);
+}
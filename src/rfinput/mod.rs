@@ -26,7 +26,8 @@ mod test;
 /// * The PFB order - in other MWA code this is a hardcoded array but we prefer to calculate it.
 ///
 fn get_vcs_order(input: u32) -> u32 {
-    (input & 0xC0) | ((input & 0x30) >> 4) | ((input & 0x0F) << 2)
+    // The bits above the bottom 6 select the fine PFB, so arrays of more than 128 tiles keep them
+    (input & !0x3F) | ((input & 0x30) >> 4) | ((input & 0x0F) << 2)
 }
 
 /// mwax_order (aka subfile_order) is the order we want the antennas in, after conversion.
@@ -22,6 +22,10 @@ fn test_get_vcs_order() {
     assert_eq!(194, get_vcs_order(224));
     assert_eq!(251, get_vcs_order(254));
     assert_eq!(255, get_vcs_order(255));
+    // Inputs of a fifth fine PFB and beyond, for arrays of more than 128 tiles
+    assert_eq!(256, get_vcs_order(256));
+    assert_eq!(511, get_vcs_order(511));
+    assert_eq!(260, get_vcs_order(257));
 }
 
 #[test]
@@ -0,0 +1,35 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with the converted scan cache.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum ScanCacheError {
+    /// An IO error reading or writing the cache directory.
+    #[error("Scan cache IO error: {0}")]
+    Io(#[from] std::io::Error),
+
+    /// An error derived from `CodecError`.
+    #[error("{0}")]
+    Codec(#[from] crate::codec::error::CodecError),
+
+    /// Error when a chunk could not be cached because it is bigger than the whole cache.
+    #[error("A {num_bytes} byte chunk cannot be cached, as the scan cache holds at most {max_bytes} bytes")]
+    ChunkTooLarge { num_bytes: u64, max_bytes: u64 },
+
+    /// Error when another `ScanCache`, usually in another process, has the cache directory open.
+    #[error("Scan cache directory {dir} is already in use by another process")]
+    Locked { dir: String },
+
+    /// Error when a line of the cache index cannot be parsed.
+    #[error("Scan cache index {index_filename} line {line_number} is invalid")]
+    InvalidIndex {
+        index_filename: String,
+        line_number: usize,
+    },
+}
@@ -0,0 +1,801 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+A size bounded, on-disk cache of converted (timestep, coarse channel) data.
+
+Reading a legacy HDU means reading it from its gpubox file and then reordering it, which costs
+far more than reading the same number of bytes from a local disk. When a context is given a
+`ScanCache`, the first read of each (timestep, coarse channel) in each order writes the
+converted, native-endian floats to a chunk file in the cache directory. Later reads, from this
+or any later process, map that chunk into memory and use it as is.
+
+Chunks are stored as is, or compressed with a `ChunkCodec` (see `ScanCache::with_codec`) when
+the cache's disk is the bottleneck. Either way a range of rows (baselines or fine channels) can
+be read from a chunk without reading or decompressing all of it.
+
+Each chunk is identified by a key describing everything its contents depend on (see
+`CorrelatorContext`'s reads), so chunks are never used for data they were not made from. An
+index file in the cache directory records each chunk's size and when it was last used; when the
+cache is over its size limit, the least recently used chunks are deleted. The index is held in
+memory and written out every `SCAN_CACHE_INDEX_FLUSH_INTERVAL` changes, on `ScanCache::flush`
+and when the cache is dropped, so inserts do not each rewrite it. Chunk files the index does not
+list (e.g. after a crash) are taken back in as the least recently used chunks when the cache is
+next opened.
+
+A cache directory is used by one process at a time: `ScanCache::open` takes an exclusive lock
+on it, which is held until the `ScanCache` is dropped. Within the process, the `ScanCache` can
+be shared between contexts and threads.
+ */
+pub mod error;
+pub use error::ScanCacheError;
+
+use std::collections::HashMap;
+use std::fs::{self, File};
+use std::io::{BufRead, BufReader, Write};
+use std::ops::Range;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
+use std::{fmt, mem};
+
+use crate::codec::{self, ChunkCodec};
+use crate::misc::{as_u8_slice, MappedFile};
+
+#[cfg(test)]
+mod test;
+
+/// Name of the index file within the cache directory
+pub const SCAN_CACHE_INDEX_FILENAME: &str = "index.txt";
+/// Name of the lock file within the cache directory
+pub const SCAN_CACHE_LOCK_FILENAME: &str = "lock";
+/// The index is written out after this many inserts and evictions
+pub const SCAN_CACHE_INDEX_FLUSH_INTERVAL: usize = 256;
+/// First bytes of every chunk file. The last two characters are the format version.
+const CHUNK_MAGIC: &[u8; 8] = b"MWALSC02";
+/// Size of a chunk header before the key
+const CHUNK_FIXED_HEADER_BYTES: usize = 32;
+/// Written in native byte order, so that a chunk made on a machine of the other endianness is not used
+const CHUNK_BYTE_ORDER_MARK: u32 = 0x0102_0304;
+/// Chunk headers are padded to a multiple of this many bytes, which keeps the data aligned
+const CHUNK_HEADER_ALIGNMENT: usize = 64;
+/// Used to give each temporary chunk file a unique name
+static NEXT_TEMP_FILE: AtomicUsize = AtomicUsize::new(0);
+
+/// Size and recency of one chunk in the cache
+#[derive(Clone, Copy, Debug)]
+struct ScanCacheEntry {
+    num_bytes: u64,
+    last_used: u64,
+}
+
+#[derive(Debug, Default)]
+struct ScanCacheState {
+    /// Chunks, by id (the hash of their key)
+    entries: HashMap<u64, ScanCacheEntry>,
+    /// Total size of all chunks, in bytes
+    num_bytes: u64,
+    /// Incremented on each use of a chunk; gives the LRU order
+    clock: u64,
+    /// Inserts and evictions since the index was last written
+    num_unsaved_changes: usize,
+}
+
+/// A size bounded, on-disk cache of converted data. See the module documentation.
+pub struct ScanCache {
+    dir: PathBuf,
+    max_bytes: u64,
+    codec: ChunkCodec,
+    state: Mutex<ScanCacheState>,
+    /// Holds the directory's lock until the cache is dropped
+    _lock_file: File,
+}
+
+impl ScanCache {
+    /// Open (or create) a cache in a directory and lock it against other processes. Chunks
+    /// already in the directory are kept, and chunks over the size limit are evicted.
+    ///
+    /// # Arguments
+    ///
+    /// * `dir` - the cache directory. Created if it does not exist. Ideally on fast local storage.
+    ///
+    /// * `max_bytes` - the most bytes of chunks to keep.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `ScanCache`, or a `ScanCacheError` (`Locked` if another
+    ///   `ScanCache` has the directory open).
+    ///
+    ///
+    pub fn open<P: AsRef<Path>>(dir: P, max_bytes: u64) -> Result<Self, ScanCacheError> {
+        let dir = dir.as_ref().to_path_buf();
+        fs::create_dir_all(&dir)?;
+
+        // The lock is released when the file is closed, so it can't outlive a crashed process
+        let lock_file = fs::OpenOptions::new()
+            .create(true)
+            .write(true)
+            .open(dir.join(SCAN_CACHE_LOCK_FILENAME))?;
+        let result = unsafe {
+            libc::flock(
+                std::os::unix::io::AsRawFd::as_raw_fd(&lock_file),
+                libc::LOCK_EX | libc::LOCK_NB,
+            )
+        };
+        if result != 0 {
+            let error = std::io::Error::last_os_error();
+            return match error.kind() {
+                std::io::ErrorKind::WouldBlock => Err(ScanCacheError::Locked {
+                    dir: dir.display().to_string(),
+                }),
+                _ => Err(error.into()),
+            };
+        }
+
+        let cache = ScanCache {
+            dir,
+            max_bytes,
+            codec: ChunkCodec::None,
+            state: Mutex::new(ScanCacheState::default()),
+            _lock_file: lock_file,
+        };
+
+        {
+            let mut state = cache.state.lock().unwrap();
+            *state = cache.load_index()?;
+            cache.evict(&mut state, None)?;
+            cache.save_index(&mut state)?;
+        }
+
+        Ok(cache)
+    }
+
+    /// Store new chunks with a codec. Chunks already in the cache are read whatever codec they
+    /// were stored with.
+    ///
+    /// # Arguments
+    ///
+    /// * `codec` - the codec for new chunks. `ChunkCodec::None` (the default) stores chunks
+    ///             uncompressed, which lets `get` map them without copying.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The updated `ScanCache`.
+    ///
+    ///
+    pub fn with_codec(mut self, codec: ChunkCodec) -> Self {
+        self.codec = codec;
+        self
+    }
+
+    /// Returns the codec new chunks are stored with.
+    pub fn codec(&self) -> ChunkCodec {
+        self.codec
+    }
+
+    /// Returns the cache directory.
+    pub fn dir(&self) -> &Path {
+        &self.dir
+    }
+
+    /// Returns the most bytes of chunks the cache keeps.
+    pub fn max_bytes(&self) -> u64 {
+        self.max_bytes
+    }
+
+    /// Returns the total size of the chunks in the cache, in bytes.
+    pub fn num_bytes(&self) -> u64 {
+        self.state.lock().unwrap().num_bytes
+    }
+
+    /// Returns the number of chunks in the cache.
+    pub fn num_chunks(&self) -> usize {
+        self.state.lock().unwrap().entries.len()
+    }
+
+    /// Look up a chunk, and if it is present, map it into memory (or decompress it, if it was
+    /// stored with a codec) and mark it as most recently used.
+    ///
+    /// # Arguments
+    ///
+    /// * `key` - describes the chunk's contents. See the module documentation.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the chunk, `None` if the cache does not hold it, or a `ScanCacheError`.
+    ///
+    ///
+    pub fn get(&self, key: &str) -> Result<Option<CachedChunk>, ScanCacheError> {
+        let chunk_file = match self.open_chunk(key)? {
+            Some(c) => c,
+            None => return Ok(None),
+        };
+
+        let contents = match chunk_file.codec {
+            ChunkCodec::None => CachedChunkContents::Mapped(chunk_file),
+            ChunkCodec::ShuffleZstd => {
+                let mut data = vec![0.; chunk_file.num_floats];
+                codec::decompress_into(chunk_file.get_payload(), &mut data)?;
+                CachedChunkContents::Decompressed(data)
+            }
+        };
+
+        Ok(Some(CachedChunk { contents }))
+    }
+
+    /// Look up a chunk, and if it is present, copy a range of its rows into a buffer and mark
+    /// it as most recently used. Only the rows needed are read (or decompressed).
+    ///
+    /// # Arguments
+    ///
+    /// * `key` - describes the chunk's contents. See the module documentation.
+    ///
+    /// * `rows` - the rows to read, where a row is `row_floats` floats as given to `insert_rows`.
+    ///
+    /// * `output` - buffer of exactly `rows.len()` rows.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing true if the rows were read, false if the cache does not hold the
+    ///   chunk, or a `ScanCacheError`.
+    ///
+    ///
+    pub fn get_rows(
+        &self,
+        key: &str,
+        rows: Range<usize>,
+        output: &mut [f32],
+    ) -> Result<bool, ScanCacheError> {
+        let chunk_file = match self.open_chunk(key)? {
+            Some(c) => c,
+            None => return Ok(false),
+        };
+
+        match chunk_file.codec {
+            ChunkCodec::None => {
+                let num_rows = chunk_file.num_floats / chunk_file.row_floats;
+                if rows.start > rows.end || rows.end > num_rows {
+                    return Err(codec::CodecError::InvalidRowRange {
+                        start: rows.start,
+                        end: rows.end,
+                        num_rows,
+                    }
+                    .into());
+                }
+                let data = &chunk_file.get_floats()
+                    [rows.start * chunk_file.row_floats..rows.end * chunk_file.row_floats];
+                if output.len() != data.len() {
+                    return Err(codec::CodecError::InvalidBufferSize {
+                        buffer_len: output.len(),
+                        expected_len: data.len(),
+                    }
+                    .into());
+                }
+                output.copy_from_slice(data);
+            }
+            ChunkCodec::ShuffleZstd => {
+                codec::decompress_rows_into(chunk_file.get_payload(), rows, output)?
+            }
+        }
+
+        Ok(true)
+    }
+
+    /// Look up a chunk, and if it is present, map its file and mark it as most recently used.
+    fn open_chunk(&self, key: &str) -> Result<Option<ChunkFile>, ScanCacheError> {
+        let id = get_chunk_id(key);
+        {
+            let mut state = self.state.lock().unwrap();
+            state.clock += 1;
+            let clock = state.clock;
+            match state.entries.get_mut(&id) {
+                Some(entry) => entry.last_used = clock,
+                None => return Ok(None),
+            }
+        }
+
+        match ChunkFile::open(&self.get_chunk_path(id), key) {
+            // The chunk was deleted behind our back; forget it
+            Err(ScanCacheError::Io(e)) if e.kind() == std::io::ErrorKind::NotFound => {
+                let mut state = self.state.lock().unwrap();
+                if let Some(entry) = state.entries.remove(&id) {
+                    state.num_bytes -= entry.num_bytes;
+                }
+                Ok(None)
+            }
+            result => result,
+        }
+    }
+
+    /// Add a chunk to the cache as a single row. See `insert_rows`.
+    pub fn insert(&self, key: &str, data: &[f32]) -> Result<(), ScanCacheError> {
+        self.insert_rows(key, data, data.len().max(1))
+    }
+
+    /// Add a chunk to the cache (replacing any chunk with the same key), stored with the cache's
+    /// codec, then evict least recently used chunks until the cache is within its size limit. A
+    /// chunk bigger than the whole cache is not added.
+    ///
+    /// # Arguments
+    ///
+    /// * `key` - describes the chunk's contents. See the module documentation.
+    ///
+    /// * `data` - the chunk's contents.
+    ///
+    /// * `row_floats` - the number of floats in each row: the smallest part of the chunk that
+    ///                  `get_rows` can read on its own.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing nothing if Ok, or a `ScanCacheError`.
+    ///
+    ///
+    pub fn insert_rows(
+        &self,
+        key: &str,
+        data: &[f32],
+        row_floats: usize,
+    ) -> Result<(), ScanCacheError> {
+        let id = get_chunk_id(key);
+        let compressed = match self.codec {
+            ChunkCodec::None => {
+                if row_floats == 0 || data.len() % row_floats != 0 {
+                    return Err(codec::CodecError::InvalidRowSize {
+                        num_floats: data.len(),
+                        row_floats,
+                    }
+                    .into());
+                }
+                None
+            }
+            ChunkCodec::ShuffleZstd => Some(codec::compress_rows(data, row_floats)?),
+        };
+        let payload = match &compressed {
+            Some(c) => &c[..],
+            None => as_u8_slice(data),
+        };
+        let header = make_chunk_header(key, self.codec, row_floats, data.len());
+        let num_bytes = (header.len() + payload.len()) as u64;
+        if num_bytes > self.max_bytes {
+            return Ok(());
+        }
+
+        // Write to a temporary file first, so a chunk file is never seen half written
+        let temp_path = self.dir.join(format!(
+            "{:016x}.{}.{}.tmp",
+            id,
+            std::process::id(),
+            NEXT_TEMP_FILE.fetch_add(1, Ordering::Relaxed)
+        ));
+        {
+            let mut file = File::create(&temp_path)?;
+            file.write_all(&header)?;
+            file.write_all(payload)?;
+        }
+        fs::rename(&temp_path, self.get_chunk_path(id))?;
+
+        let mut state = self.state.lock().unwrap();
+        state.clock += 1;
+        let entry = ScanCacheEntry {
+            num_bytes,
+            last_used: state.clock,
+        };
+        if let Some(old) = state.entries.insert(id, entry) {
+            state.num_bytes -= old.num_bytes;
+        }
+        state.num_bytes += num_bytes;
+        state.num_unsaved_changes += 1;
+
+        self.evict(&mut state, Some(id))?;
+        if state.num_unsaved_changes >= SCAN_CACHE_INDEX_FLUSH_INTERVAL {
+            self.save_index(&mut state)?;
+        }
+
+        Ok(())
+    }
+
+    /// Write the index file now, rather than waiting for enough changes or for the cache to be
+    /// dropped.
+    pub fn flush(&self) -> Result<(), ScanCacheError> {
+        let mut state = self.state.lock().unwrap();
+
+        self.save_index(&mut state)
+    }
+
+    /// Delete every chunk in the cache.
+    pub fn clear(&self) -> Result<(), ScanCacheError> {
+        let mut state = self.state.lock().unwrap();
+        for id in state.entries.keys() {
+            remove_file_if_exists(&self.get_chunk_path(*id))?;
+        }
+        state.entries.clear();
+        state.num_bytes = 0;
+
+        self.save_index(&mut state)
+    }
+
+    /// Returns the path of a chunk's file.
+    fn get_chunk_path(&self, id: u64) -> PathBuf {
+        self.dir.join(format!("{:016x}.chunk", id))
+    }
+
+    /// Delete least recently used chunks until the cache is within its size limit.
+    ///
+    /// # Arguments
+    ///
+    /// * `state` - the locked cache state.
+    ///
+    /// * `keep` - id of a chunk not to evict (the one just inserted), if any.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing nothing if Ok, or a `ScanCacheError`.
+    ///
+    ///
+    fn evict(&self, state: &mut ScanCacheState, keep: Option<u64>) -> Result<(), ScanCacheError> {
+        while state.num_bytes > self.max_bytes {
+            let oldest = state
+                .entries
+                .iter()
+                .filter(|(id, _)| Some(**id) != keep)
+                .min_by_key(|(_, entry)| entry.last_used)
+                .map(|(id, _)| *id);
+            let id = match oldest {
+                Some(id) => id,
+                None => break,
+            };
+
+            // Mapped copies of the chunk stay valid after its file is deleted
+            remove_file_if_exists(&self.get_chunk_path(id))?;
+            let entry = state.entries.remove(&id).unwrap();
+            state.num_bytes -= entry.num_bytes;
+            state.num_unsaved_changes += 1;
+        }
+
+        Ok(())
+    }
+
+    /// Read the index file, leaving out chunks whose files have gone and adding chunk files it
+    /// does not list as least recently used. A missing index gives an empty cache.
+    fn load_index(&self) -> Result<ScanCacheState, ScanCacheError> {
+        let index_path = self.dir.join(SCAN_CACHE_INDEX_FILENAME);
+        let mut state = ScanCacheState::default();
+
+        let lines = match File::open(&index_path) {
+            Ok(f) => BufReader::new(f)
+                .lines()
+                .collect::<Result<Vec<String>, _>>()?,
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => Vec::new(),
+            Err(e) => return Err(e.into()),
+        };
+
+        for (line_index, line) in lines.into_iter().enumerate() {
+            if line.trim().is_empty() {
+                continue;
+            }
+            let (id, entry) =
+                parse_index_line(&line).ok_or_else(|| ScanCacheError::InvalidIndex {
+                    index_filename: index_path.display().to_string(),
+                    line_number: line_index + 1,
+                })?;
+
+            if !self.get_chunk_path(id).exists() {
+                continue;
+            }
+            state.clock = state.clock.max(entry.last_used);
+            state.num_bytes += entry.num_bytes;
+            state.entries.insert(id, entry);
+        }
+
+        // Chunks inserted after the index was last written
+        for dir_entry in fs::read_dir(&self.dir)? {
+            let dir_entry = dir_entry?;
+            let id = match dir_entry
+                .file_name()
+                .to_str()
+                .and_then(|f| f.strip_suffix(".chunk"))
+                .and_then(|id| u64::from_str_radix(id, 16).ok())
+            {
+                Some(id) => id,
+                None => continue,
+            };
+            if !state.entries.contains_key(&id) {
+                let num_bytes = dir_entry.metadata()?.len();
+                state.num_bytes += num_bytes;
+                state.entries.insert(
+                    id,
+                    ScanCacheEntry {
+                        num_bytes,
+                        last_used: 0,
+                    },
+                );
+            }
+        }
+
+        Ok(state)
+    }
+
+    /// Write the index file (via a temporary file, so it is replaced atomically).
+    fn save_index(&self, state: &mut ScanCacheState) -> Result<(), ScanCacheError> {
+        let mut entries: Vec<(&u64, &ScanCacheEntry)> = state.entries.iter().collect();
+        entries.sort_by_key(|(_, entry)| entry.last_used);
+
+        let mut contents = String::new();
+        for (id, entry) in entries {
+            contents.push_str(&format!(
+                "{:016x} {} {}\n",
+                id, entry.num_bytes, entry.last_used
+            ));
+        }
+
+        let temp_path = self.dir.join(format!(
+            "{}.{}.tmp",
+            SCAN_CACHE_INDEX_FILENAME,
+            std::process::id()
+        ));
+        fs::write(&temp_path, contents)?;
+        fs::rename(&temp_path, self.dir.join(SCAN_CACHE_INDEX_FILENAME))?;
+        state.num_unsaved_changes = 0;
+
+        Ok(())
+    }
+}
+
+impl Drop for ScanCache {
+    /// Save the index, so chunks inserted or used since it was last written keep their place in
+    /// the LRU order.
+    fn drop(&mut self) {
+        if let Ok(mut state) = self.state.lock() {
+            // Nothing can be done about a failure here; the next open takes back any unlisted
+            // chunks as least recently used
+            let _ = self.save_index(&mut state);
+        }
+    }
+}
+
+impl fmt::Debug for ScanCache {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("ScanCache")
+            .field("dir", &self.dir)
+            .field("max_bytes", &self.max_bytes)
+            .field("num_bytes", &self.num_bytes())
+            .field("num_chunks", &self.num_chunks())
+            .finish()
+    }
+}
+
+/// A chunk from the cache. Derefs to its floats. Uncompressed chunks are mapped read-only
+/// into memory rather than copied.
+pub struct CachedChunk {
+    contents: CachedChunkContents,
+}
+
+enum CachedChunkContents {
+    Mapped(ChunkFile),
+    Decompressed(Vec<f32>),
+}
+
+impl std::ops::Deref for CachedChunk {
+    type Target = [f32];
+
+    fn deref(&self) -> &[f32] {
+        match &self.contents {
+            CachedChunkContents::Mapped(chunk_file) => chunk_file.get_floats(),
+            CachedChunkContents::Decompressed(data) => data,
+        }
+    }
+}
+
+impl fmt::Debug for CachedChunk {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_struct("CachedChunk")
+            .field("num_floats", &self.len())
+            .field(
+                "mapped",
+                &matches!(self.contents, CachedChunkContents::Mapped(_)),
+            )
+            .finish()
+    }
+}
+
+/// A chunk file, mapped read-only into memory, with its header checked
+struct ChunkFile {
+    mapped: MappedFile,
+    codec: ChunkCodec,
+    row_floats: usize,
+    num_floats: usize,
+    /// Where the floats (or compressed data) start
+    payload_offset: usize,
+}
+
+impl ChunkFile {
+    /// Map a chunk file and check its header.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - the chunk file.
+    ///
+    /// * `key` - the key the chunk must have been written with.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the mapped chunk, `None` if the file holds a different key, was
+    ///   written with another byte order or is damaged, or a `ScanCacheError`.
+    ///
+    ///
+    fn open(path: &Path, key: &str) -> Result<Option<Self>, ScanCacheError> {
+        let file = File::open(path)?;
+        let len = file.metadata()?.len() as usize;
+        let header_len = make_chunk_header(key, ChunkCodec::None, 0, 0).len();
+        if len < header_len {
+            return Ok(None);
+        }
+
+        let mut chunk_file = ChunkFile {
+            mapped: MappedFile::map(&file)?,
+            codec: ChunkCodec::None,
+            row_floats: 0,
+            num_floats: 0,
+            payload_offset: header_len,
+        };
+
+        let bytes = chunk_file.get_bytes();
+        let read_u32 = |pos: usize| {
+            let mut field = [0u8; 4];
+            field.copy_from_slice(&bytes[pos..pos + 4]);
+            u32::from_ne_bytes(field)
+        };
+        let mut num_floats_bytes = [0u8; 8];
+        num_floats_bytes.copy_from_slice(&bytes[24..32]);
+        let num_floats = u64::from_ne_bytes(num_floats_bytes) as usize;
+        let row_floats = read_u32(20) as usize;
+        let codec = match ChunkCodec::from_id(read_u32(16)) {
+            Some(c) => c,
+            None => return Ok(None),
+        };
+
+        if &bytes[..8] != CHUNK_MAGIC
+            || read_u32(8) != CHUNK_BYTE_ORDER_MARK
+            || read_u32(12) as usize != key.len()
+            || &bytes[CHUNK_FIXED_HEADER_BYTES..CHUNK_FIXED_HEADER_BYTES + key.len()]
+                != key.as_bytes()
+            || row_floats == 0
+            || num_floats % row_floats != 0
+            || (codec == ChunkCodec::None && len != header_len + num_floats * mem::size_of::<f32>())
+        {
+            return Ok(None);
+        }
+
+        chunk_file.codec = codec;
+        chunk_file.row_floats = row_floats;
+        chunk_file.num_floats = num_floats;
+
+        Ok(Some(chunk_file))
+    }
+
+    /// Returns the whole mapped file
+    fn get_bytes(&self) -> &[u8] {
+        self.mapped.get_bytes()
+    }
+
+    /// Returns the bytes after the header: the floats, or the compressed data
+    fn get_payload(&self) -> &[u8] {
+        &self.get_bytes()[self.payload_offset..]
+    }
+
+    /// Returns the floats of an uncompressed chunk
+    fn get_floats(&self) -> &[f32] {
+        debug_assert_eq!(self.codec, ChunkCodec::None);
+        // The header length is a multiple of CHUNK_HEADER_ALIGNMENT, so the floats are aligned
+        self.mapped.get_floats(self.payload_offset, self.num_floats)
+    }
+}
+
+/// Get the id of a chunk from its key, using the 64 bit FNV-1a hash. This must not change between
+/// builds (unlike `DefaultHasher`), as ids name the chunk files.
+///
+/// # Arguments
+///
+/// * `key` - the chunk's key.
+///
+///
+/// # Returns
+///
+/// * The chunk id.
+///
+///
+pub(crate) fn get_chunk_id(key: &str) -> u64 {
+    key.bytes().fold(0xcbf2_9ce4_8422_2325, |hash, byte| {
+        (hash ^ byte as u64).wrapping_mul(0x0000_0100_0000_01b3)
+    })
+}
+
+/// Build a chunk header: magic, byte order mark, key length, codec id, floats per row and number
+/// of floats (`CHUNK_FIXED_HEADER_BYTES` in all), then the key, padded with zeros to a multiple
+/// of `CHUNK_HEADER_ALIGNMENT` bytes.
+fn make_chunk_header(
+    key: &str,
+    codec: ChunkCodec,
+    row_floats: usize,
+    num_floats: usize,
+) -> Vec<u8> {
+    let mut header = Vec::with_capacity(CHUNK_HEADER_ALIGNMENT + key.len());
+    header.extend_from_slice(CHUNK_MAGIC);
+    header.extend_from_slice(&CHUNK_BYTE_ORDER_MARK.to_ne_bytes());
+    header.extend_from_slice(&(key.len() as u32).to_ne_bytes());
+    header.extend_from_slice(&codec.to_id().to_ne_bytes());
+    header.extend_from_slice(&(row_floats as u32).to_ne_bytes());
+    header.extend_from_slice(&(num_floats as u64).to_ne_bytes());
+    header.extend_from_slice(key.as_bytes());
+
+    let padded_len = (header.len() + CHUNK_HEADER_ALIGNMENT - 1) / CHUNK_HEADER_ALIGNMENT
+        * CHUNK_HEADER_ALIGNMENT;
+    header.resize(padded_len, 0);
+
+    header
+}
+
+/// Parse a line of the index: "<id in hex> <num_bytes> <last_used>".
+fn parse_index_line(line: &str) -> Option<(u64, ScanCacheEntry)> {
+    let mut fields = line.split_whitespace();
+    let id = u64::from_str_radix(fields.next()?, 16).ok()?;
+    let num_bytes = fields.next()?.parse().ok()?;
+    let last_used = fields.next()?.parse().ok()?;
+    if fields.next().is_some() {
+        return None;
+    }
+
+    Some((
+        id,
+        ScanCacheEntry {
+            num_bytes,
+            last_used,
+        },
+    ))
+}
+
+/// Delete a file, treating it already being gone as success.
+fn remove_file_if_exists(path: &Path) -> Result<(), ScanCacheError> {
+    match fs::remove_file(path) {
+        Err(e) if e.kind() != std::io::ErrorKind::NotFound => Err(e.into()),
+        _ => Ok(()),
+    }
+}
+
+/// Build the part of a chunk key which identifies a file: its canonical path, size and
+/// modification time. If the file is replaced or modified, keys made from it change.
+///
+/// # Arguments
+///
+/// * `path` - the file.
+///
+///
+/// # Returns
+///
+/// * Result containing the identity string, or a `ScanCacheError`.
+///
+///
+pub(crate) fn get_file_identity<P: AsRef<Path>>(path: P) -> Result<String, ScanCacheError> {
+    let path = fs::canonicalize(path)?;
+    let metadata = fs::metadata(&path)?;
+    let modified_ns = metadata
+        .modified()?
+        .duration_since(std::time::UNIX_EPOCH)
+        .map(|d| d.as_nanos())
+        .unwrap_or(0);
+
+    Ok(format!(
+        "{}:{}:{}",
+        path.display(),
+        metadata.len(),
+        modified_ns
+    ))
+}
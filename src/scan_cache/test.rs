@@ -0,0 +1,282 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for the converted scan cache
+*/
+#[cfg(test)]
+use super::*;
+
+/// Size on disk of a chunk of `num_floats` floats with a short key
+fn get_chunk_bytes(key: &str, num_floats: usize) -> u64 {
+    (make_chunk_header(key, ChunkCodec::None, num_floats, num_floats).len() + num_floats * 4) as u64
+}
+
+#[test]
+fn test_chunk_id_is_stable() {
+    // FNV-1a test vectors
+    assert_eq!(get_chunk_id(""), 0xcbf2_9ce4_8422_2325);
+    assert_eq!(get_chunk_id("a"), 0xaf63_dc4c_8601_ec8c);
+    assert_ne!(get_chunk_id("hdu 1"), get_chunk_id("hdu 2"));
+}
+
+#[test]
+fn test_chunk_header_is_aligned() {
+    for key in &["", "a", &"k".repeat(100)] {
+        let header = make_chunk_header(key, ChunkCodec::ShuffleZstd, 10, 10);
+        assert_eq!(header.len() % CHUNK_HEADER_ALIGNMENT, 0);
+        assert!(header.len() >= CHUNK_FIXED_HEADER_BYTES + key.len());
+        assert_eq!(&header[..8], CHUNK_MAGIC);
+    }
+}
+
+#[test]
+fn test_insert_and_get() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let cache = ScanCache::open(dir.path(), 1 << 20).unwrap();
+    let data: Vec<f32> = (0..1000).map(|i| i as f32 * 0.5).collect();
+
+    assert!(cache.get("chunk").unwrap().is_none());
+    cache.insert("chunk", &data).unwrap();
+    assert_eq!(cache.num_chunks(), 1);
+    assert_eq!(cache.num_bytes(), get_chunk_bytes("chunk", 1000));
+
+    let chunk = cache.get("chunk").unwrap().unwrap();
+    assert_eq!(&chunk[..], &data[..]);
+    assert_eq!(chunk.as_ptr() as usize % mem::align_of::<f32>(), 0);
+
+    // Replacing a chunk does not double count it
+    cache.insert("chunk", &data[..10]).unwrap();
+    assert_eq!(cache.num_chunks(), 1);
+    assert_eq!(cache.num_bytes(), get_chunk_bytes("chunk", 10));
+    // The earlier mapping still sees the old data
+    assert_eq!(chunk.len(), 1000);
+    assert_eq!(cache.get("chunk").unwrap().unwrap().len(), 10);
+}
+
+#[test]
+fn test_lru_eviction() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let chunk_bytes = get_chunk_bytes("a", 100);
+    // Room for exactly two chunks
+    let cache = ScanCache::open(dir.path(), 2 * chunk_bytes).unwrap();
+    let data = vec![1.; 100];
+
+    cache.insert("a", &data).unwrap();
+    cache.insert("b", &data).unwrap();
+    // Using "a" makes "b" the least recently used
+    assert!(cache.get("a").unwrap().is_some());
+    cache.insert("c", &data).unwrap();
+
+    assert_eq!(cache.num_chunks(), 2);
+    assert_eq!(cache.num_bytes(), 2 * chunk_bytes);
+    assert!(cache.get("a").unwrap().is_some());
+    assert!(cache.get("b").unwrap().is_none());
+    assert!(cache.get("c").unwrap().is_some());
+    assert!(!dir
+        .path()
+        .join(format!("{:016x}.chunk", get_chunk_id("b")))
+        .exists());
+
+    // A chunk bigger than the whole cache is not added, and evicts nothing
+    cache.insert("big", &vec![0.; 1000]).unwrap();
+    assert!(cache.get("big").unwrap().is_none());
+    assert_eq!(cache.num_chunks(), 2);
+}
+
+#[test]
+fn test_index_persists() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let chunk_bytes = get_chunk_bytes("a", 100);
+    let data = vec![2.; 100];
+    {
+        let cache = ScanCache::open(dir.path(), 10 * chunk_bytes).unwrap();
+        cache.insert("a", &data).unwrap();
+        cache.insert("b", &data).unwrap();
+        cache.insert("c", &data).unwrap();
+    }
+
+    // Reopening finds the chunks again
+    let cache = ScanCache::open(dir.path(), 10 * chunk_bytes).unwrap();
+    assert_eq!(cache.num_chunks(), 3);
+    assert_eq!(&cache.get("b").unwrap().unwrap()[..], &data[..]);
+    drop(cache);
+
+    // Reopening with a smaller limit evicts the least recently used. "a" was inserted first but
+    // "b" was used after "c", so "a" and "c" go.
+    let cache = ScanCache::open(dir.path(), chunk_bytes).unwrap();
+    assert_eq!(cache.num_chunks(), 1);
+    assert!(cache.get("b").unwrap().is_some());
+
+    cache.clear().unwrap();
+    assert_eq!(cache.num_chunks(), 0);
+    assert_eq!(cache.num_bytes(), 0);
+    assert!(cache.get("b").unwrap().is_none());
+}
+
+#[test]
+fn test_index_written_in_batches() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let index_path = dir.path().join(SCAN_CACHE_INDEX_FILENAME);
+    let cache = ScanCache::open(dir.path(), 1 << 30).unwrap();
+
+    // An insert doesn't rewrite the index...
+    cache.insert("a", &[1., 2.]).unwrap();
+    assert_eq!(fs::read_to_string(&index_path).unwrap().lines().count(), 0);
+    cache.flush().unwrap();
+    assert_eq!(fs::read_to_string(&index_path).unwrap().lines().count(), 1);
+
+    // ...until enough changes have built up
+    for i in 0..SCAN_CACHE_INDEX_FLUSH_INTERVAL {
+        cache.insert(&format!("chunk {}", i), &[1.]).unwrap();
+    }
+    assert_eq!(
+        fs::read_to_string(&index_path).unwrap().lines().count(),
+        SCAN_CACHE_INDEX_FLUSH_INTERVAL + 1
+    );
+}
+
+#[test]
+fn test_unlisted_chunks_are_kept() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let chunk_bytes = get_chunk_bytes("a", 100);
+    let data = vec![2.; 100];
+    {
+        let cache = ScanCache::open(dir.path(), 10 * chunk_bytes).unwrap();
+        cache.insert("a", &data).unwrap();
+        cache.flush().unwrap();
+    }
+    let listed_index = fs::read_to_string(dir.path().join(SCAN_CACHE_INDEX_FILENAME)).unwrap();
+    {
+        let cache = ScanCache::open(dir.path(), 10 * chunk_bytes).unwrap();
+        cache.insert("b", &data).unwrap();
+    }
+    // As if the process had died before writing the index again
+    fs::write(dir.path().join(SCAN_CACHE_INDEX_FILENAME), listed_index).unwrap();
+
+    let cache = ScanCache::open(dir.path(), 10 * chunk_bytes).unwrap();
+    assert_eq!(cache.num_chunks(), 2);
+    assert_eq!(cache.num_bytes(), 2 * chunk_bytes);
+    assert_eq!(&cache.get("b").unwrap().unwrap()[..], &data[..]);
+    drop(cache);
+
+    // The unlisted chunk was taken back as least recently used, but "b" has been used since
+    let cache = ScanCache::open(dir.path(), chunk_bytes).unwrap();
+    assert!(cache.get("b").unwrap().is_some());
+    assert!(cache.get("a").unwrap().is_none());
+}
+
+#[test]
+fn test_directory_is_locked() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let cache = ScanCache::open(dir.path(), 1 << 20).unwrap();
+
+    assert!(matches!(
+        ScanCache::open(dir.path(), 1 << 20).unwrap_err(),
+        ScanCacheError::Locked { .. }
+    ));
+
+    // Dropping the cache releases the lock
+    drop(cache);
+    assert!(ScanCache::open(dir.path(), 1 << 20).is_ok());
+}
+
+#[test]
+fn test_chunk_with_other_key_is_a_miss() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let cache = ScanCache::open(dir.path(), 1 << 20).unwrap();
+    cache.insert("a", &[1., 2.]).unwrap();
+
+    // Pretend "b" collides with "a" by copying a's chunk file into b's place
+    fs::copy(
+        cache.get_chunk_path(get_chunk_id("a")),
+        cache.get_chunk_path(get_chunk_id("b")),
+    )
+    .unwrap();
+    cache.insert("b", &[3.]).unwrap();
+    fs::copy(
+        cache.get_chunk_path(get_chunk_id("a")),
+        cache.get_chunk_path(get_chunk_id("b")),
+    )
+    .unwrap();
+
+    assert!(cache.get("b").unwrap().is_none());
+    assert!(cache.get("a").unwrap().is_some());
+}
+
+#[test]
+fn test_deleted_chunk_is_a_miss() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let cache = ScanCache::open(dir.path(), 1 << 20).unwrap();
+    cache.insert("a", &[1., 2.]).unwrap();
+    fs::remove_file(cache.get_chunk_path(get_chunk_id("a"))).unwrap();
+
+    assert!(cache.get("a").unwrap().is_none());
+    assert_eq!(cache.num_chunks(), 0);
+    assert_eq!(cache.num_bytes(), 0);
+}
+
+#[test]
+fn test_invalid_index() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    fs::write(
+        dir.path().join(SCAN_CACHE_INDEX_FILENAME),
+        "0000000000000001 10 1\nnot an index line\n",
+    )
+    .unwrap();
+
+    assert!(matches!(
+        ScanCache::open(dir.path(), 1 << 20).unwrap_err(),
+        ScanCacheError::InvalidIndex { line_number: 2, .. }
+    ));
+}
+
+#[test]
+fn test_file_identity_changes_with_file() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let path = dir.path().join("file.fits");
+    fs::write(&path, b"1234").unwrap();
+    let identity = get_file_identity(&path).unwrap();
+    assert_eq!(identity, get_file_identity(&path).unwrap());
+
+    fs::write(&path, b"12345").unwrap();
+    assert_ne!(identity, get_file_identity(&path).unwrap());
+
+    assert!(get_file_identity(dir.path().join("missing.fits")).is_err());
+}
+
+#[test]
+fn test_compressed_chunks() {
+    let dir = tempdir::TempDir::new("mwalib_scan_cache_test").unwrap();
+    let cache = ScanCache::open(dir.path(), 1 << 24)
+        .unwrap()
+        .with_codec(ChunkCodec::ShuffleZstd);
+    let row_floats = 512;
+    let data: Vec<f32> = (0..row_floats * 64).map(|i| (i % 100) as f32).collect();
+
+    cache.insert_rows("a", &data, row_floats).unwrap();
+    assert!(cache.num_bytes() < (data.len() * 4) as u64);
+    assert_eq!(&cache.get("a").unwrap().unwrap()[..], &data[..]);
+
+    let mut rows = vec![0.; 3 * row_floats];
+    assert!(cache.get_rows("a", 10..13, &mut rows).unwrap());
+    assert_eq!(rows, &data[10 * row_floats..13 * row_floats]);
+    assert!(!cache.get_rows("b", 10..13, &mut rows).unwrap());
+
+    // A cache reopened without the codec still reads the compressed chunk, and writes plain ones
+    drop(cache);
+    let cache = ScanCache::open(dir.path(), 1 << 24).unwrap();
+    assert_eq!(&cache.get("a").unwrap().unwrap()[..], &data[..]);
+    cache.insert_rows("b", &data, row_floats).unwrap();
+    assert!(cache.get_rows("b", 10..13, &mut rows).unwrap());
+    assert_eq!(rows, &data[10 * row_floats..13 * row_floats]);
+    assert!(cache.get_rows("b", 60..65, &mut [0.; 5 * 512]).is_err());
+
+    assert!(matches!(
+        cache
+            .insert_rows("c", &data[..100], row_floats)
+            .unwrap_err(),
+        ScanCacheError::Codec(codec::CodecError::InvalidRowSize { .. })
+    ));
+}
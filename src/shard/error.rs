@@ -0,0 +1,23 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with planning shards of work.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum ShardError {
+    /// Error when zero shards are requested.
+    #[error("At least one shard must be requested")]
+    NoShards,
+
+    /// Error when a shard index is out of range.
+    #[error("Shard index {shard_index} is invalid. There are {num_shards} shards")]
+    InvalidShardIndex {
+        shard_index: usize,
+        num_shards: usize,
+    },
+}
@@ -0,0 +1,173 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Deterministic splitting of an observation's (timestep, coarse channel) work units into
+shards, for spreading the work across processes or nodes.
+
+Shards are made of whole files, so each process reads its files sequentially and no
+file is read by more than one process. All of the files of a channel (every gpubox batch, or
+every voltage timestep) go to the same shard, so a shard's files open as a context of their own.
+Channels are balanced across shards by byte volume.
+ */
+pub mod error;
+pub use error::ShardError;
+
+use std::collections::BTreeMap;
+
+use crate::pipeline::WorkUnit;
+
+#[cfg(test)]
+mod test;
+
+/// A data file and the work units it holds
+#[derive(Clone, Debug, PartialEq)]
+pub struct ShardFile {
+    /// Path of the file
+    pub filename: String,
+    /// Channel the file holds: the gpubox number for correlator files, or the receiver channel
+    /// number for voltage files
+    pub channel_identifier: usize,
+    /// Start time of each timestep in the file, in the same order as `work_units`: UNIX time
+    /// for correlator files, GPS time for voltage files
+    pub timestep_times_ms: Vec<u64>,
+    /// The work units in this file, indexed against the context the plan was made from
+    pub work_units: Vec<WorkUnit>,
+    /// Number of bytes of data the work units read from this file
+    pub num_bytes: u64,
+}
+
+/// One shard of a plan: a set of whole files
+#[derive(Clone, Debug, PartialEq)]
+pub struct Shard {
+    /// Index of this shard within the plan
+    pub shard_index: usize,
+    /// The files in this shard, sorted by filename. For each of its channels, the shard has
+    /// every file of that channel
+    pub files: Vec<ShardFile>,
+    /// Total bytes of data in this shard
+    pub num_bytes: u64,
+}
+
+impl Shard {
+    /// Returns the filenames of this shard. Passing these to a context's constructor opens a
+    /// context restricted to this shard's channels, which examines only these files.
+    pub fn get_filenames(&self) -> Vec<String> {
+        self.files.iter().map(|f| f.filename.clone()).collect()
+    }
+
+    /// Returns the work units of this shard, indexed against the context the plan was made from,
+    /// grouped by file.
+    pub fn get_work_units(&self) -> Vec<WorkUnit> {
+        self.files
+            .iter()
+            .flat_map(|f| f.work_units.iter().copied())
+            .collect()
+    }
+
+    /// Returns the (channel identifier, timestep start time in ms) of every work unit of this
+    /// shard, grouped by file. These identify work units independently of any context's indices.
+    pub fn get_work_unit_keys(&self) -> Vec<(usize, u64)> {
+        self.files
+            .iter()
+            .flat_map(|f| {
+                f.timestep_times_ms
+                    .iter()
+                    .map(move |t| (f.channel_identifier, *t))
+            })
+            .collect()
+    }
+}
+
+/// Split files into `num_shards` shards of roughly equal byte volume, keeping the files of each
+/// channel together.
+///
+/// A context needs every batch of the channels it is given, so files are grouped by channel
+/// identifier and whole channels are assigned to shards. Channels are assigned largest first,
+/// each to the shard with the fewest bytes so far (ties go to the lower channel identifier, then
+/// the lowest shard index), which makes the plan deterministic for a given set of files. Within
+/// a shard, files are sorted by filename. If there are fewer channels than shards, some shards
+/// are empty.
+///
+/// # Arguments
+///
+/// * `files` - the files to split.
+///
+/// * `num_shards` - number of shards to make.
+///
+///
+/// # Returns
+///
+/// * Result containing `num_shards` `Shard`s, or a `ShardError`.
+///
+///
+pub fn plan_shards(files: Vec<ShardFile>, num_shards: usize) -> Result<Vec<Shard>, ShardError> {
+    if num_shards == 0 {
+        return Err(ShardError::NoShards);
+    }
+
+    let mut channels: BTreeMap<usize, Vec<ShardFile>> = BTreeMap::new();
+    for file in files {
+        channels
+            .entry(file.channel_identifier)
+            .or_default()
+            .push(file);
+    }
+    // (bytes, channel identifier, files), largest first
+    let mut channels: Vec<(u64, usize, Vec<ShardFile>)> = channels
+        .into_iter()
+        .map(|(channel_identifier, files)| {
+            (
+                files.iter().map(|f| f.num_bytes).sum(),
+                channel_identifier,
+                files,
+            )
+        })
+        .collect();
+    channels.sort_by(|a, b| b.0.cmp(&a.0).then_with(|| a.1.cmp(&b.1)));
+
+    let mut shards: Vec<Shard> = (0..num_shards)
+        .map(|shard_index| Shard {
+            shard_index,
+            files: Vec::new(),
+            num_bytes: 0,
+        })
+        .collect();
+
+    for (num_bytes, _, files) in channels {
+        // min_by_key returns the first minimum, i.e. the lowest shard index
+        let shard = shards.iter_mut().min_by_key(|s| s.num_bytes).unwrap();
+        shard.num_bytes += num_bytes;
+        shard.files.extend(files);
+    }
+
+    for shard in shards.iter_mut() {
+        shard.files.sort_by(|a, b| a.filename.cmp(&b.filename));
+    }
+
+    Ok(shards)
+}
+
+/// Get one shard of a plan, checking the index.
+///
+/// # Arguments
+///
+/// * `shards` - the plan, as returned by `plan_shards`.
+///
+/// * `shard_index` - index of the shard wanted.
+///
+///
+/// # Returns
+///
+/// * Result containing the `Shard`, or a `ShardError` if the index is out of range.
+///
+///
+pub fn get_shard(shards: &[Shard], shard_index: usize) -> Result<&Shard, ShardError> {
+    shards
+        .get(shard_index)
+        .ok_or(ShardError::InvalidShardIndex {
+            shard_index,
+            num_shards: shards.len(),
+        })
+}
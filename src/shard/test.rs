@@ -0,0 +1,126 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for shard planning
+*/
+#[cfg(test)]
+use super::*;
+
+/// Helper to make a file with one work unit per timestep
+#[cfg(test)]
+fn make_shard_file(filename: &str, coarse_chan_index: usize, num_timesteps: usize) -> ShardFile {
+    ShardFile {
+        filename: String::from(filename),
+        channel_identifier: coarse_chan_index + 100,
+        timestep_times_ms: (0..num_timesteps).map(|t| t as u64 * 1000).collect(),
+        work_units: (0..num_timesteps)
+            .map(|timestep_index| WorkUnit {
+                timestep_index,
+                coarse_chan_index,
+            })
+            .collect(),
+        num_bytes: num_timesteps as u64 * 10,
+    }
+}
+
+#[test]
+fn test_plan_shards_balanced_by_bytes() {
+    // One big file and four small ones
+    let files = vec![
+        make_shard_file("a", 0, 1),
+        make_shard_file("b", 1, 1),
+        make_shard_file("c", 2, 4),
+        make_shard_file("d", 3, 1),
+        make_shard_file("e", 4, 1),
+    ];
+
+    let shards = plan_shards(files, 2).unwrap();
+
+    assert_eq!(shards.len(), 2);
+    assert_eq!(shards[0].shard_index, 0);
+    assert_eq!(shards[0].get_filenames(), vec!["c"]);
+    assert_eq!(shards[0].num_bytes, 40);
+    assert_eq!(shards[1].get_filenames(), vec!["a", "b", "d", "e"]);
+    assert_eq!(shards[1].num_bytes, 40);
+
+    // Work units are grouped by file
+    assert_eq!(shards[1].get_work_units().len(), 4);
+    assert_eq!(shards[1].get_work_units()[1].coarse_chan_index, 1);
+    assert_eq!(shards[0].get_work_unit_keys()[3], (102, 3000));
+}
+
+#[test]
+fn test_plan_shards_keeps_channels_together() {
+    // Two batches of three channels; channel 0 has twice the data of the others
+    let mut files = Vec::new();
+    for batch in 0..2 {
+        files.push(make_shard_file(&format!("a_0{}", batch), 0, 2));
+        files.push(make_shard_file(&format!("b_0{}", batch), 1, 1));
+        files.push(make_shard_file(&format!("c_0{}", batch), 2, 1));
+    }
+
+    let shards = plan_shards(files, 2).unwrap();
+
+    // Splitting by file would have put a_00 and a_01 in different shards
+    assert_eq!(shards[0].get_filenames(), vec!["a_00", "a_01"]);
+    assert_eq!(shards[0].num_bytes, 40);
+    assert_eq!(
+        shards[1].get_filenames(),
+        vec!["b_00", "b_01", "c_00", "c_01"]
+    );
+    assert_eq!(shards[1].num_bytes, 40);
+}
+
+#[test]
+fn test_plan_shards_deterministic() {
+    let files: Vec<ShardFile> = (0..10)
+        .map(|c| make_shard_file(&format!("file{}", c), c, 1 + c % 3))
+        .collect();
+    let mut reversed = files.clone();
+    reversed.reverse();
+
+    // The input order of the files doesn't matter
+    assert_eq!(
+        plan_shards(files.clone(), 3).unwrap(),
+        plan_shards(reversed, 3).unwrap()
+    );
+
+    // Every work unit is in exactly one shard
+    let shards = plan_shards(files.clone(), 3).unwrap();
+    let mut all_work_units: Vec<WorkUnit> =
+        shards.iter().flat_map(|s| s.get_work_units()).collect();
+    all_work_units.sort();
+    let mut expected: Vec<WorkUnit> = files.iter().flat_map(|f| f.work_units.clone()).collect();
+    expected.sort();
+    assert_eq!(all_work_units, expected);
+}
+
+#[test]
+fn test_plan_shards_more_shards_than_files() {
+    let shards = plan_shards(vec![make_shard_file("a", 0, 1)], 3).unwrap();
+
+    assert_eq!(shards.len(), 3);
+    assert_eq!(shards[0].files.len(), 1);
+    assert!(shards[1].files.is_empty());
+    assert_eq!(shards[2].num_bytes, 0);
+}
+
+#[test]
+fn test_plan_shards_errors() {
+    assert!(matches!(
+        plan_shards(vec![make_shard_file("a", 0, 1)], 0).unwrap_err(),
+        ShardError::NoShards
+    ));
+
+    let shards = plan_shards(vec![make_shard_file("a", 0, 1)], 2).unwrap();
+    assert_eq!(get_shard(&shards, 1).unwrap().shard_index, 1);
+    assert!(matches!(
+        get_shard(&shards, 2).unwrap_err(),
+        ShardError::InvalidShardIndex {
+            shard_index: 2,
+            num_shards: 2
+        }
+    ));
+}
@@ -0,0 +1,16 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with computing visibility statistics.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum StatisticsError {
+    /// An error derived from `PipelineError`, from reading and converting the data.
+    #[error("{0}")]
+    Pipeline(#[from] crate::pipeline::error::PipelineError),
+}
@@ -0,0 +1,351 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Streaming statistics of visibility amplitudes, computed in one pass over a `CorrelatorContext`.
+
+Two sets of statistics are produced, each the count, mean, variance, minimum, maximum and
+number of NaNs of the amplitude |V| of the visibilities it covers:
+
+* per (baseline, fine channel, pol), across all timesteps.
+* per (timestep, fine channel, pol), across all baselines.
+
+The data is read through a `Pipeline`. Each block is folded into Welford accumulators in the
+user stage, so several blocks are accumulated at once: each worker takes a partial accumulator
+for the block's coarse channel from a shared list (or makes a new one) and puts it back when it
+is done. At the end, the partials of each coarse channel are combined with Chan et al.'s
+parallel update. Which blocks end up in which partial depends on the order the workers take
+them, so results may differ between runs by floating-point rounding, but no more.
+
+Only (timestep, coarse channel)s which have an HDU are read. Statistics with no samples have a
+count of 0 and NaN for the mean, variance, minimum and maximum.
+ */
+pub mod error;
+pub use error::StatisticsError;
+
+use std::sync::Mutex;
+
+use crate::correlator_context::CorrelatorContext;
+use crate::pipeline::{Pipeline, WorkUnit};
+
+#[cfg(test)]
+mod test;
+
+/// Options for `get_visibility_statistics`.
+#[derive(Clone, Debug)]
+pub struct StatisticsOptions {
+    /// Number of threads reading gpubox files.
+    pub num_read_workers: usize,
+    /// Number of threads converting HDUs into baseline order.
+    pub num_convert_workers: usize,
+    /// Number of threads accumulating statistics.
+    pub num_stats_workers: usize,
+}
+
+impl Default for StatisticsOptions {
+    fn default() -> Self {
+        StatisticsOptions {
+            num_read_workers: 2,
+            num_convert_workers: 2,
+            num_stats_workers: 2,
+        }
+    }
+}
+
+/// Statistics of visibility amplitudes over one axis, for each element of the other axes.
+/// All vectors have the same length and order.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct StatisticsArray {
+    /// Number of (non-NaN) amplitudes in each statistic
+    pub count: Vec<u32>,
+    /// Number of visibilities which were NaN, and so are not in the other statistics
+    pub nan_count: Vec<u32>,
+    /// Mean amplitude
+    pub mean: Vec<f32>,
+    /// Population variance of the amplitudes
+    pub variance: Vec<f32>,
+    /// Minimum amplitude
+    pub min: Vec<f32>,
+    /// Maximum amplitude
+    pub max: Vec<f32>,
+}
+
+impl StatisticsArray {
+    /// Create an array of `len` statistics, all with no samples.
+    fn new(len: usize) -> Self {
+        StatisticsArray {
+            count: vec![0; len],
+            nan_count: vec![0; len],
+            mean: vec![f32::NAN; len],
+            variance: vec![f32::NAN; len],
+            min: vec![f32::NAN; len],
+            max: vec![f32::NAN; len],
+        }
+    }
+
+    /// Number of statistics in the array.
+    pub fn len(&self) -> usize {
+        self.count.len()
+    }
+
+    /// Returns true if the array holds no statistics.
+    pub fn is_empty(&self) -> bool {
+        self.count.is_empty()
+    }
+}
+
+/// Visibility amplitude statistics of a `CorrelatorContext`. Fine channels are numbered across all
+/// of the context's coarse channels, so fine channel `f` is fine channel
+/// `f % num_fine_chans_per_coarse` of `coarse_chans[f / num_fine_chans_per_coarse]`.
+#[derive(Clone, Debug, PartialEq)]
+pub struct VisibilityStatistics {
+    /// Number of timesteps (the context's `num_timesteps`)
+    pub num_timesteps: usize,
+    /// Number of baselines
+    pub num_baselines: usize,
+    /// Number of fine channels, across all coarse channels
+    pub num_fine_chans: usize,
+    /// Number of visibility pols
+    pub num_pols: usize,
+    /// Statistics across timesteps, in [baseline][fine_chan][pol] order
+    pub baseline_stats: StatisticsArray,
+    /// Statistics across baselines, in [timestep][fine_chan][pol] order
+    pub timestep_stats: StatisticsArray,
+}
+
+/// Welford accumulators of visibility amplitudes, one per element, stored as separate
+/// contiguous arrays so that updates run over whole slices at a time.
+#[derive(Clone, Debug)]
+pub(crate) struct MomentsArray {
+    /// Number of visibilities added to every accumulator, NaN or not
+    num_samples: u32,
+    counts: Vec<u32>,
+    means: Vec<f64>,
+    /// Sum of squared differences from the mean
+    m2s: Vec<f64>,
+    mins: Vec<f32>,
+    maxs: Vec<f32>,
+}
+
+impl MomentsArray {
+    /// Create `len` empty accumulators.
+    pub(crate) fn new(len: usize) -> Self {
+        MomentsArray {
+            num_samples: 0,
+            counts: vec![0; len],
+            means: vec![0.; len],
+            m2s: vec![0.; len],
+            mins: vec![f32::INFINITY; len],
+            maxs: vec![f32::NEG_INFINITY; len],
+        }
+    }
+
+    /// Add one visibility to each accumulator.
+    ///
+    /// # Arguments
+    ///
+    /// * `vis` - one [r][i] pair per accumulator, in accumulator order.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Nothing
+    ///
+    ///
+    pub(crate) fn add_visibilities(&mut self, vis: &[f32]) {
+        let len = self.counts.len();
+        assert_eq!(vis.len(), len * 2);
+        self.num_samples += 1;
+
+        // No branches in the loop body, so it can be vectorised. A NaN amplitude leaves an
+        // accumulator as it was: it does not count, it moves the mean by 0, and f32::min/max
+        // ignore it.
+        for (((((ri, count), mean), m2), min), max) in vis
+            .chunks_exact(2)
+            .zip(self.counts.iter_mut())
+            .zip(self.means.iter_mut())
+            .zip(self.m2s.iter_mut())
+            .zip(self.mins.iter_mut())
+            .zip(self.maxs.iter_mut())
+        {
+            let amp = (ri[0] * ri[0] + ri[1] * ri[1]).sqrt();
+            let valid = !amp.is_nan();
+            *count += valid as u32;
+            let x = if valid { amp as f64 } else { *mean };
+            let delta = x - *mean;
+            *mean += delta / (*count).max(1) as f64;
+            *m2 += delta * (x - *mean);
+            *min = min.min(amp);
+            *max = max.max(amp);
+        }
+    }
+
+    /// Combine another set of accumulators of the same elements into these, with Chan et al.'s
+    /// parallel update of the mean and sum of squares.
+    pub(crate) fn merge(&mut self, other: &MomentsArray) {
+        assert_eq!(self.counts.len(), other.counts.len());
+        self.num_samples += other.num_samples;
+
+        for i in 0..self.counts.len() {
+            let (count_a, count_b) = (self.counts[i] as f64, other.counts[i] as f64);
+            let count = count_a + count_b;
+            if count_b > 0. {
+                let delta = other.means[i] - self.means[i];
+                self.means[i] += delta * count_b / count;
+                self.m2s[i] += other.m2s[i] + delta * delta * count_a * count_b / count;
+            }
+            self.counts[i] += other.counts[i];
+            self.mins[i] = self.mins[i].min(other.mins[i]);
+            self.maxs[i] = self.maxs[i].max(other.maxs[i]);
+        }
+    }
+
+    /// Write the final statistics of a run of accumulators into an array.
+    ///
+    /// # Arguments
+    ///
+    /// * `range` - the accumulators to write.
+    ///
+    /// * `stats` - the array to write into.
+    ///
+    /// * `offset` - the index in `stats` of the first accumulator of `range`.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Nothing
+    ///
+    ///
+    pub(crate) fn write_statistics(
+        &self,
+        range: std::ops::Range<usize>,
+        stats: &mut StatisticsArray,
+        offset: usize,
+    ) {
+        for (out, i) in (offset..).zip(range) {
+            let count = self.counts[i];
+            stats.count[out] = count;
+            stats.nan_count[out] = self.num_samples - count;
+            let (mean, variance, min, max) = match count {
+                0 => (f32::NAN, f32::NAN, f32::NAN, f32::NAN),
+                _ => (
+                    self.means[i] as f32,
+                    (self.m2s[i] / count as f64) as f32,
+                    self.mins[i],
+                    self.maxs[i],
+                ),
+            };
+            stats.mean[out] = mean;
+            stats.variance[out] = variance;
+            stats.min[out] = min;
+            stats.max[out] = max;
+        }
+    }
+}
+
+/// Compute visibility amplitude statistics of every timestep, baseline, fine channel and pol of
+/// a context, in one pass over the data. See the module documentation.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to read.
+///
+/// * `options` - see `StatisticsOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing the `VisibilityStatistics`, or a `StatisticsError`.
+///
+///
+pub fn get_visibility_statistics(
+    context: &CorrelatorContext,
+    options: &StatisticsOptions,
+) -> Result<VisibilityStatistics, StatisticsError> {
+    let metafits_context = &context.metafits_context;
+    let num_baselines = metafits_context.num_baselines;
+    let num_pols = metafits_context.num_visibility_pols;
+    let num_fine_chans_per_coarse = metafits_context.num_corr_fine_chans_per_coarse;
+    let num_fine_chans = num_fine_chans_per_coarse * context.num_coarse_chans;
+    // The number of accumulators of one baseline (or one timestep) of one coarse channel
+    let row_len = num_fine_chans_per_coarse * num_pols;
+
+    let work_units: Vec<WorkUnit> = context.get_work_units();
+
+    // Partial accumulators across time, each for one coarse channel, not in use by any worker
+    let partials: Mutex<Vec<(usize, MomentsArray)>> = Mutex::new(Vec::new());
+
+    let mut stats = VisibilityStatistics {
+        num_timesteps: context.num_timesteps,
+        num_baselines,
+        num_fine_chans,
+        num_pols,
+        baseline_stats: StatisticsArray::new(num_baselines * num_fine_chans * num_pols),
+        timestep_stats: StatisticsArray::new(context.num_timesteps * num_fine_chans * num_pols),
+    };
+
+    // Results come back in work unit order, and are written out as they do
+    let mut result_work_units = work_units.iter();
+    Pipeline::new(context)
+        .with_work_units(work_units.clone())
+        .with_workers(
+            options.num_read_workers,
+            options.num_convert_workers,
+            options.num_stats_workers,
+        )
+        .run_for_each(
+            |block| -> Result<MomentsArray, StatisticsError> {
+                let coarse_chan_index = block.work_unit.coarse_chan_index;
+                let data = &block.data[..context.num_timestep_coarse_chan_floats];
+
+                let mut partial = {
+                    let mut partials = partials.lock().unwrap();
+                    match partials.iter().position(|(c, _)| *c == coarse_chan_index) {
+                        Some(p) => partials.swap_remove(p).1,
+                        None => MomentsArray::new(num_baselines * row_len),
+                    }
+                };
+                partial.add_visibilities(data);
+                partials.lock().unwrap().push((coarse_chan_index, partial));
+
+                // Data is [baseline][fine_chan][pol][r][i], so each baseline is one row
+                let mut moments = MomentsArray::new(row_len);
+                for row in data.chunks_exact(row_len * 2) {
+                    moments.add_visibilities(row);
+                }
+                Ok(moments)
+            },
+            |moments| -> Result<(), StatisticsError> {
+                let work_unit = result_work_units.next().unwrap();
+                let offset = (work_unit.timestep_index * num_fine_chans
+                    + work_unit.coarse_chan_index * num_fine_chans_per_coarse)
+                    * num_pols;
+                moments.write_statistics(0..row_len, &mut stats.timestep_stats, offset);
+                Ok(())
+            },
+        )?;
+
+    let mut merged: Vec<Option<MomentsArray>> = vec![None; context.num_coarse_chans];
+    for (coarse_chan_index, partial) in partials.into_inner().unwrap() {
+        match &mut merged[coarse_chan_index] {
+            Some(moments) => moments.merge(&partial),
+            None => merged[coarse_chan_index] = Some(partial),
+        }
+    }
+    for (coarse_chan_index, moments) in merged.iter().enumerate() {
+        let moments = match moments {
+            Some(m) => m,
+            None => continue,
+        };
+        for baseline_index in 0..num_baselines {
+            let offset = (baseline_index * num_fine_chans
+                + coarse_chan_index * num_fine_chans_per_coarse)
+                * num_pols;
+            let start = baseline_index * row_len;
+            moments.write_statistics(start..start + row_len, &mut stats.baseline_stats, offset);
+        }
+    }
+
+    Ok(stats)
+}
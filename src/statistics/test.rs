@@ -0,0 +1,171 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for visibility statistics
+*/
+#[cfg(test)]
+use super::*;
+use float_cmp::*;
+
+/// Turn amplitudes into visibilities with that amplitude, alternating between real and imaginary
+fn to_visibilities(amps: &[f32]) -> Vec<f32> {
+    amps.iter()
+        .enumerate()
+        .flat_map(|(i, a)| {
+            if i % 2 == 0 {
+                vec![*a, 0.]
+            } else {
+                vec![0., -*a]
+            }
+        })
+        .collect()
+}
+
+#[test]
+fn test_moments_array_welford() {
+    // Two accumulators, each given 4 samples
+    let samples = [[1., 10.], [2., 20.], [3., 30.], [4., 40.]];
+    let mut moments = MomentsArray::new(2);
+    for s in &samples {
+        moments.add_visibilities(&to_visibilities(s));
+    }
+
+    let mut stats = StatisticsArray::new(3);
+    moments.write_statistics(0..2, &mut stats, 1);
+    assert_eq!(stats.count, vec![0, 4, 4]);
+    assert_eq!(stats.nan_count, vec![0, 0, 0]);
+    assert!(approx_eq!(f32, stats.mean[1], 2.5, epsilon = 1e-6));
+    assert!(approx_eq!(f32, stats.mean[2], 25., epsilon = 1e-5));
+    assert!(approx_eq!(f32, stats.variance[1], 1.25, epsilon = 1e-6));
+    assert!(approx_eq!(f32, stats.variance[2], 125., epsilon = 1e-4));
+    assert_eq!((stats.min[1], stats.max[1]), (1., 4.));
+    assert_eq!((stats.min[2], stats.max[2]), (10., 40.));
+    // Untouched statistics have no samples
+    assert!(stats.mean[0].is_nan() && stats.variance[0].is_nan());
+
+    // A 3-4-5 triangle has an amplitude of 5
+    let mut moments = MomentsArray::new(1);
+    moments.add_visibilities(&[3., -4.]);
+    moments.write_statistics(0..1, &mut stats, 0);
+    assert_eq!(stats.mean[0], 5.);
+    assert_eq!(stats.variance[0], 0.);
+}
+
+#[test]
+fn test_moments_array_nans() {
+    let mut moments = MomentsArray::new(2);
+    moments.add_visibilities(&[f32::NAN, 0., 1., 0.]);
+    moments.add_visibilities(&[3., 0., 0., f32::NAN]);
+    moments.add_visibilities(&[5., 0., 3., 0.]);
+
+    let mut stats = StatisticsArray::new(2);
+    moments.write_statistics(0..2, &mut stats, 0);
+    assert_eq!(stats.count, vec![2, 2]);
+    assert_eq!(stats.nan_count, vec![1, 1]);
+    assert_eq!(stats.mean, vec![4., 2.]);
+    assert_eq!(stats.variance, vec![1., 1.]);
+    assert_eq!(stats.min, vec![3., 1.]);
+    assert_eq!(stats.max, vec![5., 3.]);
+
+    // Only NaNs gives no statistics, but counts the NaNs
+    let mut moments = MomentsArray::new(1);
+    moments.add_visibilities(&[f32::NAN, f32::NAN]);
+    moments.write_statistics(0..1, &mut stats, 0);
+    assert_eq!((stats.count[0], stats.nan_count[0]), (0, 1));
+    assert!(stats.mean[0].is_nan() && stats.min[0].is_nan());
+}
+
+#[test]
+fn test_moments_array_merge() {
+    // Merging partials of any split gives the same statistics as one accumulator
+    let amps: Vec<f32> = (0..37)
+        .map(|i| ((i * 7919) % 101) as f32 * 0.37 + 1000.)
+        .collect();
+    let mut all = MomentsArray::new(1);
+    for a in &amps {
+        all.add_visibilities(&[*a, 0.]);
+    }
+
+    for split in &[0, 1, 10, 36, 37] {
+        let (mut first, mut second) = (MomentsArray::new(1), MomentsArray::new(1));
+        for a in &amps[..*split] {
+            first.add_visibilities(&[*a, 0.]);
+        }
+        for a in &amps[*split..] {
+            second.add_visibilities(&[0., *a]);
+        }
+        first.merge(&second);
+
+        let (mut expected, mut merged) = (StatisticsArray::new(1), StatisticsArray::new(1));
+        all.write_statistics(0..1, &mut expected, 0);
+        first.write_statistics(0..1, &mut merged, 0);
+        assert_eq!(merged.count, expected.count);
+        assert_eq!((merged.min, merged.max), (expected.min, expected.max));
+        assert!(approx_eq!(
+            f32,
+            merged.mean[0],
+            expected.mean[0],
+            epsilon = 1e-3
+        ));
+        assert!(approx_eq!(
+            f32,
+            merged.variance[0],
+            expected.variance[0],
+            epsilon = 1e-3
+        ));
+    }
+}
+
+#[test]
+fn test_get_visibility_statistics() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let data = context.read_by_baseline(0, 0).expect("Error!");
+
+    for num_stats_workers in &[1, 3] {
+        let options = StatisticsOptions {
+            num_stats_workers: *num_stats_workers,
+            ..Default::default()
+        };
+        let stats = get_visibility_statistics(&context, &options).unwrap();
+        let num_pols = stats.num_pols;
+        let num_fine_chans = stats.num_fine_chans;
+        assert_eq!(stats.num_timesteps, 1);
+        assert_eq!(stats.num_baselines, 8256);
+        assert_eq!(stats.baseline_stats.len(), 8256 * num_fine_chans * num_pols);
+        assert_eq!(stats.timestep_stats.len(), num_fine_chans * num_pols);
+
+        // With one timestep, each per-baseline statistic is one visibility
+        let last = data.len() / 2 - 1;
+        let amp = (data[last * 2].powi(2) + data[last * 2 + 1].powi(2)).sqrt();
+        assert_eq!(stats.baseline_stats.count[last], 1);
+        assert!(approx_eq!(
+            f32,
+            stats.baseline_stats.mean[last],
+            amp,
+            epsilon = 1e-3
+        ));
+        assert_eq!(stats.baseline_stats.variance[last], 0.);
+
+        // Each per-timestep statistic is over every baseline
+        let amps: Vec<f64> = (0..8256)
+            .map(|b| {
+                let i = b * num_fine_chans * num_pols;
+                (data[i * 2] as f64).hypot(data[i * 2 + 1] as f64)
+            })
+            .collect();
+        let mean = amps.iter().sum::<f64>() / amps.len() as f64;
+        assert_eq!(stats.timestep_stats.count[0], 8256);
+        assert!(approx_eq!(
+            f64,
+            stats.timestep_stats.mean[0] as f64,
+            mean,
+            epsilon = mean * 1e-5
+        ));
+    }
+}
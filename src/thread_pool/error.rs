@@ -0,0 +1,32 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with building thread pools.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum ThreadPoolError {
+    /// Error when a thread pool is requested with zero threads.
+    #[error("A thread pool must have at least one thread")]
+    NoThreads,
+
+    /// Error when a CPU in an affinity list is out of range.
+    #[error("CPU {cpu} in the affinity list is invalid. CPUs must be between 0 and {max_cpu}")]
+    InvalidCpu { cpu: usize, max_cpu: usize },
+
+    /// Error when a coarse channel is assigned to a NUMA node which does not exist.
+    #[error("NUMA node {node} is invalid. This machine has {num_nodes} NUMA node(s)")]
+    InvalidNumaNode { node: usize, num_nodes: usize },
+
+    /// Error when setting the CPU affinity of a thread.
+    #[error("Failed to set CPU affinity: {0}")]
+    Affinity(#[from] std::io::Error),
+
+    /// An error derived from rayon when building the pool.
+    #[error("Failed to build thread pool: {0}")]
+    Build(#[from] rayon::ThreadPoolBuildError),
+}
@@ -0,0 +1,159 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Helpers for running mwalib's internal parallelism on a caller supplied rayon
+thread pool, rather than rayon's global pool, and for pinning the threads of
+that pool to particular CPUs.
+ */
+pub mod error;
+pub use error::ThreadPoolError;
+
+use rayon::{ThreadPool, ThreadPoolBuilder};
+
+#[cfg(test)]
+mod test;
+
+/// Returns the largest CPU index which can be used in an affinity list.
+pub fn get_max_cpu_index() -> usize {
+    #[cfg(target_os = "linux")]
+    {
+        libc::CPU_SETSIZE as usize - 1
+    }
+    #[cfg(not(target_os = "linux"))]
+    {
+        usize::MAX
+    }
+}
+
+/// Checks that every CPU in an affinity list is in range.
+///
+/// # Arguments
+///
+/// * `cpu_affinity` - slice of CPU indices.
+///
+///
+/// # Returns
+///
+/// * Result containing `Ok` if all CPUs are valid, or a `ThreadPoolError` if not.
+///
+///
+pub fn validate_cpu_affinity(cpu_affinity: &[usize]) -> Result<(), ThreadPoolError> {
+    let max_cpu = get_max_cpu_index();
+
+    match cpu_affinity.iter().find(|cpu| **cpu > max_cpu) {
+        Some(cpu) => Err(ThreadPoolError::InvalidCpu { cpu: *cpu, max_cpu }),
+        None => Ok(()),
+    }
+}
+
+/// Restrict the calling thread to run only on the given CPUs.
+///
+/// This is only supported on Linux; on other platforms it does nothing.
+///
+/// # Arguments
+///
+/// * `cpus` - slice of CPU indices the thread may run on. If empty, nothing is changed.
+///
+///
+/// # Returns
+///
+/// * Result containing `Ok` if the affinity was set, or a `ThreadPoolError` if not.
+///
+///
+pub fn set_current_thread_affinity(cpus: &[usize]) -> Result<(), ThreadPoolError> {
+    validate_cpu_affinity(cpus)?;
+
+    if cpus.is_empty() {
+        return Ok(());
+    }
+
+    #[cfg(target_os = "linux")]
+    unsafe {
+        let mut cpu_set: libc::cpu_set_t = std::mem::zeroed();
+        libc::CPU_ZERO(&mut cpu_set);
+        for cpu in cpus {
+            libc::CPU_SET(*cpu, &mut cpu_set);
+        }
+
+        // A pid of 0 means the calling thread.
+        if libc::sched_setaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &cpu_set) != 0 {
+            return Err(ThreadPoolError::Affinity(std::io::Error::last_os_error()));
+        }
+    }
+
+    Ok(())
+}
+
+/// Build a rayon thread pool for mwalib to use.
+///
+/// # Arguments
+///
+/// * `num_threads` - number of worker threads.
+///
+/// * `cpu_affinity` - CPUs to pin the workers to. Worker `i` is pinned to
+///                    `cpu_affinity[i % cpu_affinity.len()]`. Pass an empty slice to leave
+///                    the workers unpinned. Pinning is best effort: if the operating system
+///                    refuses it, the worker runs unpinned.
+///
+///
+/// # Returns
+///
+/// * Result containing the new `ThreadPool`, or a `ThreadPoolError`.
+///
+///
+pub fn build_thread_pool(
+    num_threads: usize,
+    cpu_affinity: &[usize],
+) -> Result<ThreadPool, ThreadPoolError> {
+    if num_threads == 0 {
+        return Err(ThreadPoolError::NoThreads);
+    }
+    validate_cpu_affinity(cpu_affinity)?;
+
+    let cpu_affinity = cpu_affinity.to_vec();
+
+    let builder = ThreadPoolBuilder::new()
+        .num_threads(num_threads)
+        .thread_name(|index| format!("mwalib-{}", index));
+
+    let builder = if cpu_affinity.is_empty() {
+        builder
+    } else {
+        builder.start_handler(move |index| {
+            let cpu = cpu_affinity[index % cpu_affinity.len()];
+            // Nowhere to report an error from here, and an unpinned worker is
+            // still a working worker.
+            let _ = set_current_thread_affinity(&[cpu]);
+        })
+    };
+
+    Ok(builder.build()?)
+}
+
+/// Run `op` in the given thread pool, or on rayon's global pool if there is
+/// none. Any rayon parallel iterators used inside `op` run in the same pool.
+///
+/// # Arguments
+///
+/// * `thread_pool` - optional pool to run in.
+///
+/// * `op` - the work to do.
+///
+///
+/// # Returns
+///
+/// * Whatever `op` returns.
+///
+///
+pub(crate) fn install<OP, R>(thread_pool: Option<&ThreadPool>, op: OP) -> R
+where
+    OP: FnOnce() -> R + Send,
+    R: Send,
+{
+    match thread_pool {
+        Some(pool) => pool.install(op),
+        None => op(),
+    }
+}
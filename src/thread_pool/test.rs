@@ -0,0 +1,68 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for thread pool helpers
+*/
+#[cfg(test)]
+use super::*;
+
+#[test]
+fn test_build_thread_pool_num_threads() {
+    let pool = build_thread_pool(3, &[]).expect("Failed to build thread pool");
+
+    assert_eq!(pool.current_num_threads(), 3);
+
+    // Work installed in the pool sees the pool's thread count
+    assert_eq!(install(Some(&pool), rayon::current_num_threads), 3);
+}
+
+#[test]
+fn test_build_thread_pool_no_threads() {
+    assert!(matches!(
+        build_thread_pool(0, &[]).unwrap_err(),
+        ThreadPoolError::NoThreads
+    ));
+}
+
+#[test]
+fn test_validate_cpu_affinity() {
+    assert!(validate_cpu_affinity(&[]).is_ok());
+    assert!(validate_cpu_affinity(&[0, 1, 2]).is_ok());
+
+    if cfg!(target_os = "linux") {
+        let invalid_cpu = get_max_cpu_index() + 1;
+        assert!(matches!(
+            validate_cpu_affinity(&[0, invalid_cpu]).unwrap_err(),
+            ThreadPoolError::InvalidCpu { cpu, .. } if cpu == invalid_cpu
+        ));
+        assert!(build_thread_pool(1, &[invalid_cpu]).is_err());
+    }
+}
+
+#[test]
+fn test_install_without_pool() {
+    // No pool means the closure runs directly
+    assert_eq!(install(None, || 42), 42);
+}
+
+#[cfg(target_os = "linux")]
+#[test]
+fn test_build_thread_pool_affinity() {
+    let pool = build_thread_pool(1, &[0]).expect("Failed to build thread pool");
+
+    // Get the set of CPUs the worker thread is allowed to run on
+    let cpus: Vec<usize> = install(Some(&pool), || unsafe {
+        let mut cpu_set: libc::cpu_set_t = std::mem::zeroed();
+        assert_eq!(
+            libc::sched_getaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &mut cpu_set),
+            0
+        );
+        (0..get_max_cpu_index() + 1)
+            .filter(|cpu| libc::CPU_ISSET(*cpu, &cpu_set))
+            .collect()
+    });
+
+    assert_eq!(cpus, vec![0]);
+}
@@ -54,16 +54,20 @@ impl TimeStep {
     ///
     /// * `scheduled_starttime_unix_ms` - Scheduled start time of the observation based on GOODTIME-QUACKTIM in the metafits.
     ///
+    /// * `all_timesteps` - if true, include the timesteps of any gpubox file rather than only
+    ///   those common to all of them.
+    ///
     /// # Returns
     ///
-    /// * A populated vector of TimeStep structs inside an Option. Only
-    ///   timesteps *common to all* gpubox files are included. If the Option has
+    /// * A populated vector of TimeStep structs inside an Option. Unless
+    ///   `all_timesteps`, only timesteps *common to all* gpubox files are included. If the Option has
     ///   a value of None, then `gpubox_time_map` is empty.
     ///
     pub(crate) fn populate_correlator_timesteps(
         gpubox_time_map: &BTreeMap<u64, BTreeMap<usize, (usize, usize)>>,
         scheduled_starttime_gps_ms: u64,
         scheduled_starttime_unix_ms: u64,
+        all_timesteps: bool,
     ) -> Option<Vec<Self>> {
         if gpubox_time_map.is_empty() {
             return None;
@@ -76,7 +80,7 @@ impl TimeStep {
         // Now we find all keys with lengths equal to `num_gpubox_files`.
         let mut timesteps: Vec<TimeStep> = vec![];
         for (unix_time_ms, m) in gpubox_time_map.iter() {
-            if m.len() == num_gpubox_files {
+            if all_timesteps || m.len() == num_gpubox_files {
                 let gps_time_ms = misc::convert_unixtime_to_gpstime(
                     *unix_time_ms,
                     scheduled_starttime_gps_ms,
@@ -38,6 +38,7 @@ fn test_populate_correlator_timesteps() {
         &gpubox_time_map,
         scheduled_start_gpstime_ms,
         scheduled_start_unix_ms,
+        false,
     )
     .unwrap();
 
@@ -49,6 +50,57 @@ fn test_populate_correlator_timesteps() {
     assert_eq!(timesteps[5].gps_time_ms, 1_065_880_141_500);
 }
 
+#[test]
+fn test_populate_correlator_timesteps_all_timesteps() {
+    // gpubox 0 has the first 3 times and gpubox 1 the last 3, so only 1 time is common
+    let mut gpubox_time_map = BTreeMap::new();
+
+    let times: Vec<u64> = vec![
+        1_381_844_923_000,
+        1_381_844_923_500,
+        1_381_844_924_000,
+        1_381_844_924_500,
+        1_381_844_925_000,
+    ];
+
+    for (i, time) in times.iter().enumerate() {
+        let mut new_time_tree = BTreeMap::new();
+        if i <= 2 {
+            new_time_tree.insert(0, (0, i + 1));
+        }
+        if i >= 2 {
+            new_time_tree.insert(1, (0, i - 1));
+        }
+        gpubox_time_map.insert(*time, new_time_tree);
+    }
+
+    let scheduled_start_gpstime_ms = 1_065_880_139_000;
+    let scheduled_start_unix_ms = 1_381_844_923_000;
+
+    let common = TimeStep::populate_correlator_timesteps(
+        &gpubox_time_map,
+        scheduled_start_gpstime_ms,
+        scheduled_start_unix_ms,
+        false,
+    )
+    .unwrap();
+    assert_eq!(common.len(), 1);
+    assert_eq!(common[0].unix_time_ms, 1_381_844_924_000);
+
+    let all = TimeStep::populate_correlator_timesteps(
+        &gpubox_time_map,
+        scheduled_start_gpstime_ms,
+        scheduled_start_unix_ms,
+        true,
+    )
+    .unwrap();
+    assert_eq!(all.len(), 5);
+    assert_eq!(all[0].unix_time_ms, 1_381_844_923_000);
+    assert_eq!(all[0].gps_time_ms, 1_065_880_139_000);
+    assert_eq!(all[4].unix_time_ms, 1_381_844_925_000);
+    assert_eq!(all[4].gps_time_ms, 1_065_880_141_000);
+}
+
 #[test]
 fn test_populate_correlator_timesteps_none() {
     // Create a dummy BTree GPUbox map
@@ -60,6 +112,7 @@ fn test_populate_correlator_timesteps_none() {
         &gpubox_time_map,
         scheduled_start_gpstime_ms,
         scheduled_start_unix_ms,
+        false,
     );
 
     // Check
@@ -0,0 +1,414 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+A thin writer over cfitsio for the parts of UVFITS that fitsio does not cover: a random
+groups primary HDU, and binary table columns written straight from slices.
+ */
+use std::ffi::CString;
+use std::path::Path;
+use std::ptr;
+
+use fitsio_sys::{
+    ffclos, ffcrtb, ffinit, ffpcld, ffpcle, ffpclj, ffpcls, ffpgpe, ffphpr, ffpkyd, ffpkyj, ffpkys,
+    fitsfile,
+};
+use libc::{c_char, c_long};
+
+use crate::fits_read::error::FitsError;
+
+/// cfitsio's code for a binary table
+const BINARY_TBL: i32 = 2;
+
+/// An open FITS file being written with cfitsio. The file is closed when this is dropped,
+/// but errors from closing are only seen by calling `close`.
+pub(crate) struct FitsWriter {
+    fptr: *mut fitsfile,
+    filename: String,
+    /// The current HDU (1 is the primary HDU), for error messages
+    hdu_num: usize,
+}
+
+// cfitsio file handles can be used from any thread, as long as only one uses them at a time.
+// `FitsWriter` needs `&mut self` for every call, so that is guaranteed.
+unsafe impl Send for FitsWriter {}
+
+impl FitsWriter {
+    /// Create a new FITS file, which must not already exist.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - the file to create.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing the `FitsWriter`, or a `FitsError`.
+    ///
+    ///
+    pub(crate) fn create(path: &Path) -> Result<Self, FitsError> {
+        let filename = path.display().to_string();
+        let c_filename = CString::new(filename.as_str()).unwrap();
+        let mut fptr = ptr::null_mut();
+        let mut status = 0;
+        unsafe {
+            ffinit(&mut fptr, c_filename.as_ptr(), &mut status);
+        }
+
+        match status {
+            0 => Ok(FitsWriter {
+                fptr,
+                filename,
+                hdu_num: 1,
+            }),
+            _ => Err(FitsError::Open {
+                fits_error: get_fitsio_error(status, "creating file"),
+                fits_filename: filename,
+                source_file: file!(),
+                source_line: line!(),
+            }),
+        }
+    }
+
+    /// Turn a cfitsio status into a Result.
+    fn check(&self, status: i32, action: &str, source_line: u32) -> Result<(), FitsError> {
+        match status {
+            0 => Ok(()),
+            _ => Err(FitsError::Fitsio {
+                fits_error: get_fitsio_error(status, action),
+                fits_filename: self.filename.clone(),
+                hdu_num: self.hdu_num,
+                source_file: file!(),
+                source_line,
+            }),
+        }
+    }
+
+    /// Write the primary header of a random groups file.
+    ///
+    /// # Arguments
+    ///
+    /// * `naxes` - the size of each axis of a group's data, not including the leading 0 axis.
+    ///
+    /// * `pcount` - number of parameters in each group.
+    ///
+    /// * `gcount` - number of groups.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing nothing if Ok, or a `FitsError`.
+    ///
+    ///
+    pub(crate) fn write_random_groups_header(
+        &mut self,
+        naxes: &[usize],
+        pcount: usize,
+        gcount: usize,
+    ) -> Result<(), FitsError> {
+        // NAXIS1 = 0 marks the primary array as random groups
+        let mut c_naxes: Vec<c_long> = std::iter::once(0)
+            .chain(naxes.iter().map(|n| *n as c_long))
+            .collect();
+        let mut status = 0;
+        unsafe {
+            ffphpr(
+                self.fptr,
+                1,
+                -32,
+                c_naxes.len() as i32,
+                c_naxes.as_mut_ptr(),
+                pcount as i64,
+                gcount as i64,
+                1,
+                &mut status,
+            );
+        }
+        self.check(status, "writing random groups header", line!())
+    }
+
+    /// Write a string keyword to the current HDU.
+    pub(crate) fn write_key_str(
+        &mut self,
+        key: &str,
+        value: &str,
+        comment: &str,
+    ) -> Result<(), FitsError> {
+        let (c_key, c_value, c_comment) = (
+            CString::new(key).unwrap(),
+            CString::new(value).unwrap(),
+            CString::new(comment).unwrap(),
+        );
+        let mut status = 0;
+        unsafe {
+            ffpkys(
+                self.fptr,
+                c_key.as_ptr(),
+                c_value.as_ptr(),
+                c_comment.as_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing keyword", line!())
+    }
+
+    /// Write an integer keyword to the current HDU.
+    pub(crate) fn write_key_i64(
+        &mut self,
+        key: &str,
+        value: i64,
+        comment: &str,
+    ) -> Result<(), FitsError> {
+        let (c_key, c_comment) = (CString::new(key).unwrap(), CString::new(comment).unwrap());
+        let mut status = 0;
+        unsafe {
+            ffpkyj(
+                self.fptr,
+                c_key.as_ptr(),
+                value,
+                c_comment.as_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing keyword", line!())
+    }
+
+    /// Write a floating point keyword to the current HDU, at full double precision.
+    pub(crate) fn write_key_f64(
+        &mut self,
+        key: &str,
+        value: f64,
+        comment: &str,
+    ) -> Result<(), FitsError> {
+        let (c_key, c_comment) = (CString::new(key).unwrap(), CString::new(comment).unwrap());
+        let mut status = 0;
+        unsafe {
+            ffpkyd(
+                self.fptr,
+                c_key.as_ptr(),
+                value,
+                -15,
+                c_comment.as_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing keyword", line!())
+    }
+
+    /// Write consecutive groups (parameters then data, for each group) of the primary array in one call.
+    ///
+    /// # Arguments
+    ///
+    /// * `first_group` - the first group to write, counting from 1.
+    ///
+    /// * `groups` - whole groups, each `pcount` parameters followed by the group's data.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing nothing if Ok, or a `FitsError`.
+    ///
+    ///
+    pub(crate) fn write_groups(
+        &mut self,
+        first_group: usize,
+        groups: &mut [f32],
+    ) -> Result<(), FitsError> {
+        // Writing past the end of a group's parameters carries on into its data, and then
+        // into the next group, so this is one sequential write.
+        let mut status = 0;
+        unsafe {
+            ffpgpe(
+                self.fptr,
+                first_group as c_long,
+                1,
+                groups.len() as c_long,
+                groups.as_mut_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing random groups", line!())
+    }
+
+    /// Create a binary table HDU after the current HDU, and make it current.
+    ///
+    /// # Arguments
+    ///
+    /// * `extname` - the table's EXTNAME.
+    ///
+    /// * `num_rows` - number of rows.
+    ///
+    /// * `columns` - the (TTYPE, TFORM, TUNIT) of each column.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing nothing if Ok, or a `FitsError`.
+    ///
+    ///
+    pub(crate) fn create_binary_table(
+        &mut self,
+        extname: &str,
+        num_rows: usize,
+        columns: &[(&str, &str, &str)],
+    ) -> Result<(), FitsError> {
+        let to_c_strings = |strings: Vec<&str>| -> Vec<CString> {
+            strings
+                .into_iter()
+                .map(|s| CString::new(s).unwrap())
+                .collect()
+        };
+        let ttypes = to_c_strings(columns.iter().map(|c| c.0).collect());
+        let tforms = to_c_strings(columns.iter().map(|c| c.1).collect());
+        let tunits = to_c_strings(columns.iter().map(|c| c.2).collect());
+        let mut ttype_ptrs = get_c_string_ptrs(&ttypes);
+        let mut tform_ptrs = get_c_string_ptrs(&tforms);
+        let mut tunit_ptrs = get_c_string_ptrs(&tunits);
+        let c_extname = CString::new(extname).unwrap();
+
+        self.hdu_num += 1;
+        let mut status = 0;
+        unsafe {
+            ffcrtb(
+                self.fptr,
+                BINARY_TBL,
+                num_rows as i64,
+                columns.len() as i32,
+                ttype_ptrs.as_mut_ptr(),
+                tform_ptrs.as_mut_ptr(),
+                tunit_ptrs.as_mut_ptr(),
+                c_extname.as_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "creating binary table", line!())
+    }
+
+    /// Write a string column of the current binary table, from the first row.
+    pub(crate) fn write_col_str(
+        &mut self,
+        col_num: usize,
+        values: &[String],
+    ) -> Result<(), FitsError> {
+        let c_values: Vec<CString> = values
+            .iter()
+            .map(|v| CString::new(v.as_str()).unwrap())
+            .collect();
+        let mut ptrs = get_c_string_ptrs(&c_values);
+        let mut status = 0;
+        unsafe {
+            ffpcls(
+                self.fptr,
+                col_num as i32,
+                1,
+                1,
+                ptrs.len() as i64,
+                ptrs.as_mut_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing string column", line!())
+    }
+
+    /// Write a double column (all elements of each row, in row order) of the current binary table.
+    pub(crate) fn write_col_f64(
+        &mut self,
+        col_num: usize,
+        values: &[f64],
+    ) -> Result<(), FitsError> {
+        let mut values = values.to_vec();
+        let mut status = 0;
+        unsafe {
+            ffpcld(
+                self.fptr,
+                col_num as i32,
+                1,
+                1,
+                values.len() as i64,
+                values.as_mut_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing double column", line!())
+    }
+
+    /// Write a float column (all elements of each row, in row order) of the current binary table.
+    pub(crate) fn write_col_f32(
+        &mut self,
+        col_num: usize,
+        values: &[f32],
+    ) -> Result<(), FitsError> {
+        let mut values = values.to_vec();
+        let mut status = 0;
+        unsafe {
+            ffpcle(
+                self.fptr,
+                col_num as i32,
+                1,
+                1,
+                values.len() as i64,
+                values.as_mut_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing float column", line!())
+    }
+
+    /// Write an integer column (all elements of each row, in row order) of the current binary table.
+    pub(crate) fn write_col_i64(
+        &mut self,
+        col_num: usize,
+        values: &[i64],
+    ) -> Result<(), FitsError> {
+        let mut values: Vec<c_long> = values.iter().map(|v| *v as c_long).collect();
+        let mut status = 0;
+        unsafe {
+            ffpclj(
+                self.fptr,
+                col_num as i32,
+                1,
+                1,
+                values.len() as i64,
+                values.as_mut_ptr(),
+                &mut status,
+            );
+        }
+        self.check(status, "writing integer column", line!())
+    }
+
+    /// Close the file, flushing everything written to disk.
+    pub(crate) fn close(mut self) -> Result<(), FitsError> {
+        let mut status = 0;
+        unsafe {
+            ffclos(self.fptr, &mut status);
+        }
+        // Don't close again on drop, even if closing failed
+        self.fptr = ptr::null_mut();
+        self.check(status, "closing file", line!())
+    }
+}
+
+impl Drop for FitsWriter {
+    fn drop(&mut self) {
+        if !self.fptr.is_null() {
+            let mut status = 0;
+            unsafe {
+                ffclos(self.fptr, &mut status);
+            }
+        }
+    }
+}
+
+/// Get the pointers cfitsio wants for an array of strings. The pointers borrow from `strings`.
+fn get_c_string_ptrs(strings: &[CString]) -> Vec<*mut c_char> {
+    strings.iter().map(|s| s.as_ptr() as *mut c_char).collect()
+}
+
+/// Make a fitsio error from a cfitsio status.
+fn get_fitsio_error(status: i32, action: &str) -> fitsio::errors::Error {
+    fitsio::errors::Error::Fits(fitsio::errors::FitsError {
+        status,
+        message: format!("cfitsio returned status {} {}", status, action),
+    })
+}
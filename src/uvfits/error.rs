@@ -0,0 +1,47 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Errors associated with writing UVFITS files.
+*/
+
+use thiserror::Error;
+
+#[derive(Error, Debug)]
+pub enum UvfitsError {
+    /// Error when an averaging factor is zero, or frequency averaging would mix coarse channels.
+    #[error("Cannot average {time_average} timesteps and {freq_average} fine channels: both must be at least 1, and there are {num_fine_chans} fine channels per coarse channel")]
+    InvalidAveraging {
+        time_average: usize,
+        freq_average: usize,
+        num_fine_chans: usize,
+    },
+
+    /// Error when the context's coarse channels do not form one contiguous band.
+    #[error("Coarse channels {rec_chan_number1} and {rec_chan_number2} are not contiguous. A UVFITS file needs one contiguous band; open a context with only contiguous channels")]
+    NonContiguousCoarseChans {
+        rec_chan_number1: usize,
+        rec_chan_number2: usize,
+    },
+
+    /// Error when the context has no timesteps or no coarse channels to write.
+    #[error("The context has no timesteps or no coarse channels to write")]
+    NoData,
+
+    /// Error when the output file exists and overwriting was not asked for.
+    #[error("Output file {0} already exists")]
+    OutputExists(String),
+
+    /// An IO error removing an existing output file.
+    #[error("UVFITS writer IO error: {0}")]
+    Io(#[from] std::io::Error),
+
+    /// An error derived from `FitsError`, from writing the file.
+    #[error("{0}")]
+    Fits(#[from] crate::fits_read::error::FitsError),
+
+    /// An error derived from `PipelineError`, from reading the data.
+    #[error("{0}")]
+    Pipeline(#[from] crate::pipeline::error::PipelineError),
+}
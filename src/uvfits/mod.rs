@@ -0,0 +1,845 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Write a `CorrelatorContext`'s visibilities to a UVFITS file.
+
+The data is read in timestep order through a `Pipeline`, so gpubox reads and conversions run
+ahead of the writer in their own threads. Each timestep's coarse channels are assembled into
+one band, optionally averaged in time and frequency, and written as random groups (one per
+baseline, in the context's baseline order) with large sequential writes. Only the timesteps
+being averaged and the pipeline's buffers are held in memory, whatever the length of the
+observation.
+
+Each group has the parameters UU, VV, WW (in seconds), BASELINE and DATE, followed by
+[frequency][polarisation][real, imaginary, weight], with polarisations in the AIPS order
+XX, YY, XY, YX. The weight of each averaged value is the number of samples in it, negated
+if either antenna of the baseline is flagged in the metafits; it is 0 where there is no data.
+An AIPS AN (antenna) table follows the groups.
+
+UVWs are computed for the phase centre (or the tile pointing, if there is no phase centre)
+at the centre of each output timestep, without precession. The correlator's visibilities are
+phased to zenith; by default they are rotated to the phase centre by multiplying by
+exp(-2πi w ν / c) before averaging. No other corrections (cable lengths, digital gains, ...)
+are applied.
+ */
+pub mod error;
+pub use error::UvfitsError;
+
+mod cfitsio;
+
+use std::collections::BTreeMap;
+use std::fs;
+use std::path::Path;
+use std::sync::Mutex;
+
+use crate::correlator_context::CorrelatorContext;
+use crate::geometry::get_lst_rad;
+use crate::pipeline::{Pipeline, VisibilityBlock};
+use crate::{MWA_ALTITUDE_METRES, MWA_LATITUDE_RADIANS, MWA_LONGITUDE_RADIANS};
+use cfitsio::FitsWriter;
+
+#[cfg(test)]
+mod test;
+
+/// Speed of light in a vacuum, in metres per second
+const SPEED_OF_LIGHT_M_PER_S: f64 = 299_792_458.0;
+/// The Julian date of the UNIX epoch
+const UNIX_EPOCH_JD: f64 = 2_440_587.5;
+/// Number of random group parameters: UU, VV, WW, BASELINE, DATE
+const NUM_GROUP_PARAMS: usize = 5;
+/// Number of floats per visibility: real, imaginary, weight
+const NUM_VIS_FLOATS: usize = 3;
+/// Index into mwalib's polarisations (XX, XY, YX, YY) of each UVFITS polarisation (XX, YY, XY, YX)
+const UVFITS_POL_ORDER: [usize; 4] = [0, 3, 1, 2];
+/// Groups are written in calls of about this many bytes
+const UVFITS_WRITE_BYTES: usize = 8 * 1024 * 1024;
+
+/// Options for `write_uvfits`.
+#[derive(Clone, Debug)]
+pub struct UvfitsWriterOptions {
+    /// Number of timesteps to average into each output timestep. A partial last group is
+    /// averaged over the timesteps it has.
+    pub time_average: usize,
+    /// Number of fine channels to average into each output channel. Must divide the number of
+    /// fine channels per coarse channel.
+    pub freq_average: usize,
+    /// Rotate the visibilities from zenith to the phase centre the UVWs are computed for.
+    pub phase_rotate: bool,
+    /// Replace the output file if it already exists, rather than failing.
+    pub overwrite: bool,
+    /// Number of threads reading gpubox files ahead of the writer.
+    pub num_read_workers: usize,
+    /// Number of threads converting (and phase rotating) ahead of the writer.
+    pub num_convert_workers: usize,
+}
+
+impl Default for UvfitsWriterOptions {
+    fn default() -> Self {
+        UvfitsWriterOptions {
+            time_average: 1,
+            freq_average: 1,
+            phase_rotate: true,
+            overwrite: false,
+            num_read_workers: 2,
+            num_convert_workers: 2,
+        }
+    }
+}
+
+/// The shape of the output, after averaging
+#[derive(Clone, Debug)]
+pub(crate) struct UvfitsLayout {
+    pub num_baselines: usize,
+    pub num_pols: usize,
+    pub num_fine_chans_per_coarse: usize,
+    pub freq_average: usize,
+    pub num_out_chans: usize,
+    pub num_timesteps: usize,
+    pub time_average: usize,
+    pub num_out_timesteps: usize,
+}
+
+impl UvfitsLayout {
+    /// Work out the output shape, checking the averaging factors.
+    pub(crate) fn new(
+        num_baselines: usize,
+        num_pols: usize,
+        num_coarse_chans: usize,
+        num_fine_chans_per_coarse: usize,
+        num_timesteps: usize,
+        time_average: usize,
+        freq_average: usize,
+    ) -> Result<Self, UvfitsError> {
+        if time_average == 0 || freq_average == 0 || num_fine_chans_per_coarse % freq_average != 0 {
+            return Err(UvfitsError::InvalidAveraging {
+                time_average,
+                freq_average,
+                num_fine_chans: num_fine_chans_per_coarse,
+            });
+        }
+
+        Ok(UvfitsLayout {
+            num_baselines,
+            num_pols,
+            num_fine_chans_per_coarse,
+            freq_average,
+            num_out_chans: num_coarse_chans * num_fine_chans_per_coarse / freq_average,
+            num_timesteps,
+            time_average,
+            num_out_timesteps: (num_timesteps + time_average - 1) / time_average,
+        })
+    }
+
+    /// Number of floats in a group: its parameters then [frequency][pol][r, i, weight]
+    pub(crate) fn get_group_floats(&self) -> usize {
+        NUM_GROUP_PARAMS + self.num_out_chans * self.num_pols * NUM_VIS_FLOATS
+    }
+
+    /// The range of input timesteps averaged into an output timestep
+    pub(crate) fn get_timestep_range(&self, out_timestep_index: usize) -> std::ops::Range<usize> {
+        out_timestep_index * self.time_average
+            ..((out_timestep_index + 1) * self.time_average).min(self.num_timesteps)
+    }
+}
+
+/// Antenna positions and the phase centre, for UVWs and phase rotation
+pub(crate) struct UvfitsGeometry {
+    /// Local XYZ (X towards the local meridian on the equator, Y east, Z north) of each antenna, in metres
+    pub antenna_xyz: Vec<[f64; 3]>,
+    /// The antenna indices of each baseline
+    pub baseline_antennas: Vec<(usize, usize)>,
+    pub ra_rad: f64,
+    pub dec_rad: f64,
+}
+
+impl UvfitsGeometry {
+    /// Get the UVW (in metres) of each baseline, ant1 - ant2, at a local sidereal time.
+    pub(crate) fn get_baseline_uvws(&self, lst_rad: f64) -> Vec<[f64; 3]> {
+        let hour_angle_rad = lst_rad - self.ra_rad;
+        let antenna_uvws: Vec<[f64; 3]> = self
+            .antenna_xyz
+            .iter()
+            .map(|xyz| get_uvw(xyz, hour_angle_rad, self.dec_rad))
+            .collect();
+
+        self.baseline_antennas
+            .iter()
+            .map(|(ant1, ant2)| {
+                let (uvw1, uvw2) = (antenna_uvws[*ant1], antenna_uvws[*ant2]);
+                [uvw1[0] - uvw2[0], uvw1[1] - uvw2[1], uvw1[2] - uvw2[2]]
+            })
+            .collect()
+    }
+}
+
+/// Sums and sample counts of the visibilities being averaged into one output timestep
+struct Accumulator {
+    /// [baseline][output channel][pol][r, i]
+    sums: Vec<f32>,
+    /// Number of samples summed into each output channel (the same for every baseline)
+    counts: Vec<u32>,
+}
+
+/// Writer state, shared by the pipeline's user stage
+struct UvfitsStream<'a> {
+    context: &'a CorrelatorContext,
+    layout: UvfitsLayout,
+    geometry: &'a UvfitsGeometry,
+    writer: FitsWriter,
+    /// Julian date of 0h UTC on the first day, which DATE is relative to
+    jd_midnight: f64,
+    /// Whether either antenna of each baseline is flagged
+    baseline_flagged: Vec<bool>,
+    /// Number of blocks still to come for each output timestep
+    num_blocks_remaining: Vec<usize>,
+    /// Output timesteps which have had some, but not all, of their blocks
+    pending: BTreeMap<usize, Accumulator>,
+    /// Accumulators already written, to reuse rather than reallocate
+    spare: Vec<Accumulator>,
+    /// The next output timestep to write
+    next_out_timestep_index: usize,
+    /// Groups waiting to be written
+    groups: Vec<f32>,
+}
+
+impl<'a> UvfitsStream<'a> {
+    /// Add a converted block into its output timestep, then write any output timesteps which are complete.
+    fn add_block(&mut self, block: VisibilityBlock) -> Result<(), UvfitsError> {
+        let layout = &self.layout;
+        let out_timestep_index = block.work_unit.timestep_index / layout.time_average;
+        let spare = &mut self.spare;
+        let accumulator = self
+            .pending
+            .entry(out_timestep_index)
+            .or_insert_with(|| get_accumulator(spare, layout));
+
+        accumulate_block(
+            layout,
+            block.work_unit.coarse_chan_index,
+            &block.data,
+            accumulator,
+        );
+        // Return the buffer to the pool before writing
+        drop(block);
+
+        self.num_blocks_remaining[out_timestep_index] -= 1;
+        self.write_complete_timesteps()
+    }
+
+    /// Write out, in order, every output timestep that has all of its blocks.
+    fn write_complete_timesteps(&mut self) -> Result<(), UvfitsError> {
+        while self.next_out_timestep_index < self.layout.num_out_timesteps
+            && self.num_blocks_remaining[self.next_out_timestep_index] == 0
+        {
+            let out_timestep_index = self.next_out_timestep_index;
+            // An output timestep with no data at all has no accumulator, and is written with zero weights
+            let accumulator = self.pending.remove(&out_timestep_index);
+            self.write_timestep(out_timestep_index, accumulator.as_ref())?;
+            if let Some(accumulator) = accumulator {
+                self.spare.push(accumulator);
+            }
+            self.next_out_timestep_index += 1;
+        }
+
+        Ok(())
+    }
+
+    /// Write the groups of one output timestep.
+    fn write_timestep(
+        &mut self,
+        out_timestep_index: usize,
+        accumulator: Option<&Accumulator>,
+    ) -> Result<(), UvfitsError> {
+        let layout = &self.layout;
+        let context = self.context;
+        let num_baselines = layout.num_baselines;
+        let num_out_chans = layout.num_out_chans;
+        let num_pols = layout.num_pols;
+
+        let centre_unix_time_ms =
+            get_centre_unix_time_ms(context, layout.get_timestep_range(out_timestep_index));
+        let date = (get_julian_date(centre_unix_time_ms) - self.jd_midnight) as f32;
+        let uvws = self
+            .geometry
+            .get_baseline_uvws(get_lst_rad(&context.metafits_context, centre_unix_time_ms));
+
+        let group_floats = layout.get_group_floats();
+        let groups_per_write = (UVFITS_WRITE_BYTES / (group_floats * 4)).max(1);
+        let mut first_baseline = 0;
+
+        while first_baseline < num_baselines {
+            let last_baseline = (first_baseline + groups_per_write).min(num_baselines);
+            self.groups.clear();
+
+            for baseline_index in first_baseline..last_baseline {
+                let (ant1, ant2) = self.geometry.baseline_antennas[baseline_index];
+                let uvw = uvws[baseline_index];
+                self.groups.extend_from_slice(&[
+                    (uvw[0] / SPEED_OF_LIGHT_M_PER_S) as f32,
+                    (uvw[1] / SPEED_OF_LIGHT_M_PER_S) as f32,
+                    (uvw[2] / SPEED_OF_LIGHT_M_PER_S) as f32,
+                    encode_uvfits_baseline(ant1, ant2),
+                    date,
+                ]);
+
+                let weight_sign = if self.baseline_flagged[baseline_index] {
+                    -1.
+                } else {
+                    1.
+                };
+                for out_chan_index in 0..num_out_chans {
+                    let count = accumulator.map_or(0, |a| a.counts[out_chan_index]);
+                    if count == 0 {
+                        self.groups
+                            .extend(std::iter::repeat(0.).take(num_pols * NUM_VIS_FLOATS));
+                        continue;
+                    }
+                    let scale = 1. / count as f32;
+                    let weight = weight_sign * count as f32;
+                    let sums = &accumulator.unwrap().sums
+                        [(baseline_index * num_out_chans + out_chan_index) * num_pols * 2..];
+                    for pol_index in UVFITS_POL_ORDER.iter().take(num_pols) {
+                        self.groups.extend_from_slice(&[
+                            sums[pol_index * 2] * scale,
+                            sums[pol_index * 2 + 1] * scale,
+                            weight,
+                        ]);
+                    }
+                }
+            }
+
+            // Groups are numbered from 1
+            self.writer.write_groups(
+                out_timestep_index * num_baselines + first_baseline + 1,
+                &mut self.groups,
+            )?;
+            first_baseline = last_baseline;
+        }
+
+        Ok(())
+    }
+}
+
+/// Get a zeroed accumulator, reusing a spare one if there is one.
+fn get_accumulator(spare: &mut Vec<Accumulator>, layout: &UvfitsLayout) -> Accumulator {
+    match spare.pop() {
+        Some(mut accumulator) => {
+            accumulator.sums.iter_mut().for_each(|s| *s = 0.);
+            accumulator.counts.iter_mut().for_each(|c| *c = 0);
+            accumulator
+        }
+        None => Accumulator {
+            sums: vec![0.; layout.num_baselines * layout.num_out_chans * layout.num_pols * 2],
+            counts: vec![0; layout.num_out_chans],
+        },
+    }
+}
+
+/// Add a coarse channel's baseline ordered visibilities into an accumulator.
+///
+/// # Arguments
+///
+/// * `layout` - the output shape.
+///
+/// * `coarse_chan_index` - the block's coarse channel.
+///
+/// * `data` - the block's visibilities, [baseline][fine chan][pol][r, i].
+///
+/// * `accumulator` - accumulator of the block's output timestep.
+///
+///
+/// # Returns
+///
+/// * Nothing
+///
+///
+fn accumulate_block(
+    layout: &UvfitsLayout,
+    coarse_chan_index: usize,
+    data: &[f32],
+    accumulator: &mut Accumulator,
+) {
+    let num_fine_chans = layout.num_fine_chans_per_coarse;
+    let vis_floats = layout.num_pols * 2;
+    let first_out_chan = coarse_chan_index * num_fine_chans / layout.freq_average;
+
+    for (baseline_index, baseline_data) in data
+        .chunks_exact(num_fine_chans * vis_floats)
+        .take(layout.num_baselines)
+        .enumerate()
+    {
+        let out_baseline_start = baseline_index * layout.num_out_chans * vis_floats;
+        for (fine_chan_index, fine_chan_data) in baseline_data.chunks_exact(vis_floats).enumerate()
+        {
+            let out_chan_index = first_out_chan + fine_chan_index / layout.freq_average;
+            let out_start = out_baseline_start + out_chan_index * vis_floats;
+            for (sum, value) in accumulator.sums[out_start..out_start + vis_floats]
+                .iter_mut()
+                .zip(fine_chan_data)
+            {
+                *sum += value;
+            }
+        }
+    }
+
+    for fine_chan_index in 0..num_fine_chans {
+        accumulator.counts[first_out_chan + fine_chan_index / layout.freq_average] += 1;
+    }
+}
+
+/// Rotate a block's visibilities from zenith to the phase centre.
+fn rotate_block(
+    context: &CorrelatorContext,
+    geometry: &UvfitsGeometry,
+    block: &mut VisibilityBlock,
+) {
+    let metafits_context = &context.metafits_context;
+    let num_fine_chans = metafits_context.num_corr_fine_chans_per_coarse;
+    let vis_floats = metafits_context.num_visibility_pols * 2;
+    let freqs_hz = context
+        .fine_chan_table
+        .get_coarse_chan_freqs_hz(block.work_unit.coarse_chan_index);
+
+    let uvws = geometry
+        .get_baseline_uvws(context.timestep_geometry.lst_rad[block.work_unit.timestep_index]);
+
+    for (uvw, baseline_data) in uvws
+        .iter()
+        .zip(block.data.chunks_exact_mut(num_fine_chans * vis_floats))
+    {
+        let w_wavelengths_per_hz = uvw[2] / SPEED_OF_LIGHT_M_PER_S;
+        for (freq_hz, fine_chan_data) in freqs_hz
+            .iter()
+            .zip(baseline_data.chunks_exact_mut(vis_floats))
+        {
+            let (sin, cos) =
+                (-2. * std::f64::consts::PI * w_wavelengths_per_hz * freq_hz).sin_cos();
+            let (sin, cos) = (sin as f32, cos as f32);
+            for vis in fine_chan_data.chunks_exact_mut(2) {
+                let (re, im) = (vis[0], vis[1]);
+                vis[0] = re * cos - im * sin;
+                vis[1] = re * sin + im * cos;
+            }
+        }
+    }
+}
+
+/// Write a `CorrelatorContext`'s visibilities to a UVFITS file. See the module documentation.
+///
+/// # Arguments
+///
+/// * `context` - the `CorrelatorContext` to write. All of its timesteps and coarse channels are
+///               written; the coarse channels must be contiguous.
+///
+/// * `filename` - the UVFITS file to write.
+///
+/// * `options` - see `UvfitsWriterOptions`.
+///
+///
+/// # Returns
+///
+/// * Result containing the number of groups (rows) written, or a `UvfitsError`.
+///
+///
+pub fn write_uvfits<P: AsRef<Path>>(
+    context: &CorrelatorContext,
+    filename: P,
+    options: &UvfitsWriterOptions,
+) -> Result<usize, UvfitsError> {
+    let metafits_context = &context.metafits_context;
+    if context.num_timesteps == 0 || context.num_coarse_chans == 0 {
+        return Err(UvfitsError::NoData);
+    }
+    for pair in context.coarse_chans.windows(2) {
+        if pair[1].chan_start_hz != pair[0].chan_end_hz {
+            return Err(UvfitsError::NonContiguousCoarseChans {
+                rec_chan_number1: pair[0].rec_chan_number,
+                rec_chan_number2: pair[1].rec_chan_number,
+            });
+        }
+    }
+    let layout = UvfitsLayout::new(
+        metafits_context.num_baselines,
+        metafits_context.num_visibility_pols,
+        context.num_coarse_chans,
+        metafits_context.num_corr_fine_chans_per_coarse,
+        context.num_timesteps,
+        options.time_average,
+        options.freq_average,
+    )?;
+
+    let filename = filename.as_ref();
+    if filename.exists() {
+        if options.overwrite {
+            fs::remove_file(filename)?;
+        } else {
+            return Err(UvfitsError::OutputExists(filename.display().to_string()));
+        }
+    }
+
+    let geometry = UvfitsGeometry {
+        antenna_xyz: metafits_context
+            .antennas
+            .iter()
+            .map(|a| {
+                get_local_xyz(
+                    a.rfinput_x.east_m,
+                    a.rfinput_x.north_m,
+                    a.rfinput_x.height_m,
+                    MWA_LATITUDE_RADIANS,
+                )
+            })
+            .collect(),
+        baseline_antennas: metafits_context
+            .baselines
+            .iter()
+            .map(|b| (b.ant1_index, b.ant2_index))
+            .collect(),
+        ra_rad: metafits_context
+            .ra_phase_center_degrees
+            .unwrap_or(metafits_context.ra_tile_pointing_degrees)
+            .to_radians(),
+        dec_rad: metafits_context
+            .dec_phase_center_degrees
+            .unwrap_or(metafits_context.dec_tile_pointing_degrees)
+            .to_radians(),
+    };
+    let antenna_flagged: Vec<bool> = metafits_context
+        .antennas
+        .iter()
+        .map(|a| a.rfinput_x.flagged || a.rfinput_y.flagged)
+        .collect();
+
+    // Only (timestep, coarse channel)s which have an HDU are read; the rest have zero weight
+    let work_units = context.get_work_units();
+    let mut num_blocks_remaining = vec![0; layout.num_out_timesteps];
+    for work_unit in &work_units {
+        num_blocks_remaining[work_unit.timestep_index / layout.time_average] += 1;
+    }
+
+    let start_jd = get_julian_date(context.timesteps[0].unix_time_ms as f64);
+    let jd_midnight = (start_jd - 0.5).floor() + 0.5;
+    let mut writer = FitsWriter::create(filename)?;
+    write_primary_header(&mut writer, context, &layout, &geometry, jd_midnight)?;
+
+    let stream = Mutex::new(UvfitsStream {
+        context,
+        layout: layout.clone(),
+        geometry: &geometry,
+        writer,
+        jd_midnight,
+        baseline_flagged: geometry
+            .baseline_antennas
+            .iter()
+            .map(|(ant1, ant2)| antenna_flagged[*ant1] || antenna_flagged[*ant2])
+            .collect(),
+        num_blocks_remaining,
+        pending: BTreeMap::new(),
+        spare: Vec::new(),
+        next_out_timestep_index: 0,
+        groups: Vec::new(),
+    });
+
+    // Leading output timesteps with no data at all are written before any blocks arrive
+    stream.lock().unwrap().write_complete_timesteps()?;
+
+    // Queue up about a timestep's worth of blocks between each stage
+    let mut pipeline = Pipeline::new(context)
+        .with_work_units(work_units)
+        .with_workers(options.num_read_workers, options.num_convert_workers, 1)
+        .with_queue_depth(context.num_coarse_chans);
+    if options.phase_rotate {
+        let geometry = &geometry;
+        pipeline = pipeline.with_correction(move |block| rotate_block(context, geometry, block));
+    }
+    pipeline.run(|block| stream.lock().unwrap().add_block(block))?;
+
+    let mut stream = stream.into_inner().unwrap();
+    stream.write_complete_timesteps()?;
+    write_antenna_table(&mut stream.writer, context, &geometry, jd_midnight)?;
+    stream.writer.close()?;
+
+    Ok(layout.num_out_timesteps * layout.num_baselines)
+}
+
+/// Write the random groups primary header.
+fn write_primary_header(
+    writer: &mut FitsWriter,
+    context: &CorrelatorContext,
+    layout: &UvfitsLayout,
+    geometry: &UvfitsGeometry,
+    jd_midnight: f64,
+) -> Result<(), UvfitsError> {
+    let metafits_context = &context.metafits_context;
+    let fine_chan_width_hz = metafits_context.corr_fine_chan_width_hz as f64;
+    let out_chan_width_hz = fine_chan_width_hz * layout.freq_average as f64;
+
+    writer.write_random_groups_header(
+        &[
+            NUM_VIS_FLOATS,
+            layout.num_pols,
+            layout.num_out_chans,
+            1,
+            1,
+            1,
+        ],
+        NUM_GROUP_PARAMS,
+        layout.num_out_timesteps * layout.num_baselines,
+    )?;
+    writer.write_key_f64("BSCALE", 1., "")?;
+    writer.write_key_f64("BZERO", 0., "")?;
+    writer.write_key_str("OBJECT", &metafits_context.obs_name, "")?;
+    writer.write_key_str("TELESCOP", "MWA", "")?;
+    writer.write_key_str("INSTRUME", "MWA", "")?;
+    writer.write_key_f64("EPOCH", 2000., "")?;
+    writer.write_key_f64(
+        "OBSRA",
+        metafits_context.ra_tile_pointing_degrees,
+        "Tile pointing RA",
+    )?;
+    writer.write_key_f64(
+        "OBSDEC",
+        metafits_context.dec_tile_pointing_degrees,
+        "Tile pointing Dec",
+    )?;
+    writer.write_key_str(
+        "DATE-OBS",
+        &format_unix_time_ms(context.timesteps[0].unix_time_ms, "%Y-%m-%dT%H:%M:%S%.3f"),
+        "",
+    )?;
+
+    let axes: [(&str, f64, f64, &str); 6] = [
+        ("COMPLEX", 1., 1., ""),
+        // -5 to -8 are XX, YY, XY, YX
+        ("STOKES", -5., -1., ""),
+        (
+            "FREQ",
+            context.coarse_chans[0].chan_start_hz as f64 + out_chan_width_hz / 2.,
+            out_chan_width_hz,
+            "Centre of the first channel",
+        ),
+        ("IF", 1., 1., ""),
+        ("RA", geometry.ra_rad.to_degrees(), 1., "Phase centre"),
+        ("DEC", geometry.dec_rad.to_degrees(), 1., "Phase centre"),
+    ];
+    for (axis_index, (ctype, crval, cdelt, comment)) in axes.iter().enumerate() {
+        // NAXIS1 is the random groups 0 axis
+        let axis_num = axis_index + 2;
+        writer.write_key_str(&format!("CTYPE{}", axis_num), ctype, comment)?;
+        writer.write_key_f64(&format!("CRVAL{}", axis_num), *crval, "")?;
+        writer.write_key_f64(&format!("CDELT{}", axis_num), *cdelt, "")?;
+        writer.write_key_f64(&format!("CRPIX{}", axis_num), 1., "")?;
+    }
+
+    let params: [(&str, f64, &str); NUM_GROUP_PARAMS] = [
+        ("UU", 0., "seconds"),
+        ("VV", 0., "seconds"),
+        ("WW", 0., "seconds"),
+        ("BASELINE", 0., ""),
+        ("DATE", jd_midnight, "Julian date"),
+    ];
+    for (param_index, (ptype, pzero, comment)) in params.iter().enumerate() {
+        let param_num = param_index + 1;
+        writer.write_key_str(&format!("PTYPE{}", param_num), ptype, comment)?;
+        writer.write_key_f64(&format!("PSCAL{}", param_num), 1., "")?;
+        writer.write_key_f64(&format!("PZERO{}", param_num), *pzero, "")?;
+    }
+
+    Ok(())
+}
+
+/// Write the AIPS AN (antenna) table.
+fn write_antenna_table(
+    writer: &mut FitsWriter,
+    context: &CorrelatorContext,
+    geometry: &UvfitsGeometry,
+    jd_midnight: f64,
+) -> Result<(), UvfitsError> {
+    let metafits_context = &context.metafits_context;
+    let num_ants = metafits_context.num_ants;
+
+    writer.create_binary_table(
+        "AIPS AN",
+        num_ants,
+        &[
+            ("ANNAME", "8A", ""),
+            ("STABXYZ", "3D", "METERS"),
+            ("NOSTA", "1J", ""),
+            ("MNTSTA", "1J", ""),
+            ("STAXOF", "1E", "METERS"),
+            ("POLTYA", "1A", ""),
+            ("POLAA", "1E", "DEGREES"),
+            ("POLCALA", "1E", ""),
+            ("POLTYB", "1A", ""),
+            ("POLAB", "1E", "DEGREES"),
+            ("POLCALB", "1E", ""),
+        ],
+    )?;
+
+    let array_xyz = get_geocentric_xyz(
+        MWA_LATITUDE_RADIANS,
+        MWA_LONGITUDE_RADIANS,
+        MWA_ALTITUDE_METRES,
+    );
+    // TAI - UTC is GPS - UTC plus 19 s; GPS time is UNIX time less the GPS epoch, plus leap seconds
+    let first_timestep = &context.timesteps[0];
+    let tai_minus_utc_s = (first_timestep.gps_time_ms as f64 - first_timestep.unix_time_ms as f64)
+        / 1000.
+        + 315_964_800.
+        + 19.;
+    let jd_midnight_unix_time_ms = ((jd_midnight - UNIX_EPOCH_JD) * 86_400_000.).round() as u64;
+
+    writer.write_key_f64("ARRAYX", array_xyz[0], "Array centre geocentric X (m)")?;
+    writer.write_key_f64("ARRAYY", array_xyz[1], "Array centre geocentric Y (m)")?;
+    writer.write_key_f64("ARRAYZ", array_xyz[2], "Array centre geocentric Z (m)")?;
+    writer.write_key_f64(
+        "GSTIA0",
+        get_gmst_rad(jd_midnight).to_degrees(),
+        "GST at 0h on RDATE (deg)",
+    )?;
+    writer.write_key_f64("DEGPDY", 360.985_644_973_3, "Earth rotation rate (deg/day)")?;
+    writer.write_key_f64(
+        "FREQ",
+        context.coarse_chans[0].chan_start_hz as f64
+            + metafits_context.corr_fine_chan_width_hz as f64 / 2.,
+        "",
+    )?;
+    writer.write_key_str(
+        "RDATE",
+        &format_unix_time_ms(jd_midnight_unix_time_ms, "%Y-%m-%d"),
+        "",
+    )?;
+    writer.write_key_f64("POLARX", 0., "")?;
+    writer.write_key_f64("POLARY", 0., "")?;
+    writer.write_key_f64("UT1UTC", 0., "")?;
+    writer.write_key_f64("DATUTC", 0., "")?;
+    writer.write_key_str("TIMSYS", "UTC", "")?;
+    writer.write_key_str("ARRNAM", "MWA", "")?;
+    writer.write_key_i64("NUMORB", 0, "")?;
+    writer.write_key_i64("NOPCAL", 0, "")?;
+    writer.write_key_i64("FREQID", -1, "")?;
+    writer.write_key_f64("IATUTC", tai_minus_utc_s.round(), "")?;
+
+    // STABXYZ is relative to the array centre, with X towards Greenwich
+    let (sin_lon, cos_lon) = MWA_LONGITUDE_RADIANS.sin_cos();
+    let stabxyz: Vec<f64> = geometry
+        .antenna_xyz
+        .iter()
+        .flat_map(|xyz| {
+            vec![
+                xyz[0] * cos_lon - xyz[1] * sin_lon,
+                xyz[0] * sin_lon + xyz[1] * cos_lon,
+                xyz[2],
+            ]
+        })
+        .collect();
+
+    let antennas = &metafits_context.antennas;
+    writer.write_col_str(
+        1,
+        &antennas
+            .iter()
+            .map(|a| a.tile_name.clone())
+            .collect::<Vec<_>>(),
+    )?;
+    writer.write_col_f64(2, &stabxyz)?;
+    writer.write_col_i64(3, &(1..=num_ants as i64).collect::<Vec<_>>())?;
+    writer.write_col_i64(4, &vec![0; num_ants])?;
+    writer.write_col_f32(5, &vec![0.; num_ants])?;
+    writer.write_col_str(6, &vec!["X".to_string(); num_ants])?;
+    writer.write_col_f32(7, &vec![0.; num_ants])?;
+    writer.write_col_f32(8, &vec![0.; num_ants])?;
+    writer.write_col_str(9, &vec!["Y".to_string(); num_ants])?;
+    writer.write_col_f32(10, &vec![90.; num_ants])?;
+    writer.write_col_f32(11, &vec![0.; num_ants])?;
+
+    Ok(())
+}
+
+/// The centre of a range of timesteps, as a UNIX time in (fractional) milliseconds.
+fn get_centre_unix_time_ms(context: &CorrelatorContext, timesteps: std::ops::Range<usize>) -> f64 {
+    let num_timesteps = timesteps.len() as f64;
+    let sum_ms: f64 = context.timesteps[timesteps]
+        .iter()
+        .map(|t| t.unix_time_ms as f64)
+        .sum();
+
+    sum_ms / num_timesteps + context.metafits_context.corr_int_time_ms as f64 / 2.
+}
+
+/// Format a UNIX time with a chrono format string.
+fn format_unix_time_ms(unix_time_ms: u64, format: &str) -> String {
+    chrono::NaiveDateTime::from_timestamp(
+        (unix_time_ms / 1000) as i64,
+        (unix_time_ms % 1000) as u32 * 1_000_000,
+    )
+    .format(format)
+    .to_string()
+}
+
+/// Convert a UNIX time in milliseconds to a Julian date.
+pub(crate) fn get_julian_date(unix_time_ms: f64) -> f64 {
+    unix_time_ms / 86_400_000. + UNIX_EPOCH_JD
+}
+
+/// Greenwich mean sidereal time at a (UT1 ~ UTC) Julian date, in radians within [0, 2π).
+pub(crate) fn get_gmst_rad(jd: f64) -> f64 {
+    let gmst_deg = 280.460_618_37 + 360.985_647_366_29 * (jd - 2_451_545.0);
+    gmst_deg.rem_euclid(360.).to_radians()
+}
+
+/// Convert a position east, north and up of the array centre into local XYZ, where X points to
+/// the local meridian on the equator, Y east and Z to the north pole.
+pub(crate) fn get_local_xyz(
+    east_m: f64,
+    north_m: f64,
+    height_m: f64,
+    latitude_rad: f64,
+) -> [f64; 3] {
+    let (sin_lat, cos_lat) = latitude_rad.sin_cos();
+    [
+        -sin_lat * north_m + cos_lat * height_m,
+        east_m,
+        cos_lat * north_m + sin_lat * height_m,
+    ]
+}
+
+/// Project a local XYZ onto the UVW axes of a direction at an hour angle and declination.
+pub(crate) fn get_uvw(xyz: &[f64; 3], hour_angle_rad: f64, dec_rad: f64) -> [f64; 3] {
+    let (sin_ha, cos_ha) = hour_angle_rad.sin_cos();
+    let (sin_dec, cos_dec) = dec_rad.sin_cos();
+    let [x, y, z] = *xyz;
+    [
+        sin_ha * x + cos_ha * y,
+        -sin_dec * cos_ha * x + sin_dec * sin_ha * y + cos_dec * z,
+        cos_dec * cos_ha * x - cos_dec * sin_ha * y + sin_dec * z,
+    ]
+}
+
+/// Geocentric (WGS84) XYZ of a latitude, longitude and height, in metres.
+pub(crate) fn get_geocentric_xyz(latitude_rad: f64, longitude_rad: f64, height_m: f64) -> [f64; 3] {
+    const WGS84_A: f64 = 6_378_137.0;
+    const WGS84_F: f64 = 1. / 298.257_223_563;
+    let e2 = WGS84_F * (2. - WGS84_F);
+    let (sin_lat, cos_lat) = latitude_rad.sin_cos();
+    let n = WGS84_A / (1. - e2 * sin_lat * sin_lat).sqrt();
+
+    [
+        (n + height_m) * cos_lat * longitude_rad.cos(),
+        (n + height_m) * cos_lat * longitude_rad.sin(),
+        (n * (1. - e2) + height_m) * sin_lat,
+    ]
+}
+
+/// Encode a baseline's (0 based) antenna indices as a UVFITS BASELINE parameter: 256 * ant1 + ant2
+/// (counting antennas from 1), or 2048 * ant1 + ant2 + 65536 when an antenna number exceeds 255.
+pub(crate) fn encode_uvfits_baseline(ant1_index: usize, ant2_index: usize) -> f32 {
+    let (ant1, ant2) = (ant1_index + 1, ant2_index + 1);
+    if ant1 < 256 && ant2 < 256 {
+        (256 * ant1 + ant2) as f32
+    } else {
+        (2048 * ant1 + ant2 + 65536) as f32
+    }
+}
@@ -0,0 +1,214 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/*!
+Unit tests for writing UVFITS files
+*/
+#[cfg(test)]
+use super::*;
+use float_cmp::*;
+
+#[test]
+fn test_encode_uvfits_baseline() {
+    assert_eq!(encode_uvfits_baseline(0, 0), 257.);
+    assert_eq!(encode_uvfits_baseline(0, 127), 384.);
+    assert_eq!(encode_uvfits_baseline(254, 254), 65535.);
+    // Antenna numbers above 255 need the larger encoding
+    assert_eq!(encode_uvfits_baseline(0, 255), (2048 + 256 + 65536) as f32);
+    assert_eq!(
+        encode_uvfits_baseline(511, 511),
+        (2048 * 512 + 512 + 65536) as f32
+    );
+}
+
+#[test]
+fn test_julian_date_and_sidereal_time() {
+    assert!(approx_eq!(
+        f64,
+        get_julian_date(0.),
+        2_440_587.5,
+        F64Margin::default()
+    ));
+    // J2000.0 is 2000-01-01 12:00 TT; GMST then is about 280.46 degrees
+    assert!(approx_eq!(
+        f64,
+        get_gmst_rad(2_451_545.0).to_degrees(),
+        280.460_618_37,
+        epsilon = 1e-6
+    ));
+    // One sidereal day later, GMST is the same
+    assert!(approx_eq!(
+        f64,
+        get_gmst_rad(2_451_545.0 + 0.997_269_566_3),
+        get_gmst_rad(2_451_545.0),
+        epsilon = 1e-6
+    ));
+}
+
+#[test]
+fn test_get_uvw() {
+    // At zenith (HA 0, Dec = latitude), a horizontal baseline has no w
+    let east = get_local_xyz(100., 0., 0., MWA_LATITUDE_RADIANS);
+    let uvw = get_uvw(&east, 0., MWA_LATITUDE_RADIANS);
+    assert!(approx_eq!(f64, uvw[0], 100., epsilon = 1e-9));
+    assert!(approx_eq!(f64, uvw[1], 0., epsilon = 1e-9));
+    assert!(approx_eq!(f64, uvw[2], 0., epsilon = 1e-9));
+
+    let north = get_local_xyz(0., 100., 0., MWA_LATITUDE_RADIANS);
+    let uvw = get_uvw(&north, 0., MWA_LATITUDE_RADIANS);
+    assert!(approx_eq!(f64, uvw[0], 0., epsilon = 1e-9));
+    assert!(approx_eq!(f64, uvw[1], 100., epsilon = 1e-9));
+    assert!(approx_eq!(f64, uvw[2], 0., epsilon = 1e-9));
+
+    // A vertical baseline points straight at zenith
+    let up = get_local_xyz(0., 0., 10., MWA_LATITUDE_RADIANS);
+    let uvw = get_uvw(&up, 0., MWA_LATITUDE_RADIANS);
+    assert!(approx_eq!(f64, uvw[2], 10., epsilon = 1e-9));
+
+    // Baseline lengths are preserved at any hour angle and declination
+    let xyz = get_local_xyz(30., -40., 5., MWA_LATITUDE_RADIANS);
+    let uvw = get_uvw(&xyz, 1.2, -0.3);
+    let length = |v: [f64; 3]| (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]).sqrt();
+    assert!(approx_eq!(f64, length(uvw), length(xyz), epsilon = 1e-9));
+}
+
+#[test]
+fn test_get_geocentric_xyz() {
+    let xyz = get_geocentric_xyz(
+        MWA_LATITUDE_RADIANS,
+        MWA_LONGITUDE_RADIANS,
+        MWA_ALTITUDE_METRES,
+    );
+    assert!(approx_eq!(f64, xyz[0], -2_559_454.08, epsilon = 1.));
+    assert!(approx_eq!(f64, xyz[1], 5_095_372.14, epsilon = 1.));
+    assert!(approx_eq!(f64, xyz[2], -2_849_057.18, epsilon = 1.));
+}
+
+#[test]
+fn test_uvfits_layout() {
+    let layout = UvfitsLayout::new(8256, 4, 24, 32, 10, 4, 2).unwrap();
+    assert_eq!(layout.num_out_chans, 24 * 16);
+    assert_eq!(layout.num_out_timesteps, 3);
+    assert_eq!(layout.get_timestep_range(2), 8..10);
+    assert_eq!(layout.get_group_floats(), 5 + 24 * 16 * 4 * 3);
+
+    for (time_average, freq_average) in &[(0, 1), (1, 0), (1, 3)] {
+        assert!(matches!(
+            UvfitsLayout::new(8256, 4, 24, 32, 10, *time_average, *freq_average),
+            Err(UvfitsError::InvalidAveraging { .. })
+        ));
+    }
+}
+
+#[test]
+fn test_accumulate_block() {
+    // 2 baselines, 2 coarse channels of 4 fine channels averaged by 2, 1 pol
+    let layout = UvfitsLayout::new(2, 1, 2, 4, 2, 2, 2).unwrap();
+    let mut spare = Vec::new();
+    let mut accumulator = get_accumulator(&mut spare, &layout);
+    let data: Vec<f32> = (0..2 * 4 * 2).map(|i| i as f32).collect();
+
+    // The same block from two timesteps, into the second coarse channel
+    accumulate_block(&layout, 1, &data, &mut accumulator);
+    accumulate_block(&layout, 1, &data, &mut accumulator);
+
+    assert_eq!(accumulator.counts, vec![0, 0, 4, 4]);
+    // Baseline 0, output channel 2 is fine channels 0 and 1: (0 + 2) * 2, (1 + 3) * 2
+    assert_eq!(&accumulator.sums[4..8], &[4., 8., 20., 24.]);
+    assert_eq!(&accumulator.sums[12..16], &[36., 40., 52., 56.]);
+    assert_eq!(&accumulator.sums[..4], &[0.; 4]);
+
+    // Spare accumulators come back zeroed
+    spare.push(accumulator);
+    let accumulator = get_accumulator(&mut spare, &layout);
+    assert!(accumulator.sums.iter().all(|s| *s == 0.));
+    assert!(accumulator.counts.iter().all(|c| *c == 0));
+}
+
+/// Read the data of one group of a UVFITS file
+fn read_group(fptr: &mut fitsio::FitsFile, group: i64, num_floats: usize) -> Vec<f32> {
+    let mut data = vec![0.; num_floats];
+    let mut status = 0;
+    unsafe {
+        fitsio_sys::ffmahd(fptr.as_raw(), 1, std::ptr::null_mut(), &mut status);
+        fitsio_sys::ffgpve(
+            fptr.as_raw(),
+            group,
+            1,
+            num_floats as i64,
+            0.,
+            data.as_mut_ptr(),
+            &mut 0,
+            &mut status,
+        );
+    }
+    assert_eq!(status, 0);
+    data
+}
+
+#[test]
+fn test_write_uvfits() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let gpuboxfiles =
+        vec!["test_files/1101503312_1_timestep/1101503312_20141201210818_gpubox01_00.fits"];
+    let context = CorrelatorContext::new(&metafits_filename, &gpuboxfiles)
+        .expect("Failed to create CorrelatorContext");
+    let data_by_bl = context.read_by_baseline(0, 0).expect("Error!");
+    let num_baselines = context.metafits_context.num_baselines;
+    let num_fine_chans = context.metafits_context.num_corr_fine_chans_per_coarse;
+    let baseline_floats = num_fine_chans * 8;
+    let dir = tempdir::TempDir::new("mwalib_uvfits_test").unwrap();
+    let uvfits_filename = dir.path().join("test.uvfits");
+
+    for freq_average in &[1, 2] {
+        let options = UvfitsWriterOptions {
+            freq_average: *freq_average,
+            phase_rotate: false,
+            overwrite: true,
+            ..Default::default()
+        };
+        let num_groups = write_uvfits(&context, &uvfits_filename, &options).unwrap();
+        assert_eq!(num_groups, num_baselines);
+
+        let mut fptr = fitsio::FitsFile::open(&uvfits_filename).unwrap();
+        let hdu = fptr.primary_hdu().unwrap();
+        let gcount: i64 = hdu.read_key(&mut fptr, "GCOUNT").unwrap();
+        let pcount: i64 = hdu.read_key(&mut fptr, "PCOUNT").unwrap();
+        let naxis4: i64 = hdu.read_key(&mut fptr, "NAXIS4").unwrap();
+        assert_eq!(gcount, num_baselines as i64);
+        assert_eq!(pcount, 5);
+        assert_eq!(naxis4, (num_fine_chans / freq_average) as i64);
+
+        // Check the last baseline, which is a cross correlation
+        let baseline_index = num_baselines - 1;
+        let expected = &data_by_bl[baseline_index * baseline_floats..][..baseline_floats];
+        let group = read_group(
+            &mut fptr,
+            baseline_index as i64 + 1,
+            naxis4 as usize * 4 * 3,
+        );
+        for (out_chan, vis) in group.chunks_exact(12).enumerate() {
+            for (uvfits_pol, mwalib_pol) in UVFITS_POL_ORDER.iter().enumerate() {
+                for ri in 0..2 {
+                    let sum: f32 = (0..*freq_average)
+                        .map(|f| expected[(out_chan * freq_average + f) * 8 + mwalib_pol * 2 + ri])
+                        .sum();
+                    assert!(approx_eq!(
+                        f32,
+                        vis[uvfits_pol * 3 + ri],
+                        sum / *freq_average as f32,
+                        epsilon = 1e-3
+                    ));
+                }
+                assert_eq!(vis[uvfits_pol * 3 + 2].abs(), *freq_average as f32);
+            }
+        }
+    }
+
+    // Without overwrite, an existing file is an error
+    assert!(matches!(
+        write_uvfits(&context, &uvfits_filename, &UvfitsWriterOptions::default()),
+        Err(UvfitsError::OutputExists(_))
+    ));
+}
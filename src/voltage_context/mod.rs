@@ -8,6 +8,8 @@ The main interface to MWA data.
 use crate::coarse_channel::*;
 use crate::error::*;
 use crate::metafits_context::*;
+use crate::pipeline::WorkUnit;
+use crate::shard::{self, Shard, ShardError, ShardFile};
 use crate::timestep::*;
 use crate::voltage_files::*;
 use crate::*;
@@ -72,6 +74,9 @@ pub struct VoltageContext {
     /// number, batch number and HDU index are everything needed to find the
     /// correct HDU out of all voltage files.
     pub(crate) voltage_time_map: VoltageFileTimeMap,
+
+    /// Size of each voltage file in bytes. All voltage files are the same size.
+    pub(crate) voltage_file_size: u64,
 }
 
 impl VoltageContext {
@@ -209,9 +214,86 @@ impl VoltageContext {
             num_fine_chans_per_coarse,
             voltage_batches: voltage_info.gpstime_batches,
             voltage_time_map: voltage_info.time_map,
+            voltage_file_size: voltage_info.file_size,
         })
     }
 
+    /// Split this observation's work units into `num_shards` shards of whole voltage files,
+    /// balanced by byte volume. Each shard has every timestep's file for its coarse channels, so
+    /// its files can be opened as a context of their own. See `shard::plan_shards`.
+    ///
+    /// # Arguments
+    ///
+    /// * `num_shards` - number of shards to make.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * Result containing `num_shards` `Shard`s, or a `ShardError`.
+    ///
+    ///
+    pub fn plan_shards(&self, num_shards: usize) -> Result<Vec<Shard>, ShardError> {
+        let mut files: Vec<ShardFile> = Vec::new();
+
+        // Each voltage file holds exactly one timestep of one coarse channel
+        for (timestep_index, timestep) in self.timesteps.iter().enumerate() {
+            let channel_map = match self.voltage_time_map.get(&timestep.gps_time_ms) {
+                Some(m) => m,
+                None => continue,
+            };
+
+            for (coarse_chan_index, coarse_chan) in self.coarse_chans.iter().enumerate() {
+                if let Some(filename) = channel_map.get(&coarse_chan.rec_chan_number) {
+                    files.push(ShardFile {
+                        filename: filename.clone(),
+                        channel_identifier: coarse_chan.rec_chan_number,
+                        timestep_times_ms: vec![timestep.gps_time_ms],
+                        work_units: vec![WorkUnit {
+                            timestep_index,
+                            coarse_chan_index,
+                        }],
+                        num_bytes: self.voltage_file_size,
+                    });
+                }
+            }
+        }
+
+        shard::plan_shards(files, num_shards)
+    }
+
+    /// Get the work units of a shard, indexed against this context. The shard may come from a
+    /// plan made on another context of the same observation, e.g. this context may have been
+    /// opened with only the shard's files. Work units this context does not have are left out.
+    ///
+    /// # Arguments
+    ///
+    /// * `shard` - the shard.
+    ///
+    ///
+    /// # Returns
+    ///
+    /// * The shard's work units, grouped by file.
+    ///
+    ///
+    pub fn get_shard_work_units(&self, shard: &Shard) -> Vec<WorkUnit> {
+        shard
+            .get_work_unit_keys()
+            .iter()
+            .filter_map(|(channel_identifier, gps_time_ms)| {
+                Some(WorkUnit {
+                    timestep_index: self
+                        .timesteps
+                        .iter()
+                        .position(|t| t.gps_time_ms == *gps_time_ms)?,
+                    coarse_chan_index: self
+                        .coarse_chans
+                        .iter()
+                        .position(|c| c.rec_chan_number == *channel_identifier)?,
+                })
+            })
+            .collect()
+    }
+
     /*
     /// Read a single gps time / coarse channel worth of data
     /// The output data are in order:
@@ -142,6 +142,59 @@ fn test_context_legacy_v1() {
     assert_eq!(context.voltage_batches.len(), 2);
 }
 
+#[test]
+fn test_context_plan_shards() {
+    let metafits_filename = "test_files/1101503312_1_timestep/1101503312.metafits";
+    let temp_dir = tempdir::TempDir::new("voltage_test").unwrap();
+
+    // 2 timesteps x 2 coarse channels, one file each
+    let temp_filenames: Vec<String> = [
+        "1101503312_1101503312_ch123.dat",
+        "1101503312_1101503312_ch124.dat",
+        "1101503312_1101503313_ch123.dat",
+        "1101503312_1101503313_ch124.dat",
+    ]
+    .iter()
+    .map(|f| generate_test_voltage_file(&temp_dir, f, 2, 256).unwrap())
+    .collect();
+
+    let context = VoltageContext::new(&metafits_filename.to_string(), &temp_filenames)
+        .expect("Failed to create VoltageContext");
+    let file_size = std::fs::metadata(&temp_filenames[0]).unwrap().len();
+
+    let shards = context.plan_shards(2).expect("Failed to plan shards");
+
+    // Equal sized files are split evenly
+    assert_eq!(shards.len(), 2);
+    for shard in &shards {
+        assert_eq!(shard.files.len(), 2);
+        assert_eq!(shard.num_bytes, 2 * file_size);
+    }
+    let mut all_filenames: Vec<String> = shards.iter().flat_map(|s| s.get_filenames()).collect();
+    all_filenames.sort();
+    assert_eq!(all_filenames, temp_filenames);
+
+    // A context opened on just one shard's files finds the same work units
+    let shard_context =
+        VoltageContext::new(&metafits_filename.to_string(), &shards[1].get_filenames())
+            .expect("Failed to create VoltageContext");
+    let shard_work_units = shard_context.get_shard_work_units(&shards[1]);
+    assert_eq!(shard_work_units.len(), 2);
+    for (work_unit, (rec_chan_number, gps_time_ms)) in shard_work_units
+        .iter()
+        .zip(shards[1].get_work_unit_keys().iter())
+    {
+        assert_eq!(
+            shard_context.coarse_chans[work_unit.coarse_chan_index].rec_chan_number,
+            *rec_chan_number
+        );
+        assert_eq!(
+            shard_context.timesteps[work_unit.timestep_index].gps_time_ms,
+            *gps_time_ms
+        );
+    }
+}
+
 #[test]
 fn test_context_mwax_v2() {
     // Open the test mwax file